@@ -24,7 +24,8 @@ namespace gr {
     class GR_FOSPHOR_API base_sink_c : public gr::sync_block
     {
      protected:
-      base_sink_c(const char *name = NULL);
+      base_sink_c(const char *name = NULL, int n_inputs = 1,
+                  bool real_input = false);
 
      public:
 
@@ -41,12 +42,21 @@ namespace gr {
         RATIO_UP,
         RATIO_DOWN,
         FREEZE_TOGGLE,
+        AUTO_RANGE_TOGGLE,
+        TIME_BACK,
+        TIME_FORWARD,
       };
 
       enum mouse_action_t {
         CLICK,
       };
 
+      enum hidden_mode_t {
+        HIDDEN_DISCARD,		/*!< Don't process for display at all */
+        HIDDEN_DECIMATE,	/*!< Process one batch out of N */
+        HIDDEN_FULL,		/*!< Keep processing everything */
+      };
+
       virtual void execute_ui_action(enum ui_action_t action) = 0;
       virtual void execute_mouse_action(enum mouse_action_t action, int x, int y) = 0;
 
@@ -56,6 +66,295 @@ namespace gr {
       virtual void set_frequency_span(const double span) = 0;
 
       virtual void set_fft_window(const gr::fft::window::win_type win) = 0;
+
+      /*!
+       * \brief Use a polyphase filter bank instead of the FFT window
+       *
+       * Each spectrum is then computed from several consecutive blocks
+       * weighted by a prototype filter (windowed sinc) and folded,
+       * for much lower leakage at the same resolution.
+       *
+       * \param taps_per_bin Blocks per spectrum (up to 8), 0 to disable
+       */
+      virtual void set_filter_bank(int taps_per_bin) = 0;
+
+      /*!
+       * \brief Select what to do with samples while the display is hidden
+       *
+       * Outputs (shared memory, network, archive) are always kept fed.
+       * The default, HIDDEN_FULL, keeps the display (max hold, history)
+       * current; the other modes save power but lose what came while
+       * hidden.
+       *
+       * \param mode Hidden display policy
+       * \param decimation N for HIDDEN_DECIMATE
+       */
+      virtual void set_hidden_mode(enum hidden_mode_t mode,
+                                   int decimation = 8) = 0;
+
+      /*!
+       * \brief Limit the display refresh rate
+       *
+       * The display is only redrawn when there is new data, a settings
+       * change or a GUI event, and never faster than this.
+       *
+       * \param max_fps Maximum frames per second, 0 for no limit
+       */
+      virtual void set_frame_rate(float max_fps) = 0;
+
+      /*!
+       * \brief Set the buffer swap interval (0 = no vsync, 1 = vsync, ...)
+       *
+       * Only the GLFW sink can change it, Qt sets it when creating the
+       * context.
+       *
+       * \param interval Frames to wait for on swap, -1 for driver default
+       */
+      virtual void set_swap_interval(int interval) = 0;
+
+      /*!
+       * \brief Follow the signal level automatically
+       *
+       * The noise floor and peak level are measured on the device at each
+       * frame and the reference level / dB per division are adjusted with
+       * some hysteresis to keep both visible. Any manual change of the
+       * power range turns it off.
+       *
+       * \param enable Enable / disable the automatic power range
+       */
+      virtual void set_auto_range(bool enable) = 0;
+
+      /*!
+       * \brief Detect peaks and publish them on the "peaks" message port
+       *
+       * Local maxima of the live spectrum above the noise floor are found
+       * on the device. Each input gets a message (pair "peaks" . dict)
+       * with "stream", "noise_floor" and "peaks", a vector of dicts with
+       * "freq", "bw", "power" and "max_hold", strongest first.
+       *
+       * \param enable Enable / disable the detection
+       * \param threshold_db Minimum level above the noise floor
+       * \param rate Messages per second (per input)
+       * \param max_peaks Maximum number of peaks per message
+       */
+      virtual void set_peak_detection(bool enable, float threshold_db = 10.0f,
+                                      float rate = 10.0f, int max_peaks = 16) = 0;
+
+      /*!
+       * \brief Measure the power of frequency bands
+       *
+       * The linear power of each band is integrated on the device for
+       * every spectrum. Bands are shown as channels with a readout and
+       * each input gets a message on the "bands" port (pair "bands" .
+       * dict) with "stream" and "bands", a vector of dicts with "freq",
+       * "bw", "mean", "peak" (dB) and "duty" (fraction of the spectra
+       * above the threshold), all over the spectra since the previous
+       * message.
+       *
+       * \param freqs Center frequencies (same unit as the frequency range),
+       *              empty to disable (7 bands max)
+       * \param bandwidths Width of each band
+       * \param duty_threshold_db Level counted as active for the duty cycle
+       * \param rate Messages per second (per input)
+       */
+      virtual void set_band_power(const std::vector<double> &freqs,
+                                  const std::vector<double> &bandwidths,
+                                  float duty_threshold_db = -60.0f,
+                                  float rate = 10.0f) = 0;
+
+      /*!
+       * \brief Measure the spectrum occupancy
+       *
+       * Every spectrum is compared with the threshold on the device and
+       * the fraction of time each bin is above it is rolled over the
+       * window. It can be drawn as a heat strip under the spectrum and
+       * each input gets a message on the "occupancy" port (pair
+       * "occupancy" . dict) with "stream", "window" (seconds actually
+       * covered) and "occupancy", an f32vector of 1024 values in [0,1],
+       * lowest frequency first.
+       *
+       * \param enable Enable / disable the measurement
+       * \param threshold_db Level above which a bin is occupied
+       * \param window Rolling window (seconds, with the frequency span
+       *               being the sample rate). Limited to 2^30 spectra
+       *               of 1024 samples, about 3 hours at 100 Msps
+       * \param rate Messages per second (per input), 0 for none
+       * \param draw Also draw the heat strip
+       */
+      virtual void set_occupancy(bool enable, float threshold_db = -60.0f,
+                                 float window = 60.0f, float rate = 1.0f,
+                                 bool draw = true) = 0;
+
+      /*!
+       * \brief Measure the spectral kurtosis
+       *
+       * The power and squared power of every spectrum are summed on the
+       * device and at each frame give, per bin, the spectral kurtosis
+       * estimator: about 1 for noise, lower for steady carriers and
+       * higher for impulsive or pulsed signals, even buried in the noise.
+       * It can be drawn over the spectrum (full scale is 4) and / or as
+       * a waterfall (one row per frame) instead of the power one. Each
+       * input gets a message on the "kurtosis" port (pair "kurtosis" .
+       * dict) with "stream", "spectra" (behind the estimate), "kurtosis"
+       * and "std_dev" (of the power, dB), f32vectors of 1024 values,
+       * lowest frequency first.
+       *
+       * \param enable Enable / disable the measurement
+       * \param rate Messages per second (per input), 0 for none
+       * \param draw Draw the kurtosis trace
+       * \param waterfall Show the kurtosis waterfall
+       */
+      virtual void set_spectral_kurtosis(bool enable, float rate = 1.0f,
+                                         bool draw = true,
+                                         bool waterfall = false) = 0;
+
+      /*!
+       * \brief Measure the cross-spectrum of the first two inputs
+       *
+       * Auto and cross powers are exponentially averaged on the device
+       * over every spectrum, giving the per-bin coherence and phase
+       * difference. The second input tile then shows the phase as a
+       * waterfall (one row per frame) and the coherence over its
+       * spectrum, and messages go on the "cross_spectrum" port (pair
+       * "cross_spectrum" . dict) with "coherence" (in [0,1]), "phase"
+       * (radians, first input leading is positive) and "cross_power"
+       * (dB), f32vectors of 1024 values, lowest frequency first.
+       *
+       * \param enable Enable / disable the measurement
+       * \param alpha Averaging factor per spectrum, 0 for the same as
+       *              the live spectrum
+       * \param rate Messages per second, 0 for none
+       * \param draw Also draw the phase waterfall and coherence
+       */
+      virtual void set_cross_spectrum(bool enable, float alpha = 0.0f,
+                                      float rate = 1.0f, bool draw = true) = 0;
+
+      /*!
+       * \brief Check every spectrum against a limit mask
+       *
+       * The mask is piecewise linear between the given points (flat
+       * beyond the end ones) and is drawn along with the violations. Each
+       * frame with violations gets a message per input on the "mask" port
+       * (pair "mask_violation" . dict) with "stream", "time" (seconds since
+       * the epoch) and "violations", a vector of dicts with "freq", "bw",
+       * "margin" (dB above the mask) and "count" (spectra above the mask).
+       *
+       * \param freqs Frequencies of the mask points, in increasing order
+       *              (same unit as the frequency range), empty to disable
+       * \param levels_db Limit at each point (dB, same scale as the
+       *                  reference level)
+       */
+      virtual void set_spectrum_mask(const std::vector<double> &freqs,
+                                     const std::vector<float> &levels_db) = 0;
+
+      /*!
+       * \brief Export per bin percentiles of the power histogram
+       *
+       * At each interval the histogram is reduced on the device and each
+       * input gets a message on the "noise_floor" port (pair "noise_floor"
+       * . dict) with "stream", "percentile" and "low", "p50", "p90" as
+       * f32vectors of 1024 values (dB, lowest frequency first). The low
+       * percentile is the noise floor estimate.
+       *
+       * \param enable Enable / disable the export
+       * \param percentile Low percentile (fraction, e.g. 0.1 for P10)
+       * \param interval Seconds between two exports
+       * \param draw Also draw the noise floor as a trace
+       */
+      virtual void set_noise_floor(bool enable, float percentile = 0.1f,
+                                   float interval = 1.0f, bool draw = true) = 0;
+
+      /*!
+       * \brief Publish processed frames to a POSIX shared memory segment
+       *
+       * \param name Segment name (e.g. "fosphor"), empty to disable
+       */
+      virtual void set_shm_output(const std::string &name) = 0;
+
+      /*!
+       * \brief Stream processed frames to remote displays
+       *
+       * \param endpoint "tcp:HOST:PORT", "udp:HOST:PORT" or "unix:PATH",
+       *                 empty to disable
+       * \param bits Quantization of the dB values (8 or 16)
+       * \param histogram Also stream the histogram (as deltas)
+       */
+      virtual void set_net_output(const std::string &endpoint,
+                                  int bits = 8, bool histogram = false) = 0;
+
+      /*!
+       * \brief Record the waterfall to a spectrogram archive
+       *
+       * Rows are quantized against a fixed dB range, compressed in
+       * chunks and written from a background thread.
+       *
+       * \param path Archive file name, empty to stop recording
+       * \param bits Quantization (8 or 16)
+       * \param db_min Power mapped to the lowest quantized value
+       * \param db_max Power mapped to the highest quantized value
+       */
+      virtual void set_rec_output(const std::string &path, int bits = 8,
+                                  float db_min = -120.0f, float db_max = 0.0f) = 0;
+
+      /*!
+       * \brief Keep long-term min / mean / max spectrum rollups
+       *
+       * Every spectrum is accounted for, per bin, over 1 s, 1 min and
+       * 1 h periods, kept respectively for an hour, a week and a year in
+       * a fixed size file written from a background thread. Re-opening
+       * a file for the same frequency range carries on with its history.
+       *
+       * \param path Rollups file name, empty to stop
+       */
+      virtual void set_rollup_output(const std::string &path) = 0;
+
+      /*!
+       * \brief Keep the last seconds of raw samples for re-examination
+       *
+       * While the display is frozen, incoming samples keep going in the
+       * ring and the operator can step back through it (TIME_BACK /
+       * TIME_FORWARD, a quarter of the waterfall at a time). The shown
+       * span is processed again whenever it or the processing settings
+       * (FFT window, filter bank, power range, zoom) change.
+       *
+       * Replayed spectra are only displayed : measurements, messages,
+       * outputs and the band trigger keep to the live ones.
+       *
+       * \param length Seconds of samples to keep, 0 to disable
+       * \param hugepages Try to allocate the ring in huge pages
+       */
+      virtual void set_time_machine(float length, bool hugepages = false) = 0;
+
+      /*!
+       * \brief Freeze the display and show the time machine content
+       *
+       * \param seconds How long before the newest sample the shown
+       *                span ends
+       */
+      virtual void time_machine_seek(float seconds) = 0;
+
+      /*!
+       * \brief Record raw samples around spectral triggers
+       *
+       * Triggers are checked on every processed spectrum for the band
+       * power (measured bands, see set_band_power) and on every frame for
+       * new peaks (see set_peak_detection). The samples from 'pre' seconds
+       * before the trigger to 'post' seconds after the last one are
+       * written as a SigMF recording (<path>_<time>.sigmf-data and
+       * .sigmf-meta) by a background thread, triggers being annotated.
+       *
+       * \param path Recordings name prefix, empty to disable
+       * \param pre Seconds recorded before the trigger
+       * \param post Seconds recorded after the last trigger
+       * \param band Trigger on the band power
+       * \param band_threshold_db Band power triggering a recording
+       * \param new_peaks Trigger on peaks absent from the previous frame
+       */
+      virtual void set_trigger_capture(const std::string &path,
+                                       float pre = 0.1f, float post = 0.1f,
+                                       bool band = true,
+                                       float band_threshold_db = -40.0f,
+                                       bool new_peaks = false) = 0;
     };
 
   } // namespace fosphor
@@ -33,8 +33,14 @@ namespace gr {
        * constructor is in a private implementation
        * class. fosphor::glfw_sink_c::make is the public interface for
        * creating new instances.
+       *
+       * \param n_inputs Number of input streams, all processed in the
+       *                 same batched launches and displayed as tiles
+       * \param real_input Take float samples instead of complex ones and
+       *                   show DC to half the sample rate (the frequency
+       *                   range is still given for the whole band)
        */
-      static sptr make();
+      static sptr make(int n_inputs = 1, bool real_input = false);
     };
 
   } // namespace fosphor
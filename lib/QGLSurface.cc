@@ -45,13 +45,14 @@ QGLSurface::showEvent(QShowEvent *he)
 void
 QGLSurface::paintEvent(QPaintEvent *pe)
 {
-	/* Don't do anything */
+	/* Don't do anything, just ask for a redraw */
 
 	/*
 	 * The default implementation calls makeCurrent but here we want
-	 * _other_ threads to be current, so we need a dummy empty impl
-	 * for the paintEvent
+	 * _other_ threads to be current, so we need a dummy impl for the
+	 * paintEvent
 	 */
+	this->d_block->cb_redraw();
 }
 
 void
@@ -106,6 +107,15 @@ QGLSurface::keyPressEvent(QKeyEvent *ke)
 	case Qt::Key_Space:
 		this->d_block->execute_ui_action(qt_sink_c_impl::FREEZE_TOGGLE);
 		break;
+	case Qt::Key_R:
+		this->d_block->execute_ui_action(qt_sink_c_impl::AUTO_RANGE_TOGGLE);
+		break;
+	case Qt::Key_BracketLeft:
+		this->d_block->execute_ui_action(qt_sink_c_impl::TIME_BACK);
+		break;
+	case Qt::Key_BracketRight:
+		this->d_block->execute_ui_action(qt_sink_c_impl::TIME_FORWARD);
+		break;
 	}
 }
 
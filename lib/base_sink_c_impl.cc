@@ -11,13 +11,19 @@
 #include "config.h"
 #endif
 
+#include <math.h>
 #include <string.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <stdexcept>
+
 #include <gnuradio/io_signature.h>
 #include <gnuradio/thread/thread.h>
 
 #include "fifo.h"
+#include "iq_capture.h"
+#include "iq_ring.h"
 #include "base_sink_c_impl.h"
 
 #ifdef ENABLE_GLEW
@@ -33,13 +39,25 @@ extern "C" {
 namespace gr {
   namespace fosphor {
 
-base_sink_c::base_sink_c(const char *name)
+base_sink_c::base_sink_c(const char *name, int n_inputs, bool real_input)
   : gr::sync_block(name,
-                   gr::io_signature::make(1, 1, sizeof(gr_complex)),
+                   gr::io_signature::make(n_inputs, n_inputs,
+                                          real_input ? sizeof(float) : sizeof(gr_complex)),
                    gr::io_signature::make(0, 0, 0))
 {
+	/* Real samples are queued by pairs */
+	if (real_input)
+		set_output_multiple(2);
+
 	/* Register message ports */
 	message_port_register_out(pmt::mp("freq"));
+	message_port_register_out(pmt::mp("peaks"));
+	message_port_register_out(pmt::mp("bands"));
+	message_port_register_out(pmt::mp("noise_floor"));
+	message_port_register_out(pmt::mp("mask"));
+	message_port_register_out(pmt::mp("occupancy"));
+	message_port_register_out(pmt::mp("cross_spectrum"));
+	message_port_register_out(pmt::mp("kurtosis"));
 }
 
 
@@ -47,30 +65,62 @@ gr::thread::mutex base_sink_c_impl::s_boot_mutex;
 
 const int base_sink_c_impl::k_db_per_div[] = {1, 2, 5, 10, 20};
 
+const size_t base_sink_c_impl::k_tm_step = 256 * 1024;	/* Quarter waterfall */
 
-base_sink_c_impl::base_sink_c_impl()
-  : d_db_ref(0), d_db_per_div_idx(3),
+
+base_sink_c_impl::base_sink_c_impl(int n_inputs, bool real_input)
+  : d_visible(false), d_active(false), d_frozen(false),
+    d_n_inputs(n_inputs), d_real_input(real_input),
+    d_tm_ring(NULL),
+    d_cap(NULL), d_cap_processed(0), d_cap_offset(0), d_cap_frame(0),
+    d_cap_fresh(false),
+    d_wake(false), d_peaks_new(false), d_bands_new(false), d_occ_new(false),
+    d_xs_new(false), d_sk_new(false), d_mask_new(false), d_nf_pending(false),
+    d_db_ref(0), d_db_per_div_idx(3), d_auto_range(false),
     d_zoom_enabled(false), d_zoom_center(0.5), d_zoom_width(0.2),
-    d_ratio(0.35f), d_frozen(false), d_active(false), d_visible(false),
-    d_frequency(), d_fft_window(gr::fft::window::WIN_BLACKMAN_hARRIS)
+    d_ratio(0.35f),
+    d_frequency(), d_frequency_in(), d_fft_window(gr::fft::window::WIN_BLACKMAN_hARRIS),
+    d_pfb_taps(0),
+    d_hidden{HIDDEN_FULL, 8},
+    d_max_fps(60.0f), d_swap_interval(-1), d_peaks{false, 10.0f, 10.0f, 16},
+    d_bands{{}, {}, -60.0f, 10.0f},
+    d_occ{false, -60.0f, 60.0f, 1.0f, true}, d_xs{false, 0.0f, 1.0f, true},
+    d_sk{false, 1.0f, true, false}, d_nf{false, 0.1f, 1.0f, true},
+    d_net(), d_rec(), d_tm{0.0f, false, 0, false},
+    d_trig{"", 0.1f, 0.1f, true, -40.0f, false}
 {
-	/* Init FIFO */
-	this->d_fifo = new fifo(2 * 1024 * 1024);
+	int i;
+
+	/* Validate number of inputs */
+	if ((n_inputs < 1) || (n_inputs > FOSPHOR_MAX_STREAMS))
+		throw std::invalid_argument("fosphor: unsupported number of inputs");
+
+	/* Init FIFOs */
+	for (i=0; i<n_inputs; i++)
+		this->d_fifos.push_back(new fifo(2 * 1024 * 1024));
 
 	/* Init render options */
-	this->d_render_main = new fosphor_render();
-	fosphor_render_defaults(this->d_render_main);
+	this->d_render_main = new fosphor_render[n_inputs]();
+	this->d_render_zoom = new fosphor_render[n_inputs]();
+
+	for (i=0; i<n_inputs; i++)
+	{
+		fosphor_render_defaults(&this->d_render_main[i]);
+		this->d_render_main[i].stream = i;
 
-	this->d_render_zoom = new fosphor_render();
-	fosphor_render_defaults(this->d_render_zoom);
-	this->d_render_zoom->options &= ~(FRO_LABEL_PWR | FRO_LABEL_TIME);
+		fosphor_render_defaults(&this->d_render_zoom[i]);
+		this->d_render_zoom[i].stream = i;
+		this->d_render_zoom[i].options &= ~(FRO_LABEL_PWR | FRO_LABEL_TIME);
+	}
 }
 
 base_sink_c_impl::~base_sink_c_impl()
 {
-	delete this->d_render_zoom;
-	delete this->d_render_main;
-	delete this->d_fifo;
+	delete[] this->d_render_zoom;
+	delete[] this->d_render_main;
+
+	for (fifo *f : this->d_fifos)
+		delete f;
 }
 
 
@@ -96,11 +146,13 @@ void base_sink_c_impl::worker()
 		 *  implementations that don't like this) */
 		gr::thread::scoped_lock guard(s_boot_mutex);
 
-		this->d_fosphor = fosphor_init();
+		this->d_fosphor = fosphor_init_multi(this->d_n_inputs);
 		if (!this->d_fosphor) {
 			GR_LOG_ERROR(d_logger, "Failed to initialize fosphor");
 			goto error;
 		}
+
+		fosphor_set_real_input(this->d_fosphor, this->d_real_input);
 	}
 
 	this->settings_apply(~SETTING_DIMENSIONS);
@@ -110,6 +162,7 @@ void base_sink_c_impl::worker()
 	{
 		this->render();
 		this->glctx_poll();
+		this->frame_wait();
 	}
 
 error:
@@ -117,6 +170,12 @@ error:
 	if (this->d_fosphor)
 		fosphor_release(this->d_fosphor);
 
+	delete this->d_tm_ring;
+	this->d_tm_ring = NULL;
+
+	delete this->d_cap;
+	this->d_cap = NULL;
+
 	/* And GL context */
 	this->glctx_fini();
 }
@@ -135,23 +194,39 @@ base_sink_c_impl::render(void)
 	const int batch_max  = 1024;
 	const int max_iter   = 8;
 
-	int i, tot_len;
+	int i, s, tot_len;
+	uint32_t settings;
+	bool dirty;
 
 	/* Handle pending settings */
-	this->settings_apply(this->settings_get_and_reset_changed());
+	settings = this->settings_get_and_reset_changed();
+	this->settings_apply(settings);
+
+	dirty = (settings != 0);
+
+	/* Frozen : new processing settings apply to the shown span */
+	if (settings & (SETTING_FFT_WINDOW | SETTING_FILTER_BANK)) {
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		if (this->d_frozen)
+			this->d_tm.replay = true;
+	}
+
+	/* Process as much we can (all FIFOs move in lock step) */
+	tot_len = this->d_fifos[0]->used();
 
-	/* Process as much we can */
-	tot_len = this->d_fifo->used();
+	for (s=1; s<this->d_n_inputs; s++)
+		if (this->d_fifos[s]->used() < tot_len)
+			tot_len = this->d_fifos[s]->used();
 
 	for (i=0; i<max_iter && tot_len; i++)
 	{
-		gr_complex *data;
+		void *data[FOSPHOR_MAX_STREAMS];
 		int len;
 
 		/* How much can we get from FIFO in one block */
 		len = tot_len;
-		if (len > this->d_fifo->read_max_size())
-			len = this->d_fifo->read_max_size();
+		if (len > this->d_fifos[0]->read_max_size())
+			len = this->d_fifos[0]->read_max_size();
 
 		/* Adapt to valid size for fosphor */
 		len &= ~((batch_mult * fft_len) - 1);
@@ -164,30 +239,75 @@ base_sink_c_impl::render(void)
 		if (!len)
 			break;
 
+		if (this->d_tm_ring || this->d_cap || !this->d_frozen)
+			for (s=0; s<this->d_n_inputs; s++)
+				data[s] = this->d_fifos[s]->read_peek(len, false);
+
+		/* Everything goes by the capture, triggers come from live samples */
+		if (this->d_cap) {
+			if (!this->d_frozen) {
+				if (!this->d_cap_fresh)
+					this->d_cap_frame = this->d_cap->position();
+				this->d_cap_fresh  = true;
+				this->d_cap_offset = (int64_t)this->d_cap->position() - (int64_t)this->d_cap_processed;
+			}
+
+			this->d_cap->write(data, len);
+		}
+
+		/* Keep it in the time machine, frozen or not */
+		if (this->d_tm_ring) {
+			this->d_tm_ring->write(data, len);
+
+			/* The shown span doesn't move with new samples */
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			if (this->d_frozen)
+				this->d_tm.pos = std::min(this->d_tm.pos + len, this->d_tm_ring->length());
+		}
+
 		/* Send to process (if not frozen) */
 		if (!this->d_frozen) {
-			data = this->d_fifo->read_peek(len, false);
-			fosphor_process(this->d_fosphor, data, len);
+			fosphor_process_multi(this->d_fosphor, data, len);
+			this->d_cap_processed += len;
+			dirty = true;
+			this->d_peaks_new = true;
+			this->d_bands_new = true;
+			this->d_mask_new  = true;
+			this->d_occ_new   = true;
+			this->d_xs_new    = true;
+			this->d_sk_new    = true;
 		}
 
 		/* Discard */
-		this->d_fifo->read_discard(len);
+		for (s=0; s<this->d_n_inputs; s++)
+			this->d_fifos[s]->read_discard(len);
 	}
 
-	/* Are we visible ? */
+	/* Still a full batch left ? Don't wait for more */
+	if (tot_len >= (batch_mult * fft_len))
+		this->wake();
+
+	/* Frozen : show what was asked of the time machine */
+	if (this->d_frozen && this->time_machine_replay())
+		dirty = true;
+
+	/* Are we visible ? (and is there anything new to show) */
 	{
 		gr::thread::scoped_lock guard(this->d_render_mutex);
 
-		if (this->d_visible) {
+		if (this->d_visible && dirty) {
 			/* Clear everything */
 			glClearColor( 0.0f, 0.0f, 0.0f, 0.0f );
 			glClear(GL_COLOR_BUFFER_BIT);
 
 			/* Draw */
-			fosphor_draw(this->d_fosphor, this->d_render_main);
+			for (s=0; s<this->d_n_inputs; s++)
+			{
+				fosphor_draw(this->d_fosphor, &this->d_render_main[s]);
 
-			if (this->d_zoom_enabled)
-				fosphor_draw(this->d_fosphor, this->d_render_zoom);
+				if (this->d_zoom_enabled)
+					fosphor_draw(this->d_fosphor, &this->d_render_zoom[s]);
+			}
 
 			/* Done, swap buffer */
 			this->glctx_swap();
@@ -195,270 +315,1689 @@ base_sink_c_impl::render(void)
 	}
 
 	if (!this->d_visible) {
-		/* If hidden, we can't draw or swap buffer, so just wait a bit */
-		boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+		/* Outputs (shm, ...) still want their frames */
+		fosphor_sync(this->d_fosphor);
 	}
-}
 
+	/* Measurements (from the frame we just finished) */
+	this->peaks_publish();
+	this->bands_publish();
+	this->mask_publish();
+	this->occupancy_publish();
+	this->cross_spectrum_publish();
+	this->kurtosis_publish();
+	this->noise_floor_publish();
 
-void
-base_sink_c_impl::settings_mark_changed(uint32_t setting)
-{
-	gr::thread::scoped_lock lock(this->d_settings_mutex);
-	this->d_settings_changed |= setting;
-}
+	/* Triggers (idem) */
+	this->capture_trigger();
 
-uint32_t
-base_sink_c_impl::settings_get_and_reset_changed(void)
-{
-	gr::thread::scoped_lock lock(this->d_settings_mutex);
-	uint32_t v = this->d_settings_changed;
-	this->d_settings_changed = 0;
-	return v;
+	/* Follow the signal level */
+	this->auto_range_update();
 }
 
 void
-base_sink_c_impl::settings_apply(uint32_t settings)
+base_sink_c_impl::time_machine_update(void)
 {
-	if (settings & SETTING_DIMENSIONS)
-	{
-		this->glctx_update();
+	const size_t align = 16 * 1024;	/* Batch multiple */
+	float length;
+	bool hugepages;
+	size_t len;
 
-		glMatrixMode(GL_MODELVIEW);
-		glLoadIdentity();
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		length    = this->d_tm.length;
+		hugepages = this->d_tm.hugepages;
+	}
 
-		glMatrixMode(GL_PROJECTION);
-		glLoadIdentity();
-		glOrtho(0.0, (double)this->d_width, 0.0, (double)this->d_height, -1.0, 1.0);
+	/* The FIFO gets d_frequency.span samples per second (pairs of real
+	 * samples for real input) */
+	len = 0;
 
-		glViewport(0, 0, this->d_width, this->d_height);
+	if (length > 0.0f) {
+		if (this->d_frequency.span > 0.0)
+			len = ((size_t)(length * this->d_frequency.span) + align - 1) & ~(align - 1);
+		else
+			GR_LOG_WARN(d_logger, "Time machine needs the frequency span to be set");
 	}
 
-	if (settings & SETTING_POWER_RANGE) {
-		fosphor_set_power_range(this->d_fosphor,
-			this->d_db_ref,
-			this->k_db_per_div[this->d_db_per_div_idx]
-		);
-	}
+	/* Keep the content if possible */
+	if (this->d_tm_ring && (this->d_tm_ring->length() == len) &&
+	    (hugepages || !this->d_tm_ring->hugepages()))
+		return;
 
-	if (settings & SETTING_FREQUENCY_RANGE) {
-		fosphor_set_frequency_range(this->d_fosphor,
-			this->d_frequency.center,
-			this->d_frequency.span
-		);
+	if (!this->d_tm_ring && !len)
+		return;
+
+	delete this->d_tm_ring;
+	this->d_tm_ring = NULL;
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_tm.pos = 0;
 	}
 
-	if (settings & SETTING_FFT_WINDOW) {
-		std::vector<float> window =
-			gr::fft::window::build(this->d_fft_window, 1024, 6.76);
-		fosphor_set_fft_window(this->d_fosphor, window.data());
+	if (!len)
+		return;
+
+	try {
+		this->d_tm_ring = new iq_ring(this->d_n_inputs, len, hugepages);
+	} catch (std::bad_alloc &e) {
+		GR_LOG_ERROR(d_logger, boost::format("Unable to allocate %.1f s of time machine") % length);
+		return;
 	}
 
-	if (settings & (SETTING_DIMENSIONS | SETTING_RENDER_OPTIONS))
+	if (hugepages && !this->d_tm_ring->hugepages())
+		GR_LOG_WARN(d_logger, "No huge pages available for the time machine, using normal memory");
+}
+
+void
+base_sink_c_impl::capture_update(void)
+{
+	std::string path;
+	float pre, post, threshold;
+	bool band;
+
 	{
-		float f;
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		path      = this->d_trig.path;
+		pre       = this->d_trig.pre;
+		post      = this->d_trig.post;
+		band      = this->d_trig.band;
+		threshold = this->d_trig.band_threshold;
+	}
 
-		if (this->d_zoom_enabled) {
-			int a = (int)(this->d_width * 0.65f);
-			this->d_render_main->width = a;
-			this->d_render_main->options |= FRO_CHANNELS;
-			this->d_render_main->options &= ~FRO_COLOR_SCALE;
-			this->d_render_zoom->pos_x = a - 10;
-			this->d_render_zoom->width = this->d_width - a + 10;
+	/* Whatever was being recorded is finished first */
+	delete this->d_cap;
+	this->d_cap = NULL;
+	this->d_cap_peaks.clear();
+	this->d_cap_fresh = false;
+
+	if (!path.empty()) {
+		if (this->d_frequency.span > 0.0) {
+			try {
+				/* Input rate and DC frequency are the ones given, the
+				 * FIFO gets d_frequency.span samples per second. A
+				 * render can go through a whole FIFO worth before the
+				 * triggers of its first samples are seen */
+				this->d_cap = new iq_capture(
+					this->d_n_inputs, this->d_real_input, path,
+					this->d_frequency_in.span, this->d_frequency_in.center,
+					(size_t)(pre  * this->d_frequency.span),
+					(size_t)(post * this->d_frequency.span),
+					(size_t)this->d_fifos[0]->length()
+				);
+			} catch (std::bad_alloc &e) {
+				GR_LOG_ERROR(d_logger, boost::format("Unable to allocate %.1f s of pre-trigger capture") % pre);
+			}
 		} else {
-			this->d_render_main->width = this->d_width;
-			this->d_render_main->options &= ~FRO_CHANNELS;
-			this->d_render_main->options |= FRO_COLOR_SCALE;
+			GR_LOG_WARN(d_logger, "Trigger capture needs the frequency span to be set");
 		}
+	}
 
-		this->d_render_main->height = this->d_height;
-		this->d_render_zoom->height = this->d_height;
+	if (fosphor_set_band_trigger(this->d_fosphor, (this->d_cap && band) ? threshold : NAN))
+		GR_LOG_ERROR(d_logger, "Unable to set the band power trigger");
+}
+
+void
+base_sink_c_impl::capture_trigger(void)
+{
+	bool fresh = this->d_cap_fresh;
+	double bin, lo, hi;
+	uint64_t spectrum;
+	int64_t pos;
+	int status, stream, band, max, s, i, j, n;
+	bool new_peaks;
+
+	this->d_cap_fresh = false;
+
+	if (!this->d_cap)
+		return;
+
+	/* Writer problems */
+	status = this->d_cap->status();
 
-		this->d_render_main->histo_wf_ratio = this->d_ratio;
-		this->d_render_zoom->histo_wf_ratio = this->d_ratio;
+	if (status & iq_capture::STATUS_OVERRUN)
+		GR_LOG_WARN(d_logger, "Trigger capture can't keep up with the disk, recording cut short");
 
-		this->d_render_main->channels[0].enabled = this->d_zoom_enabled;
-		this->d_render_main->channels[0].center  = (float)this->d_zoom_center;
-		this->d_render_main->channels[0].width   = (float)this->d_zoom_width;
+	if (status & iq_capture::STATUS_WRITE_ERROR)
+		GR_LOG_ERROR(d_logger, "Unable to write trigger capture");
 
-		this->d_render_zoom->freq_center = (float)this->d_zoom_center;
-		this->d_render_zoom->freq_span   = (float)this->d_zoom_width;
+	/* Band power : located to the spectrum (and read even when frozen
+	 * to drop what came from replays) */
+	if ((fosphor_get_band_trigger(this->d_fosphor, &spectrum, &stream, &band) > 0) && fresh)
+	{
+		pos = (int64_t)(spectrum * 1024) + this->d_cap_offset;
+
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			if (band < (int)this->d_bands.freqs.size()) {
+				lo = this->d_bands.freqs[band] - this->d_bands.bandwidths[band] / 2.0;
+				hi = this->d_bands.freqs[band] + this->d_bands.bandwidths[band] / 2.0;
+			} else {
+				lo = hi = 0.0;
+			}
+		}
 
-		fosphor_render_refresh(this->d_render_main);
-		fosphor_render_refresh(this->d_render_zoom);
+		if (!this->d_cap->trigger((pos > 0) ? (uint64_t)pos : 0, 1024,
+				boost::str(boost::format("band %d, input %d") % band % stream),
+				lo, hi))
+			GR_LOG_WARN(d_logger, "Trigger capture pre-trigger window cut short");
 	}
-}
 
+	/* New peaks : located to the frame */
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		new_peaks = this->d_trig.new_peaks && this->d_peaks.enabled;
+		max       = this->d_peaks.max;
+	}
 
-void
-base_sink_c_impl::cb_reshape(int width, int height)
-{
-	this->d_width    = width;
-	this->d_height   = height;
-	this->settings_mark_changed(SETTING_DIMENSIONS);
-}
+	if (!new_peaks || !fresh)
+		return;
 
-void
-base_sink_c_impl::cb_visibility(bool visible)
-{
-	gr::thread::scoped_lock guard(this->d_render_mutex);
-	this->d_visible = visible;
-}
+	std::vector<struct fosphor_peak> peaks(max);
+	bool first = this->d_cap_peaks.empty();
 
+	this->d_cap_peaks.resize(this->d_n_inputs);
+	bin = this->d_frequency.span / 1024.0;
 
-void
-base_sink_c_impl::execute_ui_action(enum ui_action_t action)
-{
-	switch (action) {
-	case DB_PER_DIV_UP:
-		if (this->d_db_per_div_idx < 4)
-			this->d_db_per_div_idx++;
-		break;
+	for (s=0; s<this->d_n_inputs; s++)
+	{
+		std::vector<double> &prev = this->d_cap_peaks[s];
 
-	case DB_PER_DIV_DOWN:
-		if (this->d_db_per_div_idx > 0)
-			this->d_db_per_div_idx--;
-		break;
+		n = fosphor_get_peaks(this->d_fosphor, s, peaks.data(), max, NULL);
+		if (n < 0)
+			return;
 
-	case REF_UP:
-		this->d_db_ref += k_db_per_div[this->d_db_per_div_idx];
-		break;
+		for (i=0; i<n && !first; i++)
+		{
+			double tol = std::max(peaks[i].bw, bin);
 
-	case REF_DOWN:
-		this->d_db_ref -= k_db_per_div[this->d_db_per_div_idx];
-		break;
+			for (j=0; j<(int)prev.size(); j++)
+				if (fabs(peaks[i].freq - prev[j]) <= tol)
+					break;
 
-	case ZOOM_TOGGLE:
-		this->d_zoom_enabled ^= 1;
-		break;
+			if (j < (int)prev.size())
+				continue;
 
-	case ZOOM_WIDTH_UP:
-		if (this->d_zoom_enabled)
-			this->d_zoom_width *= 2.0;
-		break;
+			if (!this->d_cap->trigger(this->d_cap_frame, 0,
+					boost::str(boost::format("peak, input %d") % s),
+					peaks[i].freq - peaks[i].bw / 2.0,
+					peaks[i].freq + peaks[i].bw / 2.0))
+				GR_LOG_WARN(d_logger, "Trigger capture pre-trigger window cut short");
+		}
 
-	case ZOOM_WIDTH_DOWN:
-		if (this->d_zoom_enabled)
-			this->d_zoom_width /= 2.0;
-		break;
+		prev.resize(n);
+		for (i=0; i<n; i++)
+			prev[i] = peaks[i].freq;
+	}
+}
 
-	case ZOOM_CENTER_UP:
-		if (this->d_zoom_enabled)
-			this->d_zoom_center += this->d_zoom_width / 8.0;
-		break;
+bool
+base_sink_c_impl::time_machine_replay(void)
+{
+	const size_t window = 1024 * 1024;	/* One full waterfall */
+	const size_t chunk  = 128 * 1024;
+	const size_t align  = 16 * 1024;	/* Batch multiple */
+	void *data[FOSPHOR_MAX_STREAMS];
+	size_t fill, back, len, n;
+	int s;
 
-	case ZOOM_CENTER_DOWN:
-		if (this->d_zoom_enabled)
-			this->d_zoom_center -= this->d_zoom_width / 8.0;
-		break;
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
 
-	case RATIO_UP:
-		if (this->d_ratio < 0.8f)
-			this->d_ratio += 0.05f;
-		break;
+		if (!this->d_tm.replay || !this->d_tm_ring)
+			return false;
 
-	case RATIO_DOWN:
-		if (this->d_ratio > 0.2f)
-			this->d_ratio -= 0.05f;
-		break;
+		this->d_tm.replay = false;
 
-	case FREEZE_TOGGLE:
-		this->d_frozen ^= 1;
-		break;
+		/* Clamp to a full window if we have it */
+		fill = this->d_tm_ring->fill();
+		if (this->d_tm.pos > ((fill > window) ? (fill - window) : 0))
+			this->d_tm.pos = (fill > window) ? (fill - window) : 0;
+
+		back = this->d_tm.pos;
 	}
 
-	this->settings_mark_changed(
-		SETTING_POWER_RANGE |
-		SETTING_RENDER_OPTIONS
-	);
+	len = std::min(window, fill - back) & ~(align - 1);
+	if (!len)
+		return false;
+
+	/* Oldest first, through the same path as live samples but only for
+	 * display : measurements, outputs and messages already had them */
+	this->d_tm_buf.resize(chunk * this->d_n_inputs);
+
+	for (s=0; s<this->d_n_inputs; s++)
+		data[s] = &this->d_tm_buf[s * chunk];
+
+	fosphor_set_replay(this->d_fosphor, 1);
+
+	while (len) {
+		n = std::min(len, chunk);
+		this->d_tm_ring->read(data, back + len - n, n);
+		fosphor_process_multi(this->d_fosphor, data, n);
+		this->d_cap_processed += n;
+		len -= n;
+	}
+
+	fosphor_set_replay(this->d_fosphor, 0);
+
+	return true;
 }
 
 void
-base_sink_c_impl::execute_mouse_action(enum mouse_action_t action, int x, int y)
+base_sink_c_impl::auto_range_update(void)
 {
-	if (action != CLICK)
-		return;
-
-	/* Identify position */
-	int in_main = fosphor_render_pos_inside(this->d_render_main, x, y);
-	int in_zoom = this->d_zoom_enabled ? fosphor_render_pos_inside(this->d_render_zoom, x, y) : 0;
+	int db_ref, db_per_div, i;
 
-	/* Send frequency */
-	if (in_main & 1)
 	{
-		double freq = fosphor_pos2freq(this->d_fosphor, this->d_render_main, x);
-		message_port_pub(pmt::mp("freq"), pmt::cons(pmt::mp("freq"), pmt::from_double(freq)));
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		if (!this->d_auto_range)
+			return;
+		db_ref     = this->d_db_ref;
+		db_per_div = this->k_db_per_div[this->d_db_per_div_idx];
 	}
-	else if (in_zoom & 1)
+
+	if (fosphor_auto_range(this->d_fosphor, &db_ref, &db_per_div) <= 0)
+		return;
+
 	{
-		double freq = fosphor_pos2freq(this->d_fosphor, this->d_render_zoom, x);
-		message_port_pub(pmt::mp("freq"), pmt::cons(pmt::mp("freq"), pmt::from_double(freq)));
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+
+		for (i=0; i<5; i++)
+			if (this->k_db_per_div[i] == db_per_div)
+				this->d_db_per_div_idx = i;
+
+		this->d_db_ref = db_ref;
 	}
+
+	this->settings_mark_changed(SETTING_POWER_RANGE);
 }
 
 void
-base_sink_c_impl::set_frequency_range(const double center, const double span)
+base_sink_c_impl::peaks_publish(void)
 {
-	this->d_frequency.center = center;
-	this->d_frequency.span   = span;
-	this->settings_mark_changed(SETTING_FREQUENCY_RANGE);
+	boost::chrono::steady_clock::time_point now;
+	float rate;
+	int max, s, i, n;
+
+	if (!this->d_peaks_new)
+		return;
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		if (!this->d_peaks.enabled)
+			return;
+		rate = this->d_peaks.rate;
+		max  = this->d_peaks.max;
+	}
+
+	/* Rate limit */
+	now = boost::chrono::steady_clock::now();
+
+	if ((rate > 0.0f) &&
+	    (now - this->d_peaks_last) < boost::chrono::duration<float>(1.0f / rate))
+		return;
+
+	this->d_peaks_last = now;
+	this->d_peaks_new  = false;
+
+	/* One message per input */
+	std::vector<struct fosphor_peak> peaks(max);
+
+	for (s=0; s<this->d_n_inputs; s++)
+	{
+		pmt::pmt_t meta, list;
+		float noise_floor;
+
+		n = fosphor_get_peaks(this->d_fosphor, s, peaks.data(), max, &noise_floor);
+		if (n < 0)
+			return;
+
+		list = pmt::make_vector(n, pmt::PMT_NIL);
+
+		for (i=0; i<n; i++) {
+			pmt::pmt_t p = pmt::make_dict();
+			p = pmt::dict_add(p, pmt::mp("freq"),     pmt::from_double(peaks[i].freq));
+			p = pmt::dict_add(p, pmt::mp("bw"),       pmt::from_double(peaks[i].bw));
+			p = pmt::dict_add(p, pmt::mp("power"),    pmt::from_double(peaks[i].pwr));
+			p = pmt::dict_add(p, pmt::mp("max_hold"), pmt::from_double(peaks[i].pwr_max));
+			pmt::vector_set(list, i, p);
+		}
+
+		meta = pmt::make_dict();
+		meta = pmt::dict_add(meta, pmt::mp("stream"),      pmt::from_long(s));
+		meta = pmt::dict_add(meta, pmt::mp("noise_floor"), pmt::from_double(noise_floor));
+		meta = pmt::dict_add(meta, pmt::mp("peaks"),       list);
+
+		message_port_pub(pmt::mp("peaks"), pmt::cons(pmt::mp("peaks"), meta));
+	}
 }
 
 void
-base_sink_c_impl::set_frequency_center(const double center)
+base_sink_c_impl::bands_publish(void)
 {
-	this->d_frequency.center = center;
-	this->settings_mark_changed(SETTING_FREQUENCY_RANGE);
+	struct fosphor_band_power bp[FOSPHOR_MAX_CHANNELS];
+	boost::chrono::steady_clock::time_point now;
+	std::vector<double> freqs, bandwidths;
+	float rate;
+	int s, i, n;
+
+	if (!this->d_bands_new)
+		return;
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		if (this->d_bands.freqs.empty())
+			return;
+		freqs      = this->d_bands.freqs;
+		bandwidths = this->d_bands.bandwidths;
+		rate       = this->d_bands.rate;
+	}
+
+	/* Rate limit */
+	now = boost::chrono::steady_clock::now();
+
+	if ((rate > 0.0f) &&
+	    (now - this->d_bands_last) < boost::chrono::duration<float>(1.0f / rate))
+		return;
+
+	this->d_bands_last = now;
+	this->d_bands_new  = false;
+
+	/* One message per input */
+	for (s=0; s<this->d_n_inputs; s++)
+	{
+		pmt::pmt_t meta, list;
+
+		n = fosphor_get_band_power(this->d_fosphor, s, bp, (int)freqs.size());
+		if (n < 0)
+			return;
+
+		list = pmt::make_vector(n, pmt::PMT_NIL);
+
+		for (i=0; i<n; i++) {
+			pmt::pmt_t b = pmt::make_dict();
+			b = pmt::dict_add(b, pmt::mp("freq"), pmt::from_double(freqs[i]));
+			b = pmt::dict_add(b, pmt::mp("bw"),   pmt::from_double(bandwidths[i]));
+			b = pmt::dict_add(b, pmt::mp("mean"), pmt::from_double(bp[i].mean));
+			b = pmt::dict_add(b, pmt::mp("peak"), pmt::from_double(bp[i].peak));
+			b = pmt::dict_add(b, pmt::mp("duty"), pmt::from_double(bp[i].duty));
+			pmt::vector_set(list, i, b);
+		}
+
+		meta = pmt::make_dict();
+		meta = pmt::dict_add(meta, pmt::mp("stream"), pmt::from_long(s));
+		meta = pmt::dict_add(meta, pmt::mp("bands"),  list);
+
+		message_port_pub(pmt::mp("bands"), pmt::cons(pmt::mp("bands"), meta));
+	}
 }
 
 void
-base_sink_c_impl::set_frequency_span(const double span)
+base_sink_c_impl::occupancy_publish(void)
 {
-	this->d_frequency.span   = span;
-	this->settings_mark_changed(SETTING_FREQUENCY_RANGE);
+	boost::chrono::steady_clock::time_point now;
+	std::vector<float> occ(1024);
+	double span;
+	float rate;
+	int s, n;
+
+	if (!this->d_occ_new)
+		return;
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		if (!this->d_occ.enabled || (this->d_occ.rate <= 0.0f))
+			return;
+		rate = this->d_occ.rate;
+		span = this->d_frequency.span;
+	}
+
+	/* Rate limit */
+	now = boost::chrono::steady_clock::now();
+
+	if ((now - this->d_occ_last) < boost::chrono::duration<float>(1.0f / rate))
+		return;
+
+	this->d_occ_last = now;
+	this->d_occ_new  = false;
+
+	/* One message per input */
+	for (s=0; s<this->d_n_inputs; s++)
+	{
+		pmt::pmt_t meta;
+
+		n = fosphor_get_occupancy(this->d_fosphor, s, occ.data());
+		if (n <= 0)
+			return;
+
+		meta = pmt::make_dict();
+		meta = pmt::dict_add(meta, pmt::mp("stream"),    pmt::from_long(s));
+		meta = pmt::dict_add(meta, pmt::mp("window"),    pmt::from_double((span > 0.0) ? (n * 1024.0 / span) : 0.0));
+		meta = pmt::dict_add(meta, pmt::mp("occupancy"), pmt::init_f32vector(occ.size(), occ));
+
+		message_port_pub(pmt::mp("occupancy"), pmt::cons(pmt::mp("occupancy"), meta));
+	}
 }
 
 void
-base_sink_c_impl::set_fft_window(const gr::fft::window::win_type win)
+base_sink_c_impl::cross_spectrum_publish(void)
 {
-	if (win == this->d_fft_window)	/* Reloading FFT window takes time */
-		return;			/* avoid doing it if possible */
+	boost::chrono::steady_clock::time_point now;
+	std::vector<float> coh(1024), phase(1024), cross(1024);
+	pmt::pmt_t meta;
+	float rate;
 
-	this->d_fft_window = win;
-	this->settings_mark_changed(SETTING_FFT_WINDOW);
-}
+	if (!this->d_xs_new)
+		return;
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		if (!this->d_xs.enabled || (this->d_xs.rate <= 0.0f))
+			return;
+		rate = this->d_xs.rate;
+	}
 
+	/* Rate limit */
+	now = boost::chrono::steady_clock::now();
 
-int
-base_sink_c_impl::work(
-	int noutput_items,
-	gr_vector_const_void_star &input_items,
-	gr_vector_void_star &output_items)
-{
-	const gr_complex *in = (const gr_complex *) input_items[0];
-	gr_complex *dst;
-	int l, mw;
+	if ((now - this->d_xs_last) < boost::chrono::duration<float>(1.0f / rate))
+		return;
 
-	/* How much can we hope to write */
-	l = noutput_items;
-	mw = this->d_fifo->write_max_size();
+	this->d_xs_last = now;
+	this->d_xs_new  = false;
 
-	if (l > mw)
-		l = mw;
-	if (!l)
-		return 0;
+	if (fosphor_get_cross_spectrum(this->d_fosphor, coh.data(), phase.data(), cross.data()) <= 0)
+		return;
 
-	/* Get a pointer */
-	dst = this->d_fifo->write_prepare(l, true);
-	if (!dst)
-		return 0;
+	meta = pmt::make_dict();
+	meta = pmt::dict_add(meta, pmt::mp("coherence"),   pmt::init_f32vector(coh.size(), coh));
+	meta = pmt::dict_add(meta, pmt::mp("phase"),       pmt::init_f32vector(phase.size(), phase));
+	meta = pmt::dict_add(meta, pmt::mp("cross_power"), pmt::init_f32vector(cross.size(), cross));
+
+	message_port_pub(pmt::mp("cross_spectrum"), pmt::cons(pmt::mp("cross_spectrum"), meta));
+}
+
+void
+base_sink_c_impl::kurtosis_publish(void)
+{
+	boost::chrono::steady_clock::time_point now;
+	std::vector<float> sk(1024), std_db(1024);
+	float rate;
+	int s, n;
+
+	if (!this->d_sk_new)
+		return;
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		if (!this->d_sk.enabled || (this->d_sk.rate <= 0.0f))
+			return;
+		rate = this->d_sk.rate;
+	}
+
+	/* Rate limit */
+	now = boost::chrono::steady_clock::now();
+
+	if ((now - this->d_sk_last) < boost::chrono::duration<float>(1.0f / rate))
+		return;
+
+	this->d_sk_last = now;
+	this->d_sk_new  = false;
+
+	/* One message per input */
+	for (s=0; s<this->d_n_inputs; s++)
+	{
+		pmt::pmt_t meta;
+
+		n = fosphor_get_kurtosis(this->d_fosphor, s, sk.data(), std_db.data());
+		if (n <= 0)
+			return;
+
+		meta = pmt::make_dict();
+		meta = pmt::dict_add(meta, pmt::mp("stream"),   pmt::from_long(s));
+		meta = pmt::dict_add(meta, pmt::mp("spectra"),  pmt::from_long(n));
+		meta = pmt::dict_add(meta, pmt::mp("kurtosis"), pmt::init_f32vector(sk.size(), sk));
+		meta = pmt::dict_add(meta, pmt::mp("std_dev"),  pmt::init_f32vector(std_db.size(), std_db));
+
+		message_port_pub(pmt::mp("kurtosis"), pmt::cons(pmt::mp("kurtosis"), meta));
+	}
+}
+
+void
+base_sink_c_impl::mask_publish(void)
+{
+	struct fosphor_mask_violation viol[64];
+	pmt::pmt_t now;
+	int s, i, n;
+
+	if (!this->d_mask_new)
+		return;
+
+	this->d_mask_new = false;
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		if (this->d_mask.freqs.empty())
+			return;
+	}
+
+	now = pmt::from_double(
+		boost::chrono::duration<double>(
+			boost::chrono::system_clock::now().time_since_epoch()
+		).count()
+	);
+
+	/* One message per input with violations */
+	for (s=0; s<this->d_n_inputs; s++)
+	{
+		pmt::pmt_t meta, list;
+
+		n = fosphor_get_mask_violations(this->d_fosphor, s, viol, 64);
+		if (n <= 0)
+			continue;
+
+		list = pmt::make_vector(n, pmt::PMT_NIL);
+
+		for (i=0; i<n; i++) {
+			pmt::pmt_t v = pmt::make_dict();
+			v = pmt::dict_add(v, pmt::mp("freq"),   pmt::from_double(viol[i].freq));
+			v = pmt::dict_add(v, pmt::mp("bw"),     pmt::from_double(viol[i].bw));
+			v = pmt::dict_add(v, pmt::mp("margin"), pmt::from_double(viol[i].margin));
+			v = pmt::dict_add(v, pmt::mp("count"),  pmt::from_long(viol[i].count));
+			pmt::vector_set(list, i, v);
+		}
+
+		meta = pmt::make_dict();
+		meta = pmt::dict_add(meta, pmt::mp("stream"),     pmt::from_long(s));
+		meta = pmt::dict_add(meta, pmt::mp("time"),       now);
+		meta = pmt::dict_add(meta, pmt::mp("violations"), list);
+
+		message_port_pub(pmt::mp("mask"), pmt::cons(pmt::mp("mask_violation"), meta));
+	}
+}
+
+int
+base_sink_c_impl::mask_get(std::vector<float> &pos, std::vector<float> &levels)
+{
+	gr::thread::scoped_lock lock(this->d_settings_mutex);
+	int i, n;
+
+	/* Normalized like channels, relative to the displayed range */
+	if (this->d_frequency.span <= 0.0)
+		return 0;
+
+	n = this->d_mask.freqs.size();
+
+	pos.resize(n);
+	levels = this->d_mask.levels;
+
+	for (i=0; i<n; i++)
+		pos[i] = (float)(0.5 + (this->d_mask.freqs[i] - this->d_frequency.center) / this->d_frequency.span);
+
+	return n;
+}
+
+void
+base_sink_c_impl::noise_floor_publish(void)
+{
+	boost::chrono::steady_clock::time_point now;
+	float percentile, interval;
+	int s;
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		if (!this->d_nf.enabled)
+			return;
+		percentile = this->d_nf.percentile;
+		interval   = this->d_nf.interval;
+	}
+
+	/* Nothing pending: issue a new request once the interval elapsed.
+	 * The reduction then runs on the device at the end of the next frame */
+	if (!this->d_nf_pending)
+	{
+		now = boost::chrono::steady_clock::now();
+
+		if ((now - this->d_nf_last) < boost::chrono::duration<float>(interval))
+			return;
+
+		this->d_nf_last    = now;
+		this->d_nf_pending = true;
+
+		fosphor_request_percentiles(this->d_fosphor);
+		return;
+	}
+
+	/* One message per input */
+	std::vector<float> low(1024), p50(1024), p90(1024);
+
+	for (s=0; s<this->d_n_inputs; s++)
+	{
+		pmt::pmt_t meta;
+
+		if (fosphor_get_percentiles(this->d_fosphor, s, low.data(), p50.data(), p90.data()))
+			return;
+
+		meta = pmt::make_dict();
+		meta = pmt::dict_add(meta, pmt::mp("stream"),     pmt::from_long(s));
+		meta = pmt::dict_add(meta, pmt::mp("percentile"), pmt::from_double(percentile));
+		meta = pmt::dict_add(meta, pmt::mp("low"),        pmt::init_f32vector(low.size(), low));
+		meta = pmt::dict_add(meta, pmt::mp("p50"),        pmt::init_f32vector(p50.size(), p50));
+		meta = pmt::dict_add(meta, pmt::mp("p90"),        pmt::init_f32vector(p90.size(), p90));
+
+		message_port_pub(pmt::mp("noise_floor"), pmt::cons(pmt::mp("noise_floor"), meta));
+	}
+
+	this->d_nf_pending = false;
+}
+
+int
+base_sink_c_impl::bands_get(struct fosphor_channel *ch, float *threshold)
+{
+	gr::thread::scoped_lock lock(this->d_settings_mutex);
+	int i, n;
+
+	/* Normalized like channels, relative to the displayed range */
+	if (this->d_frequency.span <= 0.0)
+		return 0;
+
+	n = this->d_bands.freqs.size();
+
+	for (i=0; i<n; i++) {
+		ch[i].enabled = 1;
+		ch[i].center  = (float)(0.5 + (this->d_bands.freqs[i] - this->d_frequency.center) / this->d_frequency.span);
+		ch[i].width   = (float)(this->d_bands.bandwidths[i] / this->d_frequency.span);
+	}
+
+	if (threshold)
+		*threshold = this->d_bands.threshold;
+
+	return n;
+}
+
+void
+base_sink_c_impl::wake(void)
+{
+	gr::thread::scoped_lock lock(this->d_wake_mutex);
+	this->d_wake = true;
+	this->d_wake_cond.notify_one();
+}
+
+void
+base_sink_c_impl::frame_wait(void)
+{
+	boost::chrono::steady_clock::duration period = boost::chrono::steady_clock::duration::zero();
+	boost::chrono::steady_clock::time_point next;
+	float max_fps;
+
+	/* Frame rate cap (and if hidden, we can't draw, so no need to hurry) */
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		max_fps = this->d_max_fps;
+	}
+
+	if (max_fps > 0.0f)
+		period = boost::chrono::duration_cast<boost::chrono::steady_clock::duration>(
+			boost::chrono::duration<float>(1.0f / max_fps));
+
+	if (!this->d_visible && (period < boost::chrono::milliseconds(10)))
+		period = boost::chrono::milliseconds(10);
+
+	next = this->d_frame_last + period;
+	boost::this_thread::sleep_until(next);
+
+	/* Then sleep until there is something to do. We still need to poll
+	 * every now and then for the GL contexts delivering input events
+	 * from this thread */
+	{
+		gr::thread::scoped_lock lock(this->d_wake_mutex);
+
+		if (!this->d_wake)
+			this->d_wake_cond.wait_for(lock, boost::chrono::milliseconds(20));
+
+		this->d_wake = false;
+	}
+
+	this->d_frame_last = boost::chrono::steady_clock::now();
+}
+
+
+void
+base_sink_c_impl::settings_mark_changed(uint32_t setting)
+{
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_settings_changed |= setting;
+	}
+	this->wake();
+}
+
+uint32_t
+base_sink_c_impl::settings_get_and_reset_changed(void)
+{
+	gr::thread::scoped_lock lock(this->d_settings_mutex);
+	uint32_t v = this->d_settings_changed;
+	this->d_settings_changed = 0;
+	return v;
+}
+
+void
+base_sink_c_impl::settings_apply(uint32_t settings)
+{
+	if (settings & SETTING_DIMENSIONS)
+	{
+		this->glctx_update();
+
+		glMatrixMode(GL_MODELVIEW);
+		glLoadIdentity();
+
+		glMatrixMode(GL_PROJECTION);
+		glLoadIdentity();
+		glOrtho(0.0, (double)this->d_width, 0.0, (double)this->d_height, -1.0, 1.0);
+
+		glViewport(0, 0, this->d_width, this->d_height);
+	}
+
+	if (settings & SETTING_POWER_RANGE) {
+		fosphor_set_power_range(this->d_fosphor,
+			this->d_db_ref,
+			this->k_db_per_div[this->d_db_per_div_idx]
+		);
+	}
+
+	if (settings & SETTING_AUTO_RANGE) {
+		bool enabled;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			enabled = this->d_auto_range;
+		}
+
+		if (fosphor_set_auto_range(this->d_fosphor, enabled))
+			GR_LOG_ERROR(d_logger, "Unable to enable automatic power range");
+	}
+
+	if (settings & SETTING_FREQUENCY_RANGE) {
+		fosphor_set_frequency_range(this->d_fosphor,
+			this->d_frequency.center,
+			this->d_frequency.span
+		);
+	}
+
+	if (settings & SETTING_FFT_WINDOW) {
+		std::vector<float> window =
+			gr::fft::window::build(this->d_fft_window, 1024, 6.76);
+		fosphor_set_fft_window(this->d_fosphor, window.data());
+	}
+
+	if (settings & SETTING_FILTER_BANK) {
+		int m;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			m = this->d_pfb_taps;
+		}
+
+		if (fosphor_set_pfb(this->d_fosphor, m, NULL))
+			GR_LOG_ERROR(d_logger, "Unable to setup the polyphase filter bank");
+	}
+
+	if (settings & SETTING_SWAP_INTERVAL) {
+		int interval;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			interval = this->d_swap_interval;
+		}
+
+		if (interval >= 0)
+			this->glctx_swap_interval(interval);
+	}
+
+	if (settings & SETTING_HIDDEN_MODE) {
+		static const int policy[] = {
+			FOSPHOR_HIDDEN_DISCARD,
+			FOSPHOR_HIDDEN_DECIMATE,
+			FOSPHOR_HIDDEN_FULL,
+		};
+		int mode, decim;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			mode  = policy[this->d_hidden.mode];
+			decim = this->d_hidden.decimation;
+		}
+
+		fosphor_set_hidden_policy(this->d_fosphor, mode, decim);
+	}
+
+	if (settings & SETTING_PEAKS) {
+		bool enabled;
+		float threshold;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			enabled   = this->d_peaks.enabled;
+			threshold = this->d_peaks.threshold;
+		}
+
+		if (fosphor_set_peaks(this->d_fosphor, enabled, threshold))
+			GR_LOG_ERROR(d_logger, "Unable to enable peak detection");
+	}
+
+	if (settings & (SETTING_BANDS | SETTING_FREQUENCY_RANGE)) {
+		struct fosphor_channel bands[FOSPHOR_MAX_CHANNELS];
+		float threshold;
+		int n;
+
+		n = this->bands_get(bands, &threshold);
+
+		if (fosphor_set_bands(this->d_fosphor, bands, n, threshold))
+			GR_LOG_ERROR(d_logger, "Unable to setup band power measurements");
+	}
+
+	if (settings & (SETTING_MASK | SETTING_FREQUENCY_RANGE)) {
+		std::vector<float> pos, levels;
+		int n;
+
+		n = this->mask_get(pos, levels);
+
+		if (fosphor_set_mask(this->d_fosphor, pos.data(), levels.data(), n))
+			GR_LOG_ERROR(d_logger, "Unable to setup the limit mask");
+	}
+
+	if (settings & (SETTING_OCCUPANCY | SETTING_FREQUENCY_RANGE)) {
+		bool enabled;
+		float threshold;
+		double spectra;
+		int window;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			enabled   = this->d_occ.enabled;
+			threshold = this->d_occ.threshold;
+			spectra   = this->d_occ.window * this->d_frequency.span / 1024.0;
+		}
+
+		/* (about 3 h at 100 Msps for the longest) */
+		window = (int)std::max(1.0, std::min(spectra, (double)FOSPHOR_OCC_MAX_WINDOW));
+
+		if (fosphor_set_occupancy(this->d_fosphor, enabled, threshold, window))
+			GR_LOG_ERROR(d_logger, "Unable to setup occupancy measurement");
+	}
+
+	if (settings & SETTING_KURTOSIS) {
+		bool enabled;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			enabled = this->d_sk.enabled;
+		}
+
+		if (fosphor_set_kurtosis(this->d_fosphor, enabled))
+			GR_LOG_ERROR(d_logger, "Unable to setup spectral kurtosis measurement");
+	}
+
+	if (settings & SETTING_CROSS_SPECTRUM) {
+		bool enabled;
+		float alpha;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			enabled = this->d_xs.enabled;
+			alpha   = this->d_xs.alpha;
+		}
+
+		if (fosphor_set_cross_spectrum(this->d_fosphor, enabled, alpha))
+			GR_LOG_ERROR(d_logger, "Unable to setup cross-spectrum measurement");
+	}
+
+	if (settings & SETTING_NOISE_FLOOR) {
+		bool enabled;
+		float percentile;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			enabled    = this->d_nf.enabled;
+			percentile = this->d_nf.percentile;
+		}
+
+		if (fosphor_set_percentiles(this->d_fosphor, enabled, percentile))
+			GR_LOG_ERROR(d_logger, "Unable to enable histogram percentiles");
+
+		this->d_nf_pending = false;
+	}
+
+	if (settings & SETTING_SHM_OUTPUT) {
+		std::string name;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			name = this->d_shm_name;
+		}
+
+		if (fosphor_set_shm_output(this->d_fosphor, name.c_str()))
+			GR_LOG_ERROR(d_logger, boost::format("Unable to publish to shared memory '%s'") % name);
+	}
+
+	if (settings & SETTING_NET_OUTPUT) {
+		std::string endpoint;
+		int bits;
+		bool histo;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			endpoint = this->d_net.endpoint;
+			bits     = this->d_net.bits;
+			histo    = this->d_net.histogram;
+		}
+
+		if (fosphor_set_net_output(this->d_fosphor, endpoint.c_str(), bits, histo))
+			GR_LOG_ERROR(d_logger, boost::format("Unable to stream to '%s'") % endpoint);
+	}
+
+	if (settings & SETTING_REC_OUTPUT) {
+		std::string path;
+		int bits;
+		float db_min, db_max;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			path   = this->d_rec.path;
+			bits   = this->d_rec.bits;
+			db_min = this->d_rec.db_min;
+			db_max = this->d_rec.db_max;
+		}
+
+		if (fosphor_set_rec_output(this->d_fosphor, path.c_str(), bits, db_min, db_max))
+			GR_LOG_ERROR(d_logger, boost::format("Unable to record spectrogram to '%s'") % path);
+	}
+
+	if (settings & (SETTING_TIME_MACHINE | SETTING_FREQUENCY_RANGE))
+		this->time_machine_update();
+
+	if (settings & (SETTING_TRIGGER | SETTING_FREQUENCY_RANGE))
+		this->capture_update();
+
+	if (settings & SETTING_ROLLUP_OUTPUT) {
+		std::string path;
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			path = this->d_rollup_path;
+		}
+
+		if (fosphor_set_rollup_output(this->d_fosphor, path.c_str(), NULL, NULL, 0))
+			GR_LOG_ERROR(d_logger, boost::format("Unable to keep spectrum rollups in '%s'") % path);
+	}
+
+	if (settings & (SETTING_DIMENSIONS | SETTING_RENDER_OPTIONS |
+	                SETTING_BANDS | SETTING_FREQUENCY_RANGE |
+	                SETTING_NOISE_FLOOR | SETTING_MASK | SETTING_OCCUPANCY |
+	                SETTING_CROSS_SPECTRUM | SETTING_KURTOSIS))
+	{
+		struct fosphor_channel bands[FOSPHOR_MAX_CHANNELS];
+		int cols, rows, tile_w, tile_h, s, i, decim, n_bands;
+		bool nf_draw, mask, occ_draw, xs_draw, sk_draw, sk_wf;
+
+		/* Measured bands are shown after the zoom channel */
+		n_bands = this->bands_get(bands, NULL);
+
+		{
+			gr::thread::scoped_lock lock(this->d_settings_mutex);
+			nf_draw = this->d_nf.enabled && this->d_nf.draw;
+			mask    = !this->d_mask.freqs.empty();
+			occ_draw = this->d_occ.enabled && this->d_occ.draw;
+			xs_draw  = this->d_xs.enabled && this->d_xs.draw;
+			sk_draw  = this->d_sk.enabled && this->d_sk.draw;
+			sk_wf    = this->d_sk.enabled && this->d_sk.waterfall;
+		}
+
+		/* Zoom down-converter (shared by all inputs) */
+		decim = fosphor_set_zoom(this->d_fosphor, this->d_zoom_enabled,
+		                         this->d_zoom_center, this->d_zoom_width);
+		if (decim < 1) {
+			GR_LOG_WARN(d_logger, "Unable to setup zoom down-converter, stretching instead");
+			decim = 1;
+		}
+
+		/* Tile layout: as square as possible, first input top left */
+		cols = (int)ceilf(sqrtf((float)this->d_n_inputs));
+		rows = (this->d_n_inputs + cols - 1) / cols;
+
+		tile_w = this->d_width  / cols;
+		tile_h = this->d_height / rows;
+
+		for (s=0; s<this->d_n_inputs; s++)
+		{
+			struct fosphor_render *rm = &this->d_render_main[s];
+			struct fosphor_render *rz = &this->d_render_zoom[s];
+			int tile_x = (s % cols) * tile_w;
+			int tile_y = (rows - 1 - (s / cols)) * tile_h;
+
+			rm->pos_x = tile_x;
+			rm->pos_y = tile_y;
+			rz->pos_y = tile_y;
+
+			if (this->d_zoom_enabled) {
+				int a = (int)(tile_w * 0.65f);
+				rm->width = a;
+				rm->options |= FRO_CHANNELS;
+				rm->options &= ~FRO_COLOR_SCALE;
+				rz->pos_x = tile_x + a - 10;
+				rz->width = tile_w - a + 10;
+			} else {
+				rm->width = tile_w;
+				rm->options |= FRO_COLOR_SCALE;
+			}
+
+			if (this->d_zoom_enabled || n_bands)
+				rm->options |= FRO_CHANNELS;
+			else
+				rm->options &= ~FRO_CHANNELS;
+
+			if (n_bands)
+				rm->options |= FRO_BAND_POWER;
+			else
+				rm->options &= ~FRO_BAND_POWER;
+
+			if (nf_draw)
+				rm->options |= FRO_NOISE_FLOOR;
+			else
+				rm->options &= ~FRO_NOISE_FLOOR;
+
+			if (mask)
+				rm->options |= FRO_MASK;
+			else
+				rm->options &= ~FRO_MASK;
+
+			if (occ_draw)
+				rm->options |= FRO_OCCUPANCY;
+			else
+				rm->options &= ~FRO_OCCUPANCY;
+
+			/* Phase and coherence go in the second input tile */
+			if (xs_draw && (s == 1))
+				rm->options |= FRO_CROSS_SPEC;
+			else
+				rm->options &= ~FRO_CROSS_SPEC;
+
+			if (sk_draw)
+				rm->options |= FRO_KURTOSIS;
+			else
+				rm->options &= ~FRO_KURTOSIS;
+
+			if (sk_wf)
+				rm->options |= FRO_KURTOSIS_WF;
+			else
+				rm->options &= ~FRO_KURTOSIS_WF;
+
+			rm->height = tile_h;
+			rz->height = tile_h;
+
+			rm->histo_wf_ratio = this->d_ratio;
+			rz->histo_wf_ratio = this->d_ratio;
+
+			rm->channels[0].enabled = this->d_zoom_enabled;
+			rm->channels[0].center  = (float)this->d_zoom_center;
+			rm->channels[0].width   = (float)this->d_zoom_width;
+
+			for (i=1; i<FOSPHOR_MAX_CHANNELS; i++)
+				rm->channels[i] = (i <= n_bands) ? bands[i-1] : fosphor_channel();
+
+			if (decim > 1) {
+				rz->options |= FRO_DDC;
+				rz->freq_center = 0.5f;
+				rz->freq_span   = (float)(this->d_zoom_width * decim);
+			} else {
+				rz->options &= ~FRO_DDC;
+				rz->freq_center = (float)this->d_zoom_center;
+				rz->freq_span   = (float)this->d_zoom_width;
+			}
+
+			fosphor_render_refresh(rm);
+			fosphor_render_refresh(rz);
+		}
+	}
+}
+
+
+void
+base_sink_c_impl::cb_reshape(int width, int height)
+{
+	this->d_width    = width;
+	this->d_height   = height;
+	this->settings_mark_changed(SETTING_DIMENSIONS);
+}
+
+void
+base_sink_c_impl::cb_visibility(bool visible)
+{
+	{
+		gr::thread::scoped_lock guard(this->d_render_mutex);
+		this->d_visible = visible;
+	}
+	this->settings_mark_changed(SETTING_REDRAW);
+}
+
+void
+base_sink_c_impl::cb_redraw()
+{
+	this->settings_mark_changed(SETTING_REDRAW);
+}
+
+
+void
+base_sink_c_impl::execute_ui_action(enum ui_action_t action)
+{
+	gr::thread::scoped_lock lock(this->d_settings_mutex);
+
+	switch (action) {
+	case DB_PER_DIV_UP:
+		if (this->d_db_per_div_idx < 4)
+			this->d_db_per_div_idx++;
+		this->d_auto_range = false;
+		break;
+
+	case DB_PER_DIV_DOWN:
+		if (this->d_db_per_div_idx > 0)
+			this->d_db_per_div_idx--;
+		this->d_auto_range = false;
+		break;
+
+	case REF_UP:
+		this->d_db_ref += k_db_per_div[this->d_db_per_div_idx];
+		this->d_auto_range = false;
+		break;
+
+	case REF_DOWN:
+		this->d_db_ref -= k_db_per_div[this->d_db_per_div_idx];
+		this->d_auto_range = false;
+		break;
+
+	case ZOOM_TOGGLE:
+		this->d_zoom_enabled ^= 1;
+		break;
+
+	case ZOOM_WIDTH_UP:
+		if (this->d_zoom_enabled)
+			this->d_zoom_width *= 2.0;
+		break;
+
+	case ZOOM_WIDTH_DOWN:
+		if (this->d_zoom_enabled)
+			this->d_zoom_width /= 2.0;
+		break;
+
+	case ZOOM_CENTER_UP:
+		if (this->d_zoom_enabled)
+			this->d_zoom_center += this->d_zoom_width / 8.0;
+		break;
+
+	case ZOOM_CENTER_DOWN:
+		if (this->d_zoom_enabled)
+			this->d_zoom_center -= this->d_zoom_width / 8.0;
+		break;
+
+	case RATIO_UP:
+		if (this->d_ratio < 0.8f)
+			this->d_ratio += 0.05f;
+		break;
+
+	case RATIO_DOWN:
+		if (this->d_ratio > 0.2f)
+			this->d_ratio -= 0.05f;
+		break;
+
+	case FREEZE_TOGGLE:
+		this->d_frozen ^= 1;
+		this->d_tm.pos = 0;
+		this->d_tm.replay = false;
+		break;
+
+	case AUTO_RANGE_TOGGLE:
+		this->d_auto_range ^= 1;
+		break;
+
+	case TIME_BACK:
+		/* Nothing to go back to without the time machine */
+		if (!this->d_tm_ring)
+			break;
+		this->d_frozen = true;
+		this->d_tm.pos += k_tm_step;
+		break;
+
+	case TIME_FORWARD:
+		if (this->d_frozen)
+			this->d_tm.pos -= std::min(this->d_tm.pos, k_tm_step);
+		break;
+	}
+
+	/* Frozen : show the result of the change on the time machine span */
+	if (this->d_frozen && (action != FREEZE_TOGGLE))
+		this->d_tm.replay = true;
+
+	lock.unlock();
+
+	this->settings_mark_changed(
+		SETTING_POWER_RANGE |
+		SETTING_RENDER_OPTIONS |
+		SETTING_AUTO_RANGE
+	);
+}
+
+void
+base_sink_c_impl::execute_mouse_action(enum mouse_action_t action, int x, int y)
+{
+	if (action != CLICK)
+		return;
+
+	for (int s=0; s<this->d_n_inputs; s++)
+	{
+		struct fosphor_render *rm = &this->d_render_main[s];
+		struct fosphor_render *rz = &this->d_render_zoom[s];
+
+		/* Identify position */
+		int in_main = fosphor_render_pos_inside(rm, x, y);
+		int in_zoom = this->d_zoom_enabled ? fosphor_render_pos_inside(rz, x, y) : 0;
+
+		/* Send frequency */
+		if (in_main & 1)
+		{
+			double freq = fosphor_pos2freq(this->d_fosphor, rm, x);
+			message_port_pub(pmt::mp("freq"), pmt::cons(pmt::mp("freq"), pmt::from_double(freq)));
+			break;
+		}
+		else if (in_zoom & 1)
+		{
+			double freq = fosphor_pos2freq(this->d_fosphor, rz, x);
+			message_port_pub(pmt::mp("freq"), pmt::cons(pmt::mp("freq"), pmt::from_double(freq)));
+			break;
+		}
+	}
+}
+
+void
+base_sink_c_impl::frequency_update()
+{
+	this->d_frequency = this->d_frequency_in;
+
+	/* Real input : only DC to fs/2 is displayed */
+	if (this->d_real_input) {
+		this->d_frequency.center += this->d_frequency_in.span / 4.0;
+		this->d_frequency.span   /= 2.0;
+	}
+
+	this->settings_mark_changed(SETTING_FREQUENCY_RANGE);
+}
+
+void
+base_sink_c_impl::set_frequency_range(const double center, const double span)
+{
+	this->d_frequency_in.center = center;
+	this->d_frequency_in.span   = span;
+	this->frequency_update();
+}
+
+void
+base_sink_c_impl::set_frequency_center(const double center)
+{
+	this->d_frequency_in.center = center;
+	this->frequency_update();
+}
+
+void
+base_sink_c_impl::set_frequency_span(const double span)
+{
+	this->d_frequency_in.span   = span;
+	this->frequency_update();
+}
+
+void
+base_sink_c_impl::set_fft_window(const gr::fft::window::win_type win)
+{
+	if (win == this->d_fft_window)	/* Reloading FFT window takes time */
+		return;			/* avoid doing it if possible */
+
+	this->d_fft_window = win;
+	this->settings_mark_changed(SETTING_FFT_WINDOW);
+}
+
+void
+base_sink_c_impl::set_filter_bank(int taps_per_bin)
+{
+	if ((taps_per_bin < 0) || (taps_per_bin > 8))
+		throw std::invalid_argument("fosphor: filter bank supports up to 8 taps per bin");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		if (taps_per_bin == this->d_pfb_taps)	/* Restarts the history */
+			return;
+		this->d_pfb_taps = taps_per_bin;
+	}
+	this->settings_mark_changed(SETTING_FILTER_BANK);
+}
+
+void
+base_sink_c_impl::set_frame_rate(float max_fps)
+{
+	if (max_fps < 0.0f)
+		throw std::invalid_argument("fosphor: max frame rate can't be negative");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_max_fps = max_fps;
+	}
+	this->wake();
+}
+
+void
+base_sink_c_impl::set_swap_interval(int interval)
+{
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_swap_interval = interval;
+	}
+	this->settings_mark_changed(SETTING_SWAP_INTERVAL);
+}
+
+void
+base_sink_c_impl::set_auto_range(bool enable)
+{
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_auto_range = enable;
+	}
+	this->settings_mark_changed(SETTING_AUTO_RANGE);
+}
+
+void
+base_sink_c_impl::set_peak_detection(bool enable, float threshold_db,
+                                     float rate, int max_peaks)
+{
+	if (rate < 0.0f)
+		throw std::invalid_argument("fosphor: peak detection rate can't be negative");
+
+	if (max_peaks < 1)
+		throw std::invalid_argument("fosphor: peak detection needs max_peaks >= 1");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_peaks.enabled   = enable;
+		this->d_peaks.threshold = threshold_db;
+		this->d_peaks.rate      = rate;
+		this->d_peaks.max       = max_peaks;
+	}
+	this->settings_mark_changed(SETTING_PEAKS);
+}
+
+void
+base_sink_c_impl::set_band_power(const std::vector<double> &freqs,
+                                 const std::vector<double> &bandwidths,
+                                 float duty_threshold_db, float rate)
+{
+	if (freqs.size() != bandwidths.size())
+		throw std::invalid_argument("fosphor: need one bandwidth per band");
+
+	if (freqs.size() > (FOSPHOR_MAX_CHANNELS - 1))
+		throw std::invalid_argument("fosphor: too many bands");
+
+	if (rate < 0.0f)
+		throw std::invalid_argument("fosphor: band power rate can't be negative");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_bands.freqs      = freqs;
+		this->d_bands.bandwidths = bandwidths;
+		this->d_bands.threshold  = duty_threshold_db;
+		this->d_bands.rate       = rate;
+	}
+	this->settings_mark_changed(SETTING_BANDS);
+}
+
+void
+base_sink_c_impl::set_occupancy(bool enable, float threshold_db, float window,
+                                float rate, bool draw)
+{
+	if (window <= 0.0f)
+		throw std::invalid_argument("fosphor: occupancy window must be positive");
+
+	if (rate < 0.0f)
+		throw std::invalid_argument("fosphor: occupancy rate can't be negative");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_occ.enabled   = enable;
+		this->d_occ.threshold = threshold_db;
+		this->d_occ.window    = window;
+		this->d_occ.rate      = rate;
+		this->d_occ.draw      = draw;
+	}
+	this->settings_mark_changed(SETTING_OCCUPANCY);
+}
+
+void
+base_sink_c_impl::set_cross_spectrum(bool enable, float alpha, float rate, bool draw)
+{
+	if (enable && (this->d_n_inputs < 2))
+		throw std::invalid_argument("fosphor: cross-spectrum needs two inputs");
+
+	if (alpha > 1.0f)
+		throw std::invalid_argument("fosphor: cross-spectrum averaging factor must be within [0,1]");
+
+	if (rate < 0.0f)
+		throw std::invalid_argument("fosphor: cross-spectrum rate can't be negative");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_xs.enabled = enable;
+		this->d_xs.alpha   = alpha;
+		this->d_xs.rate    = rate;
+		this->d_xs.draw    = draw;
+	}
+	this->settings_mark_changed(SETTING_CROSS_SPECTRUM);
+}
+
+void
+base_sink_c_impl::set_spectral_kurtosis(bool enable, float rate, bool draw, bool waterfall)
+{
+	if (rate < 0.0f)
+		throw std::invalid_argument("fosphor: spectral kurtosis rate can't be negative");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_sk.enabled   = enable;
+		this->d_sk.rate      = rate;
+		this->d_sk.draw      = draw;
+		this->d_sk.waterfall = waterfall;
+	}
+	this->settings_mark_changed(SETTING_KURTOSIS);
+}
+
+void
+base_sink_c_impl::set_spectrum_mask(const std::vector<double> &freqs,
+                                    const std::vector<float> &levels_db)
+{
+	if (freqs.size() != levels_db.size())
+		throw std::invalid_argument("fosphor: need one level per mask point");
+
+	for (size_t i=1; i<freqs.size(); i++)
+		if (freqs[i] < freqs[i-1])
+			throw std::invalid_argument("fosphor: mask points must be in increasing frequency order");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_mask.freqs  = freqs;
+		this->d_mask.levels = levels_db;
+	}
+	this->settings_mark_changed(SETTING_MASK);
+}
+
+void
+base_sink_c_impl::set_noise_floor(bool enable, float percentile,
+                                  float interval, bool draw)
+{
+	if ((percentile < 0.0f) || (percentile > 1.0f))
+		throw std::invalid_argument("fosphor: noise floor percentile must be within [0,1]");
+
+	if (interval < 0.0f)
+		throw std::invalid_argument("fosphor: noise floor interval can't be negative");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_nf.enabled    = enable;
+		this->d_nf.percentile = percentile;
+		this->d_nf.interval   = interval;
+		this->d_nf.draw       = draw;
+	}
+	this->settings_mark_changed(SETTING_NOISE_FLOOR);
+}
+
+void
+base_sink_c_impl::set_hidden_mode(enum hidden_mode_t mode, int decimation)
+{
+	if ((mode < HIDDEN_DISCARD) || (mode > HIDDEN_FULL))
+		throw std::invalid_argument("fosphor: invalid hidden mode");
+
+	if (decimation < 1)
+		throw std::invalid_argument("fosphor: hidden mode decimation must be >= 1");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_hidden.mode       = mode;
+		this->d_hidden.decimation = decimation;
+	}
+	this->settings_mark_changed(SETTING_HIDDEN_MODE);
+}
+
+void
+base_sink_c_impl::set_shm_output(const std::string &name)
+{
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_shm_name = name;
+	}
+	this->settings_mark_changed(SETTING_SHM_OUTPUT);
+}
+
+void
+base_sink_c_impl::set_net_output(const std::string &endpoint, int bits, bool histogram)
+{
+	if ((bits != 8) && (bits != 16))
+		throw std::invalid_argument("fosphor: network output only supports 8 or 16 bits");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_net.endpoint  = endpoint;
+		this->d_net.bits      = bits;
+		this->d_net.histogram = histogram;
+	}
+	this->settings_mark_changed(SETTING_NET_OUTPUT);
+}
+
+void
+base_sink_c_impl::set_rec_output(const std::string &path, int bits,
+                                 float db_min, float db_max)
+{
+	if ((bits != 8) && (bits != 16))
+		throw std::invalid_argument("fosphor: spectrogram archive only supports 8 or 16 bits");
+
+	if (!(db_max > db_min))
+		throw std::invalid_argument("fosphor: invalid spectrogram archive dB range");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_rec.path   = path;
+		this->d_rec.bits   = bits;
+		this->d_rec.db_min = db_min;
+		this->d_rec.db_max = db_max;
+	}
+	this->settings_mark_changed(SETTING_REC_OUTPUT);
+}
+
+void
+base_sink_c_impl::set_rollup_output(const std::string &path)
+{
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_rollup_path = path;
+	}
+	this->settings_mark_changed(SETTING_ROLLUP_OUTPUT);
+}
+
+void
+base_sink_c_impl::set_time_machine(float length, bool hugepages)
+{
+	if (length < 0.0f)
+		throw std::invalid_argument("fosphor: time machine length can't be negative");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_tm.length    = length;
+		this->d_tm.hugepages = hugepages;
+	}
+	this->settings_mark_changed(SETTING_TIME_MACHINE);
+}
+
+void
+base_sink_c_impl::time_machine_seek(float seconds)
+{
+	if (seconds < 0.0f)
+		throw std::invalid_argument("fosphor: time machine can't seek in the future");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_frozen    = true;
+		this->d_tm.pos    = (size_t)(seconds * this->d_frequency.span);
+		this->d_tm.replay = true;
+	}
+	this->settings_mark_changed(SETTING_REDRAW);
+}
+
+void
+base_sink_c_impl::set_trigger_capture(const std::string &path, float pre, float post,
+                                      bool band, float band_threshold_db, bool new_peaks)
+{
+	if ((pre < 0.0f) || (post < 0.0f))
+		throw std::invalid_argument("fosphor: trigger capture lengths can't be negative");
+
+	{
+		gr::thread::scoped_lock lock(this->d_settings_mutex);
+		this->d_trig.path           = path;
+		this->d_trig.pre            = pre;
+		this->d_trig.post           = post;
+		this->d_trig.band           = band;
+		this->d_trig.band_threshold = band_threshold_db;
+		this->d_trig.new_peaks      = new_peaks;
+	}
+	this->settings_mark_changed(SETTING_TRIGGER);
+}
+
+
+int
+base_sink_c_impl::work(
+	int noutput_items,
+	gr_vector_const_void_star &input_items,
+	gr_vector_void_star &output_items)
+{
+	gr_complex *dst[FOSPHOR_MAX_STREAMS];
+	int l, mw, s;
+
+	/* How much can we hope to write (real samples go by pairs) */
+	l = this->d_real_input ? (noutput_items >> 1) : noutput_items;
+	mw = this->d_fifos[0]->write_max_size();
+
+	if (l > mw)
+		l = mw;
+	if (!l)
+		return 0;
+
+	/* Get a pointer for each input */
+	for (s=0; s<this->d_n_inputs; s++) {
+		dst[s] = this->d_fifos[s]->write_prepare(l, true);
+		if (!dst[s])
+			return 0;
+	}
+
+	/* Do the copy (a pair of floats has the size of a complex) */
+	for (s=0; s<this->d_n_inputs; s++) {
+		memcpy(dst[s], input_items[s], sizeof(gr_complex) * l);
+		this->d_fifos[s]->write_commit(l);
+	}
 
-	/* Do the copy */
-	memcpy(dst, in, sizeof(gr_complex) * l);
-	this->d_fifo->write_commit(l);
+	/* Let the worker know */
+	this->wake();
 
 	/* Report what we took */
-	return l;
+	return this->d_real_input ? (l << 1) : l;
 }
 
 bool base_sink_c_impl::start()
@@ -476,6 +2015,7 @@ bool base_sink_c_impl::stop()
 	bool rv = base_sink_c::stop();
 	if (this->d_active) {
 		this->d_active = false;
+		this->wake();
 		this->d_worker.join();
 	}
 	return rv;
@@ -11,17 +11,23 @@
 
 #include <stdint.h>
 
+#include <string>
+#include <vector>
+
 #include <gnuradio/thread/thread.h>
 
 #include <gnuradio/fosphor/base_sink_c.h>
 
 struct fosphor;
 struct fosphor_render;
+struct fosphor_channel;
 
 namespace gr {
   namespace fosphor {
 
     class fifo;
+    class iq_ring;
+    class iq_capture;
 
     /*!
      * \brief Base class for fosphor sink implementation
@@ -42,14 +48,87 @@ namespace gr {
       gr::thread::mutex d_render_mutex;
 
       /* fosphor core */
-      fifo *d_fifo;
+      int d_n_inputs;
+      bool d_real_input;		/* Float inputs, queued by pairs */
+      std::vector<fifo *> d_fifos;
 
       struct fosphor *d_fosphor;
-      struct fosphor_render *d_render_main;
-      struct fosphor_render *d_render_zoom;
+      struct fosphor_render *d_render_main;	/* One per input */
+      struct fosphor_render *d_render_zoom;	/* One per input */
 
       void render();
 
+      /* Time machine (raw samples ring, replayed while frozen) */
+      iq_ring *d_tm_ring;
+      std::vector<gr_complex> d_tm_buf;
+
+      void time_machine_update();
+      bool time_machine_replay();
+
+      /* Spectral trigger capture */
+      iq_capture *d_cap;
+      uint64_t d_cap_processed;	/* Samples handed to fosphor */
+      int64_t  d_cap_offset;	/* Capture position - processed (live) */
+      uint64_t d_cap_frame;	/* Capture position at the frame start */
+      bool d_cap_fresh;		/* Live samples processed this frame */
+      std::vector<std::vector<double> > d_cap_peaks;	/* Last frame peaks */
+
+      void capture_update();
+      void capture_trigger();
+
+      /* Frame pacing */
+      gr::thread::mutex d_wake_mutex;
+      gr::thread::condition_variable d_wake_cond;
+      bool d_wake;
+      boost::chrono::steady_clock::time_point d_frame_last;
+
+      void wake();
+      void frame_wait();
+
+      /* Peaks publishing */
+      bool d_peaks_new;
+      boost::chrono::steady_clock::time_point d_peaks_last;
+
+      void peaks_publish();
+
+      /* Band power publishing */
+      bool d_bands_new;
+      boost::chrono::steady_clock::time_point d_bands_last;
+
+      void bands_publish();
+
+      /* Occupancy publishing */
+      bool d_occ_new;
+      boost::chrono::steady_clock::time_point d_occ_last;
+
+      void occupancy_publish();
+
+      /* Cross-spectrum publishing */
+      bool d_xs_new;
+      boost::chrono::steady_clock::time_point d_xs_last;
+
+      void cross_spectrum_publish();
+
+      /* Spectral kurtosis publishing */
+      bool d_sk_new;
+      boost::chrono::steady_clock::time_point d_sk_last;
+
+      void kurtosis_publish();
+
+      /* Mask violations publishing */
+      bool d_mask_new;
+
+      void mask_publish();
+
+      /* Noise floor publishing */
+      bool d_nf_pending;
+      boost::chrono::steady_clock::time_point d_nf_last;
+
+      void noise_floor_publish();
+
+      /* Automatic power range */
+      void auto_range_update();
+
       static gr::thread::mutex s_boot_mutex;
 
       /* settings refresh logic */
@@ -59,6 +138,24 @@ namespace gr {
         SETTING_FREQUENCY_RANGE = (1 << 2),
         SETTING_FFT_WINDOW      = (1 << 3),
         SETTING_RENDER_OPTIONS  = (1 << 4),
+        SETTING_SHM_OUTPUT      = (1 << 5),
+        SETTING_NET_OUTPUT      = (1 << 6),
+        SETTING_REC_OUTPUT      = (1 << 7),
+        SETTING_HIDDEN_MODE     = (1 << 8),
+        SETTING_SWAP_INTERVAL   = (1 << 9),
+        SETTING_REDRAW          = (1 << 10),	/* Nothing to apply */
+        SETTING_PEAKS           = (1 << 11),
+        SETTING_BANDS           = (1 << 12),
+        SETTING_NOISE_FLOOR     = (1 << 13),
+        SETTING_AUTO_RANGE      = (1 << 14),
+        SETTING_MASK            = (1 << 15),
+        SETTING_OCCUPANCY       = (1 << 16),
+        SETTING_ROLLUP_OUTPUT   = (1 << 17),
+        SETTING_FILTER_BANK     = (1 << 18),
+        SETTING_CROSS_SPECTRUM  = (1 << 19),
+        SETTING_KURTOSIS        = (1 << 20),
+        SETTING_TIME_MACHINE    = (1 << 21),
+        SETTING_TRIGGER         = (1 << 22),
       };
 
       uint32_t d_settings_changed;
@@ -73,8 +170,10 @@ namespace gr {
       int d_height;
 
       static const int k_db_per_div[];
+      static const size_t k_tm_step;
       int d_db_ref;
       int d_db_per_div_idx;
+      bool d_auto_range;
 
       bool  d_zoom_enabled;
       double d_zoom_center;
@@ -85,12 +184,108 @@ namespace gr {
       struct {
         double center;
         double span;
-      } d_frequency;
+      } d_frequency, d_frequency_in;	/* Displayed / as set */
+
+      void frequency_update();
 
       gr::fft::window::win_type d_fft_window;
+      int d_pfb_taps;
+
+      struct {
+        enum hidden_mode_t mode;
+        int decimation;
+      } d_hidden;
+
+      float d_max_fps;
+      int d_swap_interval;
+
+      struct {
+        bool enabled;
+        float threshold;
+        float rate;
+        int max;
+      } d_peaks;
+
+      struct {
+        std::vector<double> freqs;
+        std::vector<double> bandwidths;
+        float threshold;
+        float rate;
+      } d_bands;
+
+      int bands_get(struct fosphor_channel *ch, float *threshold);
+
+      struct {
+        bool enabled;
+        float threshold;
+        float window;
+        float rate;
+        bool draw;
+      } d_occ;
+
+      struct {
+        bool enabled;
+        float alpha;
+        float rate;
+        bool draw;
+      } d_xs;
+
+      struct {
+        bool enabled;
+        float rate;
+        bool draw;
+        bool waterfall;
+      } d_sk;
+
+      struct {
+        std::vector<double> freqs;
+        std::vector<float> levels;
+      } d_mask;
+
+      int mask_get(std::vector<float> &pos, std::vector<float> &levels);
+
+      struct {
+        bool enabled;
+        float percentile;
+        float interval;
+        bool draw;
+      } d_nf;
+
+      std::string d_shm_name;
+
+      struct {
+        std::string endpoint;
+        int bits;
+        bool histogram;
+      } d_net;
+
+      struct {
+        std::string path;
+        int bits;
+        float db_min;
+        float db_max;
+      } d_rec;
+
+      std::string d_rollup_path;
+
+      struct {
+        float length;
+        bool hugepages;
+        size_t pos;		/* Samples between the shown span and the newest */
+        bool replay;
+      } d_tm;
+
+      struct {
+        std::string path;
+        float pre;
+        float post;
+        bool band;
+        float band_threshold;
+        bool new_peaks;
+      } d_trig;
 
      protected:
-      base_sink_c_impl();
+      base_sink_c_impl(int n_inputs = 1, bool real_input = false);
 
       /* Delegated implementation of GL context management */
       virtual void glctx_init() = 0;
@@ -98,10 +293,12 @@ namespace gr {
       virtual void glctx_swap() = 0;
       virtual void glctx_fini() = 0;
       virtual void glctx_update() = 0;
+      virtual void glctx_swap_interval(int interval) = 0;
 
       /* Callbacks from GL window */
       void cb_reshape(int width, int height);
       void cb_visibility(bool visible);
+      void cb_redraw();
 
      public:
       virtual ~base_sink_c_impl();
@@ -116,6 +313,36 @@ namespace gr {
       void set_frequency_span(const double span);
 
       void set_fft_window(const gr::fft::window::win_type win);
+      void set_filter_bank(int taps_per_bin);
+      void set_hidden_mode(enum hidden_mode_t mode, int decimation);
+
+      void set_frame_rate(float max_fps);
+      void set_swap_interval(int interval);
+      void set_auto_range(bool enable);
+
+      void set_peak_detection(bool enable, float threshold_db,
+                              float rate, int max_peaks);
+      void set_band_power(const std::vector<double> &freqs,
+                          const std::vector<double> &bandwidths,
+                          float duty_threshold_db, float rate);
+      void set_occupancy(bool enable, float threshold_db, float window,
+                         float rate, bool draw);
+      void set_cross_spectrum(bool enable, float alpha, float rate, bool draw);
+      void set_spectral_kurtosis(bool enable, float rate, bool draw, bool waterfall);
+      void set_spectrum_mask(const std::vector<double> &freqs,
+                             const std::vector<float> &levels_db);
+      void set_noise_floor(bool enable, float percentile,
+                           float interval, bool draw);
+
+      void set_shm_output(const std::string &name);
+      void set_net_output(const std::string &endpoint, int bits, bool histogram);
+      void set_rec_output(const std::string &path, int bits,
+                          float db_min, float db_max);
+      void set_rollup_output(const std::string &path);
+      void set_time_machine(float length, bool hugepages);
+      void time_machine_seek(float seconds);
+      void set_trigger_capture(const std::string &path, float pre, float post,
+                               bool band, float band_threshold_db, bool new_peaks);
 
       /* gr::sync_block implementation */
       int work (int noutput_items,
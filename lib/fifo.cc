@@ -25,6 +25,12 @@ fifo::~fifo()
 	delete[] this->d_buf;
 }
 
+int
+fifo::length()
+{
+	return this->d_len;
+}
+
 int
 fifo::free()
 {
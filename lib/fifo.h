@@ -33,6 +33,7 @@ namespace gr {
      fifo(int length);
      ~fifo();
 
+     int length();
      int free();
      int used();
 
@@ -17,6 +17,8 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -74,24 +76,153 @@ struct fosphor_cl_state
 
 	cl_program	prog_fft;
 	cl_kernel	kern_fft;
+	cl_kernel	kern_fft_real;
 
 	float		*fft_win;
 	int		fft_win_updated;
+	int		real_input;	/* Pairs of real samples */
+
+	/* Polyphase filter bank (buffers allocated on first use) */
+	cl_mem		mem_pfb_out;	/* Folded blocks, FFT input */
+	cl_mem		mem_pfb_hist;
+	cl_mem		mem_pfb_taps;
+	cl_mem		mem_pfb_win;	/* Unity window */
+	cl_kernel	kern_pfb_fold;
+
+	struct {
+		int		m;		/* Taps per bin, 0 = disabled */
+		float		*taps;
+		int		taps_updated;
+		int		reset;		/* History to clear */
+	} pfb;
 
 	/* Display */
 	cl_mem		mem_waterfall;
+	cl_mem		mem_waterfall_red;
 	cl_mem		mem_histogram;
 	cl_mem		mem_spectrum;
 
 	cl_program	prog_display;
 	cl_kernel	kern_display;
+	cl_kernel	kern_wf_reduce;
+
+	/* Zoom (down-converter feeding its own FFT/display) */
+	cl_mem		mem_ddc_hist;
+	cl_mem		mem_ddc_taps;
+	cl_mem		mem_zoom_in;
+	cl_mem		mem_zoom_waterfall;
+	cl_mem		mem_zoom_histogram;
+	cl_mem		mem_zoom_spectrum;
+
+	cl_program	prog_ddc;
+	cl_kernel	kern_ddc;
+	cl_kernel	kern_fft_zoom;
+	cl_kernel	kern_display_zoom;
+
+	struct {
+		int		decim;
+		int		n_taps;
+		uint32_t	phase;		/* NCO phase of the next sample */
+		uint32_t	phase_inc;
+		int		fill;		/* Outputs waiting for the FFT */
+		int		waterfall_pos;
+	} zoom;
+
+	/* Peak detection */
+	cl_mem		mem_peaks;
+	cl_kernel	kern_peaks;
+
+	/* Automatic power range statistics */
+	cl_mem		mem_range_stats;
+	cl_kernel	kern_range_stats;
+
+	/* Histogram percentiles */
+	cl_mem		mem_percentiles;
+	cl_kernel	kern_percentiles;
+
+	/* Band power */
+	cl_mem		mem_bands;
+	cl_mem		mem_bands_range;
+	cl_mem		mem_bands_trig;
+	cl_kernel	kern_band_power;
+
+	struct {
+		int		n;
+		float		threshold;
+		float		trig_threshold;
+		int		reset;		/* Next run restarts accumulation */
+		int		pending;	/* Ran since the last readback */
+		cl_uint		spectra;	/* Accumulated since the reset */
+		uint64_t	base;		/* Absolute index of the first one */
+	} bands;
+
+	/* Occupancy */
+	cl_mem		mem_occupancy;
+	cl_kernel	kern_occupancy;
+
+	struct {
+		int		enabled;
+		float		threshold;	/* Magnitude */
+		int		reset;		/* Next run restarts accumulation */
+		int		spectra;	/* Counted since the last readback */
+	} occ;
+
+	/* Long-term rollups */
+	cl_mem		mem_rollup;
+	cl_kernel	kern_rollup;
+
+	struct {
+		int		enabled;
+		int		reset;		/* Next run restarts accumulation */
+		int		spectra;	/* Accumulated since the last readback */
+	} rollup;
+
+	/* Spectral kurtosis (sums from the display kernel) */
+	cl_mem		mem_kurtosis;
+
+	struct {
+		int		enabled;
+		int		reset;		/* Next run restarts accumulation */
+		int		pending;	/* Ran since the last readback */
+	} sk;
+
+	/* Cross-spectrum (first two streams) */
+	cl_mem		mem_xs_avg;
+	cl_mem		mem_xs_out;
+	cl_kernel	kern_xs;
+
+	struct {
+		int		enabled;
+		float		alpha;
+		int		reset;		/* Next run restarts averaging */
+		int		pending;	/* Ran since the last readback */
+	} xs;
+
+	/* Limit mask compliance */
+	cl_mem		mem_mask;
+	cl_mem		mem_mask_viol;
+	cl_kernel	kern_mask_check;
+
+	struct {
+		int		enabled;
+		int		reset;		/* Next run restarts accumulation */
+		int		pending;	/* Ran since the last readback */
+	} mask;
 
 	/* Histogram range */
 	float		histo_scale;
 	float		histo_offset;
 
+	/* Max-reduced waterfall levels */
+	struct {
+		int		valid;		/* Follow the waterfall */
+		int		pending;	/* Rows reduced since last finish */
+	} wf_red;
+
 	/* State */
 	int		waterfall_pos;
+	int		waterfall_pending;	/* Rows produced since last finish */
+	int		waterfall_new;		/* Rows produced before last finish */
 	enum {
 		CL_BOOTING = 0,
 		CL_PENDING,
@@ -419,16 +550,26 @@ cl_queue_clear_buffers(struct fosphor *self)
 		cl->mem_spectrum,
 		&noise_floor, sizeof(float),
 		0,
-		2 * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		self->n_streams * 2 * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
 		0, NULL, NULL
 	);
 	CL_ERR_CHECK(err, "Unable to queue clear of spectrum buffer");
 
+	/* Zoom down-converter history to zero */
+	err = clEnqueueFillBuffer(cl->cq,
+		cl->mem_ddc_hist,
+		color, sizeof(float),
+		0,
+		self->n_streams * 2 * sizeof(cl_float) * FOSPHOR_ZOOM_MAX_TAPS,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to queue clear of zoom history buffer");
+
 	/* Init the waterfall image to noise floor */
 	color[0] = noise_floor;
 
 	img_region[0] = FOSPHOR_FFT_LEN;
-	img_region[1] = 1024;
+	img_region[1] = 1024 * self->n_streams;
 	img_region[2] = 1;
 
 	err = clEnqueueFillImage(cl->cq,
@@ -439,11 +580,19 @@ cl_queue_clear_buffers(struct fosphor *self)
 	);
 	CL_ERR_CHECK(err, "Unable to queue clear of waterfall image");
 
+	err = clEnqueueFillImage(cl->cq,
+		cl->mem_waterfall_red,
+		color,
+		img_origin, img_region,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to queue clear of reduced waterfall image");
+
 	/* Init the histogram image to all 0.0f values */
 	color[0] = 0.0f;
 
 	img_region[0] = FOSPHOR_FFT_LEN;
-	img_region[1] = 128;
+	img_region[1] = 128 * self->n_streams;
 	img_region[2] = 1;
 
 	err = clEnqueueFillImage(cl->cq,
@@ -464,6 +613,165 @@ error:
 	return err;
 }
 
+static cl_int
+cl_queue_readback_rows(struct fosphor *self, cl_mem mem, float *dst, int rows)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	size_t img_origin[3] = { 0, 0, 0 };
+	size_t img_region[3] = { FOSPHOR_FFT_LEN, 0, 1 };
+	cl_int err;
+	int i, j, row, n;
+
+	if (rows >= 1024)
+	{
+		/* Whole image in one go */
+		img_region[1] = 1024 * self->n_streams;
+
+		err = clEnqueueReadImage(cl->cq,
+			mem,
+			CL_FALSE,
+			img_origin,
+			img_region,
+			0,
+			0,
+			dst,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue readback of waterfall image");
+	}
+	else if (rows > 0)
+	{
+		/* Only the most recent rows, in (at most) two chunks per stream */
+		for (i=0; i<self->n_streams; i++)
+		{
+			row = (cl->waterfall_pos - rows) & 1023;
+
+			for (j=rows; j>0; j-=n)
+			{
+				n = (row + j > 1024) ? (1024 - row) : j;
+
+				img_origin[1] = (i * 1024) + row;
+				img_region[1] = n;
+
+				err = clEnqueueReadImage(cl->cq,
+					mem,
+					CL_FALSE,
+					img_origin,
+					img_region,
+					0,
+					0,
+					dst + img_origin[1] * FOSPHOR_FFT_LEN,
+					0, NULL, NULL
+				);
+				CL_ERR_CHECK(err, "Unable to queue readback of waterfall image");
+
+				row = (row + n) & 1023;
+			}
+		}
+	}
+
+	return CL_SUCCESS;
+
+error:
+	return err;
+}
+
+static cl_int
+cl_queue_readback(struct fosphor *self, int wf_rows, int red_rows)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	size_t img_origin[3] = { 0, 0, 0 };
+	size_t img_region[3] = { FOSPHOR_FFT_LEN, 0, 1 };
+	cl_int err;
+
+		/* Waterfall */
+	err = cl_queue_readback_rows(self, cl->mem_waterfall, self->img_waterfall, wf_rows);
+	if (err != CL_SUCCESS)
+		goto error;
+
+		/* Reduced levels (only needed here if GL can't see them) */
+	if (self->img_waterfall_red)
+	{
+		err = cl_queue_readback_rows(self, cl->mem_waterfall_red, self->img_waterfall_red, red_rows);
+		if (err != CL_SUCCESS)
+			goto error;
+	}
+
+		/* Histogram */
+	img_region[1] = 128 * self->n_streams;
+
+	err = clEnqueueReadImage(cl->cq,
+		cl->mem_histogram,
+		CL_FALSE,
+		img_origin,
+		img_region,
+		0,
+		0,
+		self->img_histogram,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to queue readback of histogram image");
+
+		/* Live spectrum */
+	err = clEnqueueReadBuffer(cl->cq,
+		cl->mem_spectrum,
+		CL_FALSE,
+		0,
+		self->n_streams * 2 * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		self->buf_spectrum,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to queue readback of spectrum buffer");
+
+		/* Zoom (only needed here if GL can't see it, and in use) */
+	if (self->img_zoom_waterfall && (cl->zoom.decim > 1))
+	{
+		img_region[1] = 1024 * self->n_streams;
+
+		err = clEnqueueReadImage(cl->cq,
+			cl->mem_zoom_waterfall,
+			CL_FALSE,
+			img_origin,
+			img_region,
+			0,
+			0,
+			self->img_zoom_waterfall,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue readback of zoom waterfall image");
+
+		img_region[1] = 128 * self->n_streams;
+
+		err = clEnqueueReadImage(cl->cq,
+			cl->mem_zoom_histogram,
+			CL_FALSE,
+			img_origin,
+			img_region,
+			0,
+			0,
+			self->img_zoom_histogram,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue readback of zoom histogram image");
+
+		err = clEnqueueReadBuffer(cl->cq,
+			cl->mem_zoom_spectrum,
+			CL_FALSE,
+			0,
+			self->n_streams * 2 * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+			self->buf_zoom_spectrum,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue readback of zoom spectrum buffer");
+	}
+
+	return CL_SUCCESS;
+
+	/* Error path */
+error:
+	return err;
+}
+
 static int
 cl_init_buffers_gl(struct fosphor *self)
 {
@@ -473,12 +781,20 @@ cl_init_buffers_gl(struct fosphor *self)
 	/* GL shared objects */
 		/* Waterfall texture */
 	cl->mem_waterfall = clCreateFromGLTexture(cl->ctx,
-		CL_MEM_WRITE_ONLY, GL_TEXTURE_2D, 0,
+		CL_MEM_READ_WRITE, GL_TEXTURE_2D, 0,
 		fosphor_gl_get_shared_id(self, GL_ID_TEX_WATERFALL),
 		&err
 	);
 	CL_ERR_CHECK(err, "Unable to share waterfall texture into OpenCL context");
 
+		/* Reduced waterfall texture */
+	cl->mem_waterfall_red = clCreateFromGLTexture(cl->ctx,
+		CL_MEM_WRITE_ONLY, GL_TEXTURE_2D, 0,
+		fosphor_gl_get_shared_id(self, GL_ID_TEX_WATERFALL_RED),
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to share reduced waterfall texture into OpenCL context");
+
 		/* Histogram texture */
 	cl->mem_histogram = clCreateFromGLTexture(cl->ctx,
 		CL_MEM_READ_WRITE, GL_TEXTURE_2D, 0,
@@ -489,7 +805,7 @@ cl_init_buffers_gl(struct fosphor *self)
 
 		/* Spectrum VBO */
 	cl->mem_spectrum = clCreateFromGLBuffer(cl->ctx,
-		CL_MEM_WRITE_ONLY,
+		CL_MEM_READ_WRITE,
 		fosphor_gl_get_shared_id(self, GL_ID_VBO_SPECTRUM),
 		&err
 	);
@@ -502,6 +818,44 @@ error:
 	return err;
 }
 
+static int
+cl_init_zoom_buffers_gl(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	cl_int err;
+
+	/* GL shared objects (created by fosphor_gl_zoom_alloc) */
+		/* Zoom waterfall texture */
+	cl->mem_zoom_waterfall = clCreateFromGLTexture(cl->ctx,
+		CL_MEM_WRITE_ONLY, GL_TEXTURE_2D, 0,
+		fosphor_gl_get_shared_id(self, GL_ID_TEX_ZOOM_WATERFALL),
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to share zoom waterfall texture into OpenCL context");
+
+		/* Zoom histogram texture */
+	cl->mem_zoom_histogram = clCreateFromGLTexture(cl->ctx,
+		CL_MEM_READ_WRITE, GL_TEXTURE_2D, 0,
+		fosphor_gl_get_shared_id(self, GL_ID_TEX_ZOOM_HISTOGRAM),
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to share zoom histogram texture into OpenCL context");
+
+		/* Zoom spectrum VBO */
+	cl->mem_zoom_spectrum = clCreateFromGLBuffer(cl->ctx,
+		CL_MEM_READ_WRITE,
+		fosphor_gl_get_shared_id(self, GL_ID_VBO_ZOOM_SPECTRUM),
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to share zoom spectrum VBO into OpenCL context");
+
+	/* All done */
+	err = 0;
+
+error:
+	return err;
+}
+
 static int
 cl_init_buffers_nogl(struct fosphor *self)
 {
@@ -524,12 +878,12 @@ cl_init_buffers_nogl(struct fosphor *self)
 	img_desc.num_samples = 0;
 	img_desc.buffer = NULL;
 
-	/* Waterfall texture */
-	img_desc.image_height = 1024;
+	/* Waterfall texture (each stream stacked vertically) */
+	img_desc.image_height = 1024 * self->n_streams;
 
 	cl->mem_waterfall = clCreateImage(
 		cl->ctx,
-		CL_MEM_WRITE_ONLY,
+		CL_MEM_READ_WRITE,
 		&img_fmt,
 		&img_desc,
 		NULL,
@@ -537,8 +891,19 @@ cl_init_buffers_nogl(struct fosphor *self)
 	);
 	CL_ERR_CHECK(err, "Unable to create waterfall image");
 
-	/* Histogram texture */
-	img_desc.image_height = 128;
+	/* Reduced waterfall texture (same layout) */
+	cl->mem_waterfall_red = clCreateImage(
+		cl->ctx,
+		CL_MEM_WRITE_ONLY,
+		&img_fmt,
+		&img_desc,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to create reduced waterfall image");
+
+	/* Histogram texture (each stream stacked vertically) */
+	img_desc.image_height = 128 * self->n_streams;
 
 	cl->mem_histogram = clCreateImage(
 		cl->ctx,
@@ -554,7 +919,7 @@ cl_init_buffers_nogl(struct fosphor *self)
 	cl->mem_spectrum = clCreateBuffer(
 		cl->ctx,
 		CL_MEM_READ_WRITE,
-		2 * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		self->n_streams * 2 * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
 		NULL,
 		&err
 	);
@@ -567,6 +932,119 @@ error:
 	return err;
 }
 
+static int
+cl_init_zoom_buffers_nogl(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	cl_image_format img_fmt;
+	cl_image_desc img_desc;
+	cl_int err;
+
+	/* Same settings and layouts as the main objects */
+	img_fmt.image_channel_order = CL_R;
+	img_fmt.image_channel_data_type = CL_FLOAT;
+
+	img_desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+	img_desc.image_width = FOSPHOR_FFT_LEN;
+	img_desc.image_depth = 0;
+	img_desc.image_array_size = 0;
+	img_desc.image_row_pitch = 0;
+	img_desc.image_slice_pitch = 0;
+	img_desc.num_mip_levels = 0;
+	img_desc.num_samples = 0;
+	img_desc.buffer = NULL;
+
+	/* Zoom waterfall texture */
+	img_desc.image_height = 1024 * self->n_streams;
+
+	cl->mem_zoom_waterfall = clCreateImage(
+		cl->ctx,
+		CL_MEM_WRITE_ONLY,
+		&img_fmt,
+		&img_desc,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to create zoom waterfall image");
+
+	/* Zoom histogram texture */
+	img_desc.image_height = 128 * self->n_streams;
+
+	cl->mem_zoom_histogram = clCreateImage(
+		cl->ctx,
+		CL_MEM_READ_WRITE,
+		&img_fmt,
+		&img_desc,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to create zoom histogram image");
+
+	/* Zoom spectrum VBO */
+	cl->mem_zoom_spectrum = clCreateBuffer(
+		cl->ctx,
+		CL_MEM_READ_WRITE,
+		self->n_streams * 2 * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to create zoom spectrum VBO buffer");
+
+	/* All done */
+	err = 0;
+
+error:
+	return err;
+}
+
+
+static cl_kernel
+cl_create_display_kernel(struct fosphor_cl_state *cl,
+                         cl_mem mem_waterfall, cl_mem mem_histogram,
+                         cl_mem mem_spectrum, cl_mem mem_kurtosis,
+                         cl_int *err_ptr)
+{
+	cl_kernel kern;
+	cl_int err;
+
+	kern = clCreateKernel(cl->prog_display, "display", &err);
+	CL_ERR_CHECK(err, "Unable to create display kernel");
+
+	/* Configure static display kernel args */
+	cl_uint fft_log2_len = FOSPHOR_FFT_LEN_LOG;
+	cl_float histo_t0r   = 16.0f;
+	cl_float histo_t0d   = 1024.0f;
+	cl_float live_alpha  = FOSPHOR_LIVE_ALPHA;
+	cl_uint  sk_reset    = 1;
+
+	err  = clSetKernelArg(kern,  0, sizeof(cl_mem),   &cl->mem_fft_out);
+	err |= clSetKernelArg(kern,  1, sizeof(cl_int),   &fft_log2_len);
+
+	err |= clSetKernelArg(kern,  3, sizeof(cl_mem),   &mem_waterfall);
+
+	err |= clSetKernelArg(kern,  5, sizeof(cl_mem),   &mem_histogram);
+	err |= clSetKernelArg(kern,  6, sizeof(cl_mem),   &mem_histogram);
+	err |= clSetKernelArg(kern,  7, sizeof(cl_float), &histo_t0r);
+	err |= clSetKernelArg(kern,  8, sizeof(cl_float), &histo_t0d);
+
+	err |= clSetKernelArg(kern, 11, sizeof(cl_mem),   &mem_spectrum);
+	err |= clSetKernelArg(kern, 12, sizeof(cl_float), &live_alpha);
+
+	err |= clSetKernelArg(kern, 14, sizeof(cl_mem),   &mem_kurtosis);
+	err |= clSetKernelArg(kern, 15, sizeof(cl_uint),  &sk_reset);
+
+	CL_ERR_CHECK(err, "Unable to configure display kernel");
+
+	return kern;
+
+error:
+	if (kern)
+		clReleaseKernel(kern);
+
+	*err_ptr = err;
+
+	return NULL;
+}
 
 static int
 cl_do_init(struct fosphor *self)
@@ -648,7 +1126,7 @@ cl_do_init(struct fosphor *self)
 	/* FFT buffers */
 	cl->mem_fft_in = clCreateBuffer(cl->ctx,
 		CL_MEM_READ_ONLY,
-		2 * sizeof(cl_float) * FOSPHOR_FFT_LEN * FOSPHOR_FFT_MAX_BATCH,
+		self->n_streams * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN * FOSPHOR_FFT_MAX_BATCH,
 		NULL,
 		&err
 	);
@@ -656,7 +1134,7 @@ cl_do_init(struct fosphor *self)
 
 	cl->mem_fft_out = clCreateBuffer(cl->ctx,
 		CL_MEM_READ_WRITE,
-		2 * sizeof(cl_float) * FOSPHOR_FFT_LEN * FOSPHOR_FFT_MAX_BATCH,
+		self->n_streams * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN * FOSPHOR_FFT_MAX_BATCH,
 		NULL,
 		&err
 	);
@@ -685,6 +1163,18 @@ cl_do_init(struct fosphor *self)
 
 	CL_ERR_CHECK(err, "Unable to configure FFT kernel");
 
+	cl->kern_fft_real = clCreateKernel(cl->prog_fft, "fft1D_1024_real", &err);
+	CL_ERR_CHECK(err, "Unable to create real input FFT kernel");
+
+	err  = clSetKernelArg(cl->kern_fft_real, 0, sizeof(cl_mem), &cl->mem_fft_in);
+	err |= clSetKernelArg(cl->kern_fft_real, 1, sizeof(cl_mem), &cl->mem_fft_out);
+	err |= clSetKernelArg(cl->kern_fft_real, 2, sizeof(cl_mem), &cl->mem_fft_win);
+
+	CL_ERR_CHECK(err, "Unable to configure real input FFT kernel");
+
+	cl->kern_pfb_fold = clCreateKernel(cl->prog_fft, "pfb_fold", &err);
+	CL_ERR_CHECK(err, "Unable to create filter bank kernel");
+
 	/* Display kernel result memory objects */
 	if (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING)
 		err = cl_init_buffers_gl(self);
@@ -706,368 +1196,1927 @@ cl_do_init(struct fosphor *self)
 	if (!cl->prog_display)
 		goto error;
 
-	cl->kern_display = clCreateKernel(cl->prog_display, "display", &err);
-	CL_ERR_CHECK(err, "Unable to create display kernel");
+	cl->mem_kurtosis = clCreateBuffer(cl->ctx,
+		CL_MEM_READ_WRITE,
+		self->n_streams * 4 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate spectral kurtosis buffer");
+
+	cl->kern_display = cl_create_display_kernel(cl,
+		cl->mem_waterfall, cl->mem_histogram, cl->mem_spectrum,
+		cl->mem_kurtosis, &err);
+	if (!cl->kern_display)
+		goto error;
 
-	/* Configure static display kernel args */
 	cl_uint fft_log2_len = FOSPHOR_FFT_LEN_LOG;
-	cl_float histo_t0r   = 16.0f;
-	cl_float histo_t0d   = 1024.0f;
-	cl_float live_alpha  = 0.002f;
 
-	err  = clSetKernelArg(cl->kern_display,  0, sizeof(cl_mem),   &cl->mem_fft_out);
-	err |= clSetKernelArg(cl->kern_display,  1, sizeof(cl_int),   &fft_log2_len);
+	/* Waterfall reduction kernel */
+	cl->kern_wf_reduce = clCreateKernel(cl->prog_display, "wf_reduce", &err);
+	CL_ERR_CHECK(err, "Unable to create waterfall reduction kernel");
 
-	err |= clSetKernelArg(cl->kern_display,  3, sizeof(cl_mem),   &cl->mem_waterfall);
+	cl_uint wf_height = 1024;
 
-	err |= clSetKernelArg(cl->kern_display,  5, sizeof(cl_mem),   &cl->mem_histogram);
-	err |= clSetKernelArg(cl->kern_display,  6, sizeof(cl_mem),   &cl->mem_histogram);
-	err |= clSetKernelArg(cl->kern_display,  7, sizeof(cl_float), &histo_t0r);
-	err |= clSetKernelArg(cl->kern_display,  8, sizeof(cl_float), &histo_t0d);
+	err  = clSetKernelArg(cl->kern_wf_reduce, 0, sizeof(cl_mem),  &cl->mem_waterfall);
+	err |= clSetKernelArg(cl->kern_wf_reduce, 1, sizeof(cl_mem),  &cl->mem_waterfall_red);
+	err |= clSetKernelArg(cl->kern_wf_reduce, 2, sizeof(cl_uint), &fft_log2_len);
+	err |= clSetKernelArg(cl->kern_wf_reduce, 3, sizeof(cl_uint), &wf_height);
 
-	err |= clSetKernelArg(cl->kern_display, 11, sizeof(cl_mem),   &cl->mem_spectrum);
-	err |= clSetKernelArg(cl->kern_display, 12, sizeof(cl_float), &live_alpha);
+	CL_ERR_CHECK(err, "Unable to configure waterfall reduction kernel");
 
-	CL_ERR_CHECK(err, "Unable to configure display kernel");
+	/* Zoom: down-converter buffers */
+	cl->mem_ddc_hist = clCreateBuffer(cl->ctx,
+		CL_MEM_READ_WRITE,
+		self->n_streams * 2 * sizeof(cl_float) * FOSPHOR_ZOOM_MAX_TAPS,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate zoom history buffer");
 
-	/* All done */
-	err = 0;
+	cl->mem_ddc_taps = clCreateBuffer(cl->ctx,
+		CL_MEM_READ_ONLY,
+		2 * sizeof(cl_float) * FOSPHOR_ZOOM_MAX_TAPS,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate zoom taps buffer");
 
-error:
-	return err;
-}
+	cl->mem_zoom_in = clCreateBuffer(cl->ctx,
+		CL_MEM_READ_WRITE,
+		self->n_streams * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN * FOSPHOR_FFT_MULT_BATCH,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate zoom FFT input buffer");
 
-static void
-cl_do_release(struct fosphor_cl_state *cl)
+	/* Zoom: down-converter kernel */
+	cl->prog_ddc = cl_load_program(cl->dev_id, cl->ctx, "ddc.cl", NULL, &err);
+	if (!cl->prog_ddc)
+		goto error;
+
+	cl->kern_ddc = clCreateKernel(cl->prog_ddc, "ddc", &err);
+	CL_ERR_CHECK(err, "Unable to create zoom down-converter kernel");
+
+	cl_uint ddc_hist_len   = FOSPHOR_ZOOM_MAX_TAPS;
+	cl_uint ddc_out_stride = FOSPHOR_FFT_LEN * FOSPHOR_FFT_MULT_BATCH;
+
+	err  = clSetKernelArg(cl->kern_ddc,  0, sizeof(cl_mem),  &cl->mem_fft_in);
+	err |= clSetKernelArg(cl->kern_ddc,  1, sizeof(cl_mem),  &cl->mem_ddc_hist);
+	err |= clSetKernelArg(cl->kern_ddc,  2, sizeof(cl_uint), &ddc_hist_len);
+	err |= clSetKernelArg(cl->kern_ddc,  4, sizeof(cl_mem),  &cl->mem_ddc_taps);
+	err |= clSetKernelArg(cl->kern_ddc, 10, sizeof(cl_mem),  &cl->mem_zoom_in);
+	err |= clSetKernelArg(cl->kern_ddc, 12, sizeof(cl_uint), &ddc_out_stride);
+
+	CL_ERR_CHECK(err, "Unable to configure zoom down-converter kernel");
+
+	/* Zoom: FFT & display kernels (same code, other objects) */
+	cl->kern_fft_zoom = clCreateKernel(cl->prog_fft, "fft1D_1024", &err);
+	CL_ERR_CHECK(err, "Unable to create zoom FFT kernel");
+
+	err  = clSetKernelArg(cl->kern_fft_zoom, 0, sizeof(cl_mem), &cl->mem_zoom_in);
+	err |= clSetKernelArg(cl->kern_fft_zoom, 1, sizeof(cl_mem), &cl->mem_fft_out);
+	err |= clSetKernelArg(cl->kern_fft_zoom, 2, sizeof(cl_mem), &cl->mem_fft_win);
+
+	CL_ERR_CHECK(err, "Unable to configure zoom FFT kernel");
+
+	/* (the output objects and the display kernel using them only exist
+	 *  while the zoom is enabled, see cl_zoom_alloc) */
+	cl->zoom.decim = 1;
+
+	/* Peak detection */
+	cl->mem_peaks = clCreateBuffer(cl->ctx,
+		CL_MEM_WRITE_ONLY,
+		self->n_streams * 4 * sizeof(cl_float) * (FOSPHOR_PEAKS_MAX + 1),
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate peaks buffer");
+
+	cl->kern_peaks = clCreateKernel(cl->prog_display, "peaks", &err);
+	CL_ERR_CHECK(err, "Unable to create peak detection kernel");
+
+	err  = clSetKernelArg(cl->kern_peaks, 0, sizeof(cl_mem),  &cl->mem_spectrum);
+	err |= clSetKernelArg(cl->kern_peaks, 1, sizeof(cl_uint), &fft_log2_len);
+	err |= clSetKernelArg(cl->kern_peaks, 3, sizeof(cl_mem),  &cl->mem_peaks);
+
+	CL_ERR_CHECK(err, "Unable to configure peak detection kernel");
+
+	/* Automatic power range statistics */
+	cl->mem_range_stats = clCreateBuffer(cl->ctx,
+		CL_MEM_WRITE_ONLY,
+		self->n_streams * 4 * sizeof(cl_float),
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate range statistics buffer");
+
+	cl->kern_range_stats = clCreateKernel(cl->prog_display, "range_stats", &err);
+	CL_ERR_CHECK(err, "Unable to create range statistics kernel");
+
+	err  = clSetKernelArg(cl->kern_range_stats, 0, sizeof(cl_mem),  &cl->mem_spectrum);
+	err |= clSetKernelArg(cl->kern_range_stats, 1, sizeof(cl_uint), &fft_log2_len);
+	err |= clSetKernelArg(cl->kern_range_stats, 2, sizeof(cl_mem),  &cl->mem_range_stats);
+	err |= clSetKernelArg(cl->kern_range_stats, 3, sizeof(cl_mem),  &cl->mem_histogram);
+
+	CL_ERR_CHECK(err, "Unable to configure range statistics kernel");
+
+	/* Band power */
+	cl->mem_bands = clCreateBuffer(cl->ctx,
+		CL_MEM_READ_WRITE,
+		self->n_streams * 4 * sizeof(cl_float) * FOSPHOR_BANDS_MAX,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate band power buffer");
+
+	cl->mem_bands_range = clCreateBuffer(cl->ctx,
+		CL_MEM_READ_ONLY,
+		2 * sizeof(cl_int) * FOSPHOR_BANDS_MAX,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate band ranges buffer");
+
+	cl->mem_bands_trig = clCreateBuffer(cl->ctx,
+		CL_MEM_READ_WRITE,
+		self->n_streams * sizeof(cl_int) * FOSPHOR_BANDS_MAX,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate band trigger buffer");
+
+	cl->kern_band_power = clCreateKernel(cl->prog_display, "band_power", &err);
+	CL_ERR_CHECK(err, "Unable to create band power kernel");
+
+	err  = clSetKernelArg(cl->kern_band_power, 0, sizeof(cl_mem),  &cl->mem_fft_out);
+	err |= clSetKernelArg(cl->kern_band_power, 1, sizeof(cl_uint), &fft_log2_len);
+	err |= clSetKernelArg(cl->kern_band_power, 3, sizeof(cl_mem),  &cl->mem_bands_range);
+	err |= clSetKernelArg(cl->kern_band_power, 6, sizeof(cl_mem),  &cl->mem_bands);
+	err |= clSetKernelArg(cl->kern_band_power, 9, sizeof(cl_mem),  &cl->mem_bands_trig);
+
+	CL_ERR_CHECK(err, "Unable to configure band power kernel");
+
+	cl->bands.reset = 1;
+	cl->bands.trig_threshold = HUGE_VALF;
+
+	/* Limit mask compliance */
+	cl->mem_mask = clCreateBuffer(cl->ctx,
+		CL_MEM_READ_ONLY,
+		sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate mask buffer");
+
+	cl->mem_mask_viol = clCreateBuffer(cl->ctx,
+		CL_MEM_READ_WRITE,
+		self->n_streams * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate mask violations buffer");
+
+	cl->kern_mask_check = clCreateKernel(cl->prog_display, "mask_check", &err);
+	CL_ERR_CHECK(err, "Unable to create mask check kernel");
+
+	err  = clSetKernelArg(cl->kern_mask_check, 0, sizeof(cl_mem),  &cl->mem_fft_out);
+	err |= clSetKernelArg(cl->kern_mask_check, 1, sizeof(cl_uint), &fft_log2_len);
+	err |= clSetKernelArg(cl->kern_mask_check, 3, sizeof(cl_mem),  &cl->mem_mask);
+	err |= clSetKernelArg(cl->kern_mask_check, 5, sizeof(cl_mem),  &cl->mem_mask_viol);
+
+	CL_ERR_CHECK(err, "Unable to configure mask check kernel");
+
+	cl->mask.reset = 1;
+
+	/* Occupancy */
+	cl->mem_occupancy = clCreateBuffer(cl->ctx,
+		CL_MEM_READ_WRITE,
+		self->n_streams * sizeof(cl_uint) * FOSPHOR_FFT_LEN,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate occupancy buffer");
+
+	cl->kern_occupancy = clCreateKernel(cl->prog_display, "occupancy", &err);
+	CL_ERR_CHECK(err, "Unable to create occupancy kernel");
+
+	err  = clSetKernelArg(cl->kern_occupancy, 0, sizeof(cl_mem),  &cl->mem_fft_out);
+	err |= clSetKernelArg(cl->kern_occupancy, 1, sizeof(cl_uint), &fft_log2_len);
+	err |= clSetKernelArg(cl->kern_occupancy, 5, sizeof(cl_mem),  &cl->mem_occupancy);
+
+	CL_ERR_CHECK(err, "Unable to configure occupancy kernel");
+
+	cl->occ.reset = 1;
+
+	/* Long-term rollups */
+	cl->mem_rollup = clCreateBuffer(cl->ctx,
+		CL_MEM_READ_WRITE,
+		self->n_streams * 4 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate rollup buffer");
+
+	cl->kern_rollup = clCreateKernel(cl->prog_display, "rollup", &err);
+	CL_ERR_CHECK(err, "Unable to create rollup kernel");
+
+	err  = clSetKernelArg(cl->kern_rollup, 0, sizeof(cl_mem),  &cl->mem_fft_out);
+	err |= clSetKernelArg(cl->kern_rollup, 1, sizeof(cl_uint), &fft_log2_len);
+	err |= clSetKernelArg(cl->kern_rollup, 4, sizeof(cl_mem),  &cl->mem_rollup);
+
+	CL_ERR_CHECK(err, "Unable to configure rollup kernel");
+
+	cl->rollup.reset = 1;
+
+	/* Cross-spectrum (only makes sense with two streams or more) */
+	if (self->n_streams >= 2)
+	{
+		cl->mem_xs_avg = clCreateBuffer(cl->ctx,
+			CL_MEM_READ_WRITE,
+			4 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+			NULL,
+			&err
+		);
+		CL_ERR_CHECK(err, "Unable to allocate cross-spectrum average buffer");
+
+		cl->mem_xs_out = clCreateBuffer(cl->ctx,
+			CL_MEM_WRITE_ONLY,
+			4 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+			NULL,
+			&err
+		);
+		CL_ERR_CHECK(err, "Unable to allocate cross-spectrum output buffer");
+
+		cl->kern_xs = clCreateKernel(cl->prog_display, "cross_spectrum", &err);
+		CL_ERR_CHECK(err, "Unable to create cross-spectrum kernel");
+
+		err  = clSetKernelArg(cl->kern_xs, 0, sizeof(cl_mem),  &cl->mem_fft_out);
+		err |= clSetKernelArg(cl->kern_xs, 1, sizeof(cl_uint), &fft_log2_len);
+		err |= clSetKernelArg(cl->kern_xs, 5, sizeof(cl_mem),  &cl->mem_xs_avg);
+		err |= clSetKernelArg(cl->kern_xs, 6, sizeof(cl_mem),  &cl->mem_xs_out);
+
+		CL_ERR_CHECK(err, "Unable to configure cross-spectrum kernel");
+
+		cl->xs.reset = 1;
+	}
+
+	/* Histogram percentiles */
+	cl->mem_percentiles = clCreateBuffer(cl->ctx,
+		CL_MEM_WRITE_ONLY,
+		self->n_streams * 4 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		NULL,
+		&err
+	);
+	CL_ERR_CHECK(err, "Unable to allocate percentiles buffer");
+
+	cl->kern_percentiles = clCreateKernel(cl->prog_display, "histo_percentiles", &err);
+	CL_ERR_CHECK(err, "Unable to create histogram percentiles kernel");
+
+	err  = clSetKernelArg(cl->kern_percentiles, 0, sizeof(cl_mem), &cl->mem_histogram);
+	err |= clSetKernelArg(cl->kern_percentiles, 4, sizeof(cl_mem), &cl->mem_percentiles);
+
+	CL_ERR_CHECK(err, "Unable to configure histogram percentiles kernel");
+
+	/* All done */
+	err = 0;
+
+error:
+	return err;
+}
+
+static void
+cl_do_release(struct fosphor_cl_state *cl)
 {
+	if (cl->kern_percentiles)
+		clReleaseKernel(cl->kern_percentiles);
+
+	if (cl->mem_percentiles)
+		clReleaseMemObject(cl->mem_percentiles);
+
+	if (cl->kern_band_power)
+		clReleaseKernel(cl->kern_band_power);
+
+	if (cl->kern_xs)
+		clReleaseKernel(cl->kern_xs);
+
+	if (cl->mem_kurtosis)
+		clReleaseMemObject(cl->mem_kurtosis);
+
+	if (cl->mem_xs_out)
+		clReleaseMemObject(cl->mem_xs_out);
+
+	if (cl->mem_xs_avg)
+		clReleaseMemObject(cl->mem_xs_avg);
+
+	if (cl->kern_rollup)
+		clReleaseKernel(cl->kern_rollup);
+
+	if (cl->mem_rollup)
+		clReleaseMemObject(cl->mem_rollup);
+
+	if (cl->kern_occupancy)
+		clReleaseKernel(cl->kern_occupancy);
+
+	if (cl->mem_occupancy)
+		clReleaseMemObject(cl->mem_occupancy);
+
+	if (cl->kern_mask_check)
+		clReleaseKernel(cl->kern_mask_check);
+
+	if (cl->mem_mask_viol)
+		clReleaseMemObject(cl->mem_mask_viol);
+
+	if (cl->mem_mask)
+		clReleaseMemObject(cl->mem_mask);
+
+	if (cl->mem_bands_range)
+		clReleaseMemObject(cl->mem_bands_range);
+
+	if (cl->mem_bands_trig)
+		clReleaseMemObject(cl->mem_bands_trig);
+
+	if (cl->mem_bands)
+		clReleaseMemObject(cl->mem_bands);
+
+	if (cl->kern_range_stats)
+		clReleaseKernel(cl->kern_range_stats);
+
+	if (cl->mem_range_stats)
+		clReleaseMemObject(cl->mem_range_stats);
+
+	if (cl->kern_peaks)
+		clReleaseKernel(cl->kern_peaks);
+
+	if (cl->mem_peaks)
+		clReleaseMemObject(cl->mem_peaks);
+
+	if (cl->kern_display_zoom)
+		clReleaseKernel(cl->kern_display_zoom);
+
+	if (cl->kern_fft_zoom)
+		clReleaseKernel(cl->kern_fft_zoom);
+
+	if (cl->kern_ddc)
+		clReleaseKernel(cl->kern_ddc);
+
+	if (cl->prog_ddc)
+		clReleaseProgram(cl->prog_ddc);
+
+	if (cl->mem_zoom_in)
+		clReleaseMemObject(cl->mem_zoom_in);
+
+	if (cl->mem_ddc_taps)
+		clReleaseMemObject(cl->mem_ddc_taps);
+
+	if (cl->mem_ddc_hist)
+		clReleaseMemObject(cl->mem_ddc_hist);
+
+	if (cl->kern_wf_reduce)
+		clReleaseKernel(cl->kern_wf_reduce);
+
 	if (cl->kern_display)
 		clReleaseKernel(cl->kern_display);
 
 	if (cl->prog_display)
 		clReleaseProgram(cl->prog_display);
 
+	if (cl->mem_zoom_spectrum)
+		clReleaseMemObject(cl->mem_zoom_spectrum);
+
+	if (cl->mem_zoom_histogram)
+		clReleaseMemObject(cl->mem_zoom_histogram);
+
+	if (cl->mem_zoom_waterfall)
+		clReleaseMemObject(cl->mem_zoom_waterfall);
+
 	if (cl->mem_spectrum)
 		clReleaseMemObject(cl->mem_spectrum);
 
 	if (cl->mem_histogram)
 		clReleaseMemObject(cl->mem_histogram);
 
+	if (cl->mem_waterfall_red)
+		clReleaseMemObject(cl->mem_waterfall_red);
+
 	if (cl->mem_waterfall)
 		clReleaseMemObject(cl->mem_waterfall);
 
-	if (cl->kern_fft)
-		clReleaseKernel(cl->kern_fft);
+	if (cl->kern_pfb_fold)
+		clReleaseKernel(cl->kern_pfb_fold);
+
+	if (cl->mem_pfb_win)
+		clReleaseMemObject(cl->mem_pfb_win);
+
+	if (cl->mem_pfb_taps)
+		clReleaseMemObject(cl->mem_pfb_taps);
+
+	if (cl->mem_pfb_hist)
+		clReleaseMemObject(cl->mem_pfb_hist);
+
+	if (cl->mem_pfb_out)
+		clReleaseMemObject(cl->mem_pfb_out);
+
+	if (cl->kern_fft_real)
+		clReleaseKernel(cl->kern_fft_real);
+
+	if (cl->kern_fft)
+		clReleaseKernel(cl->kern_fft);
+
+	if (cl->prog_fft)
+		clReleaseProgram(cl->prog_fft);
+
+	if (cl->mem_fft_win)
+		clReleaseMemObject(cl->mem_fft_win);
+
+	if (cl->mem_fft_out)
+		clReleaseMemObject(cl->mem_fft_out);
+
+	if (cl->mem_fft_in)
+		clReleaseMemObject(cl->mem_fft_in);
+
+	if (cl->cq)
+		clReleaseCommandQueue(cl->cq);
+
+	if (cl->ctx)
+		clReleaseContext(cl->ctx);
+}
+
+
+static cl_int
+cl_lock_unlock(struct fosphor_cl_state *cl, int lock, cl_event *event)
+{
+	cl_mem objs[7];
+	int n = 4;
+
+	objs[0] = cl->mem_waterfall;
+	objs[1] = cl->mem_waterfall_red;
+	objs[2] = cl->mem_histogram;
+	objs[3] = cl->mem_spectrum;
+
+	/* Zoom objects only exist while it's enabled */
+	if (cl->kern_display_zoom) {
+		objs[4] = cl->mem_zoom_waterfall;
+		objs[5] = cl->mem_zoom_histogram;
+		objs[6] = cl->mem_zoom_spectrum;
+		n = 7;
+	}
+
+	return lock ?
+		clEnqueueAcquireGLObjects(cl->cq, n, objs, 0, NULL, event) :
+		clEnqueueReleaseGLObjects(cl->cq, n, objs, 0, NULL, event);
+}
+
+static void
+cl_zoom_release(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	cl_mem objs[3];
+
+	if (!cl->mem_zoom_waterfall)
+		return;
+
+	/* Shared objects are ours while a frame is pending, hand them back */
+	if (cl->kern_display_zoom &&
+	    (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING) &&
+	    (cl->state == CL_PENDING))
+	{
+		objs[0] = cl->mem_zoom_waterfall;
+		objs[1] = cl->mem_zoom_histogram;
+		objs[2] = cl->mem_zoom_spectrum;
+
+		clEnqueueReleaseGLObjects(cl->cq, 3, objs, 0, NULL, NULL);
+	}
+
+	/* Queued work may still use them */
+	clFinish(cl->cq);
+
+	if (cl->kern_display_zoom)
+		clReleaseKernel(cl->kern_display_zoom);
+
+	if (cl->mem_zoom_spectrum)
+		clReleaseMemObject(cl->mem_zoom_spectrum);
+
+	if (cl->mem_zoom_histogram)
+		clReleaseMemObject(cl->mem_zoom_histogram);
+
+	if (cl->mem_zoom_waterfall)
+		clReleaseMemObject(cl->mem_zoom_waterfall);
+
+	cl->kern_display_zoom  = NULL;
+	cl->mem_zoom_spectrum  = NULL;
+	cl->mem_zoom_histogram = NULL;
+	cl->mem_zoom_waterfall = NULL;
+}
+
+static cl_int
+cl_zoom_alloc(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	float noise_floor, color[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	size_t img_origin[3] = {0, 0, 0}, img_region[3];
+	cl_mem objs[3];
+	cl_int err;
+
+	/* Output objects */
+	if (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING)
+		err = cl_init_zoom_buffers_gl(self);
+	else
+		err = cl_init_zoom_buffers_nogl(self);
+
+	if (err != CL_SUCCESS)
+		goto error;
+
+	/* Display kernel (the kurtosis is only measured on the main FFT,
+	 * the buffer is just there to have every argument set) */
+	cl->kern_display_zoom = cl_create_display_kernel(cl,
+		cl->mem_zoom_waterfall, cl->mem_zoom_histogram, cl->mem_zoom_spectrum,
+		cl->mem_kurtosis, &err);
+	if (!cl->kern_display_zoom)
+		goto error;
+
+	/* Shared objects need to be ours to be cleared, and stay so if
+	 * the other ones are (frame pending) */
+	objs[0] = cl->mem_zoom_waterfall;
+	objs[1] = cl->mem_zoom_histogram;
+	objs[2] = cl->mem_zoom_spectrum;
+
+	if (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING) {
+		err = clEnqueueAcquireGLObjects(cl->cq, 3, objs, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to acquire zoom GL objects");
+	}
+
+	/* Same initial content as the main objects */
+	noise_floor = - self->power.offset;
+
+	err = clEnqueueFillBuffer(cl->cq,
+		cl->mem_zoom_spectrum,
+		&noise_floor, sizeof(float),
+		0,
+		self->n_streams * 2 * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to queue clear of zoom spectrum buffer");
+
+	color[0] = noise_floor;
+
+	img_region[0] = FOSPHOR_FFT_LEN;
+	img_region[1] = 1024 * self->n_streams;
+	img_region[2] = 1;
+
+	err = clEnqueueFillImage(cl->cq,
+		cl->mem_zoom_waterfall,
+		color,
+		img_origin, img_region,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to queue clear of zoom waterfall image");
+
+	color[0] = 0.0f;
+
+	img_region[1] = 128 * self->n_streams;
+
+	err = clEnqueueFillImage(cl->cq,
+		cl->mem_zoom_histogram,
+		color,
+		img_origin, img_region,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to queue clear of zoom histogram image");
+
+	if ((self->flags & FLG_FOSPHOR_USE_CLGL_SHARING) && (cl->state != CL_PENDING)) {
+		err = clEnqueueReleaseGLObjects(cl->cq, 3, objs, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to release zoom GL objects");
+	}
+
+	/* Need to finish because our patterns are on the stack */
+	clFinish(cl->cq);
+
+	return CL_SUCCESS;
+
+error:
+	cl_zoom_release(self);
+	return err;
+}
+
+static cl_int
+cl_queue_wf_reduce(struct fosphor *self, int stream, int row, int n)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	size_t offset[3], global[3];
+	cl_uint wf_offset = row;
+	cl_int err;
+
+	/* Rows of a single stream, or all of them (stream < 0 or if
+	 * the device can't do global offsets) */
+	offset[0] = 0;
+	offset[1] = 0;
+	offset[2] = 0;
+
+	global[0] = FOSPHOR_WF_RED_WIDTH;
+	global[1] = n;
+	global[2] = self->n_streams;
+
+	if ((stream >= 0) && (cl->feat.flags & FLG_CL_OPENCL_11)) {
+		offset[2] = stream;
+		global[2] = 1;
+	}
+
+	err = clSetKernelArg(cl->kern_wf_reduce, 4, sizeof(cl_uint), &wf_offset);
+	CL_ERR_CHECK(err, "Unable to configure waterfall reduction kernel");
+
+	err = clEnqueueNDRangeKernel(cl->cq, cl->kern_wf_reduce, 3,
+		(cl->feat.flags & FLG_CL_OPENCL_11) ? offset : NULL,
+		global, NULL, 0, NULL, NULL);
+	CL_ERR_CHECK(err, "Unable to queue waterfall reduction kernel execution");
+
+	return CL_SUCCESS;
+
+error:
+	return err;
+}
+
+static cl_int
+cl_queue_zoom(struct fosphor *self, int len, cl_uint products)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	const int batch = FOSPHOR_FFT_LEN * FOSPHOR_FFT_MULT_BATCH;
+	size_t local[3], global[3];
+	cl_uint in_len = len, decim = cl->zoom.decim, n_taps = cl->zoom.n_taps;
+	cl_uint out_first, out_ofs, n_spectra = FOSPHOR_FFT_MULT_BATCH;
+	cl_int err;
+	int i, n_out, cnt;
+
+	/* Decimation is a power of 2 and len a multiple of the batch size,
+	 * so each call produces exactly len / decim outputs */
+	n_out = len / cl->zoom.decim;
+
+	err  = clSetKernelArg(cl->kern_ddc, 3, sizeof(cl_uint), &in_len);
+	err |= clSetKernelArg(cl->kern_ddc, 5, sizeof(cl_uint), &n_taps);
+	err |= clSetKernelArg(cl->kern_ddc, 6, sizeof(cl_uint), &decim);
+	err |= clSetKernelArg(cl->kern_ddc, 7, sizeof(cl_uint), &cl->zoom.phase);
+	err |= clSetKernelArg(cl->kern_ddc, 8, sizeof(cl_uint), &cl->zoom.phase_inc);
+	CL_ERR_CHECK(err, "Unable to configure zoom down-converter kernel");
+
+	for (i=0; i<n_out; i+=cnt)
+	{
+		/* Down-convert as much as fits in the pending FFT batch */
+		cnt = batch - cl->zoom.fill;
+		if (cnt > (n_out - i))
+			cnt = n_out - i;
+
+		out_first = i;
+		out_ofs   = cl->zoom.fill;
+
+		err  = clSetKernelArg(cl->kern_ddc,  9, sizeof(cl_uint), &out_first);
+		err |= clSetKernelArg(cl->kern_ddc, 11, sizeof(cl_uint), &out_ofs);
+		CL_ERR_CHECK(err, "Unable to configure zoom down-converter kernel");
+
+		global[0] = cnt;
+		global[1] = self->n_streams;
+
+		err = clEnqueueNDRangeKernel(cl->cq, cl->kern_ddc, 2, NULL, global, NULL, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to queue zoom down-converter kernel execution");
+
+		cl->zoom.fill += cnt;
+
+		if (cl->zoom.fill < batch)
+			continue;
+
+		/* Full batch: FFT (reusing the main output buffer, the main
+		 * display kernel is done with it) and display */
+		global[0] = FOSPHOR_FFT_LEN / 8;
+		global[1] = FOSPHOR_FFT_MULT_BATCH;
+		global[2] = self->n_streams;
+
+		local[0] = global[0];
+		local[1] = 1;
+		local[2] = 1;
+
+		err = clEnqueueNDRangeKernel(cl->cq, cl->kern_fft_zoom, 3, NULL, global, local, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to queue zoom FFT kernel execution");
+
+		err  = 0;
+		err |= clSetKernelArg(cl->kern_display_zoom,  2, sizeof(cl_int),   &n_spectra);
+		err |= clSetKernelArg(cl->kern_display_zoom,  4, sizeof(cl_int),   &cl->zoom.waterfall_pos);
+		err |= clSetKernelArg(cl->kern_display_zoom,  9, sizeof(cl_float), &cl->histo_scale);
+		err |= clSetKernelArg(cl->kern_display_zoom, 10, sizeof(cl_float), &cl->histo_offset);
+		err |= clSetKernelArg(cl->kern_display_zoom, 13, sizeof(cl_uint),  &products);
+		CL_ERR_CHECK(err, "Unable to configure zoom display kernel");
+
+		global[0] = FOSPHOR_FFT_LEN;
+		global[1] = 16;
+		global[2] = self->n_streams;
+		local[0] = 16;
+		local[1] = 16;
+		local[2] = 1;
+
+		err = clEnqueueNDRangeKernel(cl->cq, cl->kern_display_zoom, 3, NULL, global, local, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to queue zoom display kernel execution");
+
+		if (products & FOSPHOR_PROD_WATERFALL)
+			cl->zoom.waterfall_pos = (cl->zoom.waterfall_pos + FOSPHOR_FFT_MULT_BATCH) & 1023;
+
+		cl->zoom.fill = 0;
+	}
+
+	/* Keep the tail of the input as history for the next call */
+	for (i=0; i<self->n_streams; i++)
+	{
+		err = clEnqueueCopyBuffer(cl->cq,
+			cl->mem_fft_in, cl->mem_ddc_hist,
+			2 * sizeof(cl_float) * ((size_t)i * len + len - FOSPHOR_ZOOM_MAX_TAPS),
+			2 * sizeof(cl_float) * ((size_t)i * FOSPHOR_ZOOM_MAX_TAPS),
+			2 * sizeof(cl_float) * FOSPHOR_ZOOM_MAX_TAPS,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue zoom history update");
+	}
+
+	cl->zoom.phase += cl->zoom.phase_inc * (uint32_t)len;
+
+	return CL_SUCCESS;
+
+error:
+	return err;
+}
+
+
+static cl_int
+cl_queue_peaks(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	size_t local[2], global[2];
+	cl_int err;
+
+	err = clSetKernelArg(cl->kern_peaks, 2, sizeof(cl_float), &self->peaks.threshold);
+	CL_ERR_CHECK(err, "Unable to configure peak detection kernel");
+
+	/* One work group per stream */
+	global[0] = 256;
+	global[1] = self->n_streams;
+	local[0] = 256;
+	local[1] = 1;
+
+	err = clEnqueueNDRangeKernel(cl->cq, cl->kern_peaks, 2, NULL, global, local, 0, NULL, NULL);
+	CL_ERR_CHECK(err, "Unable to queue peak detection kernel execution");
+
+	/* Results are small, always fetch them */
+	err = clEnqueueReadBuffer(cl->cq,
+		cl->mem_peaks,
+		CL_FALSE,
+		0,
+		self->n_streams * 4 * sizeof(cl_float) * (FOSPHOR_PEAKS_MAX + 1),
+		self->peaks.buf,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to queue readback of peaks buffer");
+
+	return CL_SUCCESS;
+
+error:
+	return err;
+}
+
+static cl_int
+cl_queue_range_stats(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	cl_uint use_histo = (self->products & FOSPHOR_PROD_HISTO) ? 1 : 0;
+	size_t local[2], global[2];
+	cl_int err;
+
+	/* The histogram only helps if it's being computed */
+	err  = clSetKernelArg(cl->kern_range_stats, 4, sizeof(cl_float), &cl->histo_scale);
+	err |= clSetKernelArg(cl->kern_range_stats, 5, sizeof(cl_float), &cl->histo_offset);
+	err |= clSetKernelArg(cl->kern_range_stats, 6, sizeof(cl_uint),  &use_histo);
+	CL_ERR_CHECK(err, "Unable to configure range statistics kernel");
+
+	/* One work group per stream */
+	global[0] = 256;
+	global[1] = self->n_streams;
+	local[0] = 256;
+	local[1] = 1;
+
+	err = clEnqueueNDRangeKernel(cl->cq, cl->kern_range_stats, 2, NULL, global, local, 0, NULL, NULL);
+	CL_ERR_CHECK(err, "Unable to queue range statistics kernel execution");
+
+	/* Only a float4 per stream comes back */
+	err = clEnqueueReadBuffer(cl->cq,
+		cl->mem_range_stats,
+		CL_FALSE,
+		0,
+		self->n_streams * 4 * sizeof(cl_float),
+		self->autorange.stats,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to queue readback of range statistics");
+
+	return CL_SUCCESS;
+
+error:
+	return err;
+}
+
+static cl_int
+cl_queue_percentiles(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	size_t global[2];
+	cl_int err;
+
+	err  = clSetKernelArg(cl->kern_percentiles, 1, sizeof(cl_float), &cl->histo_scale);
+	err |= clSetKernelArg(cl->kern_percentiles, 2, sizeof(cl_float), &cl->histo_offset);
+	err |= clSetKernelArg(cl->kern_percentiles, 3, sizeof(cl_float), &self->pct.p_low);
+	CL_ERR_CHECK(err, "Unable to configure histogram percentiles kernel");
+
+	global[0] = FOSPHOR_FFT_LEN;
+	global[1] = self->n_streams;
+
+	err = clEnqueueNDRangeKernel(cl->cq, cl->kern_percentiles, 2, NULL, global, NULL, 0, NULL, NULL);
+	CL_ERR_CHECK(err, "Unable to queue histogram percentiles kernel execution");
+
+	err = clEnqueueReadBuffer(cl->cq,
+		cl->mem_percentiles,
+		CL_FALSE,
+		0,
+		self->n_streams * 4 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		self->pct.buf,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to queue readback of percentiles buffer");
+
+	return CL_SUCCESS;
+
+error:
+	return err;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* Exposed API                                                                */
+/* -------------------------------------------------------------------------- */
+
+int
+fosphor_cl_init(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl;
+	cl_int err;
+
+	/* Allocate structure */
+	cl = malloc(sizeof(struct fosphor_cl_state));
+	if (!cl)
+		return -ENOMEM;
+
+	self->cl = cl;
+
+	memset(cl, 0, sizeof(struct fosphor_cl_state));
+
+	cl->state = CL_BOOTING;
+
+	/* Find suitable device */
+	if (cl_find_device(&cl->pl_id, &cl->dev_id, &cl->feat)) {
+		fprintf(stderr, "[!] No suitable OpenCL device found\n");
+		goto error;
+	}
+
+	/* Report selected device */
+	fprintf(stderr, "[+] Selected device: %s\n", cl->feat.name);
+
+	/* Setup compatibility layer for this platform */
+	cl_compat_init();
+	cl_compat_check_platform(cl->pl_id);
+
+	/* Initialize selected platform / device */
+	err = cl_do_init(self);
+	if (err)
+		goto error;
+
+	/* Done */
+	return 0;
+
+	/* Error path */
+error:
+	fosphor_cl_release(self);
+
+	return -EIO;
+}
+
+void
+fosphor_cl_release(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+
+	/* Safety */
+	if (!cl)
+		return;
+
+	/* Release the GL objects */
+	if ((cl->state == CL_PENDING) && (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING))
+	{
+		cl_lock_unlock(cl, 0, NULL);
+	}
+
+	/* Release all allocated OpenCL resources */
+	cl_do_release(cl);
+
+	/* Release structure */
+	free(cl);
+
+	/* Nothing left */
+	self->cl = NULL;
+}
+
+int
+fosphor_cl_process(struct fosphor *self,
+                   void **samples, int len)
+{
+	struct fosphor_cl_state *cl = self->cl;
+
+	cl_kernel kern_fft;
+	cl_int err;
+	int measure = !(self->flags & FLG_FOSPHOR_REPLAY);	/* Replays are display only */
+	cl_uint products = self->products | ((measure && cl->sk.enabled) ? FOSPHOR_PROD_KURTOSIS : 0);
+	int i, locked = 0;
+	size_t local[3], global[3];
+	int n_spectra = len / FOSPHOR_FFT_LEN;
+
+	/* Validate batch size */
+	if (len & ((FOSPHOR_FFT_MULT_BATCH*FOSPHOR_FFT_LEN)-1))
+		return -EINVAL;
+
+	if (len > (FOSPHOR_FFT_LEN * FOSPHOR_FFT_MAX_BATCH))
+		return -EINVAL;
+
+	/* Nobody looking and nothing to export or measure : nothing to do */
+	if (!products && (!measure || (!cl->bands.n && !cl->mask.enabled &&
+	    !cl->occ.enabled && !cl->rollup.enabled && !cl->xs.enabled)))
+		return 0;
+
+	/* Copy new window if needed */
+	if (cl->fft_win_updated) {
+		err = clEnqueueWriteBuffer(
+			cl->cq,
+			cl->mem_fft_win,
+			CL_FALSE,
+			0, sizeof(cl_float) * FOSPHOR_FFT_LEN, cl->fft_win,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to copy data to FFT window buffer");
+
+		cl->fft_win_updated = 0;
+	}
+
+	/* Same for the filter bank prototype, and start from a clean history */
+	if (cl->pfb.m && cl->pfb.taps_updated) {
+		err = clEnqueueWriteBuffer(
+			cl->cq,
+			cl->mem_pfb_taps,
+			CL_FALSE,
+			0, sizeof(cl_float) * FOSPHOR_FFT_LEN * cl->pfb.m, cl->pfb.taps,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to copy data to filter bank taps buffer");
+
+		cl->pfb.taps_updated = 0;
+	}
+
+	if (cl->pfb.m && cl->pfb.reset) {
+		float zero = 0.0f;
+
+		err = clEnqueueFillBuffer(cl->cq,
+			cl->mem_pfb_hist,
+			&zero, sizeof(float),
+			0,
+			self->n_streams * 2 * sizeof(cl_float) * FOSPHOR_PFB_HIST_LEN,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue clear of filter bank history buffer");
+
+		cl->pfb.reset = 0;
+	}
+
+	/* Copy samples data (streams back to back) */
+	for (i=0; i<self->n_streams; i++)
+	{
+		err = clEnqueueWriteBuffer(
+			cl->cq,
+			cl->mem_fft_in,
+			CL_FALSE,
+			i * 2 * sizeof(cl_float) * len,
+			2 * sizeof(cl_float) * len, samples[i],
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to copy data to FFT input buffer");
+	}
+
+	/* Filter bank : fold the blocks ahead of the FFT */
+	if (cl->pfb.m) {
+		cl_uint in_len = len;
+		cl_uint n_taps = cl->pfb.m;
+		cl_uint real   = cl->real_input;
+
+		err  = 0;
+		err |= clSetKernelArg(cl->kern_pfb_fold, 3, sizeof(cl_uint), &in_len);
+		err |= clSetKernelArg(cl->kern_pfb_fold, 5, sizeof(cl_uint), &n_taps);
+		err |= clSetKernelArg(cl->kern_pfb_fold, 6, sizeof(cl_uint), &real);
+		CL_ERR_CHECK(err, "Unable to configure filter bank kernel");
+
+		global[0] = FOSPHOR_FFT_LEN;
+		global[1] = n_spectra;
+		global[2] = self->n_streams;
+
+		err = clEnqueueNDRangeKernel(cl->cq, cl->kern_pfb_fold, 3, NULL, global, NULL, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to queue filter bank kernel execution");
+
+		/* Keep the tail of the input as history for the next call */
+		for (i=0; i<self->n_streams; i++)
+		{
+			err = clEnqueueCopyBuffer(cl->cq,
+				cl->mem_fft_in, cl->mem_pfb_hist,
+				2 * sizeof(cl_float) * ((size_t)i * len + len - FOSPHOR_PFB_HIST_LEN),
+				2 * sizeof(cl_float) * ((size_t)i * FOSPHOR_PFB_HIST_LEN),
+				2 * sizeof(cl_float) * FOSPHOR_PFB_HIST_LEN,
+				0, NULL, NULL
+			);
+			CL_ERR_CHECK(err, "Unable to queue filter bank history update");
+		}
+	}
+
+	/* Execute FFT kernel (stream index in 3rd dimension) */
+	kern_fft = cl->real_input ? cl->kern_fft_real : cl->kern_fft;
+
+	err  = clSetKernelArg(kern_fft, 0, sizeof(cl_mem), cl->pfb.m ? &cl->mem_pfb_out : &cl->mem_fft_in);
+	err |= clSetKernelArg(kern_fft, 2, sizeof(cl_mem), cl->pfb.m ? &cl->mem_pfb_win : &cl->mem_fft_win);
+	CL_ERR_CHECK(err, "Unable to configure FFT kernel");
+
+	global[0] = FOSPHOR_FFT_LEN / 8;
+	global[1] = n_spectra;
+	global[2] = self->n_streams;
+
+	local[0] = global[0];
+	local[1] = 1;
+	local[2] = 1;
+
+	err = clEnqueueNDRangeKernel(cl->cq, kern_fft, 3, NULL, global, local, 0, NULL, NULL);
+	CL_ERR_CHECK(err, "Unable to queue FFT kernel execution");
+
+	/* Capture all GL objects */
+	if ((cl->state != CL_PENDING) && (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING)) {
+		err = cl_lock_unlock(cl, 1, NULL);
+		CL_ERR_CHECK(err, "Unable to acquire GL objects");
+		locked = 1;
+	}
+
+	/* If this is the first run, make sure to pre-clear the buffers */
+	if (cl->state == CL_BOOTING) {
+		err = cl_queue_clear_buffers(self);
+		if (err != CL_SUCCESS)
+			goto error;
+	}
+
+	/* Display products (only measurements may be wanted) */
+	if (products)
+	{
+		cl_uint sk_reset = cl->sk.reset;
+
+		/* Configure display kernel */
+		err  = 0;
+		err |= clSetKernelArg(cl->kern_display,  2, sizeof(cl_int),   &n_spectra);
+		err |= clSetKernelArg(cl->kern_display,  4, sizeof(cl_int),   &cl->waterfall_pos);
+		err |= clSetKernelArg(cl->kern_display,  9, sizeof(cl_float), &cl->histo_scale);
+		err |= clSetKernelArg(cl->kern_display, 10, sizeof(cl_float), &cl->histo_offset);
+		err |= clSetKernelArg(cl->kern_display, 13, sizeof(cl_uint),  &products);
+		err |= clSetKernelArg(cl->kern_display, 15, sizeof(cl_uint),  &sk_reset);
+		CL_ERR_CHECK(err, "Unable to configure display kernel");
+
+		/* Execute display kernel (stream index in 3rd dimension) */
+		global[0] = FOSPHOR_FFT_LEN;
+		global[1] = 16;
+		global[2] = self->n_streams;
+		local[0] = 16;
+		local[1] = 16;
+		local[2] = 1;
+
+		err = clEnqueueNDRangeKernel(cl->cq, cl->kern_display, 3, NULL, global, local, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to queue display kernel execution");
+
+		if (products & FOSPHOR_PROD_KURTOSIS) {
+			cl->sk.reset   = 0;
+			cl->sk.pending = 1;
+		}
+	}
+
+	/* Reduce (if drawn) and advance waterfall (if rows were actually written) */
+	if (products & FOSPHOR_PROD_WATERFALL) {
+		if ((products & FOSPHOR_PROD_WF_RED) && cl->wf_red.valid) {
+			err = cl_queue_wf_reduce(self, -1, cl->waterfall_pos, n_spectra);
+			if (err != CL_SUCCESS)
+				goto error;
+
+			cl->wf_red.pending += n_spectra;
+			if (cl->wf_red.pending > 1024)
+				cl->wf_red.pending = 1024;
+		} else {
+			/* Rebuilt as a whole when needed again */
+			cl->wf_red.valid = 0;
+		}
+
+		cl->waterfall_pos = (cl->waterfall_pos + n_spectra) & 1023;
+
+		cl->waterfall_pending += n_spectra;
+		if (cl->waterfall_pending > 1024)
+			cl->waterfall_pending = 1024;
+	}
+
+	/* Band power (before the zoom reuses the FFT output) */
+	if (measure && cl->bands.n) {
+		cl_uint reset = cl->bands.reset;
+
+		if (reset) {
+			cl->bands.spectra = 0;
+			cl->bands.base    = self->spectra;
+		}
+
+		err  = 0;
+		err |= clSetKernelArg(cl->kern_band_power, 2, sizeof(cl_uint),  &n_spectra);
+		err |= clSetKernelArg(cl->kern_band_power, 4, sizeof(cl_float), &cl->bands.threshold);
+		err |= clSetKernelArg(cl->kern_band_power, 5, sizeof(cl_uint),  &reset);
+		err |= clSetKernelArg(cl->kern_band_power, 7, sizeof(cl_uint),  &cl->bands.spectra);
+		err |= clSetKernelArg(cl->kern_band_power, 8, sizeof(cl_float), &cl->bands.trig_threshold);
+		CL_ERR_CHECK(err, "Unable to configure band power kernel");
+
+		global[0] = 256;
+		global[1] = cl->bands.n;
+		global[2] = self->n_streams;
+		local[0] = 256;
+		local[1] = 1;
+		local[2] = 1;
+
+		err = clEnqueueNDRangeKernel(cl->cq, cl->kern_band_power, 3, NULL, global, local, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to queue band power kernel execution");
+
+		cl->bands.reset    = 0;
+		cl->bands.pending  = 1;
+		cl->bands.spectra += n_spectra;
+	}
+
+	/* Limit mask, checked on every spectrum */
+	if (measure && cl->mask.enabled) {
+		cl_uint reset = cl->mask.reset;
+
+		err  = 0;
+		err |= clSetKernelArg(cl->kern_mask_check, 2, sizeof(cl_uint), &n_spectra);
+		err |= clSetKernelArg(cl->kern_mask_check, 4, sizeof(cl_uint), &reset);
+		CL_ERR_CHECK(err, "Unable to configure mask check kernel");
+
+		global[0] = FOSPHOR_FFT_LEN;
+		global[1] = self->n_streams;
+
+		err = clEnqueueNDRangeKernel(cl->cq, cl->kern_mask_check, 2, NULL, global, NULL, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to queue mask check kernel execution");
+
+		cl->mask.reset   = 0;
+		cl->mask.pending = 1;
+	}
+
+	/* Occupancy, counted on every spectrum */
+	if (measure && cl->occ.enabled) {
+		cl_uint reset = cl->occ.reset;
+
+		err  = 0;
+		err |= clSetKernelArg(cl->kern_occupancy, 2, sizeof(cl_uint),  &n_spectra);
+		err |= clSetKernelArg(cl->kern_occupancy, 3, sizeof(cl_float), &cl->occ.threshold);
+		err |= clSetKernelArg(cl->kern_occupancy, 4, sizeof(cl_uint),  &reset);
+		CL_ERR_CHECK(err, "Unable to configure occupancy kernel");
+
+		global[0] = FOSPHOR_FFT_LEN;
+		global[1] = self->n_streams;
+
+		err = clEnqueueNDRangeKernel(cl->cq, cl->kern_occupancy, 2, NULL, global, NULL, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to queue occupancy kernel execution");
+
+		cl->occ.reset    = 0;
+		cl->occ.spectra += n_spectra;
+	}
+
+	/* Long-term rollups, every spectrum too */
+	if (measure && cl->rollup.enabled) {
+		cl_uint reset = cl->rollup.reset;
+
+		err  = 0;
+		err |= clSetKernelArg(cl->kern_rollup, 2, sizeof(cl_uint), &n_spectra);
+		err |= clSetKernelArg(cl->kern_rollup, 3, sizeof(cl_uint), &reset);
+		CL_ERR_CHECK(err, "Unable to configure rollup kernel");
+
+		global[0] = FOSPHOR_FFT_LEN;
+		global[1] = self->n_streams;
+
+		err = clEnqueueNDRangeKernel(cl->cq, cl->kern_rollup, 2, NULL, global, NULL, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to queue rollup kernel execution");
+
+		cl->rollup.reset    = 0;
+		cl->rollup.spectra += n_spectra;
+	}
+
+	/* Cross-spectrum, averaged over every spectrum */
+	if (measure && cl->xs.enabled) {
+		cl_uint reset = cl->xs.reset;
+
+		err  = 0;
+		err |= clSetKernelArg(cl->kern_xs, 2, sizeof(cl_uint),  &n_spectra);
+		err |= clSetKernelArg(cl->kern_xs, 3, sizeof(cl_float), &cl->xs.alpha);
+		err |= clSetKernelArg(cl->kern_xs, 4, sizeof(cl_uint),  &reset);
+		CL_ERR_CHECK(err, "Unable to configure cross-spectrum kernel");
+
+		global[0] = FOSPHOR_FFT_LEN;
+
+		err = clEnqueueNDRangeKernel(cl->cq, cl->kern_xs, 1, NULL, global, NULL, 0, NULL, NULL);
+		CL_ERR_CHECK(err, "Unable to queue cross-spectrum kernel execution");
+
+		cl->xs.reset   = 0;
+		cl->xs.pending = 1;
+	}
+
+	/* Zoom down-converter on the same samples */
+	products &= ~FOSPHOR_PROD_KURTOSIS;
+
+	if ((cl->zoom.decim > 1) && products) {
+		err = cl_queue_zoom(self, len, products);
+		if (err != CL_SUCCESS)
+			goto error;
+	}
+
+	/* New state */
+	cl->state = CL_PENDING;
+
+	return 0;
+
+error:
+	if (locked) {
+		err = cl_lock_unlock(cl, 0, NULL);
+		CL_ERR_CHECK(err, "Unable to release GL objects");
+	}
+
+	return -EIO;
+}
+
+int
+fosphor_cl_finish(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+
+	cl_int err;
+
+	/* Check if we really need to do anything */
+	if (cl->state == CL_READY)
+		return 0;
+
+	/* If no data was processed, we may need to finish the boot */
+	if (cl->state == CL_BOOTING) {
+		/* Acquire GL objects if needed */
+		if (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING)
+		{
+			err = cl_lock_unlock(cl, 1, NULL);
+			CL_ERR_CHECK(err, "Unable to acquire GL objects");
+		}
+
+		/* Clear the buffers */
+		err = cl_queue_clear_buffers(self);
+		if (err != CL_SUCCESS)
+			goto error;
+	}
+
+	/* Peak detection on the updated spectrum */
+	if (self->peaks.enabled) {
+		err = cl_queue_peaks(self);
+		if (err != CL_SUCCESS)
+			goto error;
+	}
+
+	/* Level statistics for the automatic power range */
+	if (self->autorange.enabled) {
+		err = cl_queue_range_stats(self);
+		if (err != CL_SUCCESS)
+			goto error;
+
+		self->autorange.fresh = 1;
+	}
+
+	/* Histogram percentiles, if asked for */
+	if (self->pct.enabled && self->pct.requested) {
+		err = cl_queue_percentiles(self);
+		if (err != CL_SUCCESS)
+			goto error;
+
+		self->pct.requested = 0;
+		if (!++self->pct.seq)
+			self->pct.seq = 1;
+	}
+
+	/* Band power of the batches since last time */
+	if (cl->bands.pending) {
+		err = clEnqueueReadBuffer(cl->cq,
+			cl->mem_bands,
+			CL_FALSE,
+			0,
+			self->n_streams * 4 * sizeof(cl_float) * FOSPHOR_BANDS_MAX,
+			self->bands.raw,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue readback of band power buffer");
+
+		err = clEnqueueReadBuffer(cl->cq,
+			cl->mem_bands_trig,
+			CL_FALSE,
+			0,
+			self->n_streams * sizeof(cl_int) * FOSPHOR_BANDS_MAX,
+			self->bands.trig,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue readback of band trigger buffer");
+
+		self->bands.trig_base = cl->bands.base;
+
+		cl->bands.reset   = 1;
+		cl->bands.pending = 0;
+		self->bands.fresh = 1;
+	}
+
+	/* Occupancy counts of the batches since last time */
+	if (cl->occ.spectra) {
+		err = clEnqueueReadBuffer(cl->cq,
+			cl->mem_occupancy,
+			CL_FALSE,
+			0,
+			self->n_streams * sizeof(cl_uint) * FOSPHOR_FFT_LEN,
+			self->occ.raw,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue readback of occupancy buffer");
+
+		self->occ.raw_spectra = cl->occ.spectra;
+
+		cl->occ.reset   = 1;
+		cl->occ.spectra = 0;
+	}
+
+	/* Rollup statistics of the batches since last time */
+	if (cl->rollup.spectra) {
+		err = clEnqueueReadBuffer(cl->cq,
+			cl->mem_rollup,
+			CL_FALSE,
+			0,
+			self->n_streams * 4 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+			self->rollup_stats.raw,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue readback of rollup buffer");
+
+		self->rollup_stats.raw_spectra = cl->rollup.spectra;
+
+		cl->rollup.reset   = 1;
+		cl->rollup.spectra = 0;
+	}
+
+	/* Spectral kurtosis sums of the batches since last time */
+	if (cl->sk.pending) {
+		err = clEnqueueReadBuffer(cl->cq,
+			cl->mem_kurtosis,
+			CL_FALSE,
+			0,
+			self->n_streams * 4 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+			self->sk.raw,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue readback of spectral kurtosis buffer");
+
+		cl->sk.reset   = 1;
+		cl->sk.pending = 0;
+		self->sk.fresh = 1;
+	}
+
+	/* Cross-spectrum averages (they keep running, no reset) */
+	if (cl->xs.pending) {
+		err = clEnqueueReadBuffer(cl->cq,
+			cl->mem_xs_out,
+			CL_FALSE,
+			0,
+			4 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+			self->xs.raw,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue readback of cross-spectrum buffer");
+
+		cl->xs.pending = 0;
+		self->xs.fresh = 1;
+	}
+
+	/* Mask violations of the batches since last time */
+	if (cl->mask.pending) {
+		err = clEnqueueReadBuffer(cl->cq,
+			cl->mem_mask_viol,
+			CL_FALSE,
+			0,
+			self->n_streams * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+			self->mask.viol,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue readback of mask violations buffer");
+
+		cl->mask.reset   = 1;
+		cl->mask.pending = 0;
+
+		if (!++self->mask.seq)
+			self->mask.seq = 1;
+	}
+
+	/* Reduced waterfall levels drawn again : rebuild them all */
+	if ((self->products & FOSPHOR_PROD_WF_RED) && !cl->wf_red.valid) {
+		err = cl_queue_wf_reduce(self, -1, 0, 1024);
+		if (err != CL_SUCCESS)
+			goto error;
+
+		cl->wf_red.valid   = 1;
+		cl->wf_red.pending = 1024;
+	}
+
+	/* Act depending on current mode */
+	if (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING)
+	{
+		/* Host copies are only needed if someone exports them */
+		if (self->flags & FLG_FOSPHOR_HOST_READBACK)
+		{
+			err = cl_queue_readback(self, cl->waterfall_pending, 0);
+			if (err != CL_SUCCESS)
+				goto error;
+		}
+
+		/* If we use CL/GL sharing, we need to release the objects */
+		err = cl_lock_unlock(cl, 0, NULL);
+		CL_ERR_CHECK(err, "Unable to release GL objects");
+	}
+	else
+	{
+		/* If we don't use CL/GL sharing, we need to fetch the results */
+		err = cl_queue_readback(self, 1024, cl->wf_red.pending);
+		if (err != CL_SUCCESS)
+			goto error;
+
+		/* Rows for the GL side to upload */
+		if (cl->wf_red.pending) {
+			self->wf_red.rows += cl->wf_red.pending;
+			if (self->wf_red.rows > 1024)
+				self->wf_red.rows = 1024;
+			self->wf_red.pos = cl->waterfall_pos;
+		}
+	}
+
+	self->wf_red.valid = cl->wf_red.valid;
+	cl->wf_red.pending = 0;
+
+	/* Ensure CL is done */
+	clFinish(cl->cq);
+
+	/* New state */
+	cl->state = CL_READY;
+
+	cl->waterfall_new = cl->waterfall_pending;
+	cl->waterfall_pending = 0;
+
+	return 1;
+
+error:
+	return -EIO;
+}
+
+
+static int
+cl_load_prepare(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	cl_int err;
+
+	/* Same as processing : own the GL objects and clear them once */
+	if ((cl->state != CL_PENDING) && (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING)) {
+		err = cl_lock_unlock(cl, 1, NULL);
+		CL_ERR_CHECK(err, "Unable to acquire GL objects");
+	}
+
+	if (cl->state == CL_BOOTING) {
+		err = cl_queue_clear_buffers(self);
+		if (err != CL_SUCCESS)
+			goto error;
+	}
+
+	cl->state = CL_PENDING;
+
+	return 0;
+
+error:
+	return -EIO;
+}
+
+int
+fosphor_cl_load_waterfall(struct fosphor *self, int stream,
+                          int row, int n, const float *data)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	size_t img_origin[3] = { 0, 0, 0 };
+	size_t img_region[3] = { FOSPHOR_FFT_LEN, 0, 1 };
+	cl_int err;
+
+	if (cl_load_prepare(self))
+		return -EIO;
+
+	img_origin[1] = (stream * 1024) + row;
+	img_region[1] = n;
+
+	err = clEnqueueWriteImage(cl->cq,
+		cl->mem_waterfall,
+		CL_TRUE,
+		img_origin,
+		img_region,
+		0,
+		0,
+		data,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to load waterfall image");
+
+	/* Reduced levels get rebuilt at the next finish if drawn */
+	cl->wf_red.valid = 0;
+
+	return 0;
+
+error:
+	return -EIO;
+}
+
+int
+fosphor_cl_load_histogram(struct fosphor *self, int stream,
+                          int line, int n, const float *data)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	size_t img_origin[3] = { 0, 0, 0 };
+	size_t img_region[3] = { FOSPHOR_FFT_LEN, 0, 1 };
+	cl_int err;
+
+	if (cl_load_prepare(self))
+		return -EIO;
+
+	img_origin[1] = (stream * 128) + line;
+	img_region[1] = n;
+
+	err = clEnqueueWriteImage(cl->cq,
+		cl->mem_histogram,
+		CL_TRUE,
+		img_origin,
+		img_region,
+		0,
+		0,
+		data,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to load histogram image");
+
+	return 0;
+
+error:
+	return -EIO;
+}
+
+int
+fosphor_cl_load_spectrum(struct fosphor *self, int stream, const float *data)
+{
+	struct fosphor_cl_state *cl = self->cl;
+	cl_int err;
+
+	if (cl_load_prepare(self))
+		return -EIO;
 
-	if (cl->prog_fft)
-		clReleaseProgram(cl->prog_fft);
+	err = clEnqueueWriteBuffer(cl->cq,
+		cl->mem_spectrum,
+		CL_TRUE,
+		stream * 2 * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		2 * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
+		data,
+		0, NULL, NULL
+	);
+	CL_ERR_CHECK(err, "Unable to load spectrum buffer");
 
-	if (cl->mem_fft_win)
-		clReleaseMemObject(cl->mem_fft_win);
+	return 0;
 
-	if (cl->mem_fft_out)
-		clReleaseMemObject(cl->mem_fft_out);
+error:
+	return -EIO;
+}
 
-	if (cl->mem_fft_in)
-		clReleaseMemObject(cl->mem_fft_in);
+void
+fosphor_cl_set_waterfall_position(struct fosphor *self, int pos)
+{
+	struct fosphor_cl_state *cl = self->cl;
 
-	if (cl->cq)
-		clReleaseCommandQueue(cl->cq);
+	cl->waterfall_pending += (pos - cl->waterfall_pos) & 1023;
+	if (cl->waterfall_pending > 1024)
+		cl->waterfall_pending = 1024;
 
-	if (cl->ctx)
-		clReleaseContext(cl->ctx);
+	cl->waterfall_pos = pos & 1023;
 }
 
 
-static cl_int
-cl_lock_unlock(struct fosphor_cl_state *cl, int lock, cl_event *event)
+void
+fosphor_cl_load_fft_window(struct fosphor *self, float *win)
 {
-	cl_mem objs[3];
-
-	objs[0] = cl->mem_waterfall;
-	objs[1] = cl->mem_histogram;
-	objs[2] = cl->mem_spectrum;
+	struct fosphor_cl_state *cl = self->cl;
 
-	return lock ?
-		clEnqueueAcquireGLObjects(cl->cq, 3, objs, 0, NULL, event) :
-		clEnqueueReleaseGLObjects(cl->cq, 3, objs, 0, NULL, event);
+	cl->fft_win = win;
+	cl->fft_win_updated = 1;
 }
 
-
-/* -------------------------------------------------------------------------- */
-/* Exposed API                                                                */
-/* -------------------------------------------------------------------------- */
+void
+fosphor_cl_set_real_input(struct fosphor *self, int enable)
+{
+	self->cl->real_input = enable;
+}
 
 int
-fosphor_cl_init(struct fosphor *self)
+fosphor_cl_set_pfb(struct fosphor *self, int m, float *taps)
 {
-	struct fosphor_cl_state *cl;
+	struct fosphor_cl_state *cl = self->cl;
+	cl_uint hist_len = FOSPHOR_PFB_HIST_LEN;
+	float one = 1.0f;
 	cl_int err;
 
-	/* Allocate structure */
-	cl = malloc(sizeof(struct fosphor_cl_state));
-	if (!cl)
-		return -ENOMEM;
+	/* Buffers on first use */
+	if (m && !cl->mem_pfb_out)
+	{
+		cl->mem_pfb_out = clCreateBuffer(cl->ctx,
+			CL_MEM_READ_WRITE,
+			self->n_streams * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN * FOSPHOR_FFT_MAX_BATCH,
+			NULL,
+			&err
+		);
+		CL_ERR_CHECK(err, "Unable to allocate filter bank output buffer");
 
-	self->cl = cl;
+		cl->mem_pfb_hist = clCreateBuffer(cl->ctx,
+			CL_MEM_READ_WRITE,
+			self->n_streams * 2 * sizeof(cl_float) * FOSPHOR_PFB_HIST_LEN,
+			NULL,
+			&err
+		);
+		CL_ERR_CHECK(err, "Unable to allocate filter bank history buffer");
 
-	memset(cl, 0, sizeof(struct fosphor_cl_state));
+		cl->mem_pfb_taps = clCreateBuffer(cl->ctx,
+			CL_MEM_READ_ONLY,
+			sizeof(cl_float) * FOSPHOR_FFT_LEN * FOSPHOR_PFB_MAX_TAPS,
+			NULL,
+			&err
+		);
+		CL_ERR_CHECK(err, "Unable to allocate filter bank taps buffer");
 
-	cl->state = CL_BOOTING;
+		cl->mem_pfb_win = clCreateBuffer(cl->ctx,
+			CL_MEM_READ_ONLY,
+			sizeof(cl_float) * FOSPHOR_FFT_LEN,
+			NULL,
+			&err
+		);
+		CL_ERR_CHECK(err, "Unable to allocate filter bank window buffer");
 
-	/* Find suitable device */
-	if (cl_find_device(&cl->pl_id, &cl->dev_id, &cl->feat)) {
-		fprintf(stderr, "[!] No suitable OpenCL device found\n");
-		goto error;
+		err = clEnqueueFillBuffer(cl->cq,
+			cl->mem_pfb_win,
+			&one, sizeof(float),
+			0, sizeof(cl_float) * FOSPHOR_FFT_LEN,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to queue init of filter bank window buffer");
+
+		err  = clSetKernelArg(cl->kern_pfb_fold, 0, sizeof(cl_mem),  &cl->mem_fft_in);
+		err |= clSetKernelArg(cl->kern_pfb_fold, 1, sizeof(cl_mem),  &cl->mem_pfb_hist);
+		err |= clSetKernelArg(cl->kern_pfb_fold, 2, sizeof(cl_uint), &hist_len);
+		err |= clSetKernelArg(cl->kern_pfb_fold, 4, sizeof(cl_mem),  &cl->mem_pfb_taps);
+		err |= clSetKernelArg(cl->kern_pfb_fold, 7, sizeof(cl_mem),  &cl->mem_pfb_out);
+		CL_ERR_CHECK(err, "Unable to configure filter bank kernel");
 	}
 
-	/* Report selected device */
-	fprintf(stderr, "[+] Selected device: %s\n", cl->feat.name);
-
-	/* Setup compatibility layer for this platform */
-	cl_compat_init();
-	cl_compat_check_platform(cl->pl_id);
-
-	/* Initialize selected platform / device */
-	err = cl_do_init(self);
-	if (err)
-		goto error;
+	/* Old history doesn't match the new prototype */
+	cl->pfb.m            = m;
+	cl->pfb.taps         = taps;
+	cl->pfb.taps_updated = 1;
+	cl->pfb.reset        = 1;
 
-	/* Done */
 	return 0;
 
-	/* Error path */
+	/* Only the first use can fail, start over next time */
 error:
-	fosphor_cl_release(self);
+	if (cl->mem_pfb_win)
+		clReleaseMemObject(cl->mem_pfb_win);
+	if (cl->mem_pfb_taps)
+		clReleaseMemObject(cl->mem_pfb_taps);
+	if (cl->mem_pfb_hist)
+		clReleaseMemObject(cl->mem_pfb_hist);
+	if (cl->mem_pfb_out)
+		clReleaseMemObject(cl->mem_pfb_out);
+
+	cl->mem_pfb_win  = NULL;
+	cl->mem_pfb_taps = NULL;
+	cl->mem_pfb_hist = NULL;
+	cl->mem_pfb_out  = NULL;
 
 	return -EIO;
 }
 
-void
-fosphor_cl_release(struct fosphor *self)
+int
+fosphor_cl_set_bands(struct fosphor *self, const int *range, int n,
+                     float threshold, float trig_threshold)
 {
 	struct fosphor_cl_state *cl = self->cl;
+	cl_int err;
 
-	/* Safety */
-	if (!cl)
-		return;
+	if (n > FOSPHOR_BANDS_MAX)
+		return -EINVAL;
 
-	/* Release the GL objects */
-	if ((cl->state == CL_PENDING) && (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING))
-	{
-		cl_lock_unlock(cl, 0, NULL);
+	if (n) {
+		err = clEnqueueWriteBuffer(
+			cl->cq,
+			cl->mem_bands_range,
+			CL_TRUE,
+			0, 2 * sizeof(cl_int) * n, range,
+			0, NULL, NULL
+		);
+		CL_ERR_CHECK(err, "Unable to copy band ranges");
 	}
 
-	/* Release all allocated OpenCL resources */
-	cl_do_release(cl);
+	/* Whatever was accumulated is for the old bands */
+	cl->bands.n              = n;
+	cl->bands.threshold      = threshold;
+	cl->bands.trig_threshold = trig_threshold;
+	cl->bands.reset          = 1;
+	cl->bands.pending        = 0;
 
-	/* Release structure */
-	free(cl);
+	return 0;
 
-	/* Nothing left */
-	self->cl = NULL;
+error:
+	return -EIO;
 }
 
 int
-fosphor_cl_process(struct fosphor *self,
-                   void *samples, int len)
+fosphor_cl_set_mask(struct fosphor *self, const float *mask)
 {
 	struct fosphor_cl_state *cl = self->cl;
-
 	cl_int err;
-	int locked = 0;
-	size_t local[2], global[2];
-	int n_spectra = len / FOSPHOR_FFT_LEN;
-
-	/* Validate batch size */
-	if (len & ((FOSPHOR_FFT_MULT_BATCH*FOSPHOR_FFT_LEN)-1))
-		return -EINVAL;
-
-	if (len > (FOSPHOR_FFT_LEN * FOSPHOR_FFT_MAX_BATCH))
-		return -EINVAL;
 
-	/* Copy new window if needed */
-	if (cl->fft_win_updated) {
+	if (mask) {
 		err = clEnqueueWriteBuffer(
 			cl->cq,
-			cl->mem_fft_win,
-			CL_FALSE,
-			0, sizeof(cl_float) * FOSPHOR_FFT_LEN, cl->fft_win,
+			cl->mem_mask,
+			CL_TRUE,
+			0, sizeof(cl_float) * FOSPHOR_FFT_LEN, mask,
 			0, NULL, NULL
 		);
-		CL_ERR_CHECK(err, "Unable to copy data to FFT window buffer");
-
-		cl->fft_win_updated = 0;
+		CL_ERR_CHECK(err, "Unable to copy limit mask");
 	}
 
-	/* Copy samples data */
-	err = clEnqueueWriteBuffer(
-		cl->cq,
-		cl->mem_fft_in,
-		CL_FALSE,
-		0, 2 * sizeof(cl_float) * len, samples,
-		0, NULL, NULL
-	);
-	CL_ERR_CHECK(err, "Unable to copy data to FFT input buffer");
-
-	/* Execute FFT kernel */
-	global[0] = FOSPHOR_FFT_LEN / 8;
-	global[1] = n_spectra;
+	/* Whatever was accumulated is for the old mask */
+	cl->mask.enabled = (mask != NULL);
+	cl->mask.reset   = 1;
+	cl->mask.pending = 0;
 
-	local[0] = global[0];
-	local[1] = 1;
+	return 0;
 
-	err = clEnqueueNDRangeKernel(cl->cq, cl->kern_fft, 2, NULL, global, local, 0, NULL, NULL);
-	CL_ERR_CHECK(err, "Unable to queue FFT kernel execution");
+error:
+	return -EIO;
+}
 
-	/* Capture all GL objects */
-	if ((cl->state != CL_PENDING) && (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING)) {
-		err = cl_lock_unlock(cl, 1, NULL);
-		CL_ERR_CHECK(err, "Unable to acquire GL objects");
-		locked = 1;
-	}
+void
+fosphor_cl_set_occupancy(struct fosphor *self, int enable, float threshold)
+{
+	struct fosphor_cl_state *cl = self->cl;
 
-	/* If this is the first run, make sure to pre-clear the buffers */
-	if (cl->state == CL_BOOTING) {
-		err = cl_queue_clear_buffers(self);
-		if (err != CL_SUCCESS)
-			goto error;
-	}
+	/* Whatever was counted is for the old threshold */
+	cl->occ.enabled   = enable;
+	cl->occ.threshold = threshold;
+	cl->occ.reset     = 1;
+	cl->occ.spectra   = 0;
+}
 
-	/* Configure display kernel */
-	err  = 0;
-	err |= clSetKernelArg(cl->kern_display,  2, sizeof(cl_int),   &n_spectra);
-	err |= clSetKernelArg(cl->kern_display,  4, sizeof(cl_int),   &cl->waterfall_pos);
-	err |= clSetKernelArg(cl->kern_display,  9, sizeof(cl_float), &cl->histo_scale);
-	err |= clSetKernelArg(cl->kern_display, 10, sizeof(cl_float), &cl->histo_offset);
-	CL_ERR_CHECK(err, "Unable to configure display kernel");
+void
+fosphor_cl_set_rollup(struct fosphor *self, int enable)
+{
+	struct fosphor_cl_state *cl = self->cl;
 
-	/* Execute display kernel */
-	global[0] = FOSPHOR_FFT_LEN;
-	global[1] = 16;
-	local[0] = 16;
-	local[1] = 16;
+	cl->rollup.enabled = enable;
+	cl->rollup.reset   = 1;
+	cl->rollup.spectra = 0;
+}
 
-	err = clEnqueueNDRangeKernel(cl->cq, cl->kern_display, 2, NULL, global, local, 0, NULL, NULL);
-	CL_ERR_CHECK(err, "Unable to queue display kernel execution");
+void
+fosphor_cl_set_kurtosis(struct fosphor *self, int enable)
+{
+	struct fosphor_cl_state *cl = self->cl;
 
-	/* Advance waterfall */
-	cl->waterfall_pos = (cl->waterfall_pos + n_spectra) & 1023;
+	cl->sk.enabled = enable;
+	cl->sk.reset   = 1;
+	cl->sk.pending = 0;
+}
 
-	/* New state */
-	cl->state = CL_PENDING;
+int
+fosphor_cl_set_cross_spectrum(struct fosphor *self, int enable, float alpha)
+{
+	struct fosphor_cl_state *cl = self->cl;
 
-	return 0;
+	if (enable && !cl->kern_xs)
+		return -ENODEV;
 
-error:
-	if (locked) {
-		err = cl_lock_unlock(cl, 0, NULL);
-		CL_ERR_CHECK(err, "Unable to release GL objects");
-	}
+	cl->xs.enabled = enable;
+	cl->xs.alpha   = alpha;
+	cl->xs.reset   = 1;
+	cl->xs.pending = 0;
 
-	return -EIO;
+	return 0;
 }
 
 int
-fosphor_cl_finish(struct fosphor *self)
+fosphor_cl_set_zoom(struct fosphor *self, int decim, double center)
 {
 	struct fosphor_cl_state *cl = self->cl;
-
+	float *taps;
+	double f, w, hs;
+	int i, n_taps;
 	cl_int err;
 
-	/* Check if we really need to do anything */
-	if (cl->state == CL_READY)
+	/* Disabled ? */
+	if (decim <= 1) {
+		cl_zoom_release(self);
+		cl->zoom.decim = 1;
 		return 0;
+	}
 
-	/* If no data was processed, we may need to finish the boot */
-	if (cl->state == CL_BOOTING) {
-		/* Acquire GL objects if needed */
-		if (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING)
-		{
-			err = cl_lock_unlock(cl, 1, NULL);
-			CL_ERR_CHECK(err, "Unable to acquire GL objects");
-		}
+	if ((decim > FOSPHOR_ZOOM_MAX_DECIM) || (decim & (decim - 1)))
+		return -EINVAL;
 
-		/* Clear the buffers */
-		err = cl_queue_clear_buffers(self);
+	/* Output objects on first use */
+	if (!cl->kern_display_zoom) {
+		err = cl_zoom_alloc(self);
 		if (err != CL_SUCCESS)
-			goto error;
+			return -EIO;
 	}
 
-	/* Act depending on current mode */
-	if (self->flags & FLG_FOSPHOR_USE_CLGL_SHARING)
-	{
-		/* If we use CL/GL sharing, we need to release the objects */
-		err = cl_lock_unlock(cl, 0, NULL);
-		CL_ERR_CHECK(err, "Unable to release GL objects");
-	}
-	else
-	{
-		/* If we don't use CL/GL sharing, we need to fetch the results */
-		size_t img_origin[3] = { 0, 0, 0 };
-		size_t img_region[3] = { 1024, 0, 1 };
+	/* Windowed sinc low-pass (cut-off at the edge of the new band),
+	 * shifted to the zoom center */
+	n_taps = FOSPHOR_ZOOM_TAPS_MULT * decim;
+	f = center - 0.5;
 
-			/* Waterfall */
-		img_region[1] = 1024;
+	taps = malloc(2 * sizeof(float) * n_taps);
+	if (!taps)
+		return -ENOMEM;
 
-		err = clEnqueueReadImage(cl->cq,
-			cl->mem_waterfall,
-			CL_FALSE,
-			img_origin,
-			img_region,
-			0,
-			0,
-			self->img_waterfall,
-			0, NULL, NULL
-		);
-		CL_ERR_CHECK(err, "Unable to queue readback of waterfall image");
+	hs = 0.0;
+	for (i=0; i<n_taps; i++) {
+		double t = (i - (n_taps - 1) / 2.0) / decim;
+		double h = (t == 0.0) ? 1.0 : sin(M_PI * t) / (M_PI * t);
 
-			/* Histogram */
-		img_region[1] = 128;
+		w = 0.42 - 0.50 * cos(2.0 * M_PI * i / (n_taps - 1))
+		         + 0.08 * cos(4.0 * M_PI * i / (n_taps - 1));
 
-		err = clEnqueueReadImage(cl->cq,
-			cl->mem_histogram,
-			CL_FALSE,
-			img_origin,
-			img_region,
-			0,
-			0,
-			self->img_histogram,
-			0, NULL, NULL
-		);
-		CL_ERR_CHECK(err, "Unable to queue readback of histogram image");
+		taps[2*i+0] = h * w;
+		hs += h * w;
+	}
 
-			/* Live spectrum */
-		err = clEnqueueReadBuffer(cl->cq,
-			cl->mem_spectrum,
-			CL_FALSE,
-			0,
-			2 * 2 * sizeof(cl_float) * FOSPHOR_FFT_LEN,
-			self->buf_spectrum,
-			0, NULL, NULL
-		);
-		CL_ERR_CHECK(err, "Unable to queue readback of spectrum buffer");
+	for (i=0; i<n_taps; i++) {
+		double h = taps[2*i] / hs;
+		taps[2*i+0] = h * cos(2.0 * M_PI * f * i);
+		taps[2*i+1] = h * sin(2.0 * M_PI * f * i);
 	}
 
-	/* Ensure CL is done */
-	clFinish(cl->cq);
+	err = clEnqueueWriteBuffer(cl->cq,
+		cl->mem_ddc_taps,
+		CL_TRUE,
+		0, 2 * sizeof(cl_float) * n_taps, taps,
+		0, NULL, NULL
+	);
 
-	/* New state */
-	cl->state = CL_READY;
+	free(taps);
 
-	return 1;
+	CL_ERR_CHECK(err, "Unable to load zoom filter taps");
+
+	/* New config, start a new batch */
+	cl->zoom.decim     = decim;
+	cl->zoom.n_taps    = n_taps;
+	cl->zoom.phase_inc = (uint32_t)(int64_t)llround(f * 4294967296.0);
+	cl->zoom.fill      = 0;
+
+	return 0;
 
 error:
 	return -EIO;
 }
 
-
-void
-fosphor_cl_load_fft_window(struct fosphor *self, float *win)
+int
+fosphor_cl_get_zoom_waterfall_position(struct fosphor *self)
 {
 	struct fosphor_cl_state *cl = self->cl;
 
-	cl->fft_win = win;
-	cl->fft_win_updated = 1;
+	return cl->zoom.waterfall_pos;
 }
 
 int
@@ -1078,6 +3127,22 @@ fosphor_cl_get_waterfall_position(struct fosphor *self)
 	return cl->waterfall_pos;
 }
 
+int
+fosphor_cl_get_waterfall_pending(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+
+	return cl->waterfall_pending;
+}
+
+int
+fosphor_cl_get_waterfall_new(struct fosphor *self)
+{
+	struct fosphor_cl_state *cl = self->cl;
+
+	return cl->waterfall_new;
+}
+
 void
 fosphor_cl_set_histogram_range(struct fosphor *self,
                                float scale, float offset)
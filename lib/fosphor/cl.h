@@ -23,11 +23,32 @@ int  fosphor_cl_init(struct fosphor *self);
 void fosphor_cl_release(struct fosphor *self);
 
 int fosphor_cl_process(struct fosphor *self,
-                       void *samples, int len);
+                       void **samples, int len);
 int fosphor_cl_finish(struct fosphor *self);
 
+int fosphor_cl_load_waterfall(struct fosphor *self, int stream,
+                              int row, int n, const float *data);
+int fosphor_cl_load_histogram(struct fosphor *self, int stream,
+                              int line, int n, const float *data);
+int fosphor_cl_load_spectrum(struct fosphor *self, int stream,
+                             const float *data);
+void fosphor_cl_set_waterfall_position(struct fosphor *self, int pos);
+
 void fosphor_cl_load_fft_window(struct fosphor *self, float *win);
+void fosphor_cl_set_real_input(struct fosphor *self, int enable);
+int  fosphor_cl_set_pfb(struct fosphor *self, int m, float *taps);
+int  fosphor_cl_set_bands(struct fosphor *self, const int *range, int n,
+                          float threshold, float trig_threshold);
+int  fosphor_cl_set_mask(struct fosphor *self, const float *mask);
+void fosphor_cl_set_occupancy(struct fosphor *self, int enable, float threshold);
+void fosphor_cl_set_rollup(struct fosphor *self, int enable);
+void fosphor_cl_set_kurtosis(struct fosphor *self, int enable);
+int  fosphor_cl_set_cross_spectrum(struct fosphor *self, int enable, float alpha);
+int  fosphor_cl_set_zoom(struct fosphor *self, int decim, double center);
+int  fosphor_cl_get_zoom_waterfall_position(struct fosphor *self);
 int  fosphor_cl_get_waterfall_position(struct fosphor *self);
+int  fosphor_cl_get_waterfall_pending(struct fosphor *self);
+int  fosphor_cl_get_waterfall_new(struct fosphor *self);
 void fosphor_cl_set_histogram_range(struct fosphor *self,
                                     float scale, float offset);
 
@@ -0,0 +1,79 @@
+/*
+ * ddc.cl
+ *
+ * Digital down-converter OpenCL kernel. Extracts a narrow band of the
+ * input samples so the zoom view can have its own full resolution FFT.
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * NOTE (to make it clear): For the purpose of this license, any software
+ * making use of this kernel (or derivative thereof) is considered to be
+ * a derivative work (i.e. "a work based on the Program").
+ */
+
+#define M_PIf (3.141592653589f)
+
+
+/* The mixer is moved after the filter: the taps are the low-pass prototype
+ * shifted to the band of interest, so only one NCO value per output
+ *
+ *   y[m] = e^(-j.w.n) . sum_k ( h[k].e^(j.w.k) ) . x[n-k]    with n = m * D
+ */
+__kernel void ddc(
+	/* Input */
+	__global const float2 *in,		/* [ 0] New samples (all streams) */
+	__global const float2 *hist,		/* [ 1] Previous samples          */
+	const uint hist_len,			/* [ 2] History length per stream */
+	const uint in_len,			/* [ 3] New samples per stream    */
+
+	/* Filter / NCO */
+	__global const float2 *taps,		/* [ 4] Band-pass taps (complex)  */
+	const uint n_taps,			/* [ 5] Number of taps            */
+	const uint decim,			/* [ 6] Decimation                */
+	const uint phase0,			/* [ 7] NCO phase at 1st sample   */
+	const uint phase_inc,			/* [ 8] NCO phase increment       */
+
+	/* Output */
+	const uint out_first,			/* [ 9] Index of the 1st output   */
+	__global float2 *out,			/* [10] Output buffer             */
+	const uint out_ofs,			/* [11] Write position            */
+	const uint out_stride)			/* [12] Stride between streams    */
+{
+	const uint stream = get_global_id(1);
+	const int n = (out_first + get_global_id(0)) * decim;
+
+	float2 acc = (float2)(0.0f, 0.0f);
+	float2 x, h;
+	float s, c;
+	uint ph;
+	int i, k;
+
+	/* Select stream (2nd dimension). hist[-1] is the most recent */
+	in   += stream * in_len;
+	hist += (stream + 1) * hist_len;
+
+	/* Filter */
+	for (k=0; k<n_taps; k++)
+	{
+		i = n - k;
+		x = (i >= 0) ? in[i] : hist[i];
+		h = taps[k];
+
+		acc += (float2)(
+			x.x * h.x - x.y * h.y,
+			x.x * h.y + x.y * h.x
+		);
+	}
+
+	/* Mix down (phase in 1/2^32 of a cycle) */
+	ph = phase0 + phase_inc * (uint)n;
+	s = sincos(- (float)(int)ph * (M_PIf / 2147483648.0f), &c);
+
+	out[stream * out_stride + out_ofs + get_global_id(0)] = (float2)(
+		acc.x * c - acc.y * s,
+		acc.x * s + acc.y * c
+	);
+}
+
+/* vim: set syntax=c: */
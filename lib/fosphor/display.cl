@@ -42,6 +42,13 @@
 //#define MAX_HOLD_NORMAL
 #define MAX_HOLD_DECAY
 
+/* Products to compute (must match FOSPHOR_PROD_??? in private.h) */
+#define PROD_WATERFALL	(1 << 0)
+#define PROD_HISTO	(1 << 1)
+#define PROD_LIVE	(1 << 2)
+#define PROD_MAX_HOLD	(1 << 3)
+#define PROD_KURTOSIS	(1 << 4)
+
 
 #ifdef USE_NV_SM11_ATOMICS
 
@@ -85,14 +92,38 @@ __kernel void display(
 
 	/* Live spectrum */
 	__global float2 *spectrum_vbo,		/* [11] Vertex Buffer Object    */
-	const float live_alpha)			/* [12] Averaging time constant */
+	const float live_alpha,			/* [12] Averaging time constant */
+
+	/* Products */
+	const uint products,			/* [13] PROD_??? to compute */
+
+	/* Spectral kurtosis */
+	__global float4 *sk_buf,		/* [14] (S2, S4, M, -) per bin  */
+	const uint sk_reset)			/* [15] Restart accumulation    */
 {
 	int gidx;
 	float max_pwr = - 1000.0f;
+	float sk_s2 = 0.0f, sk_s4 = 0.0f;
+
+	/* Products (max hold decays towards live, so it needs it) */
+	const bool do_wf    = (products & PROD_WATERFALL) != 0;
+	const bool do_histo = (products & PROD_HISTO) != 0;
+	const bool do_max   = (products & PROD_MAX_HOLD) != 0;
+	const bool do_live  = (products & (PROD_LIVE | PROD_MAX_HOLD)) != 0;
+	const bool do_sk    = (products & PROD_KURTOSIS) != 0;
+
+	/* Select stream (3rd dimension) */
+	const uint stream = get_global_id(2);
+	const int wf_height = get_image_height(wf_tex) / get_global_size(2);
+
+	fft          += (stream * fft_batch) << fft_log2_len;
+	spectrum_vbo += (stream * 2) << fft_log2_len;
+	sk_buf       += stream << fft_log2_len;
 
 	/* Local memory */
 	__local float live_buf[16 * 16];	/* get_local_size(0) * get_local_size(1) */
 	__local float max_buf[16 * 16];		/* get_local_size(0) * get_local_size(1) */
+	__local float2 sk_lbuf[16 * 16];	/* get_local_size(0) * get_local_size(1) */
 	__local uint  histo_buf[16 * 128];
 
 	/* Local shortcuts */
@@ -138,16 +169,31 @@ __kernel void display(
 		/* Maximum pwr */
 		max_pwr = max(max_pwr, pwr);
 
+		/* Moments of the linear power (|X|^2 and |X|^4) */
+		if (do_sk) {
+			float p = fft_value.x * fft_value.x + fft_value.y * fft_value.y;
+			sk_s2 += p;
+			sk_s4 += p * p;
+		}
+
 		/* Write to Waterfall texture */
-		int2 coord;
-		coord.x = get_global_id(0);
-		coord.y = (get_local_id(1) + wf_offset + gidx) & (get_image_height(wf_tex) - 1);
+		if (do_wf) {
+			int2 coord;
+			coord.x = get_global_id(0);
+			coord.y = (get_local_id(1) + wf_offset + gidx) & (wf_height - 1);
+			coord.y += stream * wf_height;
 
-		write_imagef(wf_tex, coord, (float4)(pwr, 0.0f, 0.0f, 0.0f));
+			write_imagef(wf_tex, coord, (float4)(pwr, 0.0f, 0.0f, 0.0f));
+		}
 
 		/* Add to Live Spectrum buffer */
-		live_buf[get_local_id(1) * get_local_size(0) + get_local_id(0)] +=
-			pwr * native_powr(live_one_minus_alpha, (float)(fft_batch - gidx - get_local_id(1) - 1));
+		if (do_live)
+			live_buf[get_local_id(1) * get_local_size(0) + get_local_id(0)] +=
+				pwr * native_powr(live_one_minus_alpha, (float)(fft_batch - gidx - get_local_id(1) - 1));
+
+		/* Histogram is the costly part, skip if possible */
+		if (!do_histo)
+			continue;
 
 #ifdef USE_NV_SM11_ATOMICS
 		/* Transposition */
@@ -178,6 +224,7 @@ __kernel void display(
 	}
 
 	max_buf[get_local_id(1) * get_local_size(0) + get_local_id(0)] = max_pwr;
+	sk_lbuf[get_local_id(1) * get_local_size(0) + get_local_id(0)] = (float2)(sk_s2, sk_s4);
 
 	/* Wait for everyone before the final merges */
 	barrier(CLK_LOCAL_MEM_FENCE);
@@ -185,7 +232,7 @@ __kernel void display(
 	/* Live Spectrum merging */
 	__global float2 *live_vbo = &spectrum_vbo[0];
 
-	if (get_global_id(1) == 0)
+	if (do_live && (get_global_id(1) == 0))
 	{
 		int i,n;
 		float sum;
@@ -213,21 +260,42 @@ __kernel void display(
 		live_vbo[i] = vertex;
 	}
 
+	/* Spectral kurtosis sums merging */
+	if (do_sk && (get_global_id(1) == 0))
+	{
+		int i;
+		float2 sum = (float2)(0.0f, 0.0f);
+		float4 acc = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
+
+		for (i=0; i<get_local_size(1); i++)
+			sum += sk_lbuf[i * get_local_size(0) + get_local_id(0)];
+
+		if (!sk_reset)
+			acc = sk_buf[get_global_id(0)];
+
+		acc.x += sum.x;
+		acc.y += sum.y;
+		acc.z += (float)fft_batch;
+
+		sk_buf[get_global_id(0)] = acc;
+	}
+
 	/* Histogram merging */
-	for (gidx=0; gidx<128; gidx+=get_local_size(1))
+	for (gidx=0; do_histo && (gidx<128); gidx+=get_local_size(1))
 	{
 		const sampler_t direct_sample = CLK_NORMALIZED_COORDS_FALSE | CLK_FILTER_NEAREST | CLK_ADDRESS_CLAMP_TO_EDGE;
 
 		/* Histogram coordinates */
+		int bin = gidx + get_local_id(1);
 		int2 coord;
 		coord.x = get_global_id(0);
-		coord.y = gidx + get_local_id(1);
+		coord.y = bin + stream * 128;
 
 		/* Fetch previous histogram value */
 		float4 hv = read_imagef(histo_tex_r, direct_sample, coord);
 
 		/* Fetch hit count */
-		uint hc = histo_buf[coord.y * get_local_size(0) + get_local_id(0)]
+		uint hc = histo_buf[bin * get_local_size(0) + get_local_id(0)]
 #ifdef USE_NV_SM11_ATOMICS
 			& TAG_MASK
 #endif
@@ -256,7 +324,7 @@ __kernel void display(
 	/* Max hold */
 	__global float2 *max_vbo = &spectrum_vbo[1 << fft_log2_len];
 
-	if (get_global_id(1) == 0)
+	if (do_max && (get_global_id(1) == 0))
 	{
 		int i, j, n;
 		float2 vertex;
@@ -271,7 +339,7 @@ __kernel void display(
 			/* Histogram coordinates */
 			int2 coord;
 			coord.x = get_global_id(0);
-			coord.y = gidx;
+			coord.y = gidx + stream * 128;
 
 			/* Fetch histogram value */
 			float4 hv = read_imagef(histo_tex_r, direct_sample, coord);
@@ -310,4 +378,619 @@ __kernel void display(
 	}
 }
 
+
+/* Reduced waterfall: levels 1/2, 1/4, ... of the width stored side by side
+ * (level l starts at column N - (N >> (l-1))), each texel holding the max
+ * of the 2^l bins it covers so narrow carriers survive the reduction */
+__kernel void wf_reduce(
+	__read_only  image2d_t wf_tex,		/* [0] Full waterfall          */
+	__write_only image2d_t wf_red_tex,	/* [1] Reduced levels          */
+	const uint fft_log2_len,		/* [2] log2(FFT length)        */
+	const uint wf_height,			/* [3] Rows per stream         */
+	const uint wf_offset)			/* [4] First row to reduce     */
+{
+	const sampler_t sampler =
+		CLK_NORMALIZED_COORDS_FALSE |
+		CLK_ADDRESS_CLAMP_TO_EDGE |
+		CLK_FILTER_NEAREST;
+
+	int x = get_global_id(0);
+	int y = ((get_global_id(1) + wf_offset) & (wf_height - 1)) + get_global_id(2) * wf_height;
+	int base = 0, w = 1 << (fft_log2_len - 1), l = 1;
+	int i, b;
+	float m;
+
+	/* Find level */
+	while (x >= base + w) {
+		base += w;
+		w >>= 1;
+		l++;
+	}
+
+	/* Max over the covered bins */
+	b = (x - base) << l;
+	m = read_imagef(wf_tex, sampler, (int2)(b, y)).x;
+
+	for (i=1; i<(1<<l); i++)
+		m = max(m, read_imagef(wf_tex, sampler, (int2)(b+i, y)).x);
+
+	write_imagef(wf_red_tex, (int2)(x, y), (float4)(m, 0.0f, 0.0f, 0.0f));
+}
+
+
+/* Per-bin percentiles of the histogram: a low one (noise floor), median
+ * and 90th, interpolated inside the bins. One item per bin and stream,
+ * results in display order. */
+__kernel void histo_percentiles(
+	__read_only image2d_t histo_tex,	/* [0] Histogram texture          */
+	const float histo_scale,		/* [1] Val->Bin: scaling          */
+	const float histo_ofs,			/* [2] Val->Bin: offset           */
+	const float p_low,			/* [3] Low percentile [0,1]       */
+	__global float4 *result)		/* [4] Results                    */
+{
+	const sampler_t direct_sample = CLK_NORMALIZED_COORDS_FALSE | CLK_FILTER_NEAREST | CLK_ADDRESS_CLAMP_TO_EDGE;
+
+	const int x      = get_global_id(0);
+	const int n      = get_global_size(0);
+	const int stream = get_global_id(1);
+	const int y0     = stream * 128;
+
+	float target[3], out[3];
+	float tot, acc, v;
+	int b, k;
+
+	/* Total */
+	tot = 0.0f;
+	for (b=0; b<128; b++)
+		tot += read_imagef(histo_tex, direct_sample, (int2)(x, y0 + b)).x;
+
+	target[0] = p_low * tot;
+	target[1] = 0.5f  * tot;
+	target[2] = 0.9f  * tot;
+
+	/* Walk the distribution */
+	acc = 0.0f;
+	k = 0;
+
+	for (b=0; (b<128) && (k<3) && (tot > 0.0f); b++)
+	{
+		v = read_imagef(histo_tex, direct_sample, (int2)(x, y0 + b)).x;
+
+		while ((k < 3) && (acc + v >= target[k])) {
+			float f = (v > 0.0f) ? ((target[k] - acc) / v) : 0.0f;
+			out[k++] = ((float)b - 0.5f + f) / histo_scale - histo_ofs;
+		}
+
+		acc += v;
+	}
+
+	/* Empty (or rounding leftovers) */
+	for (; k<3; k++)
+		out[k] = (tot > 0.0f) ? (127.5f / histo_scale - histo_ofs) : - histo_ofs;
+
+	result[stream * n + (x ^ (n >> 1))] = (float4)(out[0], out[1], out[2], tot);
+}
+
+
+/* Band power (must match FOSPHOR_BANDS_MAX in private.h) */
+#define BANDS_MAX	8
+
+/* Integrates the linear power of each band (bins range in display order)
+ * for every spectrum of the batch and accumulates the sum, peak and count
+ * above threshold. Also keeps the index (since the reset) of the first
+ * spectrum above the trigger threshold, -1 if none. One work group per
+ * band and stream. */
+__attribute__((reqd_work_group_size(256, 1, 1)))
+__kernel void band_power(
+	__global const float2 *fft,		/* [0] Input FFT (complex)        */
+	const uint fft_log2_len,		/* [1] log2(FFT length)           */
+	const uint fft_batch,			/* [2] # spectrums in the input   */
+	__global const int2 *bands,		/* [3] First / last bin of bands  */
+	const float threshold,			/* [4] Duty cycle threshold       */
+	const uint reset,			/* [5] Restart accumulation       */
+	__global float4 *result,		/* [6] Results                    */
+	const uint base,			/* [7] Spectra since the reset    */
+	const float trig_threshold,		/* [8] Trigger threshold          */
+	__global int *trig)			/* [9] First spectrum above it    */
+{
+	const int band   = get_global_id(1);
+	const int stream = get_global_id(2);
+	const int lid    = get_local_id(0);
+	const int lsz    = get_local_size(0);
+	const int half   = 1 << (fft_log2_len - 1);
+	const int2 rng   = bands[band];
+
+	__local float red[256];
+
+	float4 acc = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
+	int first = -1;
+	int s, b, j;
+
+	fft    += (stream * fft_batch) << fft_log2_len;
+	result += stream * BANDS_MAX + band;
+	trig   += stream * BANDS_MAX + band;
+
+	if (!reset && (lid == 0)) {
+		acc   = *result;
+		first = *trig;
+	}
+
+	for (s=0; s<fft_batch; s++)
+	{
+		float sum = 0.0f;
+
+		/* Power over the band (bins in FFT order in memory) */
+		for (b=rng.x+lid; b<=rng.y; b+=lsz) {
+			float2 v = fft[(s << fft_log2_len) + (b ^ half)];
+			sum += v.x * v.x + v.y * v.y;
+		}
+
+		red[lid] = sum;
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		for (j=lsz>>1; j>0; j>>=1) {
+			if (lid < j)
+				red[lid] += red[lid + j];
+			barrier(CLK_LOCAL_MEM_FENCE);
+		}
+
+		if (lid == 0) {
+			acc.x += red[0];
+			acc.y  = max(acc.y, red[0]);
+			acc.z += (red[0] > threshold) ? 1.0f : 0.0f;
+			acc.w += 1.0f;
+
+			if ((first < 0) && (red[0] > trig_threshold))
+				first = base + s;
+		}
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (lid == 0) {
+		*result = acc;
+		*trig   = first;
+	}
+}
+
+
+/* Compares every spectrum of the batch with the limit mask and accumulates
+ * per bin the number of spectra above it and the largest excess (log10
+ * units). One item per bin and stream, all in FFT order. */
+__kernel void mask_check(
+	__global const float2 *fft,		/* [0] Input FFT (complex)        */
+	const uint fft_log2_len,		/* [1] log2(FFT length)           */
+	const uint fft_batch,			/* [2] # spectrums in the input   */
+	__global const float *mask,		/* [3] Limit (log10 units)        */
+	const uint reset,			/* [4] Restart accumulation       */
+	__global float2 *viol)			/* [5] Results (count, excess)    */
+{
+	const int bin    = get_global_id(0);
+	const int stream = get_global_id(1);
+	const float lim  = mask[bin];
+
+	float2 acc = (float2)(0.0f, 0.0f);
+	int s;
+
+	fft  += (stream * fft_batch) << fft_log2_len;
+	viol += (stream << fft_log2_len) + bin;
+
+	if (!reset)
+		acc = *viol;
+
+	for (s=0; s<fft_batch; s++)
+	{
+		float2 v = fft[(s << fft_log2_len) + bin];
+		float pwr = log10(hypot(v.x, v.y));
+
+		if (pwr > lim) {
+			acc.x += 1.0f;
+			acc.y  = fmax(acc.y, pwr - lim);
+		}
+	}
+
+	*viol = acc;
+}
+
+
+/* Counts, per bin, the spectra of the batch above the occupancy threshold.
+ * One item per bin and stream, FFT order. */
+__kernel void occupancy(
+	__global const float2 *fft,		/* [0] Input FFT (complex)        */
+	const uint fft_log2_len,		/* [1] log2(FFT length)           */
+	const uint fft_batch,			/* [2] # spectrums in the input   */
+	const float threshold,			/* [3] Magnitude threshold        */
+	const uint reset,			/* [4] Restart accumulation       */
+	__global uint *count)			/* [5] Results                    */
+{
+	const int bin    = get_global_id(0);
+	const int stream = get_global_id(1);
+
+	uint acc = 0;
+	int s;
+
+	fft   += (stream * fft_batch) << fft_log2_len;
+	count += (stream << fft_log2_len) + bin;
+
+	if (!reset)
+		acc = *count;
+
+	/* Compare the magnitude, no need for the log */
+	for (s=0; s<fft_batch; s++)
+	{
+		float2 v = fft[(s << fft_log2_len) + bin];
+
+		if (hypot(v.x, v.y) > threshold)
+			acc++;
+	}
+
+	*count = acc;
+}
+
+
+/* Min / max / sum of the power of every spectrum of the batch, for the
+ * long-term rollups. One item per bin and stream, FFT order, linear power
+ * (not normalized) so the host can average it properly */
+__kernel void rollup(
+	__global const float2 *fft,		/* [0] Input FFT (complex)        */
+	const uint fft_log2_len,		/* [1] log2(FFT length)           */
+	const uint fft_batch,			/* [2] # spectrums in the input   */
+	const uint reset,			/* [3] Restart accumulation       */
+	__global float4 *stats)			/* [4] (min, max, sum, -)         */
+{
+	const int bin    = get_global_id(0);
+	const int stream = get_global_id(1);
+
+	float4 acc = (float4)(INFINITY, 0.0f, 0.0f, 0.0f);
+	int s;
+
+	fft   += (stream * fft_batch) << fft_log2_len;
+	stats += (stream << fft_log2_len) + bin;
+
+	if (!reset)
+		acc = *stats;
+
+	for (s=0; s<fft_batch; s++)
+	{
+		float2 v = fft[(s << fft_log2_len) + bin];
+		float  p = v.x * v.x + v.y * v.y;
+
+		acc.x  = fmin(acc.x, p);
+		acc.y  = fmax(acc.y, p);
+		acc.z += p;
+	}
+
+	*stats = acc;
+}
+
+
+/* Cross-spectrum of the first two streams. One item per bin, FFT order.
+ * The auto and cross powers are exponentially averaged over every
+ * spectrum (same alpha as the live trace) and the results derived from
+ * the averages :
+ *   coherence |S01| / sqrt(S00 * S11) in [0,1]
+ *   phase     arg(S01) in [-pi,pi] (stream 0 leading is positive)
+ *   cross     log10(sqrt(|S01|)), same scale as the live trace */
+__kernel void cross_spectrum(
+	__global const float2 *fft,		/* [0] Input FFT (complex)        */
+	const uint fft_log2_len,		/* [1] log2(FFT length)           */
+	const uint fft_batch,			/* [2] # spectrums in the input   */
+	const float alpha,			/* [3] Averaging factor           */
+	const uint reset,			/* [4] Restart averaging          */
+	__global float4 *avg,			/* [5] (S00, S11, Re S01, Im S01) */
+	__global float4 *out)			/* [6] (coh, phase, cross, -)     */
+{
+	const int bin = get_global_id(0);
+
+	__global const float2 *fft0 = fft;
+	__global const float2 *fft1 = fft + ((fft_batch) << fft_log2_len);
+
+	float4 acc;
+	float m, d;
+	int s;
+
+	s = 0;
+
+	if (reset) {
+		float2 a = fft0[bin];
+		float2 b = fft1[bin];
+
+		acc = (float4)(
+			a.x * a.x + a.y * a.y,
+			b.x * b.x + b.y * b.y,
+			a.x * b.x + a.y * b.y,
+			a.y * b.x - a.x * b.y
+		);
+		s = 1;
+	} else {
+		acc = avg[bin];
+	}
+
+	for (; s<fft_batch; s++)
+	{
+		float2 a = fft0[(s << fft_log2_len) + bin];
+		float2 b = fft1[(s << fft_log2_len) + bin];
+		float4 v = (float4)(
+			a.x * a.x + a.y * a.y,
+			b.x * b.x + b.y * b.y,
+			a.x * b.x + a.y * b.y,	/* a . conj(b) */
+			a.y * b.x - a.x * b.y
+		);
+
+		acc += alpha * (v - acc);
+	}
+
+	avg[bin] = acc;
+
+	/* Derived values */
+	m = hypot(acc.z, acc.w);
+	d = sqrt(acc.x * acc.y);
+
+	out[bin] = (float4)(
+		(d > 0.0f) ? fmin(m / d, 1.0f) : 0.0f,
+		atan2(acc.w, acc.z),
+		0.5f * log10(m),
+		0.0f
+	);
+}
+
+
+/* Level statistics of a live spectrum, for the whole work group: noise
+ * floor (average of the bins below the average), peak and average, from
+ * bin 'first' on. Needs to be reached by all items (barriers) */
+inline float4 spectrum_levels(__global const float2 *live, int first, int n,
+                              __local float *red_sum, __local float *red_cnt,
+                              __local float *red_max)
+{
+	const int lid = get_local_id(0);
+	const int lsz = get_local_size(0);
+
+	float sum, cnt, pk, mean, nf, p;
+	int b, j;
+
+	/* Average and peak */
+	sum = 0.0f;
+	pk  = -INFINITY;
+
+	for (b=first+lid; b<n; b+=lsz) {
+		p = live[b].y;
+		sum += p;
+		pk = fmax(pk, p);
+	}
+
+	red_sum[lid] = sum;
+	red_max[lid] = pk;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (j=lsz>>1; j>0; j>>=1) {
+		if (lid < j) {
+			red_sum[lid] += red_sum[lid + j];
+			red_max[lid]  = fmax(red_max[lid], red_max[lid + j]);
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	mean = red_sum[0] / (float)(n - first);
+	pk   = red_max[0];
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	/* Noise floor */
+	sum = 0.0f;
+	cnt = 0.0f;
+
+	for (b=first+lid; b<n; b+=lsz) {
+		p = live[b].y;
+		if (p <= mean) {
+			sum += p;
+			cnt += 1.0f;
+		}
+	}
+
+	red_sum[lid] = sum;
+	red_cnt[lid] = cnt;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (j=lsz>>1; j>0; j>>=1) {
+		if (lid < j) {
+			red_sum[lid] += red_sum[lid + j];
+			red_cnt[lid] += red_cnt[lid + j];
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	nf = (red_cnt[0] > 0.0f) ? (red_sum[0] / red_cnt[0]) : mean;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	return (float4)(nf, pk, mean, 0.0f);
+}
+
+
+/* Peak detection (must match FOSPHOR_PEAKS_MAX in private.h) */
+#define PEAKS_MAX	128
+#define PEAKS_BW_MAX	64	/* Max distance explored on each side (bins) */
+
+inline bool is_peak(__global const float2 *live, int b, int n, float lvl)
+{
+	/* The extrema bin isn't displayed, skip it and its neighbors */
+	if ((b < 2) || (b >= n - 1))
+		return false;
+
+	return (live[b].y > lvl) &&
+	       (live[b].y >= live[b-1].y) &&
+	       (live[b].y >  live[b+1].y);
+}
+
+/* Finds the local maxima of the live spectrum that are above the noise
+ * floor + threshold. One work group per stream, each item covering
+ * N / 256 consecutive bins. Results are in frequency order. */
+__attribute__((reqd_work_group_size(256, 1, 1)))
+__kernel void peaks(
+	__global const float2 *spectrum_vbo,	/* [0] Spectrum (live / max hold) */
+	const uint fft_log2_len,		/* [1] log2(FFT length)           */
+	const float threshold,			/* [2] Above noise floor          */
+	__global float4 *peaks)			/* [3] Results                    */
+{
+	const int stream = get_global_id(1);
+	const int n      = 1 << fft_log2_len;
+	const int lid    = get_local_id(0);
+	const int lsz    = get_local_size(0);
+	const int span   = n / lsz;
+	const int b0     = lid * span;
+
+	__global const float2 *live     = &spectrum_vbo[(stream * 2) << fft_log2_len];
+	__global const float2 *max_hold = &live[n];
+
+	__local float red_sum[256];
+	__local float red_cnt[256];
+	__local float red_max[256];
+	__local uint  pk_ofs[256];
+
+	float nf, lvl;
+	uint ofs;
+	int i, j, b;
+
+	peaks += stream * (PEAKS_MAX + 1);
+
+	/* Noise floor */
+	nf  = spectrum_levels(live, 0, n, red_sum, red_cnt, red_max).x;
+	lvl = nf + threshold;
+
+	/* Count local maxima */
+	ofs = 0;
+	for (i=0; i<span; i++)
+		if (is_peak(live, b0 + i, n, lvl))
+			ofs++;
+
+	pk_ofs[lid] = ofs;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	/* Output offsets (once per frame, a serial scan is good enough) */
+	if (lid == 0)
+	{
+		uint acc = 0;
+
+		for (j=0; j<lsz; j++) {
+			uint c = pk_ofs[j];
+			pk_ofs[j] = acc;
+			acc += c;
+		}
+
+		peaks[0] = (float4)((float)min(acc, (uint)PEAKS_MAX), nf, (float)acc, 0.0f);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	/* Describe them */
+	ofs = pk_ofs[lid];
+
+	for (i=0; (i<span) && (ofs<PEAKS_MAX); i++)
+	{
+		float p, pl, pr, d, den, bw_lvl, l, r;
+
+		b = b0 + i;
+
+		if (!is_peak(live, b, n, lvl))
+			continue;
+
+		p  = live[b].y;
+		pl = live[b-1].y;
+		pr = live[b+1].y;
+
+		/* Parabolic interpolation of the position */
+		den = pl - 2.0f * p + pr;
+		d = (den < 0.0f) ? (0.5f * (pl - pr) / den) : 0.0f;
+
+		/* -3 dB width, interpolated at the crossings (values are
+		 * log10 of the magnitude, so 3 dB is 0.15) */
+		bw_lvl = p - 0.15f;
+
+		for (j=b-1; (j>1) && (j>b-PEAKS_BW_MAX) && (live[j].y > bw_lvl); j--);
+		den = live[j+1].y - live[j].y;
+		l = (float)j + clamp((bw_lvl - live[j].y) / fmax(den, 1e-6f), 0.0f, 1.0f);
+
+		for (j=b+1; (j<n-1) && (j<b+PEAKS_BW_MAX) && (live[j].y > bw_lvl); j++);
+		den = live[j-1].y - live[j].y;
+		r = (float)j - clamp((bw_lvl - live[j].y) / fmax(den, 1e-6f), 0.0f, 1.0f);
+
+		peaks[1 + ofs++] = (float4)((float)b + d, p, r - l, max_hold[b].y);
+	}
+}
+
+
+/* Level statistics for the automatic power range, in log10 units. The
+ * live spectrum gives the noise floor and peak of the last frame. When
+ * it's being computed, the histogram (all bins merged) refines them with
+ * what happened over time : its median for the floor (unless it sits at
+ * the edges of the displayed range, the histogram clips there) and its
+ * top 0.1 % for the peak. One work group per stream. */
+__attribute__((reqd_work_group_size(256, 1, 1)))
+__kernel void range_stats(
+	__global const float2 *spectrum_vbo,	/* [0] Spectrum (live / max hold) */
+	const uint fft_log2_len,		/* [1] log2(FFT length)           */
+	__global float4 *stats,			/* [2] Results                    */
+	__read_only image2d_t histo_tex,	/* [3] Histogram texture          */
+	const float histo_scale,		/* [4] Val->Bin: scaling          */
+	const float histo_ofs,			/* [5] Val->Bin: offset           */
+	const uint use_histo)			/* [6] Histogram is up to date    */
+{
+	const sampler_t direct_sample = CLK_NORMALIZED_COORDS_FALSE | CLK_FILTER_NEAREST | CLK_ADDRESS_CLAMP_TO_EDGE;
+
+	const int stream = get_global_id(1);
+	const int n      = 1 << fft_log2_len;
+	const int lid    = get_local_id(0);
+	const int y0     = stream * 128;
+
+	__global const float2 *live = &spectrum_vbo[(stream * 2) << fft_log2_len];
+
+	__local float red_sum[256];
+	__local float red_cnt[256];
+	__local float red_max[256];
+
+	float4 lv;
+	float tot, acc, v;
+	int b, x;
+
+	/* Live spectrum (the extrema bin isn't displayed, skip it) */
+	lv = spectrum_levels(live, 1, n, red_sum, red_cnt, red_max);
+
+	/* Histogram level distribution, one level per item */
+	if (use_histo && (lid < 128)) {
+		acc = 0.0f;
+		for (x=1; x<n; x++)
+			acc += read_imagef(histo_tex, direct_sample, (int2)(x, y0 + lid)).x;
+		red_sum[lid] = acc;
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (lid != 0)
+		return;
+
+	if (use_histo)
+	{
+		tot = 0.0f;
+		for (b=0; b<128; b++)
+			tot += red_sum[b];
+
+		if (tot > 0.0f)
+		{
+			/* Median */
+			for (b=0, acc=0.0f; (b<127) && (acc + red_sum[b] < 0.5f * tot); b++)
+				acc += red_sum[b];
+
+			if ((b > 0) && (b < 127))
+				lv.x = (float)b / histo_scale - histo_ofs;
+
+			/* Top 0.1 % */
+			for (b=127, acc=0.0f; (b>0) && (acc + red_sum[b] < 0.001f * tot); b--)
+				acc += red_sum[b];
+
+			v = (float)b / histo_scale - histo_ofs;
+			lv.y = fmax(lv.y, v);
+		}
+	}
+
+	stats[stream] = lv;
+}
+
 /* vim: set syntax=c: */
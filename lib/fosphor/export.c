@@ -0,0 +1,229 @@
+/*
+ * export.c
+ *
+ * Host side access to the processed data
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*! \addtogroup export
+ *  @{
+ */
+
+/*! \file export.c
+ *  \brief Host side access to the processed data
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "export.h"
+#include "private.h"
+
+
+/* The display kernel stores log10(|X|), 20*log10(N) still needs removing */
+static inline float
+_pwr2db(float pwr)
+{
+	const float k = 20.0f * FOSPHOR_FFT_LEN_LOG * 0.30103f;
+	return 20.0f * pwr - k;
+}
+
+static inline float
+_db2pwr(float db)
+{
+	const float k = 20.0f * FOSPHOR_FFT_LEN_LOG * 0.30103f;
+	return (db + k) * (1.0f / 20.0f);
+}
+
+
+int
+fosphor_export_host_alloc(struct fosphor *self)
+{
+	if (self->img_waterfall)
+		return 0;
+
+	self->img_waterfall = calloc(self->n_streams * FOSPHOR_FFT_LEN * FOSPHOR_EXPORT_WF_ROWS, sizeof(float));
+	self->img_histogram = calloc(self->n_streams * FOSPHOR_FFT_LEN * FOSPHOR_EXPORT_HISTO_BINS, sizeof(float));
+	self->buf_spectrum  = calloc(self->n_streams * 2 * 2 * FOSPHOR_FFT_LEN, sizeof(float));
+
+	if (!self->img_waterfall ||
+	    !self->img_histogram ||
+	    !self->buf_spectrum)
+	{
+		free(self->img_waterfall);
+		free(self->img_histogram);
+		free(self->buf_spectrum);
+
+		self->img_waterfall = NULL;
+		self->img_histogram = NULL;
+		self->buf_spectrum  = NULL;
+
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+
+void
+fosphor_export_waterfall_row(struct fosphor *self, int stream,
+                             int row, float *dst)
+{
+	const float *src;
+	int i;
+
+	row &= FOSPHOR_EXPORT_WF_ROWS - 1;
+	src = &self->img_waterfall[((stream * FOSPHOR_EXPORT_WF_ROWS) + row) * FOSPHOR_FFT_LEN];
+
+	for (i=0; i<FOSPHOR_FFT_LEN; i++)
+		dst[i] = _pwr2db(src[i ^ (FOSPHOR_FFT_LEN >> 1)]);
+}
+
+void
+fosphor_export_spectrum(struct fosphor *self, int stream,
+                        float *live, float *max_hold)
+{
+	const float *src;
+	int i;
+
+	/* VBO vertices are (x,y) and already in display order */
+	src = &self->buf_spectrum[stream * 2 * 2 * FOSPHOR_FFT_LEN];
+
+	if (live)
+		for (i=0; i<FOSPHOR_FFT_LEN; i++)
+			live[i] = _pwr2db(src[2*i+1]);
+
+	src += 2 * FOSPHOR_FFT_LEN;
+
+	if (max_hold)
+		for (i=0; i<FOSPHOR_FFT_LEN; i++)
+			max_hold[i] = _pwr2db(src[2*i+1]);
+}
+
+void
+fosphor_export_histogram_line(struct fosphor *self, int stream,
+                              int line, float *dst)
+{
+	const float *src;
+	int i;
+
+	src = &self->img_histogram[((stream * FOSPHOR_EXPORT_HISTO_BINS) + line) * FOSPHOR_FFT_LEN];
+
+	for (i=0; i<FOSPHOR_FFT_LEN; i++)
+		dst[i] = src[i ^ (FOSPHOR_FFT_LEN >> 1)];
+}
+
+void
+fosphor_export_histogram(struct fosphor *self, int stream, float *dst)
+{
+	int b;
+
+	for (b=0; b<FOSPHOR_EXPORT_HISTO_BINS; b++)
+		fosphor_export_histogram_line(self, stream, b, &dst[b * FOSPHOR_FFT_LEN]);
+}
+
+void
+fosphor_export_power_bounds(struct fosphor *self, float *db0, float *db1)
+{
+	*db0 = (float)(self->power.db_ref - 10 * self->power.db_per_div);
+	*db1 = (float)(self->power.db_ref);
+}
+
+
+
+void
+fosphor_export_quantize(uint8_t *dst, const float *db, int n,
+                        int bits, float q_db0, float q_db1)
+{
+	const float vmax  = (float)((1 << bits) - 1);
+	const float scale = vmax / (q_db1 - q_db0);
+	int i;
+
+	for (i=0; i<n; i++)
+	{
+		float v = (db[i] - q_db0) * scale + 0.5f;
+		uint16_t q;
+
+		if (!(v > 0.0f))	/* Also catches NaN */
+			q = 0;
+		else if (v > vmax)
+			q = (uint16_t)vmax;
+		else
+			q = (uint16_t)v;
+
+		if (bits == 8) {
+			dst[i] = q;
+		} else {
+			dst[2*i+0] = q;
+			dst[2*i+1] = q >> 8;
+		}
+	}
+}
+
+void
+fosphor_import_dequantize(float *dst, const uint8_t *src, int n,
+                          int bits, float q_db0, float q_db1)
+{
+	const float scale = (q_db1 - q_db0) / (float)((1 << bits) - 1);
+	int i;
+
+	if (bits == 8)
+		for (i=0; i<n; i++)
+			dst[i] = q_db0 + scale * (float)src[i];
+	else
+		for (i=0; i<n; i++)
+			dst[i] = q_db0 + scale * (float)(src[2*i] | (src[2*i+1] << 8));
+}
+
+void
+fosphor_import_rows(float *dst, const float *db, int n_rows)
+{
+	int r, i;
+
+	for (r=0; r<n_rows; r++)
+	{
+		for (i=0; i<FOSPHOR_FFT_LEN; i++)
+			dst[i] = _db2pwr(db[i ^ (FOSPHOR_FFT_LEN >> 1)]);
+
+		db  += FOSPHOR_FFT_LEN;
+		dst += FOSPHOR_FFT_LEN;
+	}
+}
+
+void
+fosphor_import_histogram(float *dst, const float *density, int n_lines)
+{
+	int l, i;
+
+	for (l=0; l<n_lines; l++)
+	{
+		for (i=0; i<FOSPHOR_FFT_LEN; i++)
+			dst[i] = density[i ^ (FOSPHOR_FFT_LEN >> 1)];
+
+		density += FOSPHOR_FFT_LEN;
+		dst     += FOSPHOR_FFT_LEN;
+	}
+}
+
+void
+fosphor_import_spectrum(float *dst, const float *live, const float *max_hold)
+{
+	const float n = (float)(FOSPHOR_FFT_LEN >> 1);
+	int i;
+
+	/* Same vertices as the display kernel generates */
+	for (i=0; i<FOSPHOR_FFT_LEN; i++)
+	{
+		dst[2*i+0] = ((float)i / n) - 1.0f;
+		dst[2*i+1] = _db2pwr(live[i]);
+
+		dst[2*(i+FOSPHOR_FFT_LEN)+0] = ((float)i / n) - 1.0f;
+		dst[2*(i+FOSPHOR_FFT_LEN)+1] = _db2pwr(max_hold[i]);
+	}
+}
+
+
+/*! @} */
@@ -0,0 +1,68 @@
+/*
+ * export.h
+ *
+ * Host side access to the processed data
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+/*! \defgroup export
+ *  @{
+ */
+
+/*! \file export.h
+ *  \brief Host side access to the processed data
+ *
+ *  All the exported rows are converted to dB (same reference as the one
+ *  used by fosphor_set_power_range) and re-ordered so that the first
+ *  element is the lowest frequency (i.e. DC is at FFT_LEN/2).
+ *
+ *  The histogram is exported as density values in [0,1]. Histogram
+ *  line b covers the power  db0 + b * (db1 - db0) / 128  with db0/db1
+ *  the bottom/top of the power range.
+ *
+ *  These only read the host copies, so they're only valid after a
+ *  fosphor_cl_finish() with FLG_FOSPHOR_HOST_READBACK set (or when not
+ *  using CL/GL sharing).
+ *
+ *  Quantized values are 8 or 16 bits (little endian) and map linearly
+ *  0 -> q_db0 and (2^bits - 1) -> q_db1, clamping outside of that.
+ *
+ *  The import helpers do the reverse conversion, producing data in the
+ *  layout of the CL objects, ready to be loaded without going through
+ *  the FFT.
+ */
+
+#include <stdint.h>
+
+struct fosphor;
+
+#define FOSPHOR_EXPORT_WF_ROWS		1024
+#define FOSPHOR_EXPORT_HISTO_BINS	128
+
+int  fosphor_export_host_alloc(struct fosphor *self);
+
+void fosphor_export_waterfall_row(struct fosphor *self, int stream,
+                                  int row, float *dst);
+void fosphor_export_spectrum(struct fosphor *self, int stream,
+                             float *live, float *max_hold);
+void fosphor_export_histogram_line(struct fosphor *self, int stream,
+                                   int line, float *dst);
+void fosphor_export_histogram(struct fosphor *self, int stream, float *dst);
+
+void fosphor_export_power_bounds(struct fosphor *self, float *db0, float *db1);
+
+void fosphor_export_quantize(uint8_t *dst, const float *db, int n,
+                             int bits, float q_db0, float q_db1);
+void fosphor_import_dequantize(float *dst, const uint8_t *src, int n,
+                               int bits, float q_db0, float q_db1);
+
+void fosphor_import_rows(float *dst, const float *db, int n_rows);
+void fosphor_import_histogram(float *dst, const float *density, int n_lines);
+void fosphor_import_spectrum(float *dst, const float *live, const float *max_hold);
+
+
+/*! @} */
@@ -350,6 +350,60 @@ fft_radix8(
 }
 
 
+/* ------------------------------------------------------------------------ */
+/* 1024 points passes (shared by the complex and real kernels)              */
+/* ------------------------------------------------------------------------ */
+
+__attribute__((always_inline)) void
+fft_1024_passes(__local float2 *buf, float2 *r, int lid)
+{
+#define WG_SIZE (1024 / 8)
+
+	/* 1st pass: 1 * Radix-8 */
+	fft_radix8(buf, r,  1, lid, WG_SIZE, 0);
+
+	/* 2nd pass: 1 * Radix-8 */
+	fft_radix8(buf, r,  8, lid, WG_SIZE, 1);
+
+	/* 3rd pass: 1 * Radix-8 */
+	fft_radix8(buf, r, 64, lid, WG_SIZE, 1);
+
+	/* 4th pass: 4 * Radix-2 */
+	{
+		const int p = 512;
+		const int i = lid << 2;
+		const int t = WG_SIZE << 2;
+		const int k = i;
+
+		fft_radix2_load(buf, r+0, i+0, t);
+		fft_radix2_load(buf, r+2, i+1, t);
+		fft_radix2_load(buf, r+4, i+2, t);
+		fft_radix2_load(buf, r+6, i+3, t);
+
+		fft_radix2_twiddle(r+0, k+0, p);
+		fft_radix2_twiddle(r+2, k+1, p);
+		fft_radix2_twiddle(r+4, k+2, p);
+		fft_radix2_twiddle(r+6, k+3, p);
+
+		fft_radix2_exec(r+0);
+		fft_radix2_exec(r+2);
+		fft_radix2_exec(r+4);
+		fft_radix2_exec(r+6);
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		fft_radix2_store(buf, r+0, i+0, k+0, p);
+		fft_radix2_store(buf, r+2, i+1, k+1, p);
+		fft_radix2_store(buf, r+4, i+2, k+2, p);
+		fft_radix2_store(buf, r+6, i+3, k+3, p);
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+#undef WG_SIZE
+}
+
+
 /* ------------------------------------------------------------------------ */
 /* FFT kernels                                                              */
 /* ------------------------------------------------------------------------ */
@@ -368,9 +422,9 @@ __kernel void fft1D_512(
 	int lid = get_local_id(0);
 	int i;
 
-	/* Adjust ptr for batch */
-	input  += N * get_global_id(1);
-	output += N * get_global_id(1);
+	/* Adjust ptr for stream & batch */
+	input  += N * (get_global_id(2) * get_global_size(1) + get_global_id(1));
+	output += N * (get_global_id(2) * get_global_size(1) + get_global_id(1));
 
 	/* Global load & window apply */
 	for (i=lid; i<N; i+=WG_SIZE)
@@ -408,58 +462,121 @@ __kernel void fft1D_1024(
 	int lid = get_local_id(0);
 	int i;
 
-	/* Adjust ptr for batch */
-	input  += N * get_global_id(1);
-	output += N * get_global_id(1);
+	/* Adjust ptr for stream & batch */
+	input  += N * (get_global_id(2) * get_global_size(1) + get_global_id(1));
+	output += N * (get_global_id(2) * get_global_size(1) + get_global_id(1));
 
 	/* Global load & window apply */
 	for (i=lid; i<N; i+=WG_SIZE)
 		buf[i] = input[i] * win[i];
 
-	/* 1st pass: 1 * Radix-8 */
-	fft_radix8(buf, r,  1, lid, WG_SIZE, 0);
+	/* 4 passes : 3 * Radix-8, 4 * Radix-2 */
+	fft_1024_passes(buf, r, lid);
 
-	/* 2nd pass: 1 * Radix-8 */
-	fft_radix8(buf, r,  8, lid, WG_SIZE, 1);
+	/* Global store */
+	for (i=0; i<8; i++)
+		output[i*WG_SIZE+lid] = buf[i*WG_SIZE+lid];
 
-	/* 3rd pass: 1 * Radix-8 */
-	fft_radix8(buf, r, 64, lid, WG_SIZE, 1);
+#undef WG_SIZE
+#undef N
+}
 
-	/* 4th pass: 4 * Radix-2 */
+/*
+ * Polyphase filter bank front end : each output block is the weighted sum
+ * of the last n_taps blocks of 1024 samples (its own being the newest),
+ * folded on top of each other. The result goes through the usual FFT
+ * kernels with a unity window. For real input, the taps are interpolated
+ * between the two samples of each pair, like the window is.
+ */
+__kernel void pfb_fold(
+	__global const float2 *in,		/* [0] New samples (all streams)  */
+	__global const float2 *hist,		/* [1] Previous samples           */
+	const uint hist_len,			/* [2] History length per stream */
+	const uint in_len,			/* [3] New samples per stream     */
+	__global const float *taps,		/* [4] Prototype (n_taps * 1024)  */
+	const uint n_taps,			/* [5] Taps per bin               */
+	const uint real_input,			/* [6] Pairs of real samples      */
+	__global float2 *out)			/* [7] Folded blocks              */
+{
+#define N 1024
+	const int n      = get_global_id(0);
+	const int blk    = get_global_id(1);
+	const int stream = get_global_id(2);
+	const int len    = n_taps * N;
+
+	float2 acc = (float2)(0.0f, 0.0f);
+	int m;
+
+	/* Select stream. hist[-1] is the most recent */
+	in   += stream * in_len;
+	hist += (stream + 1) * hist_len;
+	out  += stream * in_len + blk * N + n;
+
+	for (m=0; m<n_taps; m++)
 	{
-		const int p = 512;
-		const int i = lid << 2;
-		const int t = WG_SIZE << 2;
-		const int k = i;
+		int i = (blk - n_taps + 1 + m) * N + n;
+		int t = m * N + n;
+		float2 x = (i >= 0) ? in[i] : hist[i];
+		float2 h = real_input ?
+			(float2)(taps[t], 0.5f * (taps[t] + taps[(t+1) % len])) :
+			(float2)(taps[t], taps[t]);
+
+		acc += x * h;
+	}
 
-		fft_radix2_load(buf, r+0, i+0, t);
-		fft_radix2_load(buf, r+2, i+1, t);
-		fft_radix2_load(buf, r+4, i+2, t);
-		fft_radix2_load(buf, r+6, i+3, t);
+	*out = acc;
+#undef N
+}
 
-		fft_radix2_twiddle(r+0, k+0, p);
-		fft_radix2_twiddle(r+2, k+1, p);
-		fft_radix2_twiddle(r+4, k+2, p);
-		fft_radix2_twiddle(r+6, k+3, p);
+/*
+ * Real input : each float2 holds two consecutive real samples, so 2048 of
+ * them go through the 1024 points complex FFT and get split afterwards.
+ * The window is given for 1024 points and interpolated to 2048. Output
+ * is the positive half of the 2048 points spectrum (DC to fs/2), stored
+ * so that bin k lands in display position k (i.e. at k ^ N/2) and scaled
+ * like a complex input one (same level for a sine of same amplitude).
+ */
+__kernel void fft1D_1024_real(
+	__global   const float2 *input,
+	__global         float2 *output,
+	__constant const float  *win)
+{
+#define N 1024
+#define WG_SIZE (N / 8)
 
-		fft_radix2_exec(r+0);
-		fft_radix2_exec(r+2);
-		fft_radix2_exec(r+4);
-		fft_radix2_exec(r+6);
+	__local float2 buf[N];
 
-		barrier(CLK_LOCAL_MEM_FENCE);
+	float2 r[8];
+	int lid = get_local_id(0);
+	int i;
 
-		fft_radix2_store(buf, r+0, i+0, k+0, p);
-		fft_radix2_store(buf, r+2, i+1, k+1, p);
-		fft_radix2_store(buf, r+4, i+2, k+2, p);
-		fft_radix2_store(buf, r+6, i+3, k+3, p);
+	/* Adjust ptr for stream & batch */
+	input  += N * (get_global_id(2) * get_global_size(1) + get_global_id(1));
+	output += N * (get_global_id(2) * get_global_size(1) + get_global_id(1));
 
-		barrier(CLK_LOCAL_MEM_FENCE);
-	}
+	/* Global load & window apply (even samples on a point, odd between) */
+	for (i=lid; i<N; i+=WG_SIZE)
+		buf[i] = input[i] * (float2)(win[i], 0.5f * (win[i] + win[(i+1) & (N-1)]));
 
-	/* Global store */
+	/* Complex FFT */
+	fft_1024_passes(buf, r, lid);
+
+	/* Split : X[k] = E[k] + e^(-j.pi.k/N) O[k] with E / O the spectra
+	 * of the even / odd samples, recovered from Z[k] and Z*[N-k] */
 	for (i=0; i<8; i++)
-		output[i*WG_SIZE+lid] = buf[i*WG_SIZE+lid];
+	{
+		int k = i*WG_SIZE + lid;
+		float2 a = buf[k];
+		float2 b = buf[(N-k) & (N-1)];
+		float2 e, o;
+
+		b.y = -b.y;
+
+		e = 0.5f * (a + b);
+		o = 0.5f * (float2)(a.y - b.y, b.x - a.x);	/* (a - b) / 2j */
+
+		output[k ^ (N >> 1)] = e + twiddle(o, k, -M_PIf / (float)N);
+	}
 
 #undef WG_SIZE
 #undef N
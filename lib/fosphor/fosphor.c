@@ -15,6 +15,7 @@
  *  \brief Main fosphor entry point
  */
 
+#include <errno.h>
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -22,86 +23,1357 @@
 
 #include "cl.h"
 #include "gl.h"
+#include "export.h"
 #include "fosphor.h"
+#include "net.h"
 #include "private.h"
+#include "rec.h"
+#include "rollup.h"
+#include "shm.h"
 
 
 struct fosphor *
 fosphor_init(void)
+{
+	return fosphor_init_multi(1);
+}
+
+struct fosphor *
+fosphor_init_multi(int n_streams)
 {
 	struct fosphor *self;
 	int rv;
 
-	/* Allocate structure */
-	self = malloc(sizeof(struct fosphor));
-	if (!self)
-		return NULL;
+	/* Validate number of streams */
+	if ((n_streams < 1) || (n_streams > FOSPHOR_MAX_STREAMS))
+		return NULL;
+
+	/* Allocate structure */
+	self = malloc(sizeof(struct fosphor));
+	if (!self)
+		return NULL;
+
+	memset(self, 0, sizeof(struct fosphor));
+
+	self->n_streams = n_streams;
+
+	/* Init GL/CL sub-states */
+	rv = fosphor_gl_init(self);
+	if (rv)
+		goto error;
+
+	rv = fosphor_cl_init(self);
+	if (rv)
+		goto error;
+
+	/* Buffers (if needed) */
+	if (!(self->flags & FLG_FOSPHOR_USE_CLGL_SHARING))
+	{
+		rv = fosphor_export_host_alloc(self);
+		if (rv)
+			goto error;
+
+		self->img_waterfall_red = calloc(self->n_streams * FOSPHOR_FFT_LEN * 1024, sizeof(float));
+		if (!self->img_waterfall_red) {
+			rv = -ENOMEM;
+			goto error;
+		}
+	}
+
+	/* Initial state */
+	fosphor_set_fft_window_default(self);
+	fosphor_set_power_range(self, 0, 10);
+
+	self->zoom.decim = 1;
+
+	self->products_view = FOSPHOR_PROD_ALL;
+	fosphor_set_hidden_policy(self, FOSPHOR_HIDDEN_FULL, 1);
+
+	self->bands.trig_db = NAN;
+
+	return self;
+
+	/* Error path */
+error:
+	fosphor_release(self);
+	return NULL;
+}
+
+void
+fosphor_release(struct fosphor *self)
+{
+	if (!self)
+		return;
+
+	fosphor_shm_destroy(self->shm);
+	fosphor_net_destroy(self->net);
+	fosphor_rec_destroy(self->rec);
+	fosphor_rollup_destroy(self->rollup);
+
+	free(self->img_waterfall);
+	free(self->img_waterfall_red);
+	free(self->img_zoom_waterfall);
+	free(self->img_zoom_histogram);
+	free(self->buf_zoom_spectrum);
+	free(self->peaks.buf);
+	free(self->pct.buf);
+	free(self->autorange.stats);
+	free(self->rollup_stats.raw);
+	free(self->xs.raw);
+	free(self->xs.phase_wf);
+	free(self->sk.raw);
+	free(self->sk.cur);
+	free(self->sk.wf);
+	free(self->occ.raw);
+	free(self->occ.slots);
+	free(self->occ.sum);
+	free(self->occ.cur);
+	free(self->mask.level);
+	free(self->mask.viol);
+	free(self->bands.raw);
+	free(self->bands.acc);
+	free(self->bands.last);
+	free(self->bands.trig);
+	free(self->img_histogram);
+	free(self->buf_spectrum);
+
+	fosphor_cl_release(self);
+	fosphor_gl_release(self);
+
+	free(self);
+}
+
+int
+fosphor_get_num_streams(struct fosphor *self)
+{
+	return self->n_streams;
+}
+
+static int
+_fosphor_render_products(const struct fosphor_render *render)
+{
+	int p = 0;
+
+	if (render->options & FRO_WATERFALL)	p |= FOSPHOR_PROD_WATERFALL;
+	if (render->options & FRO_HISTO)	p |= FOSPHOR_PROD_HISTO;
+	if (render->options & FRO_LIVE)		p |= FOSPHOR_PROD_LIVE;
+	if (render->options & FRO_MAX_HOLD)	p |= FOSPHOR_PROD_MAX_HOLD;
+
+	return p;
+}
+
+static int
+_fosphor_products(struct fosphor *self)
+{
+	int view = 0;
+
+	/* Display products depend on visibility & policy */
+	if (!(self->flags & FLG_FOSPHOR_HIDDEN))
+	{
+		view = self->products_view;
+	}
+	else if (self->hidden.policy == FOSPHOR_HIDDEN_FULL)
+	{
+		view = self->products_view;
+	}
+	else if (self->hidden.policy == FOSPHOR_HIDDEN_DECIMATE)
+	{
+		if (++self->hidden.cnt >= self->hidden.decim) {
+			self->hidden.cnt = 0;
+			view = self->products_view;
+		}
+	}
+
+	/* Replayed samples don't go to the outputs */
+	if (self->flags & FLG_FOSPHOR_REPLAY)
+		return view;
+
+	return view | self->products_out;
+}
+
+static float
+_fosphor_band_db(struct fosphor *self, float lin)
+{
+	/* Same reference as the display, with the window noise bandwidth
+	 * removed so a pure tone reads like its spectrum peak */
+	return 10.0f * log10f(lin / self->bands.enbw) - 20.0f * log10f((float)FOSPHOR_FFT_LEN);
+}
+
+static void
+_fosphor_bands_accumulate(struct fosphor *self)
+{
+	int s, b;
+
+	for (s=0; s<self->n_streams; s++)
+	{
+		for (b=0; b<self->bands.n; b++)
+		{
+			int i = s * FOSPHOR_BANDS_MAX + b;
+			float *r = &self->bands.raw[4 * i];
+			float *a = &self->bands.acc[4 * i];
+
+			a[0] += r[0];
+			a[1]  = fmaxf(a[1], r[1]);
+			a[2] += r[2];
+			a[3] += r[3];
+
+			self->bands.last[i] = (r[3] > 0.0f) ?
+				_fosphor_band_db(self, r[0] / r[3]) : NAN;
+		}
+	}
+
+	self->bands.fresh = 0;
+
+	/* Earliest trigger of the frame, kept until it's read */
+	if (isnan(self->bands.trig_db) || self->bands.trig_fired)
+		return;
+
+	for (s=0; s<self->n_streams; s++)
+	{
+		for (b=0; b<self->bands.n; b++)
+		{
+			int t = self->bands.trig[s * FOSPHOR_BANDS_MAX + b];
+
+			if ((t < 0) || (self->bands.trig_fired &&
+			    (self->bands.trig_base + t >= self->bands.trig_spectrum)))
+				continue;
+
+			self->bands.trig_fired    = 1;
+			self->bands.trig_spectrum = self->bands.trig_base + t;
+			self->bands.trig_stream   = s;
+			self->bands.trig_band     = b;
+		}
+	}
+}
+
+static void
+_fosphor_occ_accumulate(struct fosphor *self)
+{
+	const int n = self->n_streams * FOSPHOR_FFT_LEN;
+	unsigned int *slot = &self->occ.slots[self->occ.slot * n];
+	int slot_len, i;
+
+	/* Add the last frame to the current slot */
+	for (i=0; i<n; i++) {
+		slot[i] += self->occ.raw[i];
+		self->occ.sum[i] += self->occ.raw[i];
+	}
+
+	self->occ.slot_spectra[self->occ.slot] += self->occ.raw_spectra;
+	self->occ.sum_spectra += self->occ.raw_spectra;
+	self->occ.raw_spectra = 0;
+
+	for (i=0; i<n; i++)
+		self->occ.cur[i] = (float)self->occ.sum[i] / (float)self->occ.sum_spectra;
+
+	if (!++self->occ.seq)
+		self->occ.seq = 1;
+
+	/* Slot full : move on, dropping the oldest one */
+	slot_len = self->occ.window / FOSPHOR_OCC_SLOTS;
+	if (slot_len < 1)
+		slot_len = 1;
+
+	if (self->occ.slot_spectra[self->occ.slot] < slot_len)
+		return;
+
+	self->occ.slot = (self->occ.slot + 1) % FOSPHOR_OCC_SLOTS;
+	slot = &self->occ.slots[self->occ.slot * n];
+
+	for (i=0; i<n; i++) {
+		self->occ.sum[i] -= slot[i];
+		slot[i] = 0;
+	}
+
+	self->occ.sum_spectra -= self->occ.slot_spectra[self->occ.slot];
+	self->occ.slot_spectra[self->occ.slot] = 0;
+}
+
+static void
+_fosphor_xs_update(struct fosphor *self)
+{
+	float *row = &self->xs.phase_wf[self->xs.wf_pos * FOSPHOR_FFT_LEN];
+	int i;
+
+	self->xs.fresh = 0;
+
+	if (!self->xs.enabled)
+		return;
+
+	for (i=0; i<FOSPHOR_FFT_LEN; i++)
+		row[i] = self->xs.raw[4*i+1];
+
+	self->xs.wf_pos = (self->xs.wf_pos + 1) % FOSPHOR_XS_WF_LEN;
+
+	if (!++self->xs.seq)
+		self->xs.seq = 1;
+}
+
+static void
+_fosphor_sk_update(struct fosphor *self)
+{
+	const float k = 20.0f * log10f((float)FOSPHOR_FFT_LEN);
+	int s, i;
+
+	self->sk.fresh = 0;
+
+	if (!self->sk.enabled)
+		return;
+
+	for (s=0; s<self->n_streams; s++)
+	{
+		const float *raw = &self->sk.raw[4 * s * FOSPHOR_FFT_LEN];
+		float *cur = &self->sk.cur[2 * s * FOSPHOR_FFT_LEN];
+		float *row = &self->sk.wf[(s * FOSPHOR_SK_WF_LEN + self->sk.wf_pos) * FOSPHOR_FFT_LEN];
+
+		for (i=0; i<FOSPHOR_FFT_LEN; i++, raw+=4, cur+=2)
+		{
+			float m = raw[2];
+			float mean, var;
+
+			if ((m < 2.0f) || (raw[0] <= 0.0f)) {
+				cur[0] = cur[1] = row[i] = NAN;
+				continue;
+			}
+
+			/* Generalized SK estimator (Nita & Gary, d = 1), 1 for
+			 * gaussian noise, < 1 for CW, > 1 for impulsive signals */
+			cur[0] = ((m + 1.0f) / (m - 1.0f)) * ((m * raw[1]) / (raw[0] * raw[0]) - 1.0f);
+
+			mean = raw[0] / m;
+			var  = raw[1] / m - mean * mean;
+			cur[1] = 5.0f * log10f(var > 0.0f ? var : 0.0f) - k;
+
+			row[i] = cur[0];
+		}
+	}
+
+	self->sk.m      = (int)self->sk.raw[2];
+	self->sk.wf_pos = (self->sk.wf_pos + 1) % FOSPHOR_SK_WF_LEN;
+
+	if (!++self->sk.seq)
+		self->sk.seq = 1;
+}
+
+static int
+_fosphor_sync(struct fosphor *self)
+{
+	int rv, new_rows;
+
+	rv = fosphor_cl_finish(self);
+	if (rv <= 0)
+		return rv;
+
+	self->flags |= FLG_FOSPHOR_GL_STALE;
+
+	/* Display only (nothing measured on the device either) */
+	if (self->flags & FLG_FOSPHOR_REPLAY)
+		return rv;
+
+	if (self->bands.fresh)
+		_fosphor_bands_accumulate(self);
+
+	if (self->occ.raw_spectra)
+		_fosphor_occ_accumulate(self);
+
+	if (self->xs.fresh)
+		_fosphor_xs_update(self);
+
+	if (self->sk.fresh)
+		_fosphor_sk_update(self);
+
+	/* Hand the frame to the outputs */
+	new_rows = fosphor_cl_get_waterfall_new(self);
+
+	if (self->shm)
+		fosphor_shm_publish(self->shm, self, new_rows);
+
+	if (self->net)
+		fosphor_net_publish(self->net, self, new_rows);
+
+	if (self->rec)
+		fosphor_rec_publish(self->rec, self, new_rows);
+
+	if (self->rollup_stats.raw_spectra) {
+		if (self->rollup)
+			fosphor_rollup_publish(self->rollup, self->rollup_stats.raw,
+			                       self->rollup_stats.raw_spectra);
+		self->rollup_stats.raw_spectra = 0;
+	}
+
+	return rv;
+}
+
+int
+fosphor_process(struct fosphor *self, void *samples, int len)
+{
+	void *stream_samples[FOSPHOR_MAX_STREAMS];
+	int i;
+
+	/* Samples for each stream are laid out back to back */
+	for (i=0; i<self->n_streams; i++)
+		stream_samples[i] = (char *)samples + i * 2 * sizeof(float) * len;
+
+	return fosphor_process_multi(self, stream_samples, len);
+}
+
+int
+fosphor_process_multi(struct fosphor *self, void **samples, int len)
+{
+	int rv;
+
+	/* New frame : only compute what was looked at during the last one */
+	if (self->flags & FLG_FOSPHOR_FRAME_SEEN) {
+		if (self->flags & FLG_FOSPHOR_FRAME_DRAWN) {
+			self->products_view = self->products_drawn;
+			self->flags &= ~FLG_FOSPHOR_HIDDEN;
+		} else {
+			self->flags |= FLG_FOSPHOR_HIDDEN;
+		}
+
+		self->products_drawn = 0;
+		self->flags &= ~(FLG_FOSPHOR_FRAME_SEEN | FLG_FOSPHOR_FRAME_DRAWN);
+	}
+
+	self->products = _fosphor_products(self);
+
+	/* Don't let waterfall rows nobody exported yet get overwritten */
+	if ((self->flags & FLG_FOSPHOR_HOST_READBACK) &&
+	    (fosphor_cl_get_waterfall_pending(self) + (len / FOSPHOR_FFT_LEN) > 1024))
+		_fosphor_sync(self);
+
+	rv = fosphor_cl_process(self, samples, len);
+
+	/* Counted even if nothing had to run (replays were already) */
+	if ((rv >= 0) && !(self->flags & FLG_FOSPHOR_REPLAY))
+		self->spectra += len / FOSPHOR_FFT_LEN;
+
+	return rv;
+}
+
+static void
+_fosphor_zoom_release(struct fosphor *self)
+{
+	fosphor_gl_zoom_release(self);
+
+	free(self->img_zoom_waterfall);
+	free(self->img_zoom_histogram);
+	free(self->buf_zoom_spectrum);
+
+	self->img_zoom_waterfall = NULL;
+	self->img_zoom_histogram = NULL;
+	self->buf_zoom_spectrum  = NULL;
+}
+
+static int
+_fosphor_zoom_alloc(struct fosphor *self)
+{
+	/* GL objects first, the CL side may share them */
+	if (fosphor_gl_zoom_alloc(self))
+		goto error;
+
+	/* Host copies (if needed) */
+	if (!(self->flags & FLG_FOSPHOR_USE_CLGL_SHARING) && !self->img_zoom_waterfall)
+	{
+		self->img_zoom_waterfall = calloc(self->n_streams * FOSPHOR_FFT_LEN * 1024, sizeof(float));
+		self->img_zoom_histogram = calloc(self->n_streams * FOSPHOR_FFT_LEN * 128, sizeof(float));
+		self->buf_zoom_spectrum  = calloc(self->n_streams * 2 * 2 * FOSPHOR_FFT_LEN, sizeof(float));
+
+		if (!self->img_zoom_waterfall ||
+		    !self->img_zoom_histogram ||
+		    !self->buf_zoom_spectrum)
+			goto error;
+	}
+
+	return 0;
+
+error:
+	_fosphor_zoom_release(self);
+	return -ENOMEM;
+}
+
+void
+fosphor_set_real_input(struct fosphor *self, int enable)
+{
+	self->real_input = enable;
+	fosphor_cl_set_real_input(self, enable);
+
+	/* Stop the down-converter if it was running */
+	if (enable && (self->zoom.decim > 1) &&
+	    (fosphor_cl_set_zoom(self, 1, self->zoom.center) == 0)) {
+		_fosphor_zoom_release(self);
+		self->zoom.decim = 1;
+	}
+}
+
+void
+fosphor_set_replay(struct fosphor *self, int enable)
+{
+	/* Don't let live samples share a frame with replayed ones */
+	if (!enable == !(self->flags & FLG_FOSPHOR_REPLAY))
+		return;
+
+	_fosphor_sync(self);
+
+	if (enable)
+		self->flags |= FLG_FOSPHOR_REPLAY;
+	else
+		self->flags &= ~FLG_FOSPHOR_REPLAY;
+}
+
+int
+fosphor_sync(struct fosphor *self)
+{
+	/* Frame without any drawing */
+	self->flags |= FLG_FOSPHOR_FRAME_SEEN;
+
+	return _fosphor_sync(self);
+}
+
+void
+fosphor_draw(struct fosphor *self, struct fosphor_render *render)
+{
+	self->products_drawn |= _fosphor_render_products(render);
+	self->flags |= FLG_FOSPHOR_FRAME_SEEN | FLG_FOSPHOR_FRAME_DRAWN;
+
+	_fosphor_sync(self);
+	if (self->flags & FLG_FOSPHOR_GL_STALE) {
+		fosphor_gl_refresh(self);
+		self->flags &= ~FLG_FOSPHOR_GL_STALE;
+	}
+	render->_wf_pos = ((render->options & FRO_DDC) && (self->zoom.decim > 1)) ?
+		fosphor_cl_get_zoom_waterfall_position(self) :
+		fosphor_cl_get_waterfall_position(self);
+	fosphor_gl_draw(self, render);
+}
+
+void
+fosphor_set_hidden_policy(struct fosphor *self, int policy, int decim)
+{
+	self->hidden.policy = policy;
+	self->hidden.decim  = (decim > 0) ? decim : 1;
+	self->hidden.cnt    = 0;
+}
+
+
+int
+fosphor_load_waterfall(struct fosphor *self, int stream, int row,
+                       const float *db, int n_rows)
+{
+	float *buf;
+	int rv = 0, n;
+
+	if (n_rows > 1024) {
+		db += (n_rows - 1024) * FOSPHOR_FFT_LEN;
+		row += n_rows - 1024;
+		n_rows = 1024;
+	}
+
+	buf = malloc(n_rows * FOSPHOR_FFT_LEN * sizeof(float));
+	if (!buf)
+		return -ENOMEM;
+
+	fosphor_import_rows(buf, db, n_rows);
+
+	/* Split at the ring wrap */
+	for (n=0; (n < n_rows) && !rv; )
+	{
+		int r = (row + n) & 1023;
+		int l = n_rows - n;
+
+		if (r + l > 1024)
+			l = 1024 - r;
+
+		rv = fosphor_cl_load_waterfall(self, stream, r, l, &buf[n * FOSPHOR_FFT_LEN]);
+		n += l;
+	}
+
+	free(buf);
+
+	return rv;
+}
+
+int
+fosphor_load_histogram(struct fosphor *self, int stream, int line,
+                       const float *density, int n_lines)
+{
+	float *buf;
+	int rv;
+
+	if ((line < 0) || (line + n_lines > 128))
+		return -EINVAL;
+
+	buf = malloc(n_lines * FOSPHOR_FFT_LEN * sizeof(float));
+	if (!buf)
+		return -ENOMEM;
+
+	fosphor_import_histogram(buf, density, n_lines);
+	rv = fosphor_cl_load_histogram(self, stream, line, n_lines, buf);
+
+	free(buf);
+
+	return rv;
+}
+
+int
+fosphor_load_spectrum(struct fosphor *self, int stream,
+                      const float *live, const float *max_hold)
+{
+	float buf[2 * 2 * FOSPHOR_FFT_LEN];
+
+	fosphor_import_spectrum(buf, live, max_hold);
+
+	return fosphor_cl_load_spectrum(self, stream, buf);
+}
+
+void
+fosphor_set_waterfall_position(struct fosphor *self, int pos)
+{
+	fosphor_cl_set_waterfall_position(self, pos);
+}
+
+
+static int
+_fosphor_update_readback(struct fosphor *self)
+{
+	int need = self->shm || self->net || self->rec;
+
+	/* What the outputs export */
+	self->products_out = 0;
+
+	if (self->shm)
+		self->products_out |= FOSPHOR_PROD_ALL;
+
+	if (self->net)
+		self->products_out |= FOSPHOR_PROD_WATERFALL | FOSPHOR_PROD_LIVE | FOSPHOR_PROD_MAX_HOLD |
+			(fosphor_net_has_histogram(self->net) ? FOSPHOR_PROD_HISTO : 0);
+
+	if (self->rec)
+		self->products_out |= FOSPHOR_PROD_WATERFALL;
+
+	if (self->peaks.enabled)
+		self->products_out |= FOSPHOR_PROD_LIVE | FOSPHOR_PROD_MAX_HOLD;
+
+	if (self->pct.enabled)
+		self->products_out |= FOSPHOR_PROD_HISTO;
+
+	if (self->autorange.enabled)
+		self->products_out |= FOSPHOR_PROD_LIVE;
+
+	if (need) {
+		if (fosphor_export_host_alloc(self))
+			return -ENOMEM;
+		self->flags |= FLG_FOSPHOR_HOST_READBACK;
+	} else {
+		self->flags &= ~FLG_FOSPHOR_HOST_READBACK;
+	}
+
+	return 0;
+}
+
+int
+fosphor_set_shm_output(struct fosphor *self, const char *name)
+{
+	/* Always start from a fresh segment */
+	fosphor_shm_destroy(self->shm);
+	self->shm = NULL;
+
+	if (name && name[0]) {
+		self->shm = fosphor_shm_create(name, self->n_streams);
+		if (!self->shm) {
+			_fosphor_update_readback(self);
+			return -EIO;
+		}
+	}
+
+	if (_fosphor_update_readback(self)) {
+		fosphor_shm_destroy(self->shm);
+		self->shm = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int
+fosphor_set_net_output(struct fosphor *self, const char *endpoint,
+                       int bits, int histo)
+{
+	/* Always start from a fresh socket */
+	fosphor_net_destroy(self->net);
+	self->net = NULL;
+
+	if (endpoint && endpoint[0]) {
+		self->net = fosphor_net_create(endpoint, self->n_streams, bits, histo);
+		if (!self->net) {
+			_fosphor_update_readback(self);
+			return -EIO;
+		}
+	}
+
+	if (_fosphor_update_readback(self)) {
+		fosphor_net_destroy(self->net);
+		self->net = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int
+fosphor_set_rec_output(struct fosphor *self, const char *path,
+                       int bits, float db_min, float db_max)
+{
+	/* Close any current archive */
+	fosphor_rec_destroy(self->rec);
+	self->rec = NULL;
+
+	if (path && path[0]) {
+		self->rec = fosphor_rec_create(path, self->n_streams, bits, db_min, db_max,
+			self->frequency.center, self->frequency.span);
+		if (!self->rec) {
+			_fosphor_update_readback(self);
+			return -EIO;
+		}
+	}
+
+	if (_fosphor_update_readback(self)) {
+		fosphor_rec_destroy(self->rec);
+		self->rec = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int
+fosphor_set_rollup_output(struct fosphor *self, const char *path,
+                          const int *period_s, const int *n_slots,
+                          int n_levels)
+{
+	/* Close (and flush) any current file */
+	fosphor_cl_set_rollup(self, 0);
+	fosphor_rollup_destroy(self->rollup);
+	self->rollup = NULL;
+	self->rollup_stats.raw_spectra = 0;
+
+	if (!path || !path[0])
+		return 0;
+
+	if (!self->rollup_stats.raw) {
+		self->rollup_stats.raw = malloc(self->n_streams * 4 * sizeof(float) * FOSPHOR_FFT_LEN);
+		if (!self->rollup_stats.raw)
+			return -ENOMEM;
+	}
+
+	self->rollup = fosphor_rollup_create(path, self->n_streams,
+		period_s, n_slots, n_levels,
+		self->frequency.center, self->frequency.span);
+	if (!self->rollup)
+		return -EIO;
+
+	fosphor_cl_set_rollup(self, 1);
+
+	return 0;
+}
+
+
+int
+fosphor_set_peaks(struct fosphor *self, int enable, float threshold_db)
+{
+	if (enable && !self->peaks.buf) {
+		self->peaks.buf = calloc(self->n_streams * 4 * (FOSPHOR_PEAKS_MAX + 1), sizeof(float));
+		if (!self->peaks.buf)
+			return -ENOMEM;
+	}
+
+	self->peaks.enabled   = enable;
+	self->peaks.threshold = threshold_db / 20.0f;
+
+	return _fosphor_update_readback(self);
+}
+
+static int
+_fosphor_peak_cmp(const void *a, const void *b)
+{
+	const struct fosphor_peak *pa = a, *pb = b;
+	return (pa->pwr < pb->pwr) - (pa->pwr > pb->pwr);
+}
+
+int
+fosphor_get_peaks(struct fosphor *self, int stream,
+                  struct fosphor_peak *peaks, int max_peaks,
+                  float *noise_floor)
+{
+	const float k = 20.0f * log10f((float)FOSPHOR_FFT_LEN);
+	const double bin = self->frequency.span / FOSPHOR_FFT_LEN;
+	struct fosphor_peak all[FOSPHOR_PEAKS_MAX];
+	float *r;
+	int i, n;
+
+	if (!self->peaks.enabled || (stream < 0) || (stream >= self->n_streams))
+		return -EINVAL;
+
+	/* Raw results of the last frame (bins in display order) */
+	r = &self->peaks.buf[stream * 4 * (FOSPHOR_PEAKS_MAX + 1)];
+	n = (int)r[0];
+	if ((n < 0) || (n > FOSPHOR_PEAKS_MAX))
+		n = 0;
+
+	if (noise_floor)
+		*noise_floor = 20.0f * r[1] - k;
+
+	for (i=0; i<n; i++) {
+		const float *e = &r[4 * (i + 1)];
+		all[i].freq    = self->frequency.center + bin * ((double)e[0] - FOSPHOR_FFT_LEN / 2);
+		all[i].bw      = bin * (double)e[2];
+		all[i].pwr     = 20.0f * e[1] - k;
+		all[i].pwr_max = 20.0f * e[3] - k;
+	}
+
+	/* Strongest first */
+	qsort(all, n, sizeof(struct fosphor_peak), _fosphor_peak_cmp);
+
+	if (n > max_peaks)
+		n = max_peaks;
+
+	memcpy(peaks, all, n * sizeof(struct fosphor_peak));
+
+	return n;
+}
+
+
+int
+fosphor_set_occupancy(struct fosphor *self, int enable,
+                      float threshold_db, int window)
+{
+	const int n = self->n_streams * FOSPHOR_FFT_LEN;
+	float thresh;
+
+	if (enable && (window < 1))
+		return -EINVAL;
+
+	if (enable && !self->occ.raw) {
+		self->occ.raw   = calloc(n, sizeof(unsigned int));
+		self->occ.slots = calloc(FOSPHOR_OCC_SLOTS * n, sizeof(unsigned int));
+		self->occ.sum   = calloc(n, sizeof(unsigned int));
+		self->occ.cur   = calloc(n, sizeof(float));
+
+		if (!self->occ.raw || !self->occ.slots || !self->occ.sum || !self->occ.cur) {
+			free(self->occ.raw);
+			free(self->occ.slots);
+			free(self->occ.sum);
+			free(self->occ.cur);
+			self->occ.raw = self->occ.slots = self->occ.sum = NULL;
+			self->occ.cur = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	/* Start over */
+	if (self->occ.raw) {
+		memset(self->occ.slots, 0x00, FOSPHOR_OCC_SLOTS * n * sizeof(unsigned int));
+		memset(self->occ.sum, 0x00, n * sizeof(unsigned int));
+		memset(self->occ.cur, 0x00, n * sizeof(float));
+		memset(self->occ.slot_spectra, 0x00, sizeof(self->occ.slot_spectra));
+	}
+
+	self->occ.enabled     = enable;
+	self->occ.window      = (window > FOSPHOR_OCC_MAX_WINDOW) ? FOSPHOR_OCC_MAX_WINDOW : window;
+	self->occ.raw_spectra = 0;
+	self->occ.slot        = 0;
+	self->occ.sum_spectra = 0;
+	self->occ.seq         = 0;
+
+	/* The device compares magnitudes */
+	thresh = powf(10.0f, threshold_db / 20.0f) * (float)FOSPHOR_FFT_LEN;
+
+	fosphor_cl_set_occupancy(self, enable, thresh);
+
+	return 0;
+}
+
+int
+fosphor_get_occupancy(struct fosphor *self, int stream, float *occ)
+{
+	const float *r;
+	int i;
+
+	if (!self->occ.enabled || (stream < 0) || (stream >= self->n_streams))
+		return -EINVAL;
+
+	if (!self->occ.sum_spectra)
+		return 0;
+
+	r = &self->occ.cur[stream * FOSPHOR_FFT_LEN];
+
+	for (i=0; i<FOSPHOR_FFT_LEN; i++)
+		occ[i] = r[i ^ (FOSPHOR_FFT_LEN >> 1)];
+
+	return self->occ.sum_spectra;
+}
+
+int
+fosphor_set_kurtosis(struct fosphor *self, int enable)
+{
+	const int n = self->n_streams * FOSPHOR_FFT_LEN;
+
+	if (enable && !self->sk.raw) {
+		self->sk.raw = calloc(4 * n, sizeof(float));
+		self->sk.cur = calloc(2 * n, sizeof(float));
+		self->sk.wf  = calloc(FOSPHOR_SK_WF_LEN * n, sizeof(float));
+
+		if (!self->sk.raw || !self->sk.cur || !self->sk.wf) {
+			free(self->sk.raw);
+			free(self->sk.cur);
+			free(self->sk.wf);
+			self->sk.raw = self->sk.cur = self->sk.wf = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	/* Start over */
+	if (self->sk.wf)
+		memset(self->sk.wf, 0x00, FOSPHOR_SK_WF_LEN * n * sizeof(float));
+
+	self->sk.enabled = enable;
+	self->sk.fresh   = 0;
+	self->sk.wf_pos  = 0;
+	self->sk.m       = 0;
+	self->sk.seq     = 0;
+
+	fosphor_cl_set_kurtosis(self, enable);
+
+	return 0;
+}
+
+int
+fosphor_get_kurtosis(struct fosphor *self, int stream, float *sk, float *std_db)
+{
+	const float *r;
+	int i;
+
+	if (!self->sk.enabled || (stream < 0) || (stream >= self->n_streams))
+		return -EINVAL;
+
+	if (!self->sk.seq)
+		return 0;
+
+	r = &self->sk.cur[2 * stream * FOSPHOR_FFT_LEN];
+
+	for (i=0; i<FOSPHOR_FFT_LEN; i++)
+	{
+		int j = i ^ (FOSPHOR_FFT_LEN >> 1);
+
+		if (sk)
+			sk[i] = r[2*j+0];
+		if (std_db)
+			std_db[i] = r[2*j+1];
+	}
+
+	return self->sk.m;
+}
+
+int
+fosphor_set_cross_spectrum(struct fosphor *self, int enable, float alpha)
+{
+	int rv;
+
+	if (enable && (self->n_streams < 2))
+		return -EINVAL;
 
-	memset(self, 0, sizeof(struct fosphor));
+	if (alpha <= 0.0f)
+		alpha = FOSPHOR_LIVE_ALPHA;
+	else if (alpha > 1.0f)
+		return -EINVAL;
 
-	/* Init GL/CL sub-states */
-	rv = fosphor_gl_init(self);
-	if (rv)
-		goto error;
+	if (enable && !self->xs.raw) {
+		self->xs.raw      = calloc(4 * FOSPHOR_FFT_LEN, sizeof(float));
+		self->xs.phase_wf = calloc(FOSPHOR_XS_WF_LEN * FOSPHOR_FFT_LEN, sizeof(float));
 
-	rv = fosphor_cl_init(self);
+		if (!self->xs.raw || !self->xs.phase_wf) {
+			free(self->xs.raw);
+			free(self->xs.phase_wf);
+			self->xs.raw = self->xs.phase_wf = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	rv = fosphor_cl_set_cross_spectrum(self, enable, alpha);
 	if (rv)
-		goto error;
+		return rv;
 
-	/* Buffers (if needed) */
-	if (!(self->flags & FLG_FOSPHOR_USE_CLGL_SHARING))
+	/* Start over */
+	if (self->xs.phase_wf)
+		memset(self->xs.phase_wf, 0x00, FOSPHOR_XS_WF_LEN * FOSPHOR_FFT_LEN * sizeof(float));
+
+	self->xs.enabled = enable;
+	self->xs.fresh   = 0;
+	self->xs.wf_pos  = 0;
+	self->xs.seq     = 0;
+
+	return 0;
+}
+
+int
+fosphor_get_cross_spectrum(struct fosphor *self,
+                           float *coherence, float *phase, float *cross_db)
+{
+	const float k = 20.0f * log10f((float)FOSPHOR_FFT_LEN);
+	int i;
+
+	if (!self->xs.enabled)
+		return -EINVAL;
+
+	if (!self->xs.seq)
+		return 0;
+
+	for (i=0; i<FOSPHOR_FFT_LEN; i++)
 	{
-		self->img_waterfall = malloc(FOSPHOR_FFT_LEN * 1024 * sizeof(float));
-		self->img_histogram = malloc(FOSPHOR_FFT_LEN *  128 * sizeof(float));
-		self->buf_spectrum  = malloc(2 * 2 * FOSPHOR_FFT_LEN * sizeof(float));
+		const float *r = &self->xs.raw[4 * (i ^ (FOSPHOR_FFT_LEN >> 1))];
+
+		if (coherence)
+			coherence[i] = r[0];
+		if (phase)
+			phase[i] = r[1];
+		if (cross_db)
+			cross_db[i] = 20.0f * r[2] - k;
+	}
 
-		if (!self->img_waterfall ||
-		    !self->img_histogram ||
-		    !self->buf_spectrum)
-			goto error;
+	return 1;
+}
+
+int
+fosphor_set_mask(struct fosphor *self,
+                 const float *pos, const float *level_db, int n_points)
+{
+	const float k = 20.0f * log10f((float)FOSPHOR_FFT_LEN);
+	float dev[FOSPHOR_FFT_LEN];
+	int i, j;
+
+	if (n_points < 0)
+		return -EINVAL;
+
+	for (j=1; j<n_points; j++)
+		if (pos[j] < pos[j-1])
+			return -EINVAL;
+
+	/* Disable */
+	if (!n_points) {
+		self->mask.enabled = 0;
+		self->mask.gen++;
+		return fosphor_cl_set_mask(self, NULL);
 	}
 
-	/* Initial state */
-	fosphor_set_fft_window_default(self);
-	fosphor_set_power_range(self, 0, 10);
+	if (!self->mask.level) {
+		self->mask.level = malloc(FOSPHOR_FFT_LEN * sizeof(float));
+		self->mask.viol  = calloc(self->n_streams * 2 * FOSPHOR_FFT_LEN, sizeof(float));
 
-	return self;
+		if (!self->mask.level || !self->mask.viol) {
+			free(self->mask.level);
+			free(self->mask.viol);
+			self->mask.level = self->mask.viol = NULL;
+			return -ENOMEM;
+		}
+	}
 
-	/* Error path */
-error:
-	fosphor_release(self);
-	return NULL;
+	/* Sample at each displayed bin, then convert for the device (log10
+	 * of the magnitude, FFT order) */
+	for (i=0, j=0; i<FOSPHOR_FFT_LEN; i++)
+	{
+		float p = (float)i / (float)FOSPHOR_FFT_LEN;
+		float l;
+
+		while ((j < n_points) && (pos[j] <= p))
+			j++;
+
+		if (j == 0)
+			l = level_db[0];
+		else if (j == n_points)
+			l = level_db[n_points-1];
+		else
+			l = level_db[j-1] + (level_db[j] - level_db[j-1]) *
+				(p - pos[j-1]) / (pos[j] - pos[j-1]);
+
+		self->mask.level[i] = l;
+		dev[i ^ (FOSPHOR_FFT_LEN >> 1)] = (l + k) / 20.0f;
+	}
+
+	self->mask.enabled = 1;
+	self->mask.seq     = 0;
+	self->mask.gen++;
+
+	return fosphor_cl_set_mask(self, dev);
 }
 
-void
-fosphor_release(struct fosphor *self)
+int
+fosphor_get_mask_violations(struct fosphor *self, int stream,
+                            struct fosphor_mask_violation *v, int max_viol)
 {
-	if (!self)
-		return;
+	const double bin = self->frequency.span / FOSPHOR_FFT_LEN;
+	const float *r;
+	int i, b, n, in_run;
 
-	free(self->img_waterfall);
-	free(self->img_histogram);
-	free(self->buf_spectrum);
+	if (!self->mask.enabled || (stream < 0) || (stream >= self->n_streams))
+		return -EINVAL;
 
-	fosphor_cl_release(self);
-	fosphor_gl_release(self);
+	if (!self->mask.seq)
+		return 0;
 
-	free(self);
+	r = &self->mask.viol[stream * 2 * FOSPHOR_FFT_LEN];
+	n = 0;
+	in_run = 0;
+
+	/* Runs of adjacent bins (display order, extrema bin not displayed) */
+	for (i=1; i<=FOSPHOR_FFT_LEN; i++)
+	{
+		b = (i ^ (FOSPHOR_FFT_LEN >> 1)) & (FOSPHOR_FFT_LEN - 1);
+
+		if ((i < FOSPHOR_FFT_LEN) && (r[2*b] > 0.0f))
+		{
+			float margin = 20.0f * r[2*b+1];
+
+			if (!in_run) {
+				if (n == max_viol)
+					break;
+				v[n].freq   = self->frequency.center + bin * (double)(i - FOSPHOR_FFT_LEN / 2);
+				v[n].bw     = 0.0;
+				v[n].margin = margin;
+				v[n].count  = 0;
+				in_run = 1;
+			}
+
+			if (margin > v[n].margin) {
+				v[n].freq   = self->frequency.center + bin * (double)(i - FOSPHOR_FFT_LEN / 2);
+				v[n].margin = margin;
+			}
+
+			if ((int)r[2*b] > v[n].count)
+				v[n].count = (int)r[2*b];
+
+			v[n].bw += bin;
+		}
+		else if (in_run)
+		{
+			in_run = 0;
+			n++;
+		}
+	}
+
+	return n;
 }
 
 int
-fosphor_process(struct fosphor *self, void *samples, int len)
+fosphor_set_percentiles(struct fosphor *self, int enable, float p_low)
 {
-	return fosphor_cl_process(self, samples, len);
+	if ((p_low < 0.0f) || (p_low > 1.0f))
+		return -EINVAL;
+
+	if (enable && !self->pct.buf) {
+		self->pct.buf = calloc(self->n_streams * 4 * FOSPHOR_FFT_LEN, sizeof(float));
+		if (!self->pct.buf)
+			return -ENOMEM;
+	}
+
+	self->pct.enabled   = enable;
+	self->pct.p_low     = p_low;
+	self->pct.requested = 0;
+	self->pct.seq       = 0;
+
+	return _fosphor_update_readback(self);
 }
 
 void
-fosphor_draw(struct fosphor *self, struct fosphor_render *render)
+fosphor_request_percentiles(struct fosphor *self)
 {
-	if (fosphor_cl_finish(self) > 0)
-		fosphor_gl_refresh(self);
-	render->_wf_pos = fosphor_cl_get_waterfall_position(self);
-	fosphor_gl_draw(self, render);
+	if (self->pct.enabled)
+		self->pct.requested = 1;
+}
+
+int
+fosphor_get_percentiles(struct fosphor *self, int stream,
+                        float *low, float *p50, float *p90)
+{
+	const float k = 20.0f * log10f((float)FOSPHOR_FFT_LEN);
+	const float *r;
+	int i;
+
+	if (!self->pct.enabled || (stream < 0) || (stream >= self->n_streams))
+		return -EINVAL;
+
+	if (!self->pct.seq || self->pct.requested)
+		return -EAGAIN;
+
+	r = &self->pct.buf[stream * 4 * FOSPHOR_FFT_LEN];
+
+	for (i=0; i<FOSPHOR_FFT_LEN; i++, r+=4) {
+		if (low) low[i] = 20.0f * r[0] - k;
+		if (p50) p50[i] = 20.0f * r[1] - k;
+		if (p90) p90[i] = 20.0f * r[2] - k;
+	}
+
+	return 0;
+}
+
+static int
+_fosphor_bands_apply(struct fosphor *self)
+{
+	int range[2 * FOSPHOR_BANDS_MAX];
+	const float *win = self->pfb.m ? self->pfb.taps : self->fft_win;
+	int n = (self->pfb.m ? self->pfb.m : 1) * FOSPHOR_FFT_LEN;
+	float s1, s2, thr, trig;
+	int i;
+
+	/* Window (or filter bank prototype) equivalent noise bandwidth (in bins) */
+	s1 = s2 = 0.0f;
+	for (i=0; i<n; i++) {
+		s1 += win[i];
+		s2 += win[i] * win[i];
+	}
+
+	self->bands.enbw = (s1 > 0.0f) ? ((float)FOSPHOR_FFT_LEN * s2 / (s1 * s1)) : 1.0f;
+
+	/* Bins covered by each band (display order) */
+	for (i=0; i<self->bands.n; i++)
+	{
+		float c = self->bands.center[i] * FOSPHOR_FFT_LEN;
+		float h = self->bands.width[i]  * FOSPHOR_FFT_LEN / 2.0f;
+		int lo = (int)ceilf(c - h);
+		int hi = (int)floorf(c + h);
+
+		if (lo > hi)	/* Narrower than a bin */
+			lo = hi = (int)roundf(c);
+
+		if (lo < 1)			lo = 1;
+		if (hi > FOSPHOR_FFT_LEN - 1)	hi = FOSPHOR_FFT_LEN - 1;
+
+		range[2*i+0] = lo;
+		range[2*i+1] = (self->bands.width[i] > 0.0f) ? hi : (lo - 1);
+	}
+
+	/* Threshold in the kernel linear units */
+	thr = self->bands.enbw * (float)FOSPHOR_FFT_LEN * (float)FOSPHOR_FFT_LEN *
+		powf(10.0f, self->bands.threshold_db / 10.0f);
+
+	trig = isnan(self->bands.trig_db) ? HUGE_VALF :
+		self->bands.enbw * (float)FOSPHOR_FFT_LEN * (float)FOSPHOR_FFT_LEN *
+		powf(10.0f, self->bands.trig_db / 10.0f);
+
+	return fosphor_cl_set_bands(self, range, self->bands.n, thr, trig);
+}
+
+int
+fosphor_set_bands(struct fosphor *self,
+                  const struct fosphor_channel *bands, int n_bands,
+                  float duty_threshold_db)
+{
+	int i;
+
+	if ((n_bands < 0) || (n_bands > FOSPHOR_BANDS_MAX))
+		return -EINVAL;
+
+	if (n_bands && !self->bands.raw) {
+		self->bands.raw  = calloc(self->n_streams * 4 * FOSPHOR_BANDS_MAX, sizeof(float));
+		self->bands.acc  = calloc(self->n_streams * 4 * FOSPHOR_BANDS_MAX, sizeof(float));
+		self->bands.last = calloc(self->n_streams * FOSPHOR_BANDS_MAX, sizeof(float));
+		self->bands.trig = calloc(self->n_streams * FOSPHOR_BANDS_MAX, sizeof(int));
+
+		if (!self->bands.raw || !self->bands.acc || !self->bands.last || !self->bands.trig) {
+			free(self->bands.raw);
+			free(self->bands.acc);
+			free(self->bands.last);
+			free(self->bands.trig);
+			self->bands.raw = self->bands.acc = self->bands.last = NULL;
+			self->bands.trig = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	self->bands.n = n_bands;
+	self->bands.threshold_db = duty_threshold_db;
+	self->bands.fresh = 0;
+	self->bands.trig_fired = 0;
+
+	for (i=0; i<n_bands; i++) {
+		self->bands.center[i] = bands[i].center;
+		self->bands.width[i]  = bands[i].enabled ? bands[i].width : 0.0f;
+	}
+
+	/* Start over */
+	if (n_bands) {
+		memset(self->bands.acc, 0x00, self->n_streams * 4 * FOSPHOR_BANDS_MAX * sizeof(float));
+		for (i=0; i<self->n_streams * FOSPHOR_BANDS_MAX; i++)
+			self->bands.last[i] = NAN;
+	}
+
+	return _fosphor_bands_apply(self);
+}
+
+int
+fosphor_get_band_power(struct fosphor *self, int stream,
+                       struct fosphor_band_power *bp, int max_bands)
+{
+	int b, n;
+
+	if (!self->bands.n || (stream < 0) || (stream >= self->n_streams))
+		return -EINVAL;
+
+	n = (self->bands.n < max_bands) ? self->bands.n : max_bands;
+
+	for (b=0; b<n; b++)
+	{
+		float *a = &self->bands.acc[4 * (stream * FOSPHOR_BANDS_MAX + b)];
+
+		if (a[3] > 0.0f) {
+			bp[b].mean = _fosphor_band_db(self, a[0] / a[3]);
+			bp[b].peak = _fosphor_band_db(self, a[1]);
+			bp[b].duty = a[2] / a[3];
+		} else {
+			bp[b].mean = NAN;
+			bp[b].peak = NAN;
+			bp[b].duty = 0.0f;
+		}
+	}
+
+	/* Next read covers what comes after this one */
+	memset(&self->bands.acc[4 * stream * FOSPHOR_BANDS_MAX], 0x00,
+	       4 * FOSPHOR_BANDS_MAX * sizeof(float));
+
+	return n;
+}
+
+int
+fosphor_set_band_trigger(struct fosphor *self, float threshold_db)
+{
+	self->bands.trig_db    = threshold_db;
+	self->bands.trig_fired = 0;
+
+	if (!self->bands.n)
+		return 0;
+
+	return _fosphor_bands_apply(self);
+}
+
+int
+fosphor_get_band_trigger(struct fosphor *self, uint64_t *spectrum,
+                         int *stream, int *band)
+{
+	if (!self->bands.n || isnan(self->bands.trig_db))
+		return -EINVAL;
+
+	if (!self->bands.trig_fired)
+		return 0;
+
+	if (spectrum)
+		*spectrum = self->bands.trig_spectrum;
+	if (stream)
+		*stream = self->bands.trig_stream;
+	if (band)
+		*band = self->bands.trig_band;
+
+	self->bands.trig_fired = 0;
+
+	return 1;
 }
 
 
@@ -118,6 +1390,7 @@ fosphor_set_fft_window_default(struct fosphor *self)
 	}
 
 	fosphor_cl_load_fft_window(self, self->fft_win);
+	_fosphor_bands_apply(self);
 }
 
 void
@@ -125,6 +1398,46 @@ fosphor_set_fft_window(struct fosphor *self, float *win)
 {
 	memcpy(self->fft_win, win, sizeof(float) * FOSPHOR_FFT_LEN);
 	fosphor_cl_load_fft_window(self, self->fft_win);
+	_fosphor_bands_apply(self);
+}
+
+int
+fosphor_set_pfb(struct fosphor *self, int m, const float *taps)
+{
+	const int len = m * FOSPHOR_FFT_LEN;
+	double s;
+	int i, rv;
+
+	if ((m < 0) || (m > FOSPHOR_PFB_MAX_TAPS))
+		return -EINVAL;
+
+	if (m && taps) {
+		memcpy(self->pfb.taps, taps, sizeof(float) * len);
+	} else if (m) {
+		/* Default : sinc one bin wide, Blackman-Harris windowed,
+		 * scaled like the default window (unity gain at bin center) */
+		s = 0.0;
+		for (i=0; i<len; i++) {
+			double x = M_PI * ((double)i - (double)len / 2.0) / (double)FOSPHOR_FFT_LEN;
+			double p = 2.0 * M_PI * (double)i / (double)len;
+			double w = 0.35875 - 0.48829 * cos(p) + 0.14128 * cos(2.0 * p) - 0.01168 * cos(3.0 * p);
+
+			self->pfb.taps[i] = (float)(((x != 0.0) ? (sin(x) / x) : 1.0) * w);
+			s += self->pfb.taps[i];
+		}
+
+		for (i=0; i<len; i++)
+			self->pfb.taps[i] *= (float)((double)FOSPHOR_FFT_LEN / s);
+	}
+
+	rv = fosphor_cl_set_pfb(self, m, self->pfb.taps);
+	if (rv)
+		return rv;
+
+	self->pfb.m = m;
+	_fosphor_bands_apply(self);
+
+	return 0;
 }
 
 
@@ -151,6 +1464,95 @@ fosphor_set_power_range(struct fosphor *self, int db_ref, int db_per_div)
 	fosphor_cl_set_histogram_range(self, scale, offset);
 }
 
+int
+fosphor_set_auto_range(struct fosphor *self, int enable)
+{
+	if (enable && !self->autorange.stats) {
+		self->autorange.stats = calloc(self->n_streams * 4, sizeof(float));
+		if (!self->autorange.stats)
+			return -ENOMEM;
+	}
+
+	/* Start over from the next measurement when (re-)enabled */
+	if (enable && !self->autorange.enabled) {
+		self->autorange.fresh = 0;
+		self->autorange.nf    = NAN;
+		self->autorange.pk    = NAN;
+	}
+
+	self->autorange.enabled = enable;
+
+	return _fosphor_update_readback(self);
+}
+
+int
+fosphor_auto_range(struct fosphor *self, int *db_ref, int *db_per_div)
+{
+	static const int k_div[] = { 1, 2, 5, 10, 20 };
+	const int n_div = sizeof(k_div) / sizeof(k_div[0]);
+	const float k = 20.0f * log10f((float)FOSPHOR_FFT_LEN);
+	float nf, pk, range, top, bot, d;
+	int i, div, ref;
+
+	if (!self->autorange.enabled)
+		return -EINVAL;
+
+	if (!self->autorange.fresh)
+		return 0;
+
+	self->autorange.fresh = 0;
+
+	/* Lowest floor and highest peak of all streams */
+	nf =  INFINITY;
+	pk = -INFINITY;
+
+	for (i=0; i<self->n_streams; i++) {
+		nf = fminf(nf, 20.0f * self->autorange.stats[4*i+0] - k);
+		pk = fmaxf(pk, 20.0f * self->autorange.stats[4*i+1] - k);
+	}
+
+	/* Smoothing: slow on the floor, fast attack / slow release on the peak */
+	if (isnan(self->autorange.nf)) {
+		self->autorange.nf = nf;
+		self->autorange.pk = pk;
+	} else {
+		self->autorange.nf += 0.05f * (nf - self->autorange.nf);
+		self->autorange.pk += ((pk > self->autorange.pk) ? 0.3f : 0.02f) * (pk - self->autorange.pk);
+	}
+
+	nf = self->autorange.nf;
+	pk = self->autorange.pk;
+	range = pk - nf;
+
+	/* Hysteresis: keep the current range as long as the floor is visible,
+	 * the peak isn't clipped and the span is neither too tight nor wasted */
+	d   = (float)*db_per_div;
+	top = (float)*db_ref;
+	bot = top - 10.0f * d;
+
+	if ((nf >= bot + 0.25f * d) &&
+	    (pk <= top - 0.25f * d) &&
+	    (pk >= top - 4.0f * d) &&
+	    (range <= 9.0f * d) &&
+	    ((range >= 2.0f * d) || (*db_per_div <= k_div[0])))
+		return 0;
+
+	/* New range: smallest scale fitting the span in 7.5 div and the
+	 * reference 1 to 2 div above the peak (whole divisions), so the floor
+	 * ends up at least half a div above the bottom */
+	for (i=0; (i<n_div-1) && (7.5f * k_div[i] < range); i++);
+	div = k_div[i];
+	ref = div * (int)ceilf((pk + (float)div) / (float)div);
+
+	if ((div == *db_per_div) && (ref == *db_ref))
+		return 0;
+
+	*db_per_div = div;
+	*db_ref     = ref;
+
+	return 1;
+}
+
 void
 fosphor_set_frequency_range(struct fosphor *self, double center, double span)
 {
@@ -158,6 +1560,46 @@ fosphor_set_frequency_range(struct fosphor *self, double center, double span)
 	self->frequency.span   = span;
 }
 
+int
+fosphor_set_zoom(struct fosphor *self, int enable, double center, double width)
+{
+	int decim = 1;
+	int rv;
+
+	/* Largest power of 2 still containing the requested width
+	 * (the down-converter needs complex samples) */
+	if (enable && !self->real_input) {
+		while (((decim * 2) <= FOSPHOR_ZOOM_MAX_DECIM) && (width * (decim * 2) <= 1.0))
+			decim *= 2;
+	}
+
+	/* Nothing changed : keep the filter and the batch in progress */
+	if ((decim == self->zoom.decim) && ((decim <= 1) || (center == self->zoom.center)))
+		return decim;
+
+	/* Down-converter output only exists while it's enabled */
+	if (decim > 1) {
+		rv = _fosphor_zoom_alloc(self);
+		if (rv)
+			return rv;
+	}
+
+	rv = fosphor_cl_set_zoom(self, decim, center);
+	if (rv) {
+		if (self->zoom.decim <= 1)
+			_fosphor_zoom_release(self);
+		return rv;
+	}
+
+	if (decim <= 1)
+		_fosphor_zoom_release(self);
+
+	self->zoom.decim  = decim;
+	self->zoom.center = center;
+
+	return decim;
+}
+
 
 void
 fosphor_render_defaults(struct fosphor_render *render)
@@ -167,6 +1609,8 @@ fosphor_render_defaults(struct fosphor_render *render)
 	render->width  = 1024;
 	render->height = 1024;
 
+	render->stream = 0;
+
 	render->options =
 		FRO_LIVE	|
 		FRO_MAX_HOLD	|
@@ -182,6 +1626,175 @@ fosphor_render_defaults(struct fosphor_render *render)
 	render->freq_center    = 0.5f;
 	render->freq_span      = 1.0f;
 	render->wf_span        = 1.0f;
+
+	render->_gen    = 0;
+	render->_n_bg   = 0;
+	render->_n_grid = 0;
+	render->_n_chan = 0;
+}
+
+static struct fosphor_render_vtx *
+_render_vtx(struct fosphor_render_vtx *v, float x, float y, const float rgba[4])
+{
+	v->x = x;
+	v->y = y;
+	memcpy(v->rgba, rgba, sizeof(v->rgba));
+	return v + 1;
+}
+
+static struct fosphor_render_vtx *
+_render_quad(struct fosphor_render_vtx *v, float x0, float x1, float y0, float y1,
+             const float rgba[4])
+{
+	v = _render_vtx(v, x0, y0, rgba);
+	v = _render_vtx(v, x1, y0, rgba);
+	v = _render_vtx(v, x1, y1, rgba);
+	v = _render_vtx(v, x0, y0, rgba);
+	v = _render_vtx(v, x1, y1, rgba);
+	v = _render_vtx(v, x0, y1, rgba);
+	return v;
+}
+
+static void
+_render_build_overlay(struct fosphor_render *render)
+{
+	static unsigned int gen = 0;
+	const float bg_color[4]   = { 0.0f, 0.0f, 0.1f, 1.0f };
+	const float grid_color[4] = { 0.0f, 0.0f, 0.0f, 0.5f };
+	struct fosphor_render_vtx *v, *v0;
+	int i;
+
+	/* New generation so the GL side knows to re-upload. This is global
+	 * so a render struct re-allocated at the same address is still seen
+	 * as different */
+	if (!++gen)
+		gen = 1;
+	render->_gen = gen;
+
+	/* Dark background when there is no histogram behind the traces */
+	v = v0 = render->_vtx;
+
+	if (!(render->options & FRO_HISTO) &&
+	     (render->options & (FRO_LIVE | FRO_MAX_HOLD)))
+		v = _render_quad(v,
+			render->_x[0], render->_x[1],
+			render->_y_histo[0], render->_y_histo[1],
+			bg_color
+		);
+
+	render->_n_bg = v - v0;
+
+	/* Grid lines */
+	v0 = v;
+
+	if (render->options & (FRO_LIVE | FRO_MAX_HOLD | FRO_HISTO))
+	{
+		for (i=0; i<11; i++)
+		{
+			float yv = render->_y_histo[0] + i * render->_y_histo_div;
+
+			v = _render_vtx(v, render->_x[0] + 0.5f, yv + 0.5f, grid_color);
+			v = _render_vtx(v, render->_x[1] - 0.5f, yv + 0.5f, grid_color);
+		}
+
+		for (i=0; i<=render->freq_n_div; i++)
+		{
+			float xv = render->_x[0] + i * render->_x_div;
+
+			v = _render_vtx(v, xv + 0.5f, render->_y_histo[0] + 0.5f, grid_color);
+			v = _render_vtx(v, xv + 0.5f, render->_y_histo[1] - 0.5f, grid_color);
+		}
+	}
+
+	render->_n_grid = v - v0;
+
+	/* Channels */
+	v0 = v;
+
+	if (render->options & FRO_CHANNELS)
+	{
+		struct {
+			int   dir;
+			float pos;
+		} pt[2*FOSPHOR_MAX_CHANNELS+2], tpt;
+
+		float xs = render->_x[1] - render->_x[0];
+		int j, n, l;
+
+		/* Generate the points from the channels */
+		n = 2;
+
+		pt[0].dir = -1; pt[0].pos = 0.0f;
+		pt[1].dir =  1; pt[1].pos = 1.0f;
+
+		for (i=0; i<FOSPHOR_MAX_CHANNELS; i++)
+		{
+			float f;
+
+			if (!render->channels[i].enabled)
+				continue;
+
+			f = render->channels[i].center
+				- render->channels[i].width / 2.0f;
+			pt[n].dir = 1;
+			pt[n].pos = (f > 0.0f) ? (f < 1.0f ? f : 1.0f) : 0.0f;
+			n++;
+
+			f = render->channels[i].center
+				+ render->channels[i].width / 2.0f;
+
+			pt[n].dir = -1;
+			pt[n].pos = (f > 0.0f) ? (f < 1.0f ? f : 1.0f) : 0.0f;
+			n++;
+		}
+
+		/* Sort and emit at the same time (only if there is something to do) */
+		l = pt[0].dir;
+
+		for (i=1; (n>2) && (i<n); i++)
+		{
+			float color[4], xa, xb;
+			int mi = i;
+
+			/* Find min index */
+			for (j=i+1; j<n; j++) {
+				if (pt[j].pos < pt[mi].pos)
+					mi = j;
+			}
+
+			/* Swap */
+			tpt    = pt[i];
+			pt[i]  = pt[mi];
+			pt[mi] = tpt;
+
+			/* Emit */
+			if ((pt[i-1].pos != pt[i].pos) && (l != 0))
+			{
+				if (l < 0) {
+					color[0] = color[1] = color[2] = 0.0f;
+					color[3] = 0.5f;
+				} else {
+					color[0] = color[1] = color[2] = 1.0f;
+					color[3] = 0.2f - 0.2f / (1 + l);
+				}
+
+				xa = render->_x[0] + pt[i-1].pos * xs;
+				xb = render->_x[0] + pt[i  ].pos * xs;
+
+				if (render->options & (FRO_LIVE | FRO_MAX_HOLD | FRO_HISTO))
+					v = _render_quad(v, xa, xb,
+						render->_y_histo[0], render->_y_histo[1], color);
+
+				if (render->options & FRO_WATERFALL)
+					v = _render_quad(v, xa, xb,
+						render->_y_wf[0], render->_y_wf[1], color);
+			}
+
+			l += pt[i].dir;
+		}
+	}
+
+	render->_n_chan = v - v0;
 }
 
 void
@@ -275,6 +1888,9 @@ fosphor_render_refresh(struct fosphor_render *render)
 		render->_y_wf[1] = 0.0f;
 		render->_y_wf[0] = 0.0f;
 	}
+
+	/* Pre-build the static overlay geometry for that layout */
+	_render_build_overlay(render);
 }
 
 
@@ -293,6 +1909,29 @@ fosphor_render_refresh(struct fosphor_render *render)
  *    best we can do)
  */
 
+void
+fosphor_render_freq_range(struct fosphor *self, const struct fosphor_render *render,
+                          double *center, double *span)
+{
+	double band_center = self->frequency.center;
+	double band_span   = self->frequency.span;
+
+	/* Zoom down-converter output ? */
+	if ((render->options & FRO_DDC) && (self->zoom.decim > 1)) {
+		band_center += band_span * (self->zoom.center - 0.5);
+		band_span   /= (double)self->zoom.decim;
+	}
+
+	/* Use the straight numbers when possible to avoid any imprecisions */
+	if (render->freq_center != 0.5f || render->freq_span != 1.0f) {
+		*center = band_center + band_span * (double)(render->freq_center - 0.5f);
+		*span   = band_span * (double)render->freq_span;
+	} else {
+		*center = band_center;
+		*span   = band_span;
+	}
+}
+
 double
 fosphor_pos2freq(struct fosphor *self, struct fosphor_render *render, int x)
 {
@@ -300,8 +1939,9 @@ fosphor_pos2freq(struct fosphor *self, struct fosphor_render *render, int x)
 	float xs = render->_x[1] - render->_x[0];
 	float xr = (xf - render->_x[0]) / xs;
 
-	double view_center = self->frequency.center + self->frequency.span * (double)(render->freq_center - 0.5f);
-	double view_span   = self->frequency.span * (double)render->freq_span;
+	double view_center, view_span;
+
+	fosphor_render_freq_range(self, render, &view_center, &view_span);
 
 	return view_center + view_span * (double)(xr - 0.5f);
 }
@@ -329,12 +1969,13 @@ fosphor_pos2samp(struct fosphor *self, struct fosphor_render *render, int y)
 int
 fosphor_freq2pos(struct fosphor *self, struct fosphor_render *render, double freq)
 {
-	double view_center = self->frequency.center + self->frequency.span * (double)(render->freq_center - 0.5f);
-	double view_span   = self->frequency.span * (double)render->freq_span;
-
-	double fr = ((freq - view_center) / view_span);
+	double view_center, view_span, fr;
 	float  xs = render->_x[1] - render->_x[0];
 
+	fosphor_render_freq_range(self, render, &view_center, &view_span);
+
+	fr = ((freq - view_center) / view_span);
+
 	return (int)roundf(render->_x[0] + (float)(fr + 0.5) * xs - 0.5f);
 }
 
@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 /*! \defgroup fosphor
  *  @{
  */
@@ -19,23 +21,241 @@
 
 struct fosphor;
 struct fosphor_render;
+struct fosphor_channel;
 
 
 /* Main API */
 
+#define FOSPHOR_MAX_STREAMS	8
+
 struct fosphor *fosphor_init(void);
+struct fosphor *fosphor_init_multi(int n_streams);
 void fosphor_release(struct fosphor *self);
 
+int  fosphor_get_num_streams(struct fosphor *self);
+
 int  fosphor_process(struct fosphor *self, void *samples, int len);
+int  fosphor_process_multi(struct fosphor *self, void **samples, int len);
+int  fosphor_sync(struct fosphor *self);
 void fosphor_draw(struct fosphor *self, struct fosphor_render *render);
 
+/* Real input: samples are floats instead of complex ones, 'len' still
+ *  counts pairs of them. Each spectrum then covers 2048 samples and only
+ *  its positive half (DC to fs/2) is computed and displayed, with the
+ *  same 1024 bins. The frequency range should be set accordingly and the
+ *  zoom falls back to stretching (the down-converter needs IQ) */
+void fosphor_set_real_input(struct fosphor *self, int enable);
+
+/* Replay: samples processed while enabled were already seen live and are
+ *  only displayed again. Measurements, outputs and the band trigger leave
+ *  them out and the spectrum count doesn't move. Changing it completes
+ *  the pending frame first */
+void fosphor_set_replay(struct fosphor *self, int enable);
+
+/* Hidden display policy (frames presented with fosphor_sync() only)
+ *  Whatever the policy, what outputs export is always kept current.
+ *  Defaults to FOSPHOR_HIDDEN_FULL */
+#define FOSPHOR_HIDDEN_DISCARD	0	/* Don't compute display products */
+#define FOSPHOR_HIDDEN_DECIMATE	1	/* Compute them every Nth batch */
+#define FOSPHOR_HIDDEN_FULL	2	/* Compute them all the time */
+
+void fosphor_set_hidden_policy(struct fosphor *self, int policy, int decim);
+
 void fosphor_set_fft_window_default(struct fosphor *self);
 void fosphor_set_fft_window(struct fosphor *self, float *win);
 
+/* Polyphase filter bank front end: each spectrum is computed from its
+ *  last 'm' blocks of 1024 samples, weighted by an m * 1024 taps prototype
+ *  and folded, instead of a single windowed block. Same resolution, much
+ *  lower leakage. 'taps' NULL selects a default prototype (windowed sinc),
+ *  m = 0 goes back to the FFT window. Taps are scaled like the window
+ *  (summing to 1024 for a unity gain at bin center), m is at most 8 */
+int  fosphor_set_pfb(struct fosphor *self, int m, const float *taps);
+
 void fosphor_set_power_range(struct fosphor *self, int db_ref, int db_per_div);
+
+/* Automatic power range: the noise floor and peak level of the live
+ *  spectrum (and of the histogram when it's displayed, to account for
+ *  what happened between frames) are measured on the device at each
+ *  frame. After a frame,
+ *  fosphor_auto_range() returns 1 and updates db_ref / db_per_div (taken
+ *  among 1, 2, 5, 10, 20) when the current ones don't show the signal
+ *  comfortably anymore, 0 otherwise. Applying them is up to the caller */
+int  fosphor_set_auto_range(struct fosphor *self, int enable);
+int  fosphor_auto_range(struct fosphor *self, int *db_ref, int *db_per_div);
 void fosphor_set_frequency_range(struct fosphor *self,
                                  double center, double span);
 
+/* Zoom down-converter: a band of 1/decim of the input, around 'center'
+ * (normalized like channels), gets its own FFT, waterfall and histogram
+ * to be displayed by renders with FRO_DDC. The decimation is the largest
+ * power of 2 that keeps 'width' inside the band, it is returned (1 means
+ * disabled) so the render can select 'width' inside it. Its buffers are
+ * only allocated while enabled (GL context needs to be current) */
+int  fosphor_set_zoom(struct fosphor *self, int enable,
+                      double center, double width);
+
+
+/* Direct loading of processed data (bypasses the FFT)
+ *  Same units and order as exported data : dB, lowest frequency first */
+
+int  fosphor_load_waterfall(struct fosphor *self, int stream, int row,
+                            const float *db, int n_rows);
+int  fosphor_load_histogram(struct fosphor *self, int stream, int line,
+                            const float *density, int n_lines);
+int  fosphor_load_spectrum(struct fosphor *self, int stream,
+                           const float *live, const float *max_hold);
+void fosphor_set_waterfall_position(struct fosphor *self, int pos);
+
+
+/* Outputs */
+
+int  fosphor_set_shm_output(struct fosphor *self, const char *name);
+int  fosphor_set_net_output(struct fosphor *self, const char *endpoint,
+                            int bits, int histo);
+int  fosphor_set_rec_output(struct fosphor *self, const char *path,
+                            int bits, float db_min, float db_max);
+
+/* Long-term min / mean / max rollups (see rollup.h for the file format).
+ *  Levels are given by slot period (seconds) and number of slots kept,
+ *  NULL for the defaults (1 s for 1 h, 1 min for a week, 1 h for a year) */
+int  fosphor_set_rollup_output(struct fosphor *self, const char *path,
+                               const int *period_s, const int *n_slots,
+                               int n_levels);
+
+
+/* Peak detection (run on the device at each frame once enabled) */
+
+/*! \brief Detected peak */
+struct fosphor_peak
+{
+	double freq;		/*!< \brief Center frequency (interpolated) */
+	double bw;		/*!< \brief -3 dB bandwidth estimate */
+	float  pwr;		/*!< \brief Live spectrum power (dB) */
+	float  pwr_max;		/*!< \brief Max hold power (dB) */
+};
+
+int  fosphor_set_peaks(struct fosphor *self, int enable, float threshold_db);
+int  fosphor_get_peaks(struct fosphor *self, int stream,
+                       struct fosphor_peak *peaks, int max_peaks,
+                       float *noise_floor);
+
+
+/* Histogram percentiles (per bin, computed from the histogram at the next
+ *  frame after a request). Results are in dB, one per FFT bin (1024),
+ *  lowest frequency first. Get returns -EAGAIN while a request is pending */
+
+int  fosphor_set_percentiles(struct fosphor *self, int enable, float p_low);
+void fosphor_request_percentiles(struct fosphor *self);
+int  fosphor_get_percentiles(struct fosphor *self, int stream,
+                             float *low, float *p50, float *p90);
+
+
+/* Band power (integrated on the device for every spectrum, before the log)
+ *  Bands are normalized like channels, disabled ones are measured empty */
+
+/*! \brief Band power measurement (over the spectra since the last read) */
+struct fosphor_band_power
+{
+	float mean;		/*!< \brief Mean power (dB) */
+	float peak;		/*!< \brief Peak power (dB) */
+	float duty;		/*!< \brief Fraction of spectra above the threshold */
+};
+
+int  fosphor_set_bands(struct fosphor *self,
+                       const struct fosphor_channel *bands, int n_bands,
+                       float duty_threshold_db);
+int  fosphor_get_band_power(struct fosphor *self, int stream,
+                            struct fosphor_band_power *bp, int max_bands);
+
+/* Band trigger: fires on the first spectrum where a measured band goes
+ *  above 'threshold_db' (NAN to disable), checked on the device for every
+ *  spectrum. Spectra are counted per stream since init, FOSPHOR_FFT_LEN
+ *  input samples (or pairs) each. Get returns 1 with the earliest one
+ *  since the last read, 0 if it didn't fire */
+int  fosphor_set_band_trigger(struct fosphor *self, float threshold_db);
+int  fosphor_get_band_trigger(struct fosphor *self, uint64_t *spectrum,
+                              int *stream, int *band);
+
+
+/* Occupancy: fraction of the spectra above a threshold, per bin, counted
+ *  on the device for every spectrum and rolled over the last 'window'
+ *  spectra (in 16 steps, at most FOSPHOR_OCC_MAX_WINDOW so the counters
+ *  can't overflow, larger ones are clamped). One value per FFT bin (1024),
+ *  lowest frequency first. Get returns the number of spectra covered */
+
+#define FOSPHOR_OCC_MAX_WINDOW	(1 << 30)
+
+int  fosphor_set_occupancy(struct fosphor *self, int enable,
+                           float threshold_db, int window);
+int  fosphor_get_occupancy(struct fosphor *self, int stream, float *occ);
+
+
+/* Spectral kurtosis: power moments summed on the device for every spectrum
+ *  over each frame, giving per bin the SK estimator (about 1 for noise,
+ *  below for steady carriers, above for impulsive / pulsed signals) and
+ *  the standard deviation of the power (dB). One value per FFT bin (1024),
+ *  lowest frequency first, either can be NULL. Get returns the number of
+ *  spectra behind the estimate (0 until the first frame) */
+
+int  fosphor_set_kurtosis(struct fosphor *self, int enable);
+int  fosphor_get_kurtosis(struct fosphor *self, int stream, float *sk, float *std_db);
+
+
+/* Cross-spectrum of the first two streams, exponentially averaged on the
+ *  device over every spectrum ('alpha' per spectrum, <= 0 for the same as
+ *  the live trace). One value per FFT bin (1024), lowest frequency first :
+ *  coherence in [0,1], phase of stream 0 relative to stream 1 in radians
+ *  and cross power in dB. Any output can be NULL. Get returns 0 until the
+ *  first results are in */
+
+int  fosphor_set_cross_spectrum(struct fosphor *self, int enable, float alpha);
+int  fosphor_get_cross_spectrum(struct fosphor *self,
+                                float *coherence, float *phase, float *cross_db);
+
+
+/* Limit mask compliance (every spectrum is checked on the device)
+ *  The mask is piecewise linear between points normalized like channels
+ *  and flat beyond the end ones, levels in dB on the same scale as the
+ *  power range. A single point gives a flat limit, none disables it.
+ *  Violations are runs of adjacent bins above the mask during the last
+ *  frame, lowest frequency first */
+
+/*! \brief Mask violation (over the spectra of the last frame) */
+struct fosphor_mask_violation
+{
+	double freq;		/*!< \brief Frequency of the largest excess */
+	double bw;		/*!< \brief Width of the run of bins above the mask */
+	float  margin;		/*!< \brief Largest excess above the mask (dB) */
+	int    count;		/*!< \brief Spectra above the mask (max over the run) */
+};
+
+int  fosphor_set_mask(struct fosphor *self,
+                      const float *pos, const float *level_db, int n_points);
+int  fosphor_get_mask_violations(struct fosphor *self, int stream,
+                                 struct fosphor_mask_violation *v, int max_viol);
+
+
+/* Remote display (receiving end of fosphor_set_net_output) */
+
+struct fosphor_net_rx;
+
+/*! \brief Parameters announced by the remote fosphor */
+struct fosphor_net_info
+{
+	int    n_streams;	/*!< \brief Number of streams */
+	int    db_ref;		/*!< \brief Power reference level */
+	int    db_per_div;	/*!< \brief Power scale */
+	double freq_center;	/*!< \brief Center frequency */
+	double freq_span;	/*!< \brief Frequency span */
+};
+
+struct fosphor_net_rx *fosphor_net_rx_open(const char *endpoint);
+void fosphor_net_rx_close(struct fosphor_net_rx *rx);
+const struct fosphor_net_info *
+     fosphor_net_rx_wait_info(struct fosphor_net_rx *rx, int timeout_ms);
+int  fosphor_net_rx_poll(struct fosphor_net_rx *rx, struct fosphor *self);
+
 
 /* Render */
 
@@ -57,6 +277,24 @@ struct fosphor_channel
 #define FRO_LABEL_TIME	(1<<6)	/*!< \brief Display time labels */
 #define FRO_CHANNELS	(1<<7)	/*!< \brief Display channels */
 #define FRO_COLOR_SCALE	(1<<8)	/*!< \brief Display intensity color scale */
+#define FRO_DDC		(1<<9)	/*!< \brief Display the zoom down-converter output */
+#define FRO_BAND_POWER	(1<<10)	/*!< \brief Display band power readouts */
+#define FRO_NOISE_FLOOR	(1<<11)	/*!< \brief Display noise floor (low percentile) */
+#define FRO_MASK	(1<<12)	/*!< \brief Display limit mask and violations */
+#define FRO_OCCUPANCY	(1<<13)	/*!< \brief Display occupancy heat strip */
+#define FRO_CROSS_SPEC	(1<<14)	/*!< \brief Display phase waterfall and coherence */
+#define FRO_KURTOSIS	(1<<15)	/*!< \brief Display spectral kurtosis trace */
+#define FRO_KURTOSIS_WF	(1<<16)	/*!< \brief Display spectral kurtosis waterfall */
+
+/*! \brief Max number of pre-built overlay vertices (see fosphor_render) */
+#define FOSPHOR_RENDER_MAX_VTX	(6 + 2 * 22 + 12 * (2 * FOSPHOR_MAX_CHANNELS + 1))
+
+/*! \brief (private) Pre-built overlay vertex */
+struct fosphor_render_vtx
+{
+	float x, y;		/*!< \brief Screen position */
+	float rgba[4];		/*!< \brief Color */
+};
 
 /*! \brief fosphor render options */
 struct fosphor_render
@@ -67,6 +305,7 @@ struct fosphor_render
 	int   width;		/*!< \brief Width  */
 	int   height;		/*!< \brief Height */
 	int   options;		/*!< \brief Options (See FRO_??? constants) */
+	int   stream;		/*!< \brief Input stream to display */
 	float histo_wf_ratio;	/*!< \brief Ratio histogram/waterfall ]0,1[ */
 	int   freq_n_div;	/*!< \brief Number of frequency divisions */
 	float freq_center;	/*!< \brief Frequency zoom center ]0,1[ */
@@ -87,6 +326,14 @@ struct fosphor_render
 	float _y_histo[2];	/*!< \brief (private) Y histogram endpoints */
 	float _y_wf[2];		/*!< \brief (private) Y waterfall endpoints */
 	float _y_label;		/*!< \brief (private) Y location for label */
+
+	unsigned int _gen;	/*!< \brief (private) Overlay geometry generation */
+	int   _n_bg;		/*!< \brief (private) # background vertices */
+	int   _n_grid;		/*!< \brief (private) # grid lines vertices */
+	int   _n_chan;		/*!< \brief (private) # channels vertices */
+
+		/*! \brief (private) Overlay geometry (background, grid, channels) */
+	struct fosphor_render_vtx _vtx[FOSPHOR_RENDER_MAX_VTX];
 };
 
 void fosphor_render_defaults(struct fosphor_render *render);
@@ -95,6 +342,9 @@ void fosphor_render_refresh(struct fosphor_render *render);
 
 /* Position Mapping */
 
+void   fosphor_render_freq_range(struct fosphor *self, const struct fosphor_render *render,
+                                 double *center, double *span);
+
 double fosphor_pos2freq(struct fosphor *self, struct fosphor_render *render, int x);
 float  fosphor_pos2pwr (struct fosphor *self, struct fosphor_render *render, int y);
 int    fosphor_pos2samp(struct fosphor *self, struct fosphor_render *render, int y);
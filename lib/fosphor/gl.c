@@ -17,6 +17,7 @@
 
 #include <errno.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -33,20 +34,96 @@
 #include "resource.h"
 
 
+#define GL_ATTR_POS	0
+#define GL_ATTR_COLOR	1
+
+#define GL_VIEW_SLOTS		16
+#define GL_LABEL_MAX_CHARS	(22 * 32)
+#define GL_SK_RANGE		4.0f	/* Spectral kurtosis full scale */
+
+struct gl_plot_shader
+{
+	int loaded;
+
+	GLuint prog;
+	GLuint vs;
+	GLuint fs;
+
+	GLint u_xform;
+};
+
+struct gl_tex_vtx
+{
+	float x, y;
+	float u, v;
+};
+
 struct fosphor_gl_state
 {
 	int init_complete;
+	GLint tex_fmt;
 
 	struct gl_font *font;
 
 	struct fosphor_gl_cmap_ctx *cmap_ctx;
 	GLuint cmap_waterfall;
 	GLuint cmap_histogram;
+	GLuint cmap_phase;
 
 	GLuint tex_waterfall;
+	GLuint tex_waterfall_red;
 	GLuint tex_histogram;
 
 	GLuint vbo_spectrum;
+
+	GLuint tex_zoom_waterfall;	/* Only while the zoom is enabled */
+	GLuint tex_zoom_histogram;
+	GLuint vbo_zoom_spectrum;
+
+	GLuint vbo_noise_floor;	/* Low percentile trace, per stream */
+	unsigned int nf_seq;	/* Percentiles sequence it was built from */
+
+	GLuint vbo_mask;	/* Limit mask trace (shared by all streams) */
+	GLuint vbo_mask_hl;	/* Violations, one line per bin and stream */
+	unsigned int mask_gen;	/* Mask generation the VBOs were built from */
+	unsigned int mask_seq;	/* Violations readback they were built from */
+
+	GLuint tex_occupancy;	/* FFT_LEN * n_streams, FFT order */
+	unsigned int occ_seq;	/* Occupancy generation it holds */
+
+	GLuint tex_xs_phase;	/* FFT_LEN * XS_WF_LEN, FFT order */
+	GLuint vbo_xs_coh;	/* Coherence trace */
+	unsigned int xs_seq;	/* Cross-spectrum generation they hold */
+
+	GLuint tex_sk_wf;	/* FFT_LEN * SK_WF_LEN, one slice per stream */
+	GLuint vbo_sk;		/* Kurtosis trace, per stream */
+	unsigned int sk_seq;	/* Kurtosis generation they hold */
+
+	struct gl_plot_shader plot;
+	GLuint vbo_tex;		/* Textured quads, streamed at each draw */
+
+	/* Per view cache (one per render we've seen). The overlay geometry
+	 * is only re-uploaded when fosphor_render_refresh() built a new
+	 * generation, the labels when something they depend on changed */
+	struct gl_view {
+		const struct fosphor_render *render;
+
+		unsigned int overlay_gen;
+		GLuint overlay_vbo;
+
+		struct {
+			unsigned int gen;
+			double view_center;
+			double view_span;
+			int db_ref;
+			int db_per_div;
+		} label_key;
+		GLuint label_vbo;
+		int label_n;
+	} views[GL_VIEW_SLOTS];
+	int views_next;
+
+	float *label_buf;	/* Scratch for label layout */
 };
 
 
@@ -113,6 +190,36 @@ gl_tex2d_write(GLuint tex_id, float *src, int width, int height)
 	);
 }
 
+static void
+gl_tex2d_write_rows(GLuint tex_id, float *src, int width, int height,
+                    int n_streams, int rows, int pos)
+{
+	int i, j, row, n;
+
+	/* 'rows' rows of each stream (stacked 'height' rows apart), the last
+	 * one just before 'pos', in (at most) two chunks per stream */
+	glBindTexture(GL_TEXTURE_2D, tex_id);
+
+	for (i=0; i<n_streams; i++)
+	{
+		row = (pos - rows + height) % height;
+
+		for (j=rows; j>0; j-=n)
+		{
+			n = (row + j > height) ? (height - row) : j;
+
+			glTexSubImage2D(
+				GL_TEXTURE_2D, 0,
+				0, i * height + row, width, n,
+				GL_RED, GL_FLOAT,
+				src + (i * height + row) * width
+			);
+
+			row = (row + n) % height;
+		}
+	}
+}
+
 #if 0
 static void
 gl_vbo_clear(GLuint vbo_id, int size)
@@ -168,6 +275,488 @@ gl_vbo_write(GLuint vbo_id, void *src, int size)
 #endif
 }
 
+static GLuint
+gl_shader_compile(GLenum type, const char *name)
+{
+	const char *shader_src;
+	GLuint shader;
+	GLint buf_len, orv;
+
+	/* Load shader sources */
+	shader_src = resource_get(name, NULL);
+	if (!shader_src)
+		return 0;
+
+	/* Compile */
+	shader = glCreateShader(type);
+
+	glShaderSource(shader, 1, (const char **)&shader_src, NULL);
+	glCompileShader(shader);
+
+	/* Check success and compile log */
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &orv);
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &buf_len);
+
+	if ((buf_len > 0) && (orv != GL_TRUE))
+	{
+		char *buf = malloc(buf_len+1);
+
+		glGetShaderInfoLog(shader, buf_len, 0, buf);
+		buf[buf_len] = '\0';
+
+		fprintf(stderr, "[!] gl shader compile log :\n%s\n", buf);
+
+		free(buf);
+	}
+
+	if (orv != GL_TRUE) {
+		fprintf(stderr, "[!] gl shader compilation failed (%s)\n", name);
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+static int
+gl_plot_init(struct gl_plot_shader *plot)
+{
+	GLint orv;
+
+	/* Compile both parts */
+	plot->vs = gl_shader_compile(GL_VERTEX_SHADER,   "plot_vertex.glsl");
+	plot->fs = gl_shader_compile(GL_FRAGMENT_SHADER, "plot_fragment.glsl");
+
+	if (!plot->vs || !plot->fs)
+		goto error;
+
+	/* Link with fixed attribute locations */
+	plot->prog = glCreateProgram();
+
+	glAttachShader(plot->prog, plot->vs);
+	glAttachShader(plot->prog, plot->fs);
+
+	glBindAttribLocation(plot->prog, GL_ATTR_POS,   "pos");
+	glBindAttribLocation(plot->prog, GL_ATTR_COLOR, "color");
+
+	glLinkProgram(plot->prog);
+
+	glGetProgramiv(plot->prog, GL_LINK_STATUS, &orv);
+	if (orv != GL_TRUE) {
+		fprintf(stderr, "[!] gl plot shader link failed\n");
+		goto error;
+	}
+
+	/* Grab the uniform locations */
+	plot->u_xform = glGetUniformLocation(plot->prog, "xform");
+
+	/* Success */
+	plot->loaded = 1;
+
+	return 0;
+
+error:
+	if (plot->prog)
+		glDeleteProgram(plot->prog);
+	if (plot->vs)
+		glDeleteShader(plot->vs);
+	if (plot->fs)
+		glDeleteShader(plot->fs);
+
+	memset(plot, 0x00, sizeof(struct gl_plot_shader));
+
+	return -EINVAL;
+}
+
+static void
+gl_plot_release(struct gl_plot_shader *plot)
+{
+	if (!plot->loaded)
+		return;
+
+	glDetachShader(plot->prog, plot->vs);
+	glDetachShader(plot->prog, plot->fs);
+	glDeleteShader(plot->vs);
+	glDeleteShader(plot->fs);
+	glDeleteProgram(plot->prog);
+
+	memset(plot, 0x00, sizeof(struct gl_plot_shader));
+}
+
+static void
+gl_plot_enable(struct gl_plot_shader *plot, const float xform[4])
+{
+	glUseProgram(plot->prog);
+	glUniform4fv(plot->u_xform, 1, xform);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+static void
+gl_plot_disable(void)
+{
+	glDisableVertexAttribArray(GL_ATTR_COLOR);
+	glDisableVertexAttribArray(GL_ATTR_POS);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glDisable(GL_BLEND);
+
+	glUseProgram(0);
+}
+
+static struct gl_view *
+gl_view_get(struct fosphor_gl_state *gl, const struct fosphor_render *render)
+{
+	struct gl_view *view;
+	int i;
+
+	/* Find the slot of that render, or recycle the oldest one */
+	for (i=0; i<GL_VIEW_SLOTS; i++)
+		if (gl->views[i].render == render)
+			return &gl->views[i];
+
+	i = gl->views_next;
+	gl->views_next = (i + 1) % GL_VIEW_SLOTS;
+
+	view = &gl->views[i];
+	view->render = render;
+	view->overlay_gen = 0;
+	view->label_key.gen = 0;
+
+	return view;
+}
+
+static void
+gl_overlay_bind(struct gl_view *view, const struct fosphor_render *render)
+{
+	if (!view->overlay_vbo)
+		glGenBuffers(1, &view->overlay_vbo);
+
+	glBindBuffer(GL_ARRAY_BUFFER, view->overlay_vbo);
+
+	/* Upload if the geometry changed */
+	if (view->overlay_gen != render->_gen)
+	{
+		int n = render->_n_bg + render->_n_grid + render->_n_chan;
+
+		glBufferData(GL_ARRAY_BUFFER,
+			n * sizeof(struct fosphor_render_vtx), render->_vtx,
+			GL_STATIC_DRAW);
+
+		view->overlay_gen = render->_gen;
+	}
+
+	/* Vertex attributes */
+	glVertexAttribPointer(GL_ATTR_POS, 2, GL_FLOAT, GL_FALSE,
+		sizeof(struct fosphor_render_vtx),
+		(void*)offsetof(struct fosphor_render_vtx, x));
+	glVertexAttribPointer(GL_ATTR_COLOR, 4, GL_FLOAT, GL_FALSE,
+		sizeof(struct fosphor_render_vtx),
+		(void*)offsetof(struct fosphor_render_vtx, rgba));
+
+	glEnableVertexAttribArray(GL_ATTR_POS);
+	glEnableVertexAttribArray(GL_ATTR_COLOR);
+}
+
+static int
+gl_label_add(struct fosphor_gl_state *gl, int n,
+             float x, enum glf_align x_align,
+             float y, enum glf_align y_align,
+             const char *str)
+{
+	/* Safety, shouldn't happen with sane axis */
+	if ((n / 4) + strlen(str) > GL_LABEL_MAX_CHARS)
+		return n;
+
+	return n + glf_layout_str(gl->font, &gl->label_buf[8 * n],
+		x, x_align, y, y_align, str);
+}
+
+static void
+gl_noise_floor_update(struct fosphor *self)
+{
+	struct fosphor_gl_state *gl = self->gl;
+	const float *src = self->pct.buf;
+	float *ptr;
+	int i, n;
+
+	/* Expects the noise floor VBO to be bound. The percentiles are
+	 * already in display order and in the same units as the spectrum */
+	ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	if (!ptr)
+		return;
+
+	n = self->n_streams * FOSPHOR_FFT_LEN;
+
+	for (i=0; i<n; i++, src+=4) {
+		*ptr++ = (float)((i % FOSPHOR_FFT_LEN) - (FOSPHOR_FFT_LEN >> 1)) / (float)(FOSPHOR_FFT_LEN >> 1);
+		*ptr++ = src[0];
+	}
+
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+
+	gl->nf_seq = self->pct.seq;
+}
+
+static void
+gl_xs_update(struct fosphor *self)
+{
+	struct fosphor_gl_state *gl = self->gl;
+	const float *src = self->xs.raw;
+	float *ptr;
+	int i;
+
+	if (gl->xs_seq == self->xs.seq)
+		return;
+
+	/* Phase waterfall, whole ring (rows are in FFT order like the main one) */
+	gl_tex2d_write(gl->tex_xs_phase, self->xs.phase_wf, FOSPHOR_FFT_LEN, FOSPHOR_XS_WF_LEN);
+
+	/* Coherence trace, display order */
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_xs_coh);
+
+	ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	if (ptr) {
+		for (i=0; i<FOSPHOR_FFT_LEN; i++) {
+			*ptr++ = (float)(i - (FOSPHOR_FFT_LEN >> 1)) / (float)(FOSPHOR_FFT_LEN >> 1);
+			*ptr++ = src[4 * (i ^ (FOSPHOR_FFT_LEN >> 1))];
+		}
+
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	gl->xs_seq = self->xs.seq;
+}
+
+static void
+gl_sk_update(struct fosphor *self)
+{
+	struct fosphor_gl_state *gl = self->gl;
+	const float *src = self->sk.cur;
+	float *ptr;
+	int i, n;
+
+	if (gl->sk_seq == self->sk.seq)
+		return;
+
+	/* Waterfall, all slices */
+	gl_tex2d_write(gl->tex_sk_wf, self->sk.wf, FOSPHOR_FFT_LEN, FOSPHOR_SK_WF_LEN * self->n_streams);
+
+	/* Traces, display order (bins without estimate at 0) */
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_sk);
+
+	ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	if (ptr) {
+		n = self->n_streams * FOSPHOR_FFT_LEN;
+
+		for (i=0; i<n; i++) {
+			int j = (i & ~(FOSPHOR_FFT_LEN - 1)) | ((i ^ (FOSPHOR_FFT_LEN >> 1)) & (FOSPHOR_FFT_LEN - 1));
+			float v = src[2*j];
+
+			*ptr++ = (float)((i % FOSPHOR_FFT_LEN) - (FOSPHOR_FFT_LEN >> 1)) / (float)(FOSPHOR_FFT_LEN >> 1);
+			*ptr++ = isnan(v) ? 0.0f : v;
+		}
+
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	gl->sk_seq = self->sk.seq;
+}
+
+static void
+gl_mask_update(struct fosphor *self)
+{
+	struct fosphor_gl_state *gl = self->gl;
+	const float k = log10f((float)FOSPHOR_FFT_LEN);
+	const int half = FOSPHOR_FFT_LEN >> 1;
+	float *ptr;
+	int s, i;
+
+	/* Trace, when the mask changed */
+	if (gl->mask_gen != self->mask.gen)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_mask);
+
+		ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+		if (!ptr)
+			return;
+
+		for (i=0; i<FOSPHOR_FFT_LEN; i++) {
+			*ptr++ = (float)(i - half) / (float)half;
+			*ptr++ = k + self->mask.level[i] / 20.0f;
+		}
+
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+
+		gl->mask_gen = self->mask.gen;
+		gl->mask_seq = 0;
+	}
+
+	/* Violations, when new ones were read back. Each bin gets a line
+	 * from the mask up to its largest excess, degenerate if none */
+	if (self->mask.seq && (gl->mask_seq != self->mask.seq))
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_mask_hl);
+
+		ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+		if (!ptr)
+			return;
+
+		for (s=0; s<self->n_streams; s++)
+		{
+			const float *r = &self->mask.viol[s * 2 * FOSPHOR_FFT_LEN];
+
+			for (i=0; i<FOSPHOR_FFT_LEN; i++) {
+				float x = (float)(i - half) / (float)half;
+				float y = k + self->mask.level[i] / 20.0f;
+				int b = i ^ half;
+
+				*ptr++ = x;
+				*ptr++ = y;
+				*ptr++ = x;
+				*ptr++ = y + ((r[2*b] > 0.0f) ? r[2*b+1] : 0.0f);
+			}
+		}
+
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+
+		gl->mask_seq = self->mask.seq;
+	}
+}
+
+static void
+gl_labels_update(struct fosphor *self, struct gl_view *view,
+                 const struct fosphor_render *render)
+{
+	struct fosphor_gl_state *gl = self->gl;
+	struct freq_axis freq_axis;
+	double view_center, view_span;
+	float xv_ofs_total;
+	char buf[32];
+	int i, n;
+
+	/* What's the view ? */
+	fosphor_render_freq_range(self, render,
+	                          &view_center, &view_span);
+
+	/* Anything changed ? */
+	if ((view->label_key.gen         == render->_gen) &&
+	    (view->label_key.view_center == view_center) &&
+	    (view->label_key.view_span   == view_span) &&
+	    (view->label_key.db_ref      == self->power.db_ref) &&
+	    (view->label_key.db_per_div  == self->power.db_per_div))
+		return;
+
+	view->label_key.gen         = render->_gen;
+	view->label_key.view_center = view_center;
+	view->label_key.view_span   = view_span;
+	view->label_key.db_ref      = self->power.db_ref;
+	view->label_key.db_per_div  = self->power.db_per_div;
+
+	/* Layout all the labels */
+	n = 0;
+
+	if (render->options & FRO_LABEL_PWR)
+	{
+		for (i=0; i<11; i++)
+		{
+			snprintf(buf, sizeof(buf), "%d",
+				self->power.db_ref - (10-i) * self->power.db_per_div);
+
+			n = gl_label_add(gl, n,
+				render->_x_label, GLF_RIGHT,
+				render->_y_histo[0] + i * render->_y_histo_div, GLF_CENTER,
+				buf
+			);
+		}
+	}
+
+	if (render->options & FRO_LABEL_FREQ)
+	{
+		freq_axis_build(&freq_axis, view_center, view_span, render->freq_n_div);
+
+		freq_axis_render(&freq_axis, buf,  (render->freq_n_div / 2));
+		xv_ofs_total  = glf_width_str(gl->font, buf);
+		freq_axis_render(&freq_axis, buf, -(render->freq_n_div / 2));
+		xv_ofs_total += glf_width_str(gl->font, buf);
+		xv_ofs_total /= 2.0f;
+
+		for (i=0; i<=render->freq_n_div; i++)
+		{
+			int ib = i - (render->freq_n_div / 2);
+			float xv, xv_ofs;
+
+			xv = render->_x[0] + i * render->_x_div;
+
+			freq_axis_render(&freq_axis, buf, ib);
+
+			xv_ofs = floor((- xv_ofs_total * ib) / render->freq_n_div);
+
+			n = gl_label_add(gl, n,
+				xv + xv_ofs, GLF_CENTER,
+				render->_y_label, GLF_CENTER,
+				buf
+			);
+		}
+	}
+
+	/* Upload */
+	if (!view->label_vbo)
+		glGenBuffers(1, &view->label_vbo);
+
+	glBindBuffer(GL_ARRAY_BUFFER, view->label_vbo);
+	glBufferData(GL_ARRAY_BUFFER, n * 8 * sizeof(float), gl->label_buf, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	view->label_n = n;
+}
+
+static int
+gl_tex_quad(struct gl_tex_vtx *vtx, float x[2], float y[2], float u[2], float v[2])
+{
+	static const int idx[6][2] = { {0,0}, {1,0}, {1,1}, {0,0}, {1,1}, {0,1} };
+	int i;
+
+	for (i=0; i<6; i++) {
+		vtx[i].x = x[idx[i][0]];
+		vtx[i].y = y[idx[i][1]];
+		vtx[i].u = u[idx[i][0]];
+		vtx[i].v = v[idx[i][1]];
+	}
+
+	return 6;
+}
+
+static void
+gl_tex_draw(struct fosphor_gl_state *gl, struct gl_tex_vtx *vtx, int n)
+{
+	/* The color map programs only have a fragment stage, so feed the
+	 * fixed vertex attributes, but from a buffer object */
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_tex);
+	glBufferData(GL_ARRAY_BUFFER, n * sizeof(struct gl_tex_vtx), vtx, GL_STREAM_DRAW);
+
+	glVertexPointer(2, GL_FLOAT, sizeof(struct gl_tex_vtx),
+		(void*)offsetof(struct gl_tex_vtx, x));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(struct gl_tex_vtx),
+		(void*)offsetof(struct gl_tex_vtx, u));
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	glDrawArrays(GL_TRIANGLES, 0, n);
+
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 static void
 gl_deferred_init(struct fosphor *self)
 {
@@ -186,7 +775,9 @@ gl_deferred_init(struct fosphor *self)
 		GL_R32F :
 		GL_LUMINANCE32F_ARB;
 
-	/* Waterfall texture (FFT_LEN * 1024) */
+	gl->tex_fmt = tex_fmt;
+
+	/* Waterfall texture (FFT_LEN * 1024, one slice per stream) */
 	glGenTextures(1, &gl->tex_waterfall);
 
 	glBindTexture(GL_TEXTURE_2D, gl->tex_waterfall);
@@ -196,27 +787,117 @@ gl_deferred_init(struct fosphor *self)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, tex_fmt, FOSPHOR_FFT_LEN, 1024, 0, GL_RED, GL_FLOAT, NULL);
+	glTexImage2D(GL_TEXTURE_2D, 0, tex_fmt, FOSPHOR_FFT_LEN, 1024 * self->n_streams, 0, GL_RED, GL_FLOAT, NULL);
+
+	/* Reduced waterfall texture (same size, levels side by side) */
+	glGenTextures(1, &gl->tex_waterfall_red);
+
+	glBindTexture(GL_TEXTURE_2D, gl->tex_waterfall_red);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, tex_fmt, FOSPHOR_FFT_LEN, 1024 * self->n_streams, 0, GL_RED, GL_FLOAT, NULL);
+
+	/* Histogram texture (FFT_LEN * 128, one slice per stream) */
+	glGenTextures(1, &gl->tex_histogram);
+
+	glBindTexture(GL_TEXTURE_2D, gl->tex_histogram);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, tex_fmt, FOSPHOR_FFT_LEN, 128 * self->n_streams, 0, GL_RED, GL_FLOAT, NULL);
+
+	/* Occupancy texture (FFT_LEN * 1, one line per stream) */
+	glGenTextures(1, &gl->tex_occupancy);
+
+	glBindTexture(GL_TEXTURE_2D, gl->tex_occupancy);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, tex_fmt, FOSPHOR_FFT_LEN, self->n_streams, 0, GL_RED, GL_FLOAT, NULL);
+
+	/* Cross-spectrum phase waterfall (FFT_LEN * XS_WF_LEN). Phase can't
+	 * be interpolated across the -pi / pi wrap, hence nearest */
+	glGenTextures(1, &gl->tex_xs_phase);
+
+	glBindTexture(GL_TEXTURE_2D, gl->tex_xs_phase);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, tex_fmt, FOSPHOR_FFT_LEN, FOSPHOR_XS_WF_LEN, 0, GL_RED, GL_FLOAT, NULL);
+
+	/* Spectral kurtosis waterfall (FFT_LEN * SK_WF_LEN, one slice per stream) */
+	glGenTextures(1, &gl->tex_sk_wf);
+
+	glBindTexture(GL_TEXTURE_2D, gl->tex_sk_wf);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, tex_fmt, FOSPHOR_FFT_LEN, FOSPHOR_SK_WF_LEN * self->n_streams, 0, GL_RED, GL_FLOAT, NULL);
+
+	/* Spectrum VBO (2 * FFT_LEN per stream, half for live, half for 'hold') */
+	glGenBuffers(1, &gl->vbo_spectrum);
+
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_spectrum);
+
+	len = self->n_streams * 2 * sizeof(float) * 2 * FOSPHOR_FFT_LEN;
+	glBufferData(GL_ARRAY_BUFFER, len, NULL, GL_DYNAMIC_DRAW);
+
+	/* (the zoom down-converter output is only created when enabled,
+	 *  see fosphor_gl_zoom_alloc) */
+
+	/* Noise floor VBO (FFT_LEN per stream, filled from the percentiles) */
+	glGenBuffers(1, &gl->vbo_noise_floor);
+
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_noise_floor);
+
+	glBufferData(GL_ARRAY_BUFFER, len / 2, NULL, GL_DYNAMIC_DRAW);
+
+	/* Limit mask VBOs (FFT_LEN for the trace, 2 * FFT_LEN per stream for
+	 * the violations, same layout as the spectrum) */
+	glGenBuffers(1, &gl->vbo_mask);
+
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_mask);
+
+	glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(float) * FOSPHOR_FFT_LEN, NULL, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &gl->vbo_mask_hl);
 
-	/* Histogram texture (FFT_LEN * 128) */
-	glGenTextures(1, &gl->tex_histogram);
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_mask_hl);
 
-	glBindTexture(GL_TEXTURE_2D, gl->tex_histogram);
+	glBufferData(GL_ARRAY_BUFFER, len, NULL, GL_DYNAMIC_DRAW);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	/* Coherence VBO (FFT_LEN, filled from the cross-spectrum results) */
+	glGenBuffers(1, &gl->vbo_xs_coh);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, tex_fmt, FOSPHOR_FFT_LEN, 128, 0, GL_RED, GL_FLOAT, NULL);
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_xs_coh);
 
-	/* Spectrum VBO (2 * FFT_LEN, half for live, half for 'hold') */
-	glGenBuffers(1, &gl->vbo_spectrum);
+	glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(float) * FOSPHOR_FFT_LEN, NULL, GL_DYNAMIC_DRAW);
 
-	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_spectrum);
+	/* Kurtosis VBO (FFT_LEN per stream, filled from the estimates) */
+	glGenBuffers(1, &gl->vbo_sk);
 
-	len = 2 * sizeof(float) * 2 * FOSPHOR_FFT_LEN;
-	glBufferData(GL_ARRAY_BUFFER, len, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_sk);
+
+	glBufferData(GL_ARRAY_BUFFER, len / 2, NULL, GL_DYNAMIC_DRAW);
+
+	/* Textured quads VBO (content streamed at each draw) */
+	glGenBuffers(1, &gl->vbo_tex);
 }
 
 
@@ -266,10 +947,26 @@ fosphor_gl_init(struct fosphor *self)
 	                               fosphor_gl_cmap_waterfall, NULL, 256);
 	rv |= fosphor_gl_cmap_generate(&gl->cmap_histogram,
 	                               fosphor_gl_cmap_histogram, NULL, 256);
+	rv |= fosphor_gl_cmap_generate(&gl->cmap_phase,
+	                               fosphor_gl_cmap_phase, NULL, 256);
 
 	if (rv)
 		goto error;
 
+	/* Labels layout scratch */
+	gl->label_buf = malloc(GL_LABEL_MAX_CHARS * 4 * 8 * sizeof(float));
+	if (!gl->label_buf) {
+		rv = -ENOMEM;
+		goto error;
+	}
+
+	/* Plot program (traces, grid, overlays) */
+	rv = gl_plot_init(&gl->plot);
+	if (rv) {
+		fprintf(stderr, "[!] Plot shader failed to load, aborting\n");
+		goto error;
+	}
+
 	/* Done */
 	return 0;
 
@@ -283,17 +980,42 @@ void
 fosphor_gl_release(struct fosphor *self)
 {
 	struct fosphor_gl_state *gl = self->gl;
+	int i;
 
 	/* Safety */
 	if (!gl)
 		return;
 
 	/* Release all */
+	for (i=0; i<GL_VIEW_SLOTS; i++) {
+		if (gl->views[i].overlay_vbo)
+			glDeleteBuffers(1, &gl->views[i].overlay_vbo);
+		if (gl->views[i].label_vbo)
+			glDeleteBuffers(1, &gl->views[i].label_vbo);
+	}
+
+	free(gl->label_buf);
+
+	gl_plot_release(&gl->plot);
+
+	glDeleteBuffers(1, &gl->vbo_tex);
 	glDeleteBuffers(1, &gl->vbo_spectrum);
+	glDeleteBuffers(1, &gl->vbo_noise_floor);
+	glDeleteBuffers(1, &gl->vbo_mask);
+	glDeleteBuffers(1, &gl->vbo_mask_hl);
+	glDeleteBuffers(1, &gl->vbo_xs_coh);
+	glDeleteBuffers(1, &gl->vbo_sk);
 
+	fosphor_gl_zoom_release(self);
+
+	glDeleteTextures(1, &gl->tex_sk_wf);
+	glDeleteTextures(1, &gl->tex_xs_phase);
+	glDeleteTextures(1, &gl->tex_occupancy);
 	glDeleteTextures(1, &gl->tex_histogram);
+	glDeleteTextures(1, &gl->tex_waterfall_red);
 	glDeleteTextures(1, &gl->tex_waterfall);
 
+	glDeleteTextures(1, &gl->cmap_phase);
 	glDeleteTextures(1, &gl->cmap_histogram);
 	glDeleteTextures(1, &gl->cmap_waterfall);
 	fosphor_gl_cmap_release(gl->cmap_ctx);
@@ -308,6 +1030,71 @@ fosphor_gl_release(struct fosphor *self)
 }
 
 
+int
+fosphor_gl_zoom_alloc(struct fosphor *self)
+{
+	struct fosphor_gl_state *gl = self->gl;
+	int len;
+
+	gl_deferred_init(self);
+
+	/* Already there ? */
+	if (gl->tex_zoom_waterfall)
+		return 0;
+
+	/* Zoom down-converter output (same layout as the main ones) */
+	glGenTextures(1, &gl->tex_zoom_waterfall);
+
+	glBindTexture(GL_TEXTURE_2D, gl->tex_zoom_waterfall);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, gl->tex_fmt, FOSPHOR_FFT_LEN, 1024 * self->n_streams, 0, GL_RED, GL_FLOAT, NULL);
+
+	glGenTextures(1, &gl->tex_zoom_histogram);
+
+	glBindTexture(GL_TEXTURE_2D, gl->tex_zoom_histogram);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, gl->tex_fmt, FOSPHOR_FFT_LEN, 128 * self->n_streams, 0, GL_RED, GL_FLOAT, NULL);
+
+	glGenBuffers(1, &gl->vbo_zoom_spectrum);
+
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_zoom_spectrum);
+
+	len = self->n_streams * 2 * sizeof(float) * 2 * FOSPHOR_FFT_LEN;
+	glBufferData(GL_ARRAY_BUFFER, len, NULL, GL_DYNAMIC_DRAW);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return 0;
+}
+
+void
+fosphor_gl_zoom_release(struct fosphor *self)
+{
+	struct fosphor_gl_state *gl = self->gl;
+
+	if (!gl->tex_zoom_waterfall)
+		return;
+
+	glDeleteBuffers(1, &gl->vbo_zoom_spectrum);
+	glDeleteTextures(1, &gl->tex_zoom_histogram);
+	glDeleteTextures(1, &gl->tex_zoom_waterfall);
+
+	gl->vbo_zoom_spectrum  = 0;
+	gl->tex_zoom_histogram = 0;
+	gl->tex_zoom_waterfall = 0;
+}
+
+
 GLuint
 fosphor_gl_get_shared_id(struct fosphor *self,
                          enum fosphor_gl_id id)
@@ -323,11 +1110,23 @@ fosphor_gl_get_shared_id(struct fosphor *self,
 	case GL_ID_TEX_WATERFALL:
 		return gl->tex_waterfall;
 
+	case GL_ID_TEX_WATERFALL_RED:
+		return gl->tex_waterfall_red;
+
 	case GL_ID_TEX_HISTOGRAM:
 		return gl->tex_histogram;
 
 	case GL_ID_VBO_SPECTRUM:
 		return gl->vbo_spectrum;
+
+	case GL_ID_TEX_ZOOM_WATERFALL:
+		return gl->tex_zoom_waterfall;
+
+	case GL_ID_TEX_ZOOM_HISTOGRAM:
+		return gl->tex_zoom_histogram;
+
+	case GL_ID_VBO_ZOOM_SPECTRUM:
+		return gl->vbo_zoom_spectrum;
 	}
 
 	return 0;
@@ -344,24 +1143,68 @@ fosphor_gl_refresh(struct fosphor *self)
 
 	gl_deferred_init(self);
 
-	gl_tex2d_write(gl->tex_waterfall, self->img_waterfall, FOSPHOR_FFT_LEN, 1024);
-	gl_tex2d_write(gl->tex_histogram, self->img_histogram, FOSPHOR_FFT_LEN,  128);
-	gl_vbo_write(gl->vbo_spectrum, self->buf_spectrum, 2 * 2 * sizeof(float) * FOSPHOR_FFT_LEN);
+	gl_tex2d_write(gl->tex_waterfall, self->img_waterfall, FOSPHOR_FFT_LEN, 1024 * self->n_streams);
+	gl_tex2d_write(gl->tex_histogram, self->img_histogram, FOSPHOR_FFT_LEN,  128 * self->n_streams);
+	gl_vbo_write(gl->vbo_spectrum, self->buf_spectrum, self->n_streams * 2 * 2 * sizeof(float) * FOSPHOR_FFT_LEN);
+
+	if (self->zoom.decim > 1) {
+		gl_tex2d_write(gl->tex_zoom_waterfall, self->img_zoom_waterfall, FOSPHOR_FFT_LEN, 1024 * self->n_streams);
+		gl_tex2d_write(gl->tex_zoom_histogram, self->img_zoom_histogram, FOSPHOR_FFT_LEN,  128 * self->n_streams);
+		gl_vbo_write(gl->vbo_zoom_spectrum, self->buf_zoom_spectrum, self->n_streams * 2 * 2 * sizeof(float) * FOSPHOR_FFT_LEN);
+	}
+
+	/* Reduced levels only change while drawn, and only by a few rows */
+	if (self->wf_red.rows) {
+		gl_tex2d_write_rows(gl->tex_waterfall_red, self->img_waterfall_red,
+		                    FOSPHOR_FFT_LEN, 1024, self->n_streams,
+		                    self->wf_red.rows, self->wf_red.pos);
+		self->wf_red.rows = 0;
+	}
 }
 
 
 void
 fosphor_gl_draw(struct fosphor *self, struct fosphor_render *render)
 {
+	static const float xform_id[4] = { 1.0f, 0.0f, 1.0f, 0.0f };
 	struct fosphor_gl_state *gl = self->gl;
-	struct freq_axis freq_axis;
+	struct gl_view *view;
+	GLuint tex_wf, tex_histo, vbo_spectrum;
 	float x[2], y[2], u[2], v[2];
-	float tw;
-	int i;
+	float tw, sh, so;
+	int stream, ddc, xs, sk;
 
 	/* Utils */
 	tw = 1.0f / (float)(FOSPHOR_FFT_LEN);	/* Texel width */
 
+	stream = render->stream;
+	if ((stream < 0) || (stream >= self->n_streams))
+		stream = 0;
+
+	sh = 1.0f / (float)self->n_streams;	/* Stream slice height */
+	so = sh * (float)stream;		/* Stream slice offset */
+
+	view = gl_view_get(gl, render);	/* Cached geometry */
+
+	/* Source: main FFT or zoom down-converter output */
+	ddc = (render->options & FRO_DDC) && (self->zoom.decim > 1);
+
+	tex_wf       = ddc ? gl->tex_zoom_waterfall : gl->tex_waterfall;
+	tex_histo    = ddc ? gl->tex_zoom_histogram : gl->tex_histogram;
+	vbo_spectrum = ddc ? gl->vbo_zoom_spectrum  : gl->vbo_spectrum;
+
+	/* Cross-spectrum (computed on the main FFT) */
+	xs = (render->options & FRO_CROSS_SPEC) && self->xs.seq && !ddc;
+
+	if (xs)
+		gl_xs_update(self);
+
+	/* Spectral kurtosis (measured on the main FFT too) */
+	sk = (render->options & (FRO_KURTOSIS | FRO_KURTOSIS_WF)) && self->sk.seq && !ddc;
+
+	if (sk)
+		gl_sk_update(self);
+
 	/* Texture mapping notes:
 	 *
 	 *  - The texture have the "DC" bin at texel 0, however we want it to
@@ -382,11 +1225,45 @@ fosphor_gl_draw(struct fosphor *self, struct fosphor_render *render)
 	 *    inside the first displayed bin on each side)
 	 *  - Finally the zoom is applied and then the transform to map on the
 	 *    requested screen area
+	 *
+	 * Multi-stream notes:
+	 *
+	 *  - Each stream has its own horizontal slice of the waterfall and
+	 *    histogram textures and its own 2 * N vertices in the spectrum VBO
+	 *  - Since the waterfall can't rely on GL_REPEAT to wrap inside a
+	 *    slice, it's drawn as two quads when the visible span wraps
+	 *
+	 * Overlay notes:
+	 *
+	 *  - The background, grid lines and channels geometry only depends on
+	 *    the layout so it's built by fosphor_render_refresh() and kept in
+	 *    a VBO here until the next refresh
+	 *  - Labels are laid out in a VBO as well, redone only when the layout,
+	 *    the frequency view or the power range changes
+	 *
+	 * Reduced waterfall notes:
+	 *
+	 *  - When the view has less pixels than displayed bins, the max-reduced
+	 *    level with at most one texel per pixel is sampled (nearest) instead
+	 *    so that narrow carriers don't get skipped
+	 *  - Level l is 2^-l wide and starts at 1 - 2^(1-l) in the texture
+	 *  - Those levels are only computed (and without CL/GL sharing, read
+	 *    back and uploaded) for frames where a view samples them
+	 *  - The zoom down-converter output has no reduced levels, it's
+	 *    meant to be viewed with (close to) one bin per pixel anyway
+	 *  - The spectrum is drawn straight from the VBO filled by the display
+	 *    kernel and the whole mapping above is done by the plot vertex
+	 *    shader 'xform' uniform
+	 *  - The cross-spectrum phase and spectral kurtosis waterfalls have
+	 *    one row per frame and replace the power one, the same fraction
+	 *    of them is shown
 	 */
 
-        /* Draw waterfall */
-	if (render->options & FRO_WATERFALL)
+	/* Draw cross-spectrum phase waterfall */
+	if ((render->options & FRO_WATERFALL) && xs)
 	{
+		struct gl_tex_vtx vtx[6];
+
 		x[0] = render->_x[0];
 		x[1] = render->_x[1];
 
@@ -396,82 +1273,251 @@ fosphor_gl_draw(struct fosphor *self, struct fosphor_render *render)
 		u[0] = 0.5f + (tw / 2.0f) + render->freq_center - (render->freq_span / 2.0f);
 		u[1] = 0.5f + (tw / 2.0f) + render->freq_center + (render->freq_span / 2.0f);
 
-		v[1] = (float)render->_wf_pos / 1024.0f;
+		v[1] = (float)self->xs.wf_pos / (float)FOSPHOR_XS_WF_LEN;
 		v[0] = v[1] - render->wf_span;
 
+		/* [-pi,pi] to [0,1] */
 		fosphor_gl_cmap_enable(gl->cmap_ctx,
-		                       gl->tex_waterfall, gl->cmap_waterfall,
-		                       self->power.scale, self->power.offset,
-		                       GL_CMAP_MODE_BILINEAR);
+		                       gl->tex_xs_phase, gl->cmap_phase,
+		                       1.0f / (2.0f * M_PI), M_PI,
+		                       GL_CMAP_MODE_NEAREST);
 
-		glBegin( GL_QUADS );
-		glTexCoord2f(u[0], v[0]); glVertex2f(x[0], y[0]);
-		glTexCoord2f(u[1], v[0]); glVertex2f(x[1], y[0]);
-		glTexCoord2f(u[1], v[1]); glVertex2f(x[1], y[1]);
-		glTexCoord2f(u[0], v[1]); glVertex2f(x[0], y[1]);
-		glEnd();
+		gl_tex_draw(gl, vtx, gl_tex_quad(vtx, x, y, u, v));
 
 		fosphor_gl_cmap_disable();
 
 		if (render->options & FRO_COLOR_SCALE)
-			fosphor_gl_cmap_draw_scale(gl->cmap_waterfall,
+			fosphor_gl_cmap_draw_scale(gl->cmap_phase,
 						   x[1]+2.0f, x[1]+10.0f, y[0], y[1]);
 	}
 
-	/* Draw histogram */
-	if (render->options & FRO_HISTO)
+	/* Draw spectral kurtosis waterfall */
+	else if ((render->options & FRO_WATERFALL) && (render->options & FRO_KURTOSIS_WF) && sk)
 	{
+		struct gl_tex_vtx vtx[12];
+		float ym;
+		int n = 0;
+
 		x[0] = render->_x[0];
 		x[1] = render->_x[1];
 
-		y[0] = render->_y_histo[0];
-		y[1] = render->_y_histo[1];
+		y[0] = render->_y_wf[0];
+		y[1] = render->_y_wf[1];
 
 		u[0] = 0.5f + (tw / 2.0f) + render->freq_center - (render->freq_span / 2.0f);
 		u[1] = 0.5f + (tw / 2.0f) + render->freq_center + (render->freq_span / 2.0f);
 
-		v[0] = 0.0f;
-		v[1] = 1.0f;
+		v[1] = (float)self->sk.wf_pos / (float)FOSPHOR_SK_WF_LEN;
+		v[0] = v[1] - render->wf_span;
+
+		if ((self->n_streams > 1) && (v[0] < 0.0f))
+		{
+			float ys[2], vs[2];
+
+			/* Wraps inside the slice: split in two */
+			ym = y[0] + (y[1] - y[0]) * (- v[0] / render->wf_span);
+
+			ys[0] = y[0];
+			ys[1] = ym;
+			vs[0] = so + (1.0f + v[0]) * sh;
+			vs[1] = so + sh;
+			n += gl_tex_quad(&vtx[n], x, ys, u, vs);
+
+			y[0] = ym;
+			v[0] = 0.0f;
+		}
+
+		v[0] = so + v[0] * sh;
+		v[1] = so + v[1] * sh;
+		n += gl_tex_quad(&vtx[n], x, y, u, v);
 
 		fosphor_gl_cmap_enable(gl->cmap_ctx,
-		                       gl->tex_histogram, gl->cmap_histogram,
-		                       1.1f, 0.0f, GL_CMAP_MODE_BILINEAR);
+		                       gl->tex_sk_wf, gl->cmap_waterfall,
+		                       1.0f / GL_SK_RANGE, 0.0f,
+		                       GL_CMAP_MODE_NEAREST);
 
-		glBegin( GL_QUADS );
-		glTexCoord2f(u[0], v[0]); glVertex2f(x[0], y[0]);
-		glTexCoord2f(u[1], v[0]); glVertex2f(x[1], y[0]);
-		glTexCoord2f(u[1], v[1]); glVertex2f(x[1], y[1]);
-		glTexCoord2f(u[0], v[1]); glVertex2f(x[0], y[1]);
-		glEnd();
+		gl_tex_draw(gl, vtx, n);
 
 		fosphor_gl_cmap_disable();
 
 		if (render->options & FRO_COLOR_SCALE)
-			fosphor_gl_cmap_draw_scale(gl->cmap_histogram,
-						   x[1]+2.0f, x[1]+10.0f, y[0], y[1]);
+			fosphor_gl_cmap_draw_scale(gl->cmap_waterfall,
+						   x[1]+2.0f, x[1]+10.0f, render->_y_wf[0], y[1]);
+	}
+
+	/* Draw waterfall */
+	else if (render->options & FRO_WATERFALL)
+	{
+		struct gl_tex_vtx vtx[24];
+		float ys[2][2], vs[2][2];
+		float bins;
+		int i, n_slices, n, lvl;
+
+		x[0] = render->_x[0];
+		x[1] = render->_x[1];
+
+		y[0] = render->_y_wf[0];
+		y[1] = render->_y_wf[1];
+
+		u[0] = 0.5f + (tw / 2.0f) + render->freq_center - (render->freq_span / 2.0f);
+		u[1] = 0.5f + (tw / 2.0f) + render->freq_center + (render->freq_span / 2.0f);
+
+		v[1] = (float)render->_wf_pos / 1024.0f;
+		v[0] = v[1] - render->wf_span;
+
+		/* Vertical slices */
+		n_slices = 0;
+
+		if ((self->n_streams > 1) && (v[0] < 0.0f))
+		{
+			/* Wraps inside the slice: split in two */
+			float ym = y[0] + (y[1] - y[0]) * (- v[0] / render->wf_span);
+
+			ys[0][0] = y[0];
+			ys[0][1] = ym;
+			vs[0][0] = so + (1.0f + v[0]) * sh;
+			vs[0][1] = so + sh;
+			n_slices++;
+
+			y[0] = ym;
+			v[0] = 0.0f;
+		}
+
+		ys[n_slices][0] = y[0];
+		ys[n_slices][1] = y[1];
+		vs[n_slices][0] = so + v[0] * sh;
+		vs[n_slices][1] = so + v[1] * sh;
+		n_slices++;
+
+		/* Pick the reduced level so there's at most one texel per pixel */
+		bins = (float)FOSPHOR_FFT_LEN * render->freq_span;
+
+		for (lvl=0; !ddc && (lvl < FOSPHOR_WF_RED_LEVELS) && (bins > (x[1] - x[0])); lvl++)
+			bins *= 0.5f;
+
+		/* The reduced levels are only maintained once asked for, until
+		 * then (a frame or so) the full waterfall has to do */
+		if (lvl) {
+			self->products_drawn |= FOSPHOR_PROD_WF_RED;
+			if (!self->wf_red.valid)
+				lvl = 0;
+		}
+
+		/* Quads */
+		n = 0;
+
+		for (i=0; i<n_slices; i++)
+		{
+			float s[2], xm[2], ua[2], lo, lw;
+
+			if (!lvl) {
+				n += gl_tex_quad(&vtx[n], x, ys[i], u, vs[i]);
+				continue;
+			}
+
+			/* Reduced levels can't rely on GL_REPEAT either, so
+			 * split where the span wraps around */
+			lo = 1.0f - 2.0f / (float)(1 << lvl);	/* Level offset */
+			lw = 1.0f / (float)(1 << lvl);		/* Level width  */
+
+			s[0] = u[0] - floorf(u[0]);
+			s[1] = s[0] + (u[1] - u[0]);
+
+			if (s[1] > 1.0f)
+			{
+				xm[0] = x[0];
+				xm[1] = x[0] + (x[1] - x[0]) * (1.0f - s[0]) / (s[1] - s[0]);
+				ua[0] = lo + s[0] * lw;
+				ua[1] = lo + lw;
+
+				n += gl_tex_quad(&vtx[n], xm, ys[i], ua, vs[i]);
+
+				xm[0] = xm[1];
+				xm[1] = x[1];
+				ua[0] = lo;
+				ua[1] = lo + (s[1] - 1.0f) * lw;
+
+				n += gl_tex_quad(&vtx[n], xm, ys[i], ua, vs[i]);
+			}
+			else
+			{
+				ua[0] = lo + s[0] * lw;
+				ua[1] = lo + s[1] * lw;
+
+				n += gl_tex_quad(&vtx[n], x, ys[i], ua, vs[i]);
+			}
+		}
+
+		if (lvl)
+			fosphor_gl_cmap_enable(gl->cmap_ctx,
+			                       gl->tex_waterfall_red, gl->cmap_waterfall,
+			                       self->power.scale, self->power.offset,
+			                       GL_CMAP_MODE_NEAREST);
+		else
+			fosphor_gl_cmap_enable(gl->cmap_ctx,
+			                       tex_wf, gl->cmap_waterfall,
+			                       self->power.scale, self->power.offset,
+			                       GL_CMAP_MODE_BILINEAR);
+
+		gl_tex_draw(gl, vtx, n);
+
+		fosphor_gl_cmap_disable();
+
+		if (render->options & FRO_COLOR_SCALE)
+			fosphor_gl_cmap_draw_scale(gl->cmap_waterfall,
+						   x[1]+2.0f, x[1]+10.0f, render->_y_wf[0], y[1]);
 	}
-	else if (render->options & (FRO_LIVE | FRO_MAX_HOLD))
+
+	/* Draw histogram */
+	if (render->options & FRO_HISTO)
 	{
+		struct gl_tex_vtx vtx[6];
+
 		x[0] = render->_x[0];
 		x[1] = render->_x[1];
 
 		y[0] = render->_y_histo[0];
 		y[1] = render->_y_histo[1];
 
-		glColor3f(0.0f, 0.0f, 0.1f);
+		u[0] = 0.5f + (tw / 2.0f) + render->freq_center - (render->freq_span / 2.0f);
+		u[1] = 0.5f + (tw / 2.0f) + render->freq_center + (render->freq_span / 2.0f);
+
+		v[0] = so;
+		v[1] = so + sh;
+
+		if (self->n_streams > 1) {
+			/* Stay half a texel away from the neighbor slices */
+			v[0] += 0.5f * sh / 128.0f;
+			v[1] -= 0.5f * sh / 128.0f;
+		}
+
+		fosphor_gl_cmap_enable(gl->cmap_ctx,
+		                       tex_histo, gl->cmap_histogram,
+		                       1.1f, 0.0f, GL_CMAP_MODE_BILINEAR);
+
+		gl_tex_draw(gl, vtx, gl_tex_quad(vtx, x, y, u, v));
+
+		fosphor_gl_cmap_disable();
 
-		glBegin( GL_QUADS );
-		glVertex2f(x[0], y[0]);
-		glVertex2f(x[1], y[0]);
-		glVertex2f(x[1], y[1]);
-		glVertex2f(x[0], y[1]);
-		glEnd();
+		if (render->options & FRO_COLOR_SCALE)
+			fosphor_gl_cmap_draw_scale(gl->cmap_histogram,
+						   x[1]+2.0f, x[1]+10.0f, y[0], y[1]);
 	}
 
-	/* Draw spectrum */
+	/* Draw background (if no histogram) and spectrum */
 	if (render->options & (FRO_LIVE | FRO_MAX_HOLD))
 	{
-		int idx[2], len;
+		float xform[4];
+		int idx[2], len, base;
+
+		/* Background */
+		if (render->_n_bg)
+		{
+			gl_plot_enable(&gl->plot, xform_id);
+			gl_overlay_bind(view, render);
+			glDrawArrays(GL_TRIANGLES, 0, render->_n_bg);
+			gl_plot_disable();
+		}
 
 		/* Select end-points */
 		idx[0] = ceilf ((float)(FOSPHOR_FFT_LEN) * (render->freq_center - (render->freq_span / 2.0f)));
@@ -484,279 +1530,196 @@ fosphor_gl_draw(struct fosphor *self, struct fosphor_render *render)
 
 		len = idx[1] - idx[0] + 1;
 
-		/* Setup */
-		glPushMatrix();
-
-			/* Screen position scaling */
-		glTranslatef(
-			render->_x[0],
-			render->_y_histo[0],
-			0.0f
-		);
+		base = stream * 2 * FOSPHOR_FFT_LEN;
 
-		glScalef(
-			render->_x[1] - render->_x[0],
-			render->_y_histo[1] - render->_y_histo[0],
-			1.0f
-		);
+		/* Transform: vertex x in [-1,1] is mapped to [0,1] (centers of
+		 * the displayed bins), then the zoom and screen area are applied.
+		 * (The half-texel skips on each side cancel out) */
+		xform[0] = 0.5f * (render->_x[1] - render->_x[0]) / render->freq_span;
+		xform[1] = render->_x[0] + (render->_x[1] - render->_x[0]) *
+			(0.5f - render->freq_center + render->freq_span / 2.0f) / render->freq_span;
+		xform[2] = (render->_y_histo[1] - render->_y_histo[0]) * self->power.scale;
+		xform[3] = render->_y_histo[0] + xform[2] * self->power.offset;
 
-			/* Power offset / scaling */
-		glScalef(1.0f, self->power.scale, 1.0f);
-		glTranslatef(0.0f, self->power.offset, 0.0f);
+		/* GL state setup */
+		gl_plot_enable(&gl->plot, xform);
 
-			/* Spectrum range selection */
-		glScalef(1.0f / render->freq_span, 1.0f, 1.0f);
-		glTranslatef(- render->freq_center + render->freq_span / 2.0f, 0.0f, 0.0f);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo_spectrum);
+		glVertexAttribPointer(GL_ATTR_POS, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(GL_ATTR_POS);
+		glDisableVertexAttribArray(GL_ATTR_COLOR);
 
-			/* Map the center of each N-1 bins */
-		glTranslatef(tw, 0.0f, 0.0f);
-		glScalef(1.0f - 2.0 * tw, 1.0f, 1.0f);
-
-			/* Spectrum x scaling to [0.0 -> 1.0] range */
-		glTranslatef(0.5f, 0.0f, 0.0f);
-		glScalef(0.5f / (1.0f - 2.0f * tw), 1.0f, 1.0f);
-
-			/* GL state setup */
-		glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_spectrum);
-		glVertexPointer(2, GL_FLOAT, 0, 0);
-
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		glEnable(GL_LINE_SMOOTH);
 		glLineWidth(1.0f);
 
 		/* Live */
 		if (render->options & FRO_LIVE)
 		{
-			glColor4f(1.0f, 1.0f, 1.0f, 0.75f);
-
-			glEnableClientState(GL_VERTEX_ARRAY);
-			glDrawArrays(GL_LINE_STRIP, idx[0], len);
-			glDisableClientState(GL_VERTEX_ARRAY);
+			glVertexAttrib4f(GL_ATTR_COLOR, 1.0f, 1.0f, 1.0f, 0.75f);
+			glDrawArrays(GL_LINE_STRIP, base + idx[0], len);
 		}
 
 		/* Max hold */
 		if (render->options & FRO_MAX_HOLD)
 		{
-			glColor4f(1.0f, 0.0f, 0.0f, 0.75f);
-
-			glEnableClientState(GL_VERTEX_ARRAY);
-			glDrawArrays(GL_LINE_STRIP, idx[0] + FOSPHOR_FFT_LEN, len);
-			glDisableClientState(GL_VERTEX_ARRAY);
+			glVertexAttrib4f(GL_ATTR_COLOR, 1.0f, 0.0f, 0.0f, 0.75f);
+			glDrawArrays(GL_LINE_STRIP, base + idx[0] + FOSPHOR_FFT_LEN, len);
 		}
 
-		/* Cleanup */
-		glDisable(GL_BLEND);
-
-		glPopMatrix();
-	}
-
-	/* Setup frequency axis */
-	if (render->freq_center != 0.5f || render->freq_span != 1.0f)
-	{
-		double view_center = self->frequency.center + self->frequency.span * (double)(render->freq_center - 0.5f);
-		double view_span   = self->frequency.span * (double)render->freq_span;
-
-		freq_axis_build(&freq_axis,
-				view_center,
-				view_span,
-				render->freq_n_div
-		);
-	}
-	else
-	{
-		/* Use the straight number we were provider without math to
-		 * avoid any imprecisions */
-		freq_axis_build(&freq_axis,
-				self->frequency.center,
-				self->frequency.span,
-				render->freq_n_div
-		);
-	}
-
-	/* Draw grid */
-	if (render->options & (FRO_LIVE | FRO_MAX_HOLD | FRO_HISTO))
-	{
-		for (i=0; i<11; i++)
+		/* Noise floor (percentiles are computed on the main FFT) */
+		if ((render->options & FRO_NOISE_FLOOR) && self->pct.seq && !ddc)
 		{
-			float fg_color[3] = { 1.00f, 1.00f, 0.33f };
-			float yv;
+			glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_noise_floor);
 
-			yv = render->_y_histo[0] + i * render->_y_histo_div;
+			if (gl->nf_seq != self->pct.seq)
+				gl_noise_floor_update(self);
 
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glColor4f(0.0f, 0.0f, 0.0f, 0.5f);
+			glVertexAttribPointer(GL_ATTR_POS, 2, GL_FLOAT, GL_FALSE, 0, 0);
+			glVertexAttrib4f(GL_ATTR_COLOR, 0.0f, 1.0f, 0.0f, 0.75f);
+			glDrawArrays(GL_LINE_STRIP, stream * FOSPHOR_FFT_LEN + idx[0], len);
+		}
 
-			glBegin(GL_LINES);
-			glVertex2f(render->_x[0] + 0.5f, yv + 0.5f);
-			glVertex2f(render->_x[1] - 0.5f, yv + 0.5f);
-			glEnd();
+		/* Limit mask and violations (checked on the main FFT) */
+		if ((render->options & FRO_MASK) && self->mask.enabled && !ddc)
+		{
+			gl_mask_update(self);
 
-			glDisable(GL_BLEND);
+			glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_mask);
+			glVertexAttribPointer(GL_ATTR_POS, 2, GL_FLOAT, GL_FALSE, 0, 0);
+			glVertexAttrib4f(GL_ATTR_COLOR, 1.0f, 0.5f, 0.0f, 0.75f);
+			glDrawArrays(GL_LINE_STRIP, idx[0], len);
 
-			if (render->options & FRO_LABEL_PWR)
+			if (self->mask.seq)
 			{
-				glf_begin(gl->font, fg_color);
-
-				glf_printf(gl->font,
-				           render->_x_label, GLF_RIGHT,
-				           yv, GLF_CENTER,
-				           "%d", self->power.db_ref - (10-i) * self->power.db_per_div
-				);
-
-				glf_end();
+				glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_mask_hl);
+				glVertexAttribPointer(GL_ATTR_POS, 2, GL_FLOAT, GL_FALSE, 0, 0);
+				glVertexAttrib4f(GL_ATTR_COLOR, 1.0f, 0.0f, 0.0f, 1.0f);
+				glLineWidth(2.0f);
+				glDrawArrays(GL_LINES, 2 * (stream * FOSPHOR_FFT_LEN + idx[0]), 2 * len);
+				glLineWidth(1.0f);
 			}
 		}
 
-		for (i=0; i<=render->freq_n_div; i++)
+		/* Spectral kurtosis, [0,GL_SK_RANGE] over the whole plot height */
+		if (sk && (render->options & FRO_KURTOSIS))
 		{
-			float fg_color[3] = { 1.00f, 1.00f, 0.33f };
-			float xv, xv_ofs, xv_ofs_total;
-			char buf[32];
-
-			xv = render->_x[0] + i * render->_x_div;
+			xform[2] = (render->_y_histo[1] - render->_y_histo[0]) / GL_SK_RANGE;
+			xform[3] = render->_y_histo[0];
 
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glColor4f(0.0f, 0.0f, 0.0f, 0.5f);
+			gl_plot_enable(&gl->plot, xform);
 
-			glBegin(GL_LINES);
-			glVertex2f(xv + 0.5f, render->_y_histo[0]+0.5f);
-			glVertex2f(xv + 0.5f, render->_y_histo[1]-0.5f);
-			glEnd();
+			glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_sk);
+			glVertexAttribPointer(GL_ATTR_POS, 2, GL_FLOAT, GL_FALSE, 0, 0);
+			glVertexAttrib4f(GL_ATTR_COLOR, 1.0f, 0.0f, 1.0f, 0.75f);
+			glDrawArrays(GL_LINE_STRIP, stream * FOSPHOR_FFT_LEN + idx[0], len);
+		}
 
-			glDisable(GL_BLEND);
+		/* Coherence, [0,1] over the whole plot height */
+		if (xs)
+		{
+			xform[2] = render->_y_histo[1] - render->_y_histo[0];
+			xform[3] = render->_y_histo[0];
 
-			freq_axis_render(&freq_axis, buf,  (render->freq_n_div / 2));
-			xv_ofs_total  = glf_width_str(gl->font, buf);
-			freq_axis_render(&freq_axis, buf, -(render->freq_n_div / 2));
-			xv_ofs_total += glf_width_str(gl->font, buf);
-			xv_ofs_total /= 2.0f;
+			gl_plot_enable(&gl->plot, xform);
 
-			if (render->options & FRO_LABEL_FREQ)
-			{
-				int ib = i - (render->freq_n_div / 2);
+			glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_xs_coh);
+			glVertexAttribPointer(GL_ATTR_POS, 2, GL_FLOAT, GL_FALSE, 0, 0);
+			glVertexAttrib4f(GL_ATTR_COLOR, 0.0f, 1.0f, 1.0f, 0.75f);
+			glDrawArrays(GL_LINE_STRIP, idx[0], len);
+		}
 
-				glf_begin(gl->font, fg_color);
+		/* Cleanup */
+		gl_plot_disable();
+	}
 
-				freq_axis_render(&freq_axis, buf, ib);
+	/* Draw occupancy heat strip (counted on the main FFT) */
+	if ((render->options & FRO_OCCUPANCY) && self->occ.seq && !ddc)
+	{
+		struct gl_tex_vtx vtx[6];
 
-				xv_ofs = floor((- xv_ofs_total * ib) / render->freq_n_div);
+		if (gl->occ_seq != self->occ.seq) {
+			gl_tex2d_write(gl->tex_occupancy, self->occ.cur, FOSPHOR_FFT_LEN, self->n_streams);
+			gl->occ_seq = self->occ.seq;
+		}
 
-				glf_printf(gl->font,
-				           xv + xv_ofs, GLF_CENTER,
-				           render->_y_label, GLF_CENTER,
-				           "%s", buf
-				);
+		x[0] = render->_x[0];
+		x[1] = render->_x[1];
 
-				glf_end();
-			}
-		}
-	}
+		y[0] = render->_y_histo[0];
+		y[1] = render->_y_histo[0] + 8.0f;
 
-	/* Draw channels */
-	if (render->options & FRO_CHANNELS)
-	{
-		struct {
-			int   dir;
-			float pos;
-		} pt[2*FOSPHOR_MAX_CHANNELS+2], tpt;
+		u[0] = 0.5f + (tw / 2.0f) + render->freq_center - (render->freq_span / 2.0f);
+		u[1] = 0.5f + (tw / 2.0f) + render->freq_center + (render->freq_span / 2.0f);
 
-		int i, j, n;
+		v[0] = v[1] = so + 0.5f * sh;	/* Center of the stream line */
 
-		/* Generate the points from the channels */
-		n = 2;
+		fosphor_gl_cmap_enable(gl->cmap_ctx,
+		                       gl->tex_occupancy, gl->cmap_waterfall,
+		                       1.0f, 0.0f, GL_CMAP_MODE_NEAREST);
 
-		pt[0].dir = -1; pt[0].pos = 0.0f;
-		pt[1].dir =  1; pt[1].pos = 1.0f;
+		gl_tex_draw(gl, vtx, gl_tex_quad(vtx, x, y, u, v));
 
-		for (i=0; i<FOSPHOR_MAX_CHANNELS; i++)
-		{
-			float f;
+		fosphor_gl_cmap_disable();
+	}
 
-			if (!render->channels[i].enabled)
-				continue;
+	/* Draw grid */
+	if (render->options & (FRO_LIVE | FRO_MAX_HOLD | FRO_HISTO))
+	{
+		float fg_color[3] = { 1.00f, 1.00f, 0.33f };
 
-			f = render->channels[i].center
-				- render->channels[i].width / 2.0f;
-			pt[n].dir = 1;
-			pt[n].pos = (f > 0.0f) ? (f < 1.0f ? f : 1.0f) : 0.0f;
-			n++;
+		/* All lines in one go */
+		gl_plot_enable(&gl->plot, xform_id);
+		gl_overlay_bind(view, render);
+		glDrawArrays(GL_LINES, render->_n_bg, render->_n_grid);
+		gl_plot_disable();
 
-			f = render->channels[i].center
-				+ render->channels[i].width / 2.0f;
+		/* All labels in one go */
+		gl_labels_update(self, view, render);
 
-			pt[n].dir = -1;
-			pt[n].pos = (f > 0.0f) ? (f < 1.0f ? f : 1.0f) : 0.0f;
-			n++;
+		if (view->label_n)
+		{
+			glf_begin(gl->font, fg_color);
+			glf_draw_vbo(view->label_vbo, view->label_n);
+			glf_end();
 		}
+	}
 
-		/* Only if there is something to do ... */
-		if (n > 2)
-		{
-			int l = pt[0].dir;
+	/* Draw channels */
+	if ((render->options & FRO_CHANNELS) && render->_n_chan)
+	{
+		gl_plot_enable(&gl->plot, xform_id);
+		gl_overlay_bind(view, render);
+		glDrawArrays(GL_TRIANGLES, render->_n_bg + render->_n_grid, render->_n_chan);
+		gl_plot_disable();
+	}
 
-			/* GL setup */
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	/* Band power readouts (bands are defined on the main FFT) */
+	if ((render->options & FRO_BAND_POWER) && self->bands.n && !ddc)
+	{
+		float fg_color[3] = { 1.00f, 1.00f, 1.00f };
+		char buf[32];
+		int i;
 
-			glPushMatrix();
+		glf_begin(gl->font, fg_color);
 
-			glTranslatef(render->_x[0], 0.0f, 0.0f);
-			glScalef(render->_x[1] - render->_x[0], 1.0f, 1.0f);
+		for (i=0; i<self->bands.n; i++)
+		{
+			float val = self->bands.last[stream * FOSPHOR_BANDS_MAX + i];
+			float xr = (self->bands.center[i] - render->freq_center) / render->freq_span + 0.5f;
 
-			/* Sort and draw at the same time */
-			for (i=1; i<n; i++)
-			{
-				int mi = i;
-
-				/* Find min index */
-				for (j=i+1; j<n; j++) {
-					if (pt[j].pos < pt[mi].pos)
-						mi = j;
-				}
-
-				/* Swap */
-				tpt    = pt[i];
-				pt[i]  = pt[mi];
-				pt[mi] = tpt;
-
-				/* Draw */
-				if ((pt[i-1].pos != pt[i].pos) && (l != 0))
-				{
-					if (l < 0)
-						glColor4f(0.0f, 0.0f, 0.0f, 0.5f);
-					else
-						glColor4f(1.0f, 1.0f, 1.0f, 0.2f - 0.2f / (1 + l));
-
-					if (render->options & FRO_WATERFALL) {
-						glBegin( GL_QUADS );
-						glVertex2f(pt[i  ].pos, render->_y_histo[0]);
-						glVertex2f(pt[i-1].pos, render->_y_histo[0]);
-						glVertex2f(pt[i-1].pos, render->_y_histo[1]);
-						glVertex2f(pt[i  ].pos, render->_y_histo[1]);
-						glEnd();
-					}
-
-					if (render->options & (FRO_LIVE | FRO_MAX_HOLD | FRO_HISTO)) {
-						glBegin( GL_QUADS );
-						glVertex2f(pt[i  ].pos, render->_y_wf[0]);
-						glVertex2f(pt[i-1].pos, render->_y_wf[0]);
-						glVertex2f(pt[i-1].pos, render->_y_wf[1]);
-						glVertex2f(pt[i  ].pos, render->_y_wf[1]);
-						glEnd();
-					}
-				}
-
-				l += pt[i].dir;
-			}
+			if (isnan(val) || (xr < 0.0f) || (xr > 1.0f))
+				continue;
 
-			/* GL cleanup */
-			glPopMatrix();
+			snprintf(buf, sizeof(buf), "%.1f dB", val);
 
-			glDisable(GL_BLEND);
+			glf_draw_str(gl->font,
+				render->_x[0] + xr * (render->_x[1] - render->_x[0]), GLF_CENTER,
+				render->_y_histo[1] - 2.0f, GLF_TOP,
+				buf
+			);
 		}
+
+		glf_end();
 	}
 
 	/* Ensure GL is done */
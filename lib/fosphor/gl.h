@@ -28,13 +28,20 @@ void fosphor_gl_release(struct fosphor *self);
 
 enum fosphor_gl_id {
 	GL_ID_TEX_WATERFALL,
+	GL_ID_TEX_WATERFALL_RED,
 	GL_ID_TEX_HISTOGRAM,
 	GL_ID_VBO_SPECTRUM,
+	GL_ID_TEX_ZOOM_WATERFALL,
+	GL_ID_TEX_ZOOM_HISTOGRAM,
+	GL_ID_VBO_ZOOM_SPECTRUM,
 };
 
 GLuint fosphor_gl_get_shared_id(struct fosphor *self,
                                 enum fosphor_gl_id id);
 
+int  fosphor_gl_zoom_alloc(struct fosphor *self);
+void fosphor_gl_zoom_release(struct fosphor *self);
+
 void fosphor_gl_refresh(struct fosphor *self);
 void fosphor_gl_draw(struct fosphor *self, struct fosphor_render *render);
 
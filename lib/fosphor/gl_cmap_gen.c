@@ -199,6 +199,28 @@ fosphor_gl_cmap_waterfall(uint32_t *rgba, int N, void *arg)
 }
 
 
+int
+fosphor_gl_cmap_phase(uint32_t *rgba, int N, void *arg)
+{
+	int i;
+
+	/* Full hue circle, both ends are the same color so that -pi / pi
+	 * wrap arounds don't show */
+	for (i=0; i<N; i++)
+	{
+		float p = (1.0f * i) / (N - 1);
+
+		_set_rgba_from_hsv(&rgba[i],
+			p * 1.2f,		/* H (sectors are 1/5th wide) */
+			0.8f,			/* S */
+			0.9f			/* V */
+		);
+	}
+
+	return 0;
+}
+
+
 #ifdef ENABLE_PNG
 #include <png.h>
 int
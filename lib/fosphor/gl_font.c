@@ -331,18 +331,14 @@ glf_width_str(const struct gl_font *glf, const char *str)
 	return xb;
 }
 
-void
-glf_draw_str(const struct gl_font *glf,
-             float x, enum glf_align x_align,
-	     float y, enum glf_align y_align,
-	     const char *str)
+int
+glf_layout_str(const struct gl_font *glf, float *data,
+               float x, enum glf_align x_align,
+               float y, enum glf_align y_align,
+               const char *str)
 {
-	float *data;
 	float xb, xofs, yofs;
-	int i;
-
-	/* Temporary buffer for vertex data */
-	data = malloc(8 * sizeof(float) * 4 * strlen(str));
+	int i, n;
 
 	/* Add chars to the buffer */
 	xb = 0.0f;
@@ -352,6 +348,8 @@ glf_draw_str(const struct gl_font *glf,
 		xb += (float)glf->glyphs[str[i] - GLF_MIN_CHR].advance_x;
 	}
 
+	n = 4 * i;
+
 	/* Align */
 	if (x_align == GLF_CENTER) {
 		xofs = x - roundf(xb / 2.0f);
@@ -373,11 +371,29 @@ glf_draw_str(const struct gl_font *glf,
 
 	yofs += (float) glf->glyph_bb.ofs_y;
 
-	for (i=0; i<4*strlen(str); i++) {
+	for (i=0; i<n; i++) {
 		data[8*i + 4] += xofs;
 		data[8*i + 5] += yofs;
 	}
 
+	return n;
+}
+
+void
+glf_draw_str(const struct gl_font *glf,
+             float x, enum glf_align x_align,
+	     float y, enum glf_align y_align,
+	     const char *str)
+{
+	float *data;
+	int n;
+
+	/* Temporary buffer for vertex data */
+	data = malloc(8 * sizeof(float) * 4 * strlen(str));
+
+	/* Layout */
+	n = glf_layout_str(glf, data, x, x_align, y, y_align, str);
+
 	/* Draw */
 #if 1
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -390,14 +406,14 @@ glf_draw_str(const struct gl_font *glf,
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
-	glDrawArrays(GL_QUADS, 0,  4*strlen(str));
+	glDrawArrays(GL_QUADS, 0, n);
 
 	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 	glDisableClientState(GL_VERTEX_ARRAY);
 	glDisableClientState(GL_COLOR_ARRAY);
 #else
         glBegin( GL_QUADS );
-	for (i=0; i<4*strlen(str); i++) {
+	for (int i=0; i<n; i++) {
 		glColor4f(data[8*i + 0], data[8*i + 1], data[8*i + 2], data[8*i + 3]);
 		glTexCoord2f(data[8*i + 6], data[8*i + 7]);
 		glVertex2f(data[8*i + 4], data[8*i + 5]);
@@ -409,6 +425,28 @@ glf_draw_str(const struct gl_font *glf,
 	free(data);
 }
 
+void
+glf_draw_vbo(GLuint vbo, int n_vtx)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+	glColorPointer   (4, GL_FLOAT, 8 * sizeof(float), (void*)(0 * sizeof(float)));
+	glVertexPointer  (2, GL_FLOAT, 8 * sizeof(float), (void*)(4 * sizeof(float)));
+	glTexCoordPointer(2, GL_FLOAT, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+
+	glEnableClientState(GL_COLOR_ARRAY);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	glDrawArrays(GL_QUADS, 0, n_vtx);
+
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 void
 glf_printf(const struct gl_font *glf,
            float x, enum glf_align x_align,
@@ -17,6 +17,8 @@
  *  \brief Basic OpenGL font rendering
  */
 
+#include "gl_platform.h"
+
 #ifdef _MSC_VER
 # define ATTR_FORMAT(a,b,c)
 #else
@@ -45,6 +47,15 @@ int glf_load_face_mem(struct gl_font *glf, const void *data, size_t len);
 
 float glf_width_str(const struct gl_font *glf, const char *str);
 
+/* Layout of 'str' as vertex data (4 vertices of 8 floats per char) that
+ * can be kept in a VBO and later drawn with glf_draw_vbo (between
+ * glf_begin / glf_end, which setup the font state) */
+int  glf_layout_str(const struct gl_font *glf, float *data,
+                    float x, enum glf_align x_align,
+                    float y, enum glf_align y_align,
+                    const char *str);
+void glf_draw_vbo(GLuint vbo, int n_vtx);
+
 void glf_draw_str(const struct gl_font *glf,
                   float x, enum glf_align x_align,
                   float y, enum glf_align y_align,
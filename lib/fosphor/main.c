@@ -11,6 +11,10 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 #ifdef _WIN32
 #include <GL/glew.h>
 #endif
@@ -18,6 +22,7 @@
 
 #include "fosphor.h"
 #include "private.h"
+#include "rec.h"
 
 struct app_state
 {
@@ -28,9 +33,32 @@ struct app_state
 	FILE *src_fh;
 	void *src_buf;
 
+	/* Raw IQ file mapping */
+	uint8_t *src_map;
+	size_t src_len;			/* In samples */
+	size_t src_pos;
+	double sample_rate;
+
+	/* Spectrogram archive */
+	struct fosphor_rec_reader *arc;
+	int64_t arc_row;		/* Next row to display */
+	uint64_t arc_t_ns;		/* Playback time */
+	float *arc_buf;
+	float arc_max[FOSPHOR_FFT_LEN];
+
+	/* Playback control */
+	int paused;
+	int speed;
+	uint64_t t_last;
+
+	struct fosphor_net_rx *net_rx;
+
 	int w, h;
 
 	int db_ref, db_per_div_idx;
+	int auto_range;
+	int pfb;
+	int kurtosis;
 	float ratio;
 	double zoom_width, zoom_center;
 	int zoom_enable;
@@ -129,12 +157,247 @@ time_toc(const char *str)
 
 
 /* ------------------------------------------------------------------------ */
-/* GLFW                                                                     */
+/* Playback                                                                 */
 /* ------------------------------------------------------------------------ */
 
 #define BATCH_LEN	128
 #define BATCH_COUNT	4
 
+static double
+play_get_time(void)
+{
+	if (g_as->arc)
+		return (g_as->arc_t_ns - fosphor_rec_reader_row_time(g_as->arc, 0)) * 1e-9;
+	else
+		return g_as->src_pos / g_as->sample_rate;
+}
+
+static double
+play_get_duration(void)
+{
+	if (g_as->arc)
+		return (fosphor_rec_reader_row_time(g_as->arc, fosphor_rec_reader_rows(g_as->arc) - 1) -
+		        fosphor_rec_reader_row_time(g_as->arc, 0)) * 1e-9;
+	else
+		return g_as->src_len / g_as->sample_rate;
+}
+
+static void
+play_update_title(GLFWwindow *wnd)
+{
+	char title[128];
+	double t = play_get_time();
+	double d = play_get_duration();
+
+	snprintf(title, sizeof(title), "Fosphor test - %02d:%02d:%04.1f / %02d:%02d:%04.1f%s x%d",
+		(int)(t / 3600), (int)(t / 60) % 60, t - 60 * (int)(t / 60),
+		(int)(d / 3600), (int)(d / 60) % 60, d - 60 * (int)(d / 60),
+		g_as->paused ? " (paused)" : "",
+		g_as->speed
+	);
+
+	glfwSetWindowTitle(wnd, title);
+}
+
+/* Upload the archive rows [row - n, row) straight into the waterfall */
+static void
+play_archive_rows(int64_t row, int n)
+{
+	const struct fosphor_rec_header *h = fosphor_rec_reader_header(g_as->arc);
+	int s, i, j;
+
+	if (n > 1024)
+		n = 1024;
+
+	if (n <= 0)
+		return;
+
+	if (fosphor_rec_reader_read(g_as->arc, row - n, n, g_as->arc_buf))
+		fprintf(stderr, "[w] Corrupted data in spectrogram archive\n");
+
+	for (s=0; s<h->n_streams; s++)
+	{
+		float *d = &g_as->arc_buf[s * n * FOSPHOR_FFT_LEN];
+		float *last = &d[(n - 1) * FOSPHOR_FFT_LEN];
+
+		fosphor_load_waterfall(g_as->fosphor, s, (int)((row - n) & 1023), d, n);
+
+		/* Spectrum : newest row, peak of what was skipped over */
+		memcpy(g_as->arc_max, last, sizeof(g_as->arc_max));
+
+		for (j=0; j<n-1; j++)
+			for (i=0; i<FOSPHOR_FFT_LEN; i++)
+				if (d[j * FOSPHOR_FFT_LEN + i] > g_as->arc_max[i])
+					g_as->arc_max[i] = d[j * FOSPHOR_FFT_LEN + i];
+
+		fosphor_load_spectrum(g_as->fosphor, s, last, g_as->arc_max);
+	}
+
+	fosphor_set_waterfall_position(g_as->fosphor, (int)(row & 1023));
+}
+
+static void
+play_seek(GLFWwindow *wnd, double t)
+{
+	double d = play_get_duration();
+
+	if (t < 0.0)
+		t = 0.0;
+	else if (t > d)
+		t = d;
+
+	if (g_as->arc) {
+		/* Jump there and refill the whole waterfall at once */
+		g_as->arc_t_ns = fosphor_rec_reader_row_time(g_as->arc, 0) + (uint64_t)(t * 1e9);
+		g_as->arc_row  = fosphor_rec_reader_find_time(g_as->arc, g_as->arc_t_ns) + 1;
+		play_archive_rows(g_as->arc_row, 1024);
+	} else {
+		g_as->src_pos = (size_t)(t * g_as->sample_rate) & ~(FOSPHOR_FFT_LEN - 1);
+		if (g_as->src_pos + FOSPHOR_FFT_LEN > g_as->src_len)
+			g_as->src_pos = 0;
+	}
+
+	play_update_title(wnd);
+}
+
+static void
+play_archive(GLFWwindow *wnd)
+{
+	uint64_t now = time_now();
+	int64_t row, end;
+
+	if (!g_as->paused)
+		g_as->arc_t_ns += (now - g_as->t_last) * 1000ULL * g_as->speed;
+
+	g_as->t_last = now;
+
+	if (g_as->paused)
+		return;
+
+	/* Stop at the end */
+	end = fosphor_rec_reader_rows(g_as->arc);
+
+	if (g_as->arc_row >= end) {
+		g_as->paused = 1;
+		play_update_title(wnd);
+		return;
+	}
+
+	/* Upload the rows we're due for */
+	row = fosphor_rec_reader_find_time(g_as->arc, g_as->arc_t_ns) + 1;
+
+	if (row > g_as->arc_row) {
+		play_archive_rows(row, (int)(row - g_as->arc_row));
+		g_as->arc_row = row;
+	}
+}
+
+static void
+play_raw(void)
+{
+	int c, r;
+
+	if (g_as->paused)
+		return;
+
+	for (c=0; c<BATCH_COUNT; c++)
+	{
+		/* Wrap when there isn't a full FFT left */
+		if (g_as->src_pos + FOSPHOR_FFT_LEN > g_as->src_len)
+			g_as->src_pos = 0;
+
+		r = FOSPHOR_FFT_LEN * BATCH_LEN;
+		if (g_as->src_pos + r > g_as->src_len)
+			r = (g_as->src_len - g_as->src_pos) & ~(FOSPHOR_FFT_LEN - 1);
+
+		/* Straight from the mapping, no copy */
+		fosphor_process(g_as->fosphor, g_as->src_map + g_as->src_pos * 2 * sizeof(float), r);
+
+		g_as->src_pos += r;
+	}
+}
+
+static int
+play_open(const char *filename)
+{
+	uint32_t magic = 0;
+	FILE *fh;
+	int is_arc;
+
+	/* Archive or raw IQ ? */
+	fh = fopen(filename, "rb");
+	if (!fh) {
+		fprintf(stderr, "[!] Failed to open input file\n");
+		return -EIO;
+	}
+
+	is_arc = (fread(&magic, sizeof(magic), 1, fh) == 1) && (magic == FOSPHOR_REC_MAGIC);
+
+	if (is_arc) {
+		fclose(fh);
+
+		g_as->arc = fosphor_rec_reader_open(filename);
+		if (!g_as->arc)
+			return -EIO;
+
+		g_as->arc_buf = malloc(fosphor_rec_reader_header(g_as->arc)->n_streams *
+		                       1024 * FOSPHOR_FFT_LEN * sizeof(float));
+		if (!g_as->arc_buf)
+			return -ENOMEM;
+
+		return 0;
+	}
+
+#ifndef _WIN32
+	/* Map raw IQ when we can, sequential read as fallback */
+	{
+		struct stat st;
+		void *map;
+
+		if (!fstat(fileno(fh), &st) && S_ISREG(st.st_mode) &&
+		    (st.st_size >= 0) &&
+		    ((size_t)st.st_size >= 2 * sizeof(float) * FOSPHOR_FFT_LEN))
+		{
+			map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fileno(fh), 0);
+
+			if (map != MAP_FAILED) {
+				fclose(fh);
+
+				g_as->src_map = map;
+				g_as->src_len = st.st_size / (2 * sizeof(float));
+
+				return 0;
+			}
+		}
+	}
+#endif
+
+	rewind(fh);
+	g_as->src_fh = fh;
+
+	return 0;
+}
+
+static void
+play_close(void)
+{
+	fosphor_rec_reader_close(g_as->arc);
+	free(g_as->arc_buf);
+
+#ifndef _WIN32
+	if (g_as->src_map)
+		munmap(g_as->src_map, g_as->src_len * 2 * sizeof(float));
+#endif
+
+	if (g_as->src_fh)
+		fclose(g_as->src_fh);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* GLFW                                                                     */
+/* ------------------------------------------------------------------------ */
+
 static void
 glfw_render(GLFWwindow *wnd)
 {
@@ -144,7 +407,7 @@ glfw_render(GLFWwindow *wnd)
 	/* Timing */
 	if (!fc)
 		time_tic();
-	if (fc == 99) {
+	if ((fc == 99) && (g_as->src_fh || g_as->src_map) && !g_as->paused) {
 		uint64_t t;
 		float bw;
 
@@ -154,12 +417,35 @@ glfw_render(GLFWwindow *wnd)
 		fprintf(stderr, "BW estimated: %f Msps\n", bw / 1e6);
 	}
 
+	if ((fc == 99) && (g_as->arc || g_as->src_map))
+		play_update_title(wnd);
+
 	fc = (fc+1) % 100;
 
 	/* Clear everything */
 	glClearColor( 0.0f, 0.0f, 0.0f, 0.0f );
 	glClear(GL_COLOR_BUFFER_BIT);
 
+	/* Remote display : just take whatever arrived */
+	if (g_as->net_rx) {
+		if (fosphor_net_rx_poll(g_as->net_rx, g_as->fosphor) < 0) {
+			fprintf(stderr, "[!] Lost connection to remote fosphor\n");
+			glfwSetWindowShouldClose(wnd, 1);
+		}
+		goto draw;
+	}
+
+	/* Archive / mapped file playback */
+	if (g_as->arc) {
+		play_archive(wnd);
+		goto draw;
+	}
+
+	if (g_as->src_map) {
+		play_raw();
+		goto draw;
+	}
+
 	/* Process some samples */
 	for (c=0; c<BATCH_COUNT; c++) {
 		r = sizeof(float) * 2 * FOSPHOR_FFT_LEN * BATCH_LEN;
@@ -182,6 +468,7 @@ glfw_render(GLFWwindow *wnd)
 		fosphor_process(g_as->fosphor, g_as->src_buf, FOSPHOR_FFT_LEN * BATCH_LEN);
 	}
 
+draw:
 	/* Draw fosphor */
 	fosphor_draw(g_as->fosphor, &g_as->render_main);
 
@@ -190,11 +477,30 @@ glfw_render(GLFWwindow *wnd)
 
 	/* Done, swap buffer */
 	glfwSwapBuffers(wnd);
+
+	/* Follow the signal level */
+	if (g_as->auto_range)
+	{
+		int db_ref = g_as->db_ref, db_per_div = k_db_per_div[g_as->db_per_div_idx], i;
+
+		if (fosphor_auto_range(g_as->fosphor, &db_ref, &db_per_div) > 0)
+		{
+			for (i=0; i<5; i++)
+				if (k_db_per_div[i] == db_per_div)
+					g_as->db_per_div_idx = i;
+
+			g_as->db_ref = db_ref;
+
+			fosphor_set_power_range(g_as->fosphor, g_as->db_ref, k_db_per_div[g_as->db_per_div_idx]);
+		}
+	}
 }
 
 static void
 _update_fosphor(void)
 {
+	int decim;
+
 	/* Configure the screen zones */
 	if (g_as->zoom_enable)
 	{
@@ -229,8 +535,21 @@ _update_fosphor(void)
 	g_as->render_main.channels[0].center  = (float)g_as->zoom_center;
 	g_as->render_main.channels[0].width   = (float)g_as->zoom_width;
 
-	g_as->render_zoom.freq_center = g_as->zoom_center;
-	g_as->render_zoom.freq_span   = g_as->zoom_width;
+	decim = g_as->fosphor ?
+		fosphor_set_zoom(g_as->fosphor, g_as->zoom_enable, g_as->zoom_center, g_as->zoom_width) :
+		1;
+
+	if (decim > 1) {
+		/* True resolution from the down-converter */
+		g_as->render_zoom.options |= FRO_DDC;
+		g_as->render_zoom.freq_center = 0.5f;
+		g_as->render_zoom.freq_span   = g_as->zoom_width * decim;
+	} else {
+		/* Stretch the main FFT */
+		g_as->render_zoom.options &= ~FRO_DDC;
+		g_as->render_zoom.freq_center = g_as->zoom_center;
+		g_as->render_zoom.freq_span   = g_as->zoom_width;
+	}
 
 	/* Update render options */
 	fosphor_render_refresh(&g_as->render_main);
@@ -239,6 +558,7 @@ _update_fosphor(void)
 	/* Set other fosphor params */
 	if (g_as->fosphor) {
 		fosphor_set_power_range(g_as->fosphor, g_as->db_ref, k_db_per_div[g_as->db_per_div_idx]);
+		fosphor_set_auto_range(g_as->fosphor, g_as->auto_range);
 	}
 }
 
@@ -277,20 +597,44 @@ glfw_cb_key(GLFWwindow *wnd, int key, int scancode, int action, int mods)
 
 	case GLFW_KEY_UP:
 		g_as->db_ref -= k_db_per_div[g_as->db_per_div_idx];
+		g_as->auto_range = 0;
 		break;
 
 	case GLFW_KEY_DOWN:
 		g_as->db_ref += k_db_per_div[g_as->db_per_div_idx];
+		g_as->auto_range = 0;
 		break;
 
 	case GLFW_KEY_LEFT:
 		if (g_as->db_per_div_idx > 0)
 			g_as->db_per_div_idx--;
+		g_as->auto_range = 0;
 		break;
 
 	case GLFW_KEY_RIGHT:
 		if (g_as->db_per_div_idx < 4)
 			g_as->db_per_div_idx++;
+		g_as->auto_range = 0;
+		break;
+
+	case GLFW_KEY_R:
+		g_as->auto_range ^= 1;
+		break;
+
+	case GLFW_KEY_F:
+		g_as->pfb ^= 1;
+		if (fosphor_set_pfb(g_as->fosphor, g_as->pfb ? 4 : 0, NULL))
+			g_as->pfb = 0;
+		break;
+
+	case GLFW_KEY_K:
+		g_as->kurtosis ^= 1;
+		if (fosphor_set_kurtosis(g_as->fosphor, g_as->kurtosis))
+			g_as->kurtosis = 0;
+		if (g_as->kurtosis)
+			g_as->render_main.options |= FRO_KURTOSIS;
+		else
+			g_as->render_main.options &= ~FRO_KURTOSIS;
 		break;
 
 	case GLFW_KEY_W:
@@ -324,6 +668,50 @@ glfw_cb_key(GLFWwindow *wnd, int key, int scancode, int action, int mods)
 		break;
 	}
 
+	/* Playback control */
+	if (g_as->arc || g_as->src_map)
+	{
+		switch (key)
+		{
+		case GLFW_KEY_SPACE:
+			g_as->paused ^= 1;
+			if (!g_as->paused && g_as->arc &&
+			    (g_as->arc_row >= fosphor_rec_reader_rows(g_as->arc)))
+				play_seek(wnd, 0.0);
+			else
+				play_update_title(wnd);
+			break;
+
+		case GLFW_KEY_PAGE_UP:
+			play_seek(wnd, play_get_time() - 10.0 * g_as->speed);
+			break;
+
+		case GLFW_KEY_PAGE_DOWN:
+			play_seek(wnd, play_get_time() + 10.0 * g_as->speed);
+			break;
+
+		case GLFW_KEY_HOME:
+			play_seek(wnd, 0.0);
+			break;
+
+		case GLFW_KEY_END:
+			play_seek(wnd, play_get_duration());
+			break;
+
+		case GLFW_KEY_LEFT_BRACKET:
+			if (g_as->speed > 1)
+				g_as->speed >>= 1;
+			play_update_title(wnd);
+			break;
+
+		case GLFW_KEY_RIGHT_BRACKET:
+			if (g_as->arc && (g_as->speed < 1024))
+				g_as->speed <<= 1;
+			play_update_title(wnd);
+			break;
+		}
+	}
+
 	_update_fosphor();
 }
 
@@ -372,23 +760,118 @@ glfw_cleanup(GLFWwindow *wnd)
 /* Main                                                                     */
 /* ------------------------------------------------------------------------ */
 
+static void
+usage(const char *argv0)
+{
+	fprintf(stderr,
+		"Usage: %s [options] [filename.cfile]\n"
+		"       %s -c ENDPOINT\n"
+		"\n"
+		"  -c ENDPOINT  Display frames streamed by a remote fosphor\n"
+		"  -o ENDPOINT  Stream processed frames to remote displays\n"
+		"  -b BITS      Quantization of streamed frames (8 or 16)\n"
+		"  -H           Also stream the histogram\n"
+		"  -s NAME      Publish processed frames to shared memory\n"
+		"  -w FILE      Record the waterfall to a spectrogram archive\n"
+		"  -l FILE      Keep long-term min/mean/max spectrum rollups\n"
+		"  -r RATE      Sample rate of the raw IQ file (default 1 Msps)\n"
+		"  -f           The raw file holds real float samples, not IQ\n"
+		"  -t SECONDS   Start playback at this position\n"
+		"\n"
+		"ENDPOINT is tcp:HOST:PORT, udp:HOST:PORT or unix:PATH\n"
+		"\n"
+		"The input file can be raw IQ or a spectrogram archive. Archives are\n"
+		"played back in real time without any FFT. Playback keys :\n"
+		"  Space               Pause / resume\n"
+		"  PgUp / PgDown       Seek 10 s (times speed) backward / forward\n"
+		"  Home / End          Seek to start / end\n"
+		"  [ / ]               Archive playback speed\n"
+		"\n"
+		"R toggles the automatic power range, arrow keys set it manually.\n"
+		"F toggles the polyphase filter bank (4 taps per bin).\n"
+		"K toggles the spectral kurtosis trace (full scale 4, noise is 1).\n",
+		argv0, argv0
+	);
+}
+
 int main(int argc, char *argv[])
 {
 	GLFWwindow *wnd = NULL;
-	int rv;
+	const char *net_in = NULL, *net_out = NULL, *shm_out = NULL, *filename = NULL;
+	const char *rec_out = NULL, *rollup_out = NULL;
+	double sample_rate = 1e6, t_start = 0.0;
+	int net_bits = 8, net_histo = 0, n_streams = 1, real_input = 0;
+	int db_ref = 0, db_per_div_idx = 3;
+	int i, rv;
+
+	/* Options */
+	for (i=1; i<argc; i++)
+	{
+		if (argv[i][0] != '-' || !argv[i][1]) {
+			if (filename)
+				goto bad_args;
+			filename = argv[i];
+		} else if (!strcmp(argv[i], "-H")) {
+			net_histo = 1;
+		} else if (!strcmp(argv[i], "-f")) {
+			real_input = 1;
+		} else if (i+1 == argc) {
+			goto bad_args;
+		} else if (!strcmp(argv[i], "-c")) {
+			net_in = argv[++i];
+		} else if (!strcmp(argv[i], "-o")) {
+			net_out = argv[++i];
+		} else if (!strcmp(argv[i], "-b")) {
+			net_bits = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-s")) {
+			shm_out = argv[++i];
+		} else if (!strcmp(argv[i], "-w")) {
+			rec_out = argv[++i];
+		} else if (!strcmp(argv[i], "-l")) {
+			rollup_out = argv[++i];
+		} else if (!strcmp(argv[i], "-r")) {
+			sample_rate = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "-t")) {
+			t_start = atof(argv[++i]);
+		} else {
+			goto bad_args;
+		}
+	}
+
+	if ((net_in && filename) || !(sample_rate > 0.0))
+		goto bad_args;
 
-	/* Open source file */
-	if (argc == 2) {
-		g_as->src_fh = fopen(argv[1], "rb");
-		if (!g_as->src_fh) {
-			fprintf(stderr, "[!] Failed to open input file\n");
+	/* Open source */
+	if (net_in) {
+		const struct fosphor_net_info *info;
+
+		g_as->net_rx = fosphor_net_rx_open(net_in);
+		if (!g_as->net_rx)
+			return -EIO;
+
+		info = fosphor_net_rx_wait_info(g_as->net_rx, 5000);
+		if (!info) {
+			fprintf(stderr, "[!] No stream info received from remote fosphor\n");
+			fosphor_net_rx_close(g_as->net_rx);
 			return -EIO;
 		}
-	} else if (argc == 1) {
-		g_as->src_fh = stdin;
+
+		/* Start with the remote display settings */
+		n_streams = info->n_streams;
+		db_ref = info->db_ref;
+
+		for (i=0; i<5; i++)
+			if (k_db_per_div[i] == info->db_per_div)
+				db_per_div_idx = i;
+	} else if (filename) {
+		rv = play_open(filename);
+		if (rv)
+			goto error;
+
+		if (g_as->arc)
+			n_streams = fosphor_rec_reader_header(g_as->arc)->n_streams;
 	} else {
-		fprintf(stderr, "Usage: %s filename.cfile\n", argv[0]);
-		return -EINVAL;;
+		g_as->src_fh = stdin;
 	}
 
 	g_as->src_buf = malloc(2 * sizeof(float) * FOSPHOR_FFT_LEN * FOSPHOR_FFT_MAX_BATCH);
@@ -398,11 +881,13 @@ int main(int argc, char *argv[])
 	}
 
 	/* Init our state */
-	g_as->db_per_div_idx = 3;
-	g_as->db_ref = 0;
+	g_as->db_per_div_idx = db_per_div_idx;
+	g_as->db_ref = db_ref;
 	g_as->ratio = 0.5f;
 	g_as->zoom_center = 0.5;
 	g_as->zoom_width  = 0.2;
+	g_as->sample_rate = real_input ? (sample_rate / 2.0) : sample_rate;	/* Pairs for real input */
+	g_as->speed = 1;
 
 	/* Default fosphor render options */
 	fosphor_render_defaults(&g_as->render_main);
@@ -421,7 +906,7 @@ int main(int argc, char *argv[])
 	}
 
 	/* Init fosphor */
-	g_as->fosphor = fosphor_init();
+	g_as->fosphor = fosphor_init_multi(n_streams);
 	if (!g_as->fosphor) {
 		fprintf(stderr, "[!] Failed to initialize fosphor\n");
 		rv = -EIO;
@@ -430,6 +915,44 @@ int main(int argc, char *argv[])
 
 	fosphor_set_power_range(g_as->fosphor, g_as->db_ref, k_db_per_div[g_as->db_per_div_idx]);
 
+	/* Real input : DC to fs/2 */
+	if (real_input && !net_in) {
+		fosphor_set_real_input(g_as->fosphor, 1);
+		fosphor_set_frequency_range(g_as->fosphor, sample_rate / 4.0, sample_rate / 2.0);
+	}
+
+	/* Outputs */
+	if (shm_out && fosphor_set_shm_output(g_as->fosphor, shm_out)) {
+		rv = -EIO;
+		goto error;
+	}
+
+	if (net_out && fosphor_set_net_output(g_as->fosphor, net_out, net_bits, net_histo)) {
+		rv = -EIO;
+		goto error;
+	}
+
+	/* Playback start */
+	if (g_as->arc) {
+		const struct fosphor_rec_header *h = fosphor_rec_reader_header(g_as->arc);
+		fosphor_set_frequency_range(g_as->fosphor, h->freq_center, h->freq_span);
+	}
+
+	if (g_as->arc || g_as->src_map) {
+		g_as->t_last = time_now();
+		play_seek(wnd, t_start);
+	}
+
+	if (rec_out && fosphor_set_rec_output(g_as->fosphor, rec_out, 8, -120.0f, 0.0f)) {
+		rv = -EIO;
+		goto error;
+	}
+
+	if (rollup_out && fosphor_set_rollup_output(g_as->fosphor, rollup_out, NULL, NULL, 0)) {
+		rv = -EIO;
+		goto error;
+	}
+
 	/* Run ! */
 	while (!glfwWindowShouldClose(wnd))
 	{
@@ -448,7 +971,14 @@ error:
 		glfw_cleanup(wnd);
 
 	free(g_as->src_buf);
-	fclose(g_as->src_fh);
+
+	play_close();
+
+	fosphor_net_rx_close(g_as->net_rx);
 
 	return rv;
+
+bad_args:
+	usage(argv[0]);
+	return -EINVAL;
 }
@@ -0,0 +1,1112 @@
+/*
+ * net.c
+ *
+ * Streaming of processed frames over sockets
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*! \addtogroup net
+ *  @{
+ */
+
+/*! \file net.c
+ *  \brief Streaming of processed frames over sockets
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cl.h"
+#include "export.h"
+#include "fosphor.h"
+#include "net.h"
+#include "private.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+
+#define MAX_CLIENTS		16
+#define MAX_ROWS_PER_MSG	16
+#define MAX_LINES_PER_MSG	32
+#define MAX_BACKLOG		(16 * 1024 * 1024)
+
+/* Fixed quantization range when using 16 bits samples */
+#define Q16_DB0		-192.0f
+#define Q16_DB1		  64.0f
+
+enum net_type {
+	NET_TCP,
+	NET_UDP,
+	NET_UNIX,
+};
+
+struct net_buf
+{
+	uint8_t *data;
+	size_t len;
+	size_t size;
+};
+
+struct net_client
+{
+	int fd;
+	int synced;			/* Got INFO + full histogram */
+	struct net_buf backlog;		/* Data the socket didn't take yet */
+};
+
+struct fosphor_net
+{
+	enum net_type type;
+	int fd;				/* Listen socket, or UDP socket */
+	char unix_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+	struct net_client clients[MAX_CLIENTS];
+	int n_clients;
+
+	/* Options */
+	int n_streams;
+	int bits;
+	int histo;
+
+	/* State */
+	uint32_t frame;
+	uint64_t total_rows;
+
+	struct {
+		int db_ref;
+		int db_per_div;
+		double freq_center;
+		double freq_span;
+	} info;
+
+	uint8_t *histo_cur;		/* Quantized histograms, this frame */
+	uint8_t *histo_last;		/* Quantized histograms, as sent */
+	float row[FOSPHOR_FFT_LEN * 2];
+
+	struct net_buf buf;		/* Common data for this frame */
+	struct net_buf sync;		/* Extra data for new clients */
+};
+
+
+/* -------------------------------------------------------------------------- */
+/* Helpers                                                                    */
+/* -------------------------------------------------------------------------- */
+
+static inline void
+_put_u16(uint8_t *p, uint16_t v)
+{
+	p[0] = v; p[1] = v >> 8;
+}
+
+static inline void
+_put_u32(uint8_t *p, uint32_t v)
+{
+	p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static inline void
+_put_f32(uint8_t *p, float v)
+{
+	uint32_t u;
+	memcpy(&u, &v, 4);
+	_put_u32(p, u);
+}
+
+static inline void
+_put_f64(uint8_t *p, double v)
+{
+	uint64_t u;
+	memcpy(&u, &v, 8);
+	_put_u32(p, (uint32_t)u);
+	_put_u32(p+4, (uint32_t)(u >> 32));
+}
+
+static inline uint16_t
+_get_u16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t
+_get_u32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline float
+_get_f32(const uint8_t *p)
+{
+	uint32_t u = _get_u32(p);
+	float v;
+	memcpy(&v, &u, 4);
+	return v;
+}
+
+static inline double
+_get_f64(const uint8_t *p)
+{
+	uint64_t u = _get_u32(p) | ((uint64_t)_get_u32(p+4) << 32);
+	double v;
+	memcpy(&v, &u, 8);
+	return v;
+}
+
+
+static int
+_net_buf_reserve(struct net_buf *nb, size_t len)
+{
+	uint8_t *d;
+	size_t s;
+
+	if (nb->len + len <= nb->size)
+		return 0;
+
+	s = nb->size ? nb->size : 65536;
+	while (s < nb->len + len)
+		s <<= 1;
+
+	d = realloc(nb->data, s);
+	if (!d)
+		return -ENOMEM;
+
+	nb->data = d;
+	nb->size = s;
+
+	return 0;
+}
+
+static void
+_net_buf_free(struct net_buf *nb)
+{
+	free(nb->data);
+	memset(nb, 0, sizeof(struct net_buf));
+}
+
+
+static int
+_net_parse(const char *endpoint, enum net_type *type,
+           char *host, size_t host_len, char **port)
+{
+	const char *p;
+
+	if (!strncmp(endpoint, "tcp:", 4)) {
+		*type = NET_TCP;
+		p = endpoint + 4;
+	} else if (!strncmp(endpoint, "udp:", 4)) {
+		*type = NET_UDP;
+		p = endpoint + 4;
+	} else if (!strncmp(endpoint, "unix:", 5)) {
+		*type = NET_UNIX;
+		p = endpoint + 5;
+	} else {
+		return -EINVAL;
+	}
+
+	if (strlen(p) >= host_len)
+		return -EINVAL;
+
+	strcpy(host, p);
+
+	if (*type == NET_UNIX) {
+		*port = NULL;
+		return host[0] ? 0 : -EINVAL;
+	}
+
+	/* Port is after the last ':' */
+	*port = strrchr(host, ':');
+	if (!*port)
+		return -EINVAL;
+
+	*(*port)++ = '\0';
+
+	return 0;
+}
+
+static int
+_net_socket(const char *endpoint, int server, enum net_type *type_p,
+            char *unix_path, size_t unix_path_len)
+{
+	struct addrinfo hints, *res = NULL, *ai;
+	char host[256], *port;
+	enum net_type type;
+	int fd = -1, one = 1;
+
+	if (_net_parse(endpoint, &type, host, sizeof(host), &port)) {
+		fprintf(stderr, "[!] Invalid endpoint '%s'\n", endpoint);
+		return -1;
+	}
+
+	*type_p = type;
+
+	/* Local socket */
+	if (type == NET_UNIX)
+	{
+		struct sockaddr_un sun;
+
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+
+		if (strlen(host) >= sizeof(sun.sun_path))
+			return -1;
+
+		strcpy(sun.sun_path, host);
+
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+
+		if (server) {
+			unlink(sun.sun_path);
+			if (bind(fd, (struct sockaddr *)&sun, sizeof(sun)) || listen(fd, MAX_CLIENTS))
+				goto error;
+			if (unix_path)
+				snprintf(unix_path, unix_path_len, "%s", sun.sun_path);
+		} else {
+			if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)))
+				goto error;
+		}
+
+		return fd;
+	}
+
+	/* IP sockets */
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = (type == NET_TCP) ? SOCK_STREAM : SOCK_DGRAM;
+	hints.ai_flags    = (server == (type == NET_TCP)) ? AI_PASSIVE : 0;
+
+	if (getaddrinfo(host[0] ? host : NULL, port, &hints, &res))
+		return -1;
+
+	for (ai=res; ai; ai=ai->ai_next)
+	{
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+		if (type == NET_TCP) {
+			/* TCP : server listens, client connects */
+			if (server) {
+				if (!bind(fd, ai->ai_addr, ai->ai_addrlen) && !listen(fd, MAX_CLIENTS))
+					break;
+			} else {
+				if (!connect(fd, ai->ai_addr, ai->ai_addrlen))
+					break;
+			}
+		} else {
+			/* UDP : server pushes to the address, client binds it */
+			if (server) {
+				if (!connect(fd, ai->ai_addr, ai->ai_addrlen))
+					break;
+			} else {
+				if (!bind(fd, ai->ai_addr, ai->ai_addrlen))
+					break;
+			}
+		}
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(res);
+
+	return fd;
+
+error:
+	close(fd);
+	return -1;
+}
+
+static void
+_net_nonblock(int fd)
+{
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* Publisher                                                                  */
+/* -------------------------------------------------------------------------- */
+
+static void
+_net_client_drop(struct fosphor_net *net, int i)
+{
+	close(net->clients[i].fd);
+	_net_buf_free(&net->clients[i].backlog);
+
+	net->clients[i] = net->clients[--net->n_clients];
+	memset(&net->clients[net->n_clients], 0, sizeof(struct net_client));
+}
+
+static void
+_net_accept(struct fosphor_net *net)
+{
+	int fd, sz = 4 * 1024 * 1024;
+
+	while ((fd = accept(net->fd, NULL, NULL)) >= 0)
+	{
+		if (net->n_clients == MAX_CLIENTS) {
+			close(fd);
+			continue;
+		}
+
+		_net_nonblock(fd);
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+
+		memset(&net->clients[net->n_clients], 0, sizeof(struct net_client));
+		net->clients[net->n_clients++].fd = fd;
+	}
+}
+
+/* Sends as much as possible, queue the rest. Returns -1 if client is lost */
+static int
+_net_client_send(struct net_client *c, const uint8_t *data, size_t len)
+{
+	struct net_buf *bl = &c->backlog;
+	ssize_t rv;
+
+	/* Flush the backlog first */
+	while (bl->len) {
+		rv = send(c->fd, bl->data, bl->len, MSG_NOSIGNAL);
+		if (rv < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				break;
+			return -1;
+		}
+		memmove(bl->data, bl->data + rv, bl->len - rv);
+		bl->len -= rv;
+	}
+
+	/* Then the new data */
+	if (!bl->len) {
+		while (len) {
+			rv = send(c->fd, data, len, MSG_NOSIGNAL);
+			if (rv < 0) {
+				if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+					break;
+				return -1;
+			}
+			data += rv;
+			len  -= rv;
+		}
+	}
+
+	if (!len)
+		return 0;
+
+	/* Client too slow to ever catch up ? */
+	if (bl->len + len > MAX_BACKLOG)
+		return -1;
+
+	if (_net_buf_reserve(bl, len))
+		return -1;
+
+	memcpy(bl->data + bl->len, data, len);
+	bl->len += len;
+
+	return 0;
+}
+
+static uint8_t *
+_net_msg_begin(struct fosphor_net *net, struct net_buf *nb,
+               int type, int stream, size_t max_len)
+{
+	uint8_t *h;
+
+	if (_net_buf_reserve(nb, FOSPHOR_NET_HDR_LEN + max_len))
+		return NULL;
+
+	h = nb->data + nb->len;
+
+	_put_u32(&h[0], FOSPHOR_NET_MAGIC);
+	h[4] = FOSPHOR_NET_VERSION;
+	h[5] = type;
+	h[6] = stream;
+	h[7] = net->bits;
+	_put_u32(&h[8], net->frame);
+
+	return h + FOSPHOR_NET_HDR_LEN;
+}
+
+static void
+_net_msg_end(struct fosphor_net *net, struct net_buf *nb, size_t len)
+{
+	uint8_t *h = nb->data + nb->len;
+
+	_put_u32(&h[12], len);
+
+	if (net->type == NET_UDP) {
+		/* One datagram per message, losses are fine */
+		send(net->fd, h, FOSPHOR_NET_HDR_LEN + len, MSG_NOSIGNAL);
+	} else {
+		nb->len += FOSPHOR_NET_HDR_LEN + len;
+	}
+}
+
+static void
+_net_msg_info(struct fosphor_net *net, struct net_buf *nb)
+{
+	uint8_t *p = _net_msg_begin(net, nb, FOSPHOR_NET_MSG_INFO, 0, 32);
+	if (!p)
+		return;
+
+	_put_u32(&p[ 0], net->n_streams);
+	_put_u32(&p[ 4], FOSPHOR_FFT_LEN);
+	_put_u32(&p[ 8], net->info.db_ref);
+	_put_u32(&p[12], net->info.db_per_div);
+	_put_f64(&p[16], net->info.freq_center);
+	_put_f64(&p[24], net->info.freq_span);
+
+	_net_msg_end(net, nb, 32);
+}
+
+static void
+_net_msg_histo(struct fosphor_net *net, struct net_buf *nb,
+               int stream, int line, int n_lines)
+{
+	const size_t line_len = FOSPHOR_FFT_LEN;
+	uint8_t *p;
+
+	p = _net_msg_begin(net, nb, FOSPHOR_NET_MSG_HISTO, stream, 4 + n_lines * line_len);
+	if (!p)
+		return;
+
+	_put_u16(&p[0], line);
+	_put_u16(&p[2], n_lines);
+
+	memcpy(&p[4],
+		&net->histo_cur[((stream * FOSPHOR_EXPORT_HISTO_BINS) + line) * line_len],
+		n_lines * line_len);
+
+	_net_msg_end(net, nb, 4 + n_lines * line_len);
+}
+
+static void
+_net_msgs_histo_full(struct fosphor_net *net, struct net_buf *nb)
+{
+	int s, l;
+
+	for (s=0; s<net->n_streams; s++)
+		for (l=0; l<FOSPHOR_EXPORT_HISTO_BINS; l+=MAX_LINES_PER_MSG)
+			_net_msg_histo(net, nb, s, l, MAX_LINES_PER_MSG);
+}
+
+static void
+_net_msgs_histo_delta(struct fosphor_net *net, struct net_buf *nb)
+{
+	const size_t line_len = FOSPHOR_FFT_LEN;
+	int s, l, run;
+
+	for (s=0; s<net->n_streams; s++)
+	{
+		run = 0;
+
+		for (l=0; l<=FOSPHOR_EXPORT_HISTO_BINS; l++)
+		{
+			size_t o = ((s * FOSPHOR_EXPORT_HISTO_BINS) + l) * line_len;
+			int changed = (l < FOSPHOR_EXPORT_HISTO_BINS) &&
+			              memcmp(&net->histo_cur[o], &net->histo_last[o], line_len);
+
+			/* Send runs of changed lines */
+			if (changed && (run < MAX_LINES_PER_MSG)) {
+				run++;
+				continue;
+			}
+
+			if (run)
+				_net_msg_histo(net, nb, s, l - run, run);
+
+			run = changed ? 1 : 0;
+		}
+	}
+}
+
+
+struct fosphor_net *
+fosphor_net_create(const char *endpoint, int n_streams, int bits, int histo)
+{
+	struct fosphor_net *net;
+	size_t hl;
+
+	if ((bits != 8) && (bits != 16))
+		return NULL;
+
+	/* Allocate structure */
+	net = malloc(sizeof(struct fosphor_net));
+	if (!net)
+		return NULL;
+
+	memset(net, 0, sizeof(struct fosphor_net));
+
+	net->n_streams = n_streams;
+	net->bits      = bits;
+	net->histo     = histo;
+
+	/* Histogram state */
+	if (histo) {
+		hl = n_streams * FOSPHOR_EXPORT_HISTO_BINS * FOSPHOR_FFT_LEN;
+
+		net->histo_cur  = calloc(hl, 1);
+		net->histo_last = calloc(hl, 1);
+
+		if (!net->histo_cur || !net->histo_last)
+			goto error;
+	}
+
+	/* Socket */
+	net->fd = _net_socket(endpoint, 1, &net->type, net->unix_path, sizeof(net->unix_path));
+	if (net->fd < 0) {
+		fprintf(stderr, "[!] Unable to setup network output '%s'\n", endpoint);
+		goto error;
+	}
+
+	_net_nonblock(net->fd);
+
+	return net;
+
+	/* Error path */
+error:
+	free(net->histo_cur);
+	free(net->histo_last);
+	free(net);
+
+	return NULL;
+}
+
+void
+fosphor_net_destroy(struct fosphor_net *net)
+{
+	if (!net)
+		return;
+
+	while (net->n_clients)
+		_net_client_drop(net, 0);
+
+	close(net->fd);
+
+	if (net->unix_path[0])
+		unlink(net->unix_path);
+
+	_net_buf_free(&net->buf);
+	_net_buf_free(&net->sync);
+
+	free(net->histo_cur);
+	free(net->histo_last);
+	free(net);
+}
+
+void
+fosphor_net_publish(struct fosphor_net *net, struct fosphor *fosphor,
+                    int new_rows)
+{
+	const int bps = net->bits >> 3;
+	int info_changed, keyframe, need_sync;
+	int pos, s, i, j, n;
+	float q0, q1;
+	uint8_t *p;
+
+	pos = fosphor_cl_get_waterfall_position(fosphor);
+
+	/* Clients management */
+	if (net->type != NET_UDP)
+	{
+		_net_accept(net);
+
+		/* Nobody listening ? Just keep the row count right */
+		if (!net->n_clients) {
+			net->total_rows += new_rows;
+			return;
+		}
+	}
+
+	net->frame++;
+
+	/* Quantization range */
+	if (net->bits == 8) {
+		fosphor_export_power_bounds(fosphor, &q0, &q1);
+	} else {
+		q0 = Q16_DB0;
+		q1 = Q16_DB1;
+	}
+
+	/* What to send */
+	info_changed =
+		(net->info.db_ref      != fosphor->power.db_ref) ||
+		(net->info.db_per_div  != fosphor->power.db_per_div) ||
+		(net->info.freq_center != fosphor->frequency.center) ||
+		(net->info.freq_span   != fosphor->frequency.span);
+
+	net->info.db_ref      = fosphor->power.db_ref;
+	net->info.db_per_div  = fosphor->power.db_per_div;
+	net->info.freq_center = fosphor->frequency.center;
+	net->info.freq_span   = fosphor->frequency.span;
+
+	keyframe = (net->type == NET_UDP) && !(net->frame % FOSPHOR_NET_KEYFRAME);
+
+	need_sync = 0;
+	for (i=0; i<net->n_clients; i++)
+		need_sync |= !net->clients[i].synced;
+
+	/* Current histograms */
+	if (net->histo)
+	{
+		for (s=0; s<net->n_streams; s++)
+		{
+			uint8_t *h = &net->histo_cur[s * FOSPHOR_EXPORT_HISTO_BINS * FOSPHOR_FFT_LEN];
+
+			for (i=0; i<FOSPHOR_EXPORT_HISTO_BINS; i++)
+			{
+				/* Line by line, to avoid a full float copy */
+				fosphor_export_histogram_line(fosphor, s, i, net->row);
+
+				for (j=0; j<FOSPHOR_FFT_LEN; j++)
+					h[j] = (uint8_t)(net->row[j] * 255.0f + 0.5f);
+
+				h += FOSPHOR_FFT_LEN;
+			}
+		}
+	}
+
+	/* Sync data for new clients */
+	net->sync.len = 0;
+
+	if (need_sync) {
+		_net_msg_info(net, &net->sync);
+		if (net->histo)
+			_net_msgs_histo_full(net, &net->sync);
+	}
+
+	/* Common data */
+	net->buf.len = 0;
+
+	if (info_changed || keyframe)
+		_net_msg_info(net, &net->buf);
+
+	for (s=0; s<net->n_streams; s++)
+	{
+		/* Waterfall rows */
+		for (i=0; i<new_rows; i+=n)
+		{
+			n = new_rows - i;
+			if (n > MAX_ROWS_PER_MSG)
+				n = MAX_ROWS_PER_MSG;
+
+			p = _net_msg_begin(net, &net->buf, FOSPHOR_NET_MSG_WF_ROWS, s,
+				16 + n * FOSPHOR_FFT_LEN * bps);
+			if (!p)
+				break;
+
+			_put_u32(&p[0], (uint32_t)(net->total_rows + i));
+			_put_u16(&p[4], n);
+			_put_u16(&p[6], 0);
+			_put_f32(&p[8], q0);
+			_put_f32(&p[12], q1);
+
+			for (j=0; j<n; j++) {
+				fosphor_export_waterfall_row(fosphor, s, pos - new_rows + i + j, net->row);
+				fosphor_export_quantize(&p[16 + j * FOSPHOR_FFT_LEN * bps], net->row, FOSPHOR_FFT_LEN, net->bits, q0, q1);
+			}
+
+			_net_msg_end(net, &net->buf, 16 + n * FOSPHOR_FFT_LEN * bps);
+		}
+
+		/* Live and max-hold spectra */
+		p = _net_msg_begin(net, &net->buf, FOSPHOR_NET_MSG_SPECTRUM, s,
+			8 + 2 * FOSPHOR_FFT_LEN * bps);
+		if (p) {
+			_put_f32(&p[0], q0);
+			_put_f32(&p[4], q1);
+
+			fosphor_export_spectrum(fosphor, s, net->row, net->row + FOSPHOR_FFT_LEN);
+			fosphor_export_quantize(&p[8], net->row, 2 * FOSPHOR_FFT_LEN, net->bits, q0, q1);
+
+			_net_msg_end(net, &net->buf, 8 + 2 * FOSPHOR_FFT_LEN * bps);
+		}
+	}
+
+	if (net->histo) {
+		if (keyframe)
+			_net_msgs_histo_full(net, &net->buf);
+		else
+			_net_msgs_histo_delta(net, &net->buf);
+
+		memcpy(net->histo_last, net->histo_cur,
+			net->n_streams * FOSPHOR_EXPORT_HISTO_BINS * FOSPHOR_FFT_LEN);
+	}
+
+	net->total_rows += new_rows;
+
+	/* Send to all clients (UDP was sent as we went) */
+	for (i=net->n_clients-1; i>=0; i--)
+	{
+		struct net_client *c = &net->clients[i];
+		int err = 0;
+
+		if (!c->synced) {
+			err = _net_client_send(c, net->sync.data, net->sync.len);
+			c->synced = 1;
+		}
+
+		if (!err)
+			err = _net_client_send(c, net->buf.data, net->buf.len);
+
+		if (err) {
+			fprintf(stderr, "[w] Network client lost or too slow, dropping it\n");
+			_net_client_drop(net, i);
+		}
+	}
+}
+
+int
+fosphor_net_has_histogram(struct fosphor_net *net)
+{
+	return net->histo;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* Receiver                                                                   */
+/* -------------------------------------------------------------------------- */
+
+struct fosphor_net_rx
+{
+	enum net_type type;
+	int fd;
+
+	struct fosphor_net_info info;
+	int has_info;
+	int info_changed;
+
+	struct net_buf buf;
+	float data[2 * MAX_ROWS_PER_MSG * FOSPHOR_FFT_LEN];
+};
+
+
+static int
+_net_rx_handle(struct fosphor_net_rx *rx, struct fosphor *fosphor,
+               const uint8_t *h, const uint8_t *p, uint32_t len)
+{
+	int type = h[5], stream = h[6], bits = h[7];
+	int bps = bits >> 3;
+	int i, n;
+
+	if (h[4] != FOSPHOR_NET_VERSION)
+		return -EINVAL;
+
+	if (type == FOSPHOR_NET_MSG_INFO)
+	{
+		struct fosphor_net_info info;
+
+		if (len < 32)
+			return -EINVAL;
+
+		memset(&info, 0, sizeof(info));
+
+		info.n_streams   = _get_u32(&p[0]);
+		info.db_ref      = (int32_t)_get_u32(&p[8]);
+		info.db_per_div  = (int32_t)_get_u32(&p[12]);
+		info.freq_center = _get_f64(&p[16]);
+		info.freq_span   = _get_f64(&p[24]);
+
+		if ((_get_u32(&p[4]) != FOSPHOR_FFT_LEN) ||
+		    (info.n_streams < 1) || (info.n_streams > FOSPHOR_MAX_STREAMS))
+			return -EINVAL;
+
+		/* Stream count can't change under our feet */
+		if (rx->has_info && (info.n_streams != rx->info.n_streams))
+			return -EINVAL;
+
+		rx->info_changed |= !rx->has_info || memcmp(&info, &rx->info, sizeof(info));
+		rx->info = info;
+		rx->has_info = 1;
+
+		if (fosphor && rx->info_changed) {
+			fosphor_set_power_range(fosphor, info.db_ref, info.db_per_div);
+			fosphor_set_frequency_range(fosphor, info.freq_center, info.freq_span);
+			rx->info_changed = 0;
+		}
+
+		return 0;
+	}
+
+	/* Everything else needs a display with a known layout */
+	if (!fosphor || !rx->has_info || (stream >= rx->info.n_streams))
+		return 0;
+
+	if ((bits != 8) && (bits != 16))
+		return -EINVAL;
+
+	switch (type)
+	{
+	case FOSPHOR_NET_MSG_WF_ROWS:
+	{
+		uint32_t row;
+
+		if (len < 16)
+			return -EINVAL;
+
+		row = _get_u32(&p[0]);
+		n   = _get_u16(&p[4]);
+
+		if ((n > MAX_ROWS_PER_MSG) || (len < (uint32_t)(16 + n * FOSPHOR_FFT_LEN * bps)))
+			return -EINVAL;
+
+		fosphor_import_dequantize(rx->data, &p[16], n * FOSPHOR_FFT_LEN, bits,
+			_get_f32(&p[8]), _get_f32(&p[12]));
+
+		fosphor_load_waterfall(fosphor, stream, row & 1023, rx->data, n);
+		fosphor_set_waterfall_position(fosphor, (row + n) & 1023);
+		break;
+	}
+
+	case FOSPHOR_NET_MSG_SPECTRUM:
+		if (len < (uint32_t)(8 + 2 * FOSPHOR_FFT_LEN * bps))
+			return -EINVAL;
+
+		fosphor_import_dequantize(rx->data, &p[8], 2 * FOSPHOR_FFT_LEN, bits,
+			_get_f32(&p[0]), _get_f32(&p[4]));
+
+		fosphor_load_spectrum(fosphor, stream, rx->data, rx->data + FOSPHOR_FFT_LEN);
+		break;
+
+	case FOSPHOR_NET_MSG_HISTO:
+	{
+		int line;
+
+		if (len < 4)
+			return -EINVAL;
+
+		line = _get_u16(&p[0]);
+		n    = _get_u16(&p[2]);
+
+		if ((n > MAX_LINES_PER_MSG) || (len < (uint32_t)(4 + n * FOSPHOR_FFT_LEN)))
+			return -EINVAL;
+
+		for (i=0; i<n*FOSPHOR_FFT_LEN; i++)
+			rx->data[i] = (float)p[4+i] * (1.0f / 255.0f);
+
+		fosphor_load_histogram(fosphor, stream, line, rx->data, n);
+		break;
+	}
+
+	default:
+		/* Unknown messages are skipped */
+		break;
+	}
+
+	return 0;
+}
+
+static int
+_net_rx_read(struct fosphor_net_rx *rx, struct fosphor *fosphor)
+{
+	struct net_buf *nb = &rx->buf;
+	int n_msg = 0, rv;
+	ssize_t l;
+
+	/* UDP : Each datagram is a message */
+	if (rx->type == NET_UDP)
+	{
+		if (_net_buf_reserve(nb, 65536))
+			return -ENOMEM;
+
+		while ((l = recv(rx->fd, nb->data, 65536, MSG_DONTWAIT)) > 0)
+		{
+			if ((l < FOSPHOR_NET_HDR_LEN) ||
+			    (_get_u32(nb->data) != FOSPHOR_NET_MAGIC) ||
+			    (_get_u32(&nb->data[12]) > l - FOSPHOR_NET_HDR_LEN))
+				continue;
+
+			rv = _net_rx_handle(rx, fosphor, nb->data,
+				nb->data + FOSPHOR_NET_HDR_LEN, _get_u32(&nb->data[12]));
+			if (!rv)
+				n_msg++;
+		}
+
+		return n_msg;
+	}
+
+	/* Stream : Accumulate and split */
+	while (1)
+	{
+		if (_net_buf_reserve(nb, 65536))
+			return -ENOMEM;
+
+		l = recv(rx->fd, nb->data + nb->len, nb->size - nb->len, MSG_DONTWAIT);
+		if (l == 0)
+			return -EPIPE;
+		if (l < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				break;
+			return -EIO;
+		}
+
+		nb->len += l;
+	}
+
+	while (nb->len >= FOSPHOR_NET_HDR_LEN)
+	{
+		size_t ml;
+
+		/* Without display, only look for INFO and keep the rest */
+		if (!fosphor && rx->has_info)
+			break;
+
+		if (_get_u32(nb->data) != FOSPHOR_NET_MAGIC)
+			return -EINVAL;
+
+		ml = FOSPHOR_NET_HDR_LEN + _get_u32(&nb->data[12]);
+		if (nb->len < ml)
+			break;
+
+		rv = _net_rx_handle(rx, fosphor, nb->data,
+			nb->data + FOSPHOR_NET_HDR_LEN, ml - FOSPHOR_NET_HDR_LEN);
+		if (rv)
+			return rv;
+
+		memmove(nb->data, nb->data + ml, nb->len - ml);
+		nb->len -= ml;
+		n_msg++;
+	}
+
+	return n_msg;
+}
+
+
+struct fosphor_net_rx *
+fosphor_net_rx_open(const char *endpoint)
+{
+	struct fosphor_net_rx *rx;
+
+	rx = malloc(sizeof(struct fosphor_net_rx));
+	if (!rx)
+		return NULL;
+
+	memset(rx, 0, sizeof(struct fosphor_net_rx));
+
+	rx->fd = _net_socket(endpoint, 0, &rx->type, NULL, 0);
+	if (rx->fd < 0) {
+		fprintf(stderr, "[!] Unable to connect to '%s'\n", endpoint);
+		free(rx);
+		return NULL;
+	}
+
+	return rx;
+}
+
+void
+fosphor_net_rx_close(struct fosphor_net_rx *rx)
+{
+	if (!rx)
+		return;
+
+	close(rx->fd);
+	_net_buf_free(&rx->buf);
+	free(rx);
+}
+
+const struct fosphor_net_info *
+fosphor_net_rx_wait_info(struct fosphor_net_rx *rx, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = rx->fd, .events = POLLIN };
+
+	while (!rx->has_info)
+	{
+		if (poll(&pfd, 1, timeout_ms) <= 0)
+			return NULL;
+
+		/* Only INFO gets used until there is a display */
+		if (_net_rx_read(rx, NULL) < 0)
+			return NULL;
+	}
+
+	return &rx->info;
+}
+
+int
+fosphor_net_rx_poll(struct fosphor_net_rx *rx, struct fosphor *fosphor)
+{
+	int rv;
+
+	rv = _net_rx_read(rx, fosphor);
+	if (rv < 0)
+		return rv;
+
+	/* First INFO may have arrived before we had a display */
+	if (rx->info_changed) {
+		fosphor_set_power_range(fosphor, rx->info.db_ref, rx->info.db_per_div);
+		fosphor_set_frequency_range(fosphor, rx->info.freq_center, rx->info.freq_span);
+		rx->info_changed = 0;
+	}
+
+	return rv;
+}
+
+#else /* _WIN32 */
+
+struct fosphor_net *
+fosphor_net_create(const char *endpoint, int n_streams, int bits, int histo)
+{
+	fprintf(stderr, "[!] Network output not supported on this platform\n");
+	return NULL;
+}
+
+void
+fosphor_net_destroy(struct fosphor_net *net)
+{
+}
+
+void
+fosphor_net_publish(struct fosphor_net *net, struct fosphor *fosphor,
+                    int new_rows)
+{
+}
+
+int
+fosphor_net_has_histogram(struct fosphor_net *net)
+{
+	return 0;
+}
+
+struct fosphor_net_rx *
+fosphor_net_rx_open(const char *endpoint)
+{
+	fprintf(stderr, "[!] Network display not supported on this platform\n");
+	return NULL;
+}
+
+void
+fosphor_net_rx_close(struct fosphor_net_rx *rx)
+{
+}
+
+const struct fosphor_net_info *
+fosphor_net_rx_wait_info(struct fosphor_net_rx *rx, int timeout_ms)
+{
+	return NULL;
+}
+
+int
+fosphor_net_rx_poll(struct fosphor_net_rx *rx, struct fosphor *fosphor)
+{
+	return -ENOTSUP;
+}
+
+#endif /* _WIN32 */
+
+
+/*! @} */
@@ -0,0 +1,86 @@
+/*
+ * net.h
+ *
+ * Streaming of processed frames over sockets
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+/*! \defgroup net
+ *  @{
+ */
+
+/*! \file net.h
+ *  \brief Streaming of processed frames over sockets
+ *
+ *  Endpoints are given as :
+ *
+ *   - "tcp:HOST:PORT"  : server listens (HOST may be empty), client connects
+ *   - "unix:PATH"      : same, on a local stream socket
+ *   - "udp:HOST:PORT"  : server sends datagrams there, client binds to it
+ *
+ *  The stream is a sequence of messages, each made of a 16 bytes header
+ *  followed by `len` bytes of payload. Everything is little endian. Over
+ *  UDP each datagram carries exactly one message.
+ *
+ *  Header :
+ *   u32 magic ("FOSN")  u8 version  u8 type  u8 stream  u8 bits
+ *   u32 frame           u32 len
+ *
+ *  Payloads (rows are lowest frequency first, see export.h) :
+ *
+ *   INFO     : u32 n_streams  u32 fft_len  i32 db_ref  i32 db_per_div
+ *              f64 freq_center  f64 freq_span
+ *   WF_ROWS  : u32 first_row  u16 n_rows  u16 0  f32 q_db0  f32 q_db1
+ *              n_rows * fft_len quantized samples
+ *   SPECTRUM : f32 q_db0  f32 q_db1
+ *              fft_len quantized live samples then fft_len max-hold ones
+ *   HISTO    : u16 first_line  u16 n_lines
+ *              n_lines * fft_len u8 densities (255 = 1.0)
+ *
+ *  Quantized samples are `bits` (8 or 16) wide and map linearly
+ *  0 -> q_db0 and (2^bits - 1) -> q_db1. `first_row` is an absolute row
+ *  counter, its 10 LSBs give the position in the waterfall ring.
+ *
+ *  Histogram lines are only sent when they changed, so receivers must
+ *  keep the previous state. INFO and the full histogram are sent to any
+ *  new client, and every FOSPHOR_NET_KEYFRAME frames over UDP.
+ */
+
+#include <stdint.h>
+
+struct fosphor;
+
+
+#define FOSPHOR_NET_MAGIC	0x4e534f46	/* "FOSN" */
+#define FOSPHOR_NET_VERSION	1
+
+#define FOSPHOR_NET_HDR_LEN	16
+#define FOSPHOR_NET_KEYFRAME	64
+
+enum fosphor_net_msg_type {
+	FOSPHOR_NET_MSG_INFO		= 1,
+	FOSPHOR_NET_MSG_WF_ROWS		= 2,
+	FOSPHOR_NET_MSG_SPECTRUM	= 3,
+	FOSPHOR_NET_MSG_HISTO		= 4,
+};
+
+
+/* Publisher */
+
+struct fosphor_net;
+
+struct fosphor_net *fosphor_net_create(const char *endpoint, int n_streams,
+                                       int bits, int histo);
+void fosphor_net_destroy(struct fosphor_net *net);
+void fosphor_net_publish(struct fosphor_net *net, struct fosphor *fosphor,
+                         int new_rows);
+int  fosphor_net_has_histogram(struct fosphor_net *net);
+
+/* The receiver API is public, see fosphor.h */
+
+
+/*! @} */
@@ -0,0 +1,33 @@
+/*
+ * plot_fragment.glsl
+ *
+ * Plot shader (spectrum traces, grid & overlays) - Fragment part
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Note (to make it clear): for the purpose of this license, any software
+ * making use of this shader (or derivative thereof) is considered to be
+ * a derivative work (i.e. "a work based on the program").
+ */
+
+#version 120
+
+
+/* ------------------------------------------------------------------------ */
+/* Main fragment shader code                                                */
+/* ------------------------------------------------------------------------ */
+
+/* In/Out */
+
+varying vec4 v_color;
+
+
+/* Shader main */
+
+void main()
+{
+	gl_FragColor = v_color;
+}
+
+/* vim: set syntax=c: */
@@ -0,0 +1,47 @@
+/*
+ * plot_vertex.glsl
+ *
+ * Plot shader (spectrum traces, grid & overlays) - Vertex part
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Note (to make it clear): for the purpose of this license, any software
+ * making use of this shader (or derivative thereof) is considered to be
+ * a derivative work (i.e. "a work based on the program").
+ */
+
+/* Only GLSL 1.2 so it works on anything that can do VBOs and shaders.
+ * The projection is still the one setup by the application.
+ */
+
+#version 120
+
+
+/* ------------------------------------------------------------------------ */
+/* Main vertex shader code                                                  */
+/* ------------------------------------------------------------------------ */
+
+/* Uniforms */
+
+uniform vec4 xform;		/* (x scale, x offset, y scale, y offset) */
+
+
+/* In/Out */
+
+attribute vec2 pos;		/* Position (before xform) */
+attribute vec4 color;		/* Color (constant attribute for traces) */
+
+varying vec4 v_color;
+
+
+/* Shader main */
+
+void main()
+{
+	vec2 p = pos * xform.xz + xform.yw;
+	gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 0.0, 1.0);
+	v_color = color;
+}
+
+/* vim: set syntax=c: */
@@ -17,6 +17,8 @@
  *  \brief Private fosphor definitions
  */
 
+#include <stdint.h>
+
 
 #define FOSPHOR_FFT_LEN_LOG	10
 #define FOSPHOR_FFT_LEN		(1<<FOSPHOR_FFT_LEN_LOG)
@@ -24,8 +26,49 @@
 #define FOSPHOR_FFT_MULT_BATCH	16
 #define FOSPHOR_FFT_MAX_BATCH	1024
 
+/* Polyphase filter bank: max taps per bin, and input history kept for it */
+#define FOSPHOR_PFB_MAX_TAPS	8
+#define FOSPHOR_PFB_HIST_LEN	((FOSPHOR_PFB_MAX_TAPS - 1) * FOSPHOR_FFT_LEN)
+
+/* Max-reduced waterfall levels (1/2 .. 1/16 of the width), stored side by
+ * side in a FOSPHOR_FFT_LEN wide image, level l at column N - (N >> (l-1)) */
+#define FOSPHOR_WF_RED_LEVELS	4
+#define FOSPHOR_WF_RED_WIDTH	(FOSPHOR_FFT_LEN - (FOSPHOR_FFT_LEN >> FOSPHOR_WF_RED_LEVELS))
+
+/* Zoom down-converter: power of 2 decimation, FIR of 32 taps per unit of
+ * decimation, output processed by batches of FOSPHOR_FFT_MULT_BATCH */
+#define FOSPHOR_ZOOM_MAX_DECIM	256
+#define FOSPHOR_ZOOM_TAPS_MULT	32
+#define FOSPHOR_ZOOM_MAX_TAPS	(FOSPHOR_ZOOM_TAPS_MULT * FOSPHOR_ZOOM_MAX_DECIM)
+
+/* Peak detection results: per stream, one header (count, noise floor,
+ * total found) then up to FOSPHOR_PEAKS_MAX entries (bin, power, -3 dB
+ * width in bins, max hold power), all as float4 (must match display.cl) */
+#define FOSPHOR_PEAKS_MAX	128
+
+/* Band power measurements (same as FOSPHOR_MAX_CHANNELS). Results are
+ * per stream and band : linear sum, peak, # spectra above threshold and
+ * # spectra, as float4 (must match display.cl) */
+#define FOSPHOR_BANDS_MAX	8
+
+/* Steps of the occupancy rolling window */
+#define FOSPHOR_OCC_SLOTS	16
+
+/* Live trace exponential averaging factor (per spectrum) */
+#define FOSPHOR_LIVE_ALPHA	0.002f
+
+/* Rows of the cross-spectrum phase waterfall (one per frame) */
+#define FOSPHOR_XS_WF_LEN	256
+
+/* Rows of the spectral kurtosis waterfall (one per frame and stream) */
+#define FOSPHOR_SK_WF_LEN	256
+
 struct fosphor_cl_state;
 struct fosphor_gl_state;
+struct fosphor_shm;
+struct fosphor_net;
+struct fosphor_rec;
+struct fosphor_rollup;
 
 struct fosphor
 {
@@ -33,14 +76,35 @@ struct fosphor
 	struct fosphor_gl_state *gl;
 
 #define FLG_FOSPHOR_USE_CLGL_SHARING	(1<<0)
+#define FLG_FOSPHOR_HOST_READBACK	(1<<1)
+#define FLG_FOSPHOR_GL_STALE		(1<<2)
+#define FLG_FOSPHOR_FRAME_SEEN		(1<<3)
+#define FLG_FOSPHOR_FRAME_DRAWN		(1<<4)
+#define FLG_FOSPHOR_HIDDEN		(1<<5)
+#define FLG_FOSPHOR_REPLAY		(1<<6)
 	int flags;
 
+	int n_streams;
+	int real_input;		/* Pairs of real samples instead of IQ */
+	uint64_t spectra;	/* Per stream, handed to the device since init */
+
 	float fft_win[FOSPHOR_FFT_LEN];
 
+	/* Polyphase filter bank front end (replaces the window when enabled) */
+	struct {
+		int m;			/* Taps per bin, 0 when disabled */
+		float taps[FOSPHOR_PFB_MAX_TAPS * FOSPHOR_FFT_LEN];
+	} pfb;
+
 	float *img_waterfall;
+	float *img_waterfall_red;	/* Only without CL/GL sharing */
 	float *img_histogram;
 	float *buf_spectrum;
 
+	float *img_zoom_waterfall;	/* Only without CL/GL sharing */
+	float *img_zoom_histogram;
+	float *buf_zoom_spectrum;
+
 	struct {
 		int db_ref;
 		int db_per_div;
@@ -52,6 +116,146 @@ struct fosphor
 		double center;
 		double span;
 	} frequency;
+
+	/* Outputs (exporting processed frames) */
+	struct fosphor_shm *shm;
+	struct fosphor_net *net;
+	struct fosphor_rec *rec;
+	struct fosphor_rollup *rollup;
+
+	/* Products to compute (union of what's drawn and exported) */
+#define FOSPHOR_PROD_WATERFALL	(1<<0)
+#define FOSPHOR_PROD_HISTO	(1<<1)
+#define FOSPHOR_PROD_LIVE	(1<<2)
+#define FOSPHOR_PROD_MAX_HOLD	(1<<3)
+#define FOSPHOR_PROD_ALL	0xf
+#define FOSPHOR_PROD_KURTOSIS	(1<<4)	/* Measurement, added by the CL side */
+#define FOSPHOR_PROD_WF_RED	(1<<5)	/* Reduced waterfall, added by the GL side */
+	int products;		/* Used by the compute */
+	int products_drawn;	/* Drawn since the last frame */
+	int products_view;	/* Drawn during the last visible frame */
+	int products_out;	/* Needed by the outputs */
+
+	/* Max-reduced waterfall levels (only kept up to date while drawn) */
+	struct {
+		int valid;		/* Follow the waterfall, set by the CL side */
+		int rows;		/* Rows of 'img_waterfall_red' not in GL yet */
+		int pos;		/* Row following the last of them */
+	} wf_red;
+
+	/* Zoom down-converter */
+	struct {
+		int decim;		/* 1 when disabled */
+		double center;		/* Normalized center frequency */
+	} zoom;
+
+	/* Peak detection (run at each frame when enabled) */
+	struct {
+		int enabled;
+		float threshold;	/* Above noise floor, in log10 units */
+		float *buf;		/* Results of the last frame */
+	} peaks;
+
+	/* Band power measurements (run at each batch when enabled) */
+	struct {
+		int n;			/* Measured bands, 0 when disabled */
+		float center[FOSPHOR_BANDS_MAX];	/* Normalized */
+		float width[FOSPHOR_BANDS_MAX];
+		float threshold_db;	/* Duty cycle threshold */
+		float enbw;		/* Window equivalent noise bandwidth (bins) */
+		int fresh;		/* New results in 'raw' */
+		float *raw;		/* Last frame (from the device) */
+		float *acc;		/* Accumulated since last read */
+		float *last;		/* Last frame mean power (dB) */
+		float trig_db;		/* Trigger threshold, NAN when disabled */
+		int *trig;		/* Last frame first spectrum above it, -1 = none */
+		uint64_t trig_base;	/* Absolute index of the frame first spectrum */
+		int trig_fired;		/* Unread trigger below */
+		uint64_t trig_spectrum;	/* Earliest spectrum above the threshold */
+		int trig_stream;
+		int trig_band;
+	} bands;
+
+	/* Histogram percentiles (computed on request) */
+	struct {
+		int enabled;
+		float p_low;		/* Noise floor percentile [0,1] */
+		int requested;		/* To compute at the next frame */
+		unsigned int seq;	/* Results generation, 0 = none yet */
+		float *buf;		/* [stream][bin] (low, p50, p90, total) */
+	} pct;
+
+	/* Occupancy (counted on the device for every spectrum, rolled over
+	 * the window here in FOSPHOR_OCC_SLOTS steps) */
+	struct {
+		int enabled;
+		int window;		/* In spectra */
+		unsigned int *raw;	/* [stream][bin] Counts of the last frame */
+		int raw_spectra;	/* Spectra in 'raw', 0 = nothing new */
+		unsigned int *slots;	/* [slot][stream][bin] Counts */
+		int slot_spectra[FOSPHOR_OCC_SLOTS];
+		int slot;		/* Current slot */
+		unsigned int *sum;	/* [stream][bin] Counts over all slots */
+		int sum_spectra;
+		float *cur;		/* [stream][bin] Occupancy */
+		unsigned int seq;	/* Bumped when 'cur' is updated */
+	} occ;
+
+	/* Long-term rollups statistics (accumulated on the device for every
+	 * spectrum, handed to the rollups output at each frame) */
+	struct {
+		float *raw;		/* [stream][bin] (min, max, sum, -), FFT order */
+		int raw_spectra;	/* Spectra in 'raw', 0 = nothing new */
+	} rollup_stats;
+
+	/* Cross-spectrum of the first two streams (averaged on the device,
+	 * one phase waterfall row kept here at each frame) */
+	struct {
+		int enabled;
+		int fresh;		/* New results in 'raw' */
+		float *raw;		/* [bin] (coherence, phase, cross, -), FFT order */
+		float *phase_wf;	/* [row][bin] Phase, FFT order */
+		int wf_pos;		/* Next row to write */
+		unsigned int seq;	/* Bumped at each new row, 0 = none yet */
+	} xs;
+
+	/* Spectral kurtosis (power moments summed on the device by the
+	 * display kernel, estimator computed here at each frame) */
+	struct {
+		int enabled;
+		int fresh;		/* New results in 'raw' */
+		float *raw;		/* [stream][bin] (S2, S4, M, -), FFT order */
+		float *cur;		/* [stream][bin] (SK, power std dev), FFT order */
+		float *wf;		/* [stream][row][bin] SK, FFT order */
+		int wf_pos;		/* Next row to write */
+		int m;			/* Spectra behind the last estimate */
+		unsigned int seq;	/* Bumped at each new row, 0 = none yet */
+	} sk;
+
+	/* Limit mask compliance (checked on the device for every spectrum) */
+	struct {
+		int enabled;
+		float *level;		/* [bin] Limit (dB), display order */
+		float *viol;		/* [stream][bin] (count, excess), FFT order */
+		unsigned int gen;	/* Mask generation, bumped at each change */
+		unsigned int seq;	/* Violations readback generation */
+	} mask;
+
+	/* Automatic power range (statistics run at each frame when enabled) */
+	struct {
+		int enabled;
+		int fresh;		/* New statistics in 'stats' */
+		float *stats;		/* [stream] (noise floor, peak, mean, -) */
+		float nf;		/* Smoothed noise floor (dB), NAN = none */
+		float pk;		/* Smoothed peak level (dB), NAN = none */
+	} autorange;
+
+	/* What to do while nothing is drawn */
+	struct {
+		int policy;
+		int decim;
+		int cnt;
+	} hidden;
 };
 
 
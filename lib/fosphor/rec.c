@@ -0,0 +1,986 @@
+/*
+ * rec.c
+ *
+ * Spectrogram archive recorder & reader
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*! \addtogroup rec
+ *  @{
+ */
+
+/*! \file rec.c
+ *  \brief Spectrogram archive recorder & reader
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cl.h"
+#include "export.h"
+#include "private.h"
+#include "rec.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef ENABLE_ZLIB
+# include <zlib.h>
+#endif
+
+
+#define REC_QUEUE_LEN	8
+
+struct rec_chunk
+{
+	struct fosphor_rec_chunk hdr;
+	uint8_t *raw;			/* Quantized rows */
+};
+
+struct fosphor_rec
+{
+	FILE *fh;
+	struct fosphor_rec_header hdr;
+
+	/* Geometry */
+	size_t row_len;			/* Bytes per row */
+	size_t raw_len;			/* Bytes per full chunk */
+
+	/* Producer side (render thread) */
+	struct rec_chunk *cur;
+	uint64_t total_rows;
+	uint64_t t_last_ns;
+	unsigned int dropped;
+	float row[FOSPHOR_FFT_LEN];
+
+	/* Chunks : free pool and queue to the writer */
+	struct rec_chunk chunks[REC_QUEUE_LEN];
+	struct rec_chunk *pool[REC_QUEUE_LEN];
+	struct rec_chunk *queue[REC_QUEUE_LEN];
+	int n_pool, q_head, q_len;
+
+	/* Writer thread */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stop;
+
+	uint8_t *enc;			/* Encoding buffer */
+	size_t enc_size;
+
+	struct fosphor_rec_index_entry *index;
+	uint32_t n_chunks;
+	uint32_t index_size;
+	uint64_t offset;
+	int io_error;
+};
+
+
+static uint64_t
+_rec_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* Writer thread                                                              */
+/* -------------------------------------------------------------------------- */
+
+static void
+_rec_delta(struct fosphor_rec *rec, struct rec_chunk *c)
+{
+	int s, r, i;
+
+	/* Backwards so we always diff against the original row */
+	for (s=0; s<rec->hdr.n_streams; s++)
+	{
+		uint8_t *base = c->raw + s * c->hdr.n_rows * rec->row_len;
+
+		for (r=c->hdr.n_rows-1; r>0; r--)
+		{
+			uint8_t *cr = base + r * rec->row_len;
+			uint8_t *pr = cr - rec->row_len;
+
+			if (rec->hdr.bits == 8) {
+				for (i=0; i<FOSPHOR_FFT_LEN; i++)
+					cr[i] -= pr[i];
+			} else {
+				for (i=0; i<FOSPHOR_FFT_LEN; i++) {
+					uint16_t v = (cr[2*i] | (cr[2*i+1] << 8)) -
+					             (pr[2*i] | (pr[2*i+1] << 8));
+					cr[2*i+0] = v;
+					cr[2*i+1] = v >> 8;
+				}
+			}
+		}
+	}
+}
+
+static int
+_rec_write_chunk(struct fosphor_rec *rec, struct rec_chunk *c)
+{
+	const uint8_t *data;
+	size_t len;
+	int s;
+
+	/* Partial chunk : pack the streams together */
+	if (c->hdr.n_rows < FOSPHOR_REC_CHUNK_ROWS)
+		for (s=1; s<rec->hdr.n_streams; s++)
+			memmove(c->raw + s * c->hdr.n_rows * rec->row_len,
+			        c->raw + s * FOSPHOR_REC_CHUNK_ROWS * rec->row_len,
+			        c->hdr.n_rows * rec->row_len);
+
+	/* Filter & encode */
+	c->hdr.raw_len = rec->hdr.n_streams * c->hdr.n_rows * rec->row_len;
+
+	_rec_delta(rec, c);
+
+	data = c->raw;
+	len  = c->hdr.raw_len;
+
+#ifdef ENABLE_ZLIB
+	if (rec->hdr.codec == FOSPHOR_REC_CODEC_DEFLATE)
+	{
+		uLongf zl = rec->enc_size;
+
+		if (compress2(rec->enc, &zl, c->raw, c->hdr.raw_len, 3) != Z_OK)
+			return -1;
+
+		data = rec->enc;
+		len  = zl;
+	}
+#endif
+
+	c->hdr.data_len = len;
+
+	/* Grow index if needed */
+	if (rec->n_chunks == rec->index_size)
+	{
+		uint32_t ns = rec->index_size ? (rec->index_size * 2) : 1024;
+		void *ni = realloc(rec->index, ns * sizeof(struct fosphor_rec_index_entry));
+		if (!ni)
+			return -1;
+		rec->index = ni;
+		rec->index_size = ns;
+	}
+
+	rec->index[rec->n_chunks].offset     = rec->offset;
+	rec->index[rec->n_chunks].first_row  = c->hdr.first_row;
+	rec->index[rec->n_chunks].t_first_ns = c->hdr.t_first_ns;
+	rec->index[rec->n_chunks].t_last_ns  = c->hdr.t_last_ns;
+
+	/* Write */
+	if ((fwrite(&c->hdr, sizeof(c->hdr), 1, rec->fh) != 1) ||
+	    (fwrite(data, len, 1, rec->fh) != 1))
+		return -1;
+
+	rec->offset += sizeof(c->hdr) + len;
+	rec->n_chunks++;
+
+	return 0;
+}
+
+static void
+_rec_write_index(struct fosphor_rec *rec)
+{
+	struct fosphor_rec_trailer trailer;
+
+	trailer.magic        = FOSPHOR_REC_INDEX_MAGIC;
+	trailer.n_chunks     = rec->n_chunks;
+	trailer.index_offset = rec->offset;
+
+	if (rec->n_chunks)
+		fwrite(rec->index, sizeof(struct fosphor_rec_index_entry), rec->n_chunks, rec->fh);
+	fwrite(&trailer, sizeof(trailer), 1, rec->fh);
+}
+
+static void *
+_rec_thread(void *arg)
+{
+	struct fosphor_rec *rec = arg;
+	struct rec_chunk *c;
+
+	pthread_mutex_lock(&rec->lock);
+
+	while (1)
+	{
+		/* Wait for work */
+		while (!rec->q_len && !rec->stop)
+			pthread_cond_wait(&rec->cond, &rec->lock);
+
+		if (!rec->q_len)
+			break;
+
+		c = rec->queue[rec->q_head];
+		rec->q_head = (rec->q_head + 1) % REC_QUEUE_LEN;
+		rec->q_len--;
+
+		/* Do the slow part unlocked */
+		pthread_mutex_unlock(&rec->lock);
+
+		if (!rec->io_error && _rec_write_chunk(rec, c)) {
+			fprintf(stderr, "[!] Spectrogram archive write error, recording stopped\n");
+			rec->io_error = 1;
+		}
+
+		pthread_mutex_lock(&rec->lock);
+
+		rec->pool[rec->n_pool++] = c;
+	}
+
+	pthread_mutex_unlock(&rec->lock);
+
+	return NULL;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* Producer                                                                   */
+/* -------------------------------------------------------------------------- */
+
+static void
+_rec_submit(struct fosphor_rec *rec)
+{
+	struct rec_chunk *c = rec->cur;
+
+	rec->cur = NULL;
+
+	if (!c)
+		return;
+
+	pthread_mutex_lock(&rec->lock);
+
+	if (c->hdr.n_rows)
+	{
+		rec->queue[(rec->q_head + rec->q_len) % REC_QUEUE_LEN] = c;
+		rec->q_len++;
+		pthread_cond_signal(&rec->cond);
+	}
+	else
+	{
+		rec->pool[rec->n_pool++] = c;
+	}
+
+	pthread_mutex_unlock(&rec->lock);
+}
+
+static struct rec_chunk *
+_rec_get_chunk(struct fosphor_rec *rec)
+{
+	struct rec_chunk *c = NULL;
+
+	pthread_mutex_lock(&rec->lock);
+	if (rec->n_pool)
+		c = rec->pool[--rec->n_pool];
+	pthread_mutex_unlock(&rec->lock);
+
+	return c;
+}
+
+
+struct fosphor_rec *
+fosphor_rec_create(const char *path, int n_streams,
+                   int bits, float db_min, float db_max,
+                   double freq_center, double freq_span)
+{
+	struct fosphor_rec *rec;
+	int i;
+
+	if (((bits != 8) && (bits != 16)) || !(db_max > db_min))
+		return NULL;
+
+	/* Allocate structure */
+	rec = malloc(sizeof(struct fosphor_rec));
+	if (!rec)
+		return NULL;
+
+	memset(rec, 0, sizeof(struct fosphor_rec));
+
+	/* Header */
+	rec->hdr.magic       = FOSPHOR_REC_MAGIC;
+	rec->hdr.version     = FOSPHOR_REC_VERSION;
+	rec->hdr.bits        = bits;
+#ifdef ENABLE_ZLIB
+	rec->hdr.codec       = FOSPHOR_REC_CODEC_DEFLATE;
+#else
+	rec->hdr.codec       = FOSPHOR_REC_CODEC_RAW;
+#endif
+	rec->hdr.fft_len     = FOSPHOR_FFT_LEN;
+	rec->hdr.n_streams   = n_streams;
+	rec->hdr.chunk_rows  = FOSPHOR_REC_CHUNK_ROWS;
+	rec->hdr.q_db0       = db_min;
+	rec->hdr.q_db1       = db_max;
+	rec->hdr.freq_center = freq_center;
+	rec->hdr.freq_span   = freq_span;
+	rec->hdr.t_start_ns  = _rec_now_ns();
+
+	/* Buffers */
+	rec->row_len = FOSPHOR_FFT_LEN * (bits >> 3);
+	rec->raw_len = n_streams * FOSPHOR_REC_CHUNK_ROWS * rec->row_len;
+
+	for (i=0; i<REC_QUEUE_LEN; i++) {
+		rec->chunks[i].raw = malloc(rec->raw_len);
+		if (!rec->chunks[i].raw)
+			goto error;
+		rec->pool[rec->n_pool++] = &rec->chunks[i];
+	}
+
+#ifdef ENABLE_ZLIB
+	rec->enc_size = compressBound(rec->raw_len);
+	rec->enc = malloc(rec->enc_size);
+	if (!rec->enc)
+		goto error;
+#endif
+
+	/* File */
+	rec->fh = fopen(path, "wb");
+	if (!rec->fh) {
+		fprintf(stderr, "[!] Unable to create spectrogram archive '%s'\n", path);
+		goto error;
+	}
+
+	if (fwrite(&rec->hdr, sizeof(rec->hdr), 1, rec->fh) != 1)
+		goto error;
+
+	rec->offset = sizeof(rec->hdr);
+
+	/* Writer thread */
+	pthread_mutex_init(&rec->lock, NULL);
+	pthread_cond_init(&rec->cond, NULL);
+
+	if (pthread_create(&rec->thread, NULL, _rec_thread, rec)) {
+		pthread_cond_destroy(&rec->cond);
+		pthread_mutex_destroy(&rec->lock);
+		goto error;
+	}
+
+	return rec;
+
+	/* Error path */
+error:
+	if (rec->fh) {
+		fclose(rec->fh);
+		remove(path);
+	}
+
+	for (i=0; i<REC_QUEUE_LEN; i++)
+		free(rec->chunks[i].raw);
+
+	free(rec->enc);
+	free(rec);
+
+	return NULL;
+}
+
+void
+fosphor_rec_destroy(struct fosphor_rec *rec)
+{
+	int i;
+
+	if (!rec)
+		return;
+
+	/* Flush partial chunk and let the writer finish */
+	_rec_submit(rec);
+
+	pthread_mutex_lock(&rec->lock);
+	rec->stop = 1;
+	pthread_cond_signal(&rec->cond);
+	pthread_mutex_unlock(&rec->lock);
+
+	pthread_join(rec->thread, NULL);
+
+	pthread_cond_destroy(&rec->cond);
+	pthread_mutex_destroy(&rec->lock);
+
+	/* Index & close */
+	if (!rec->io_error)
+		_rec_write_index(rec);
+
+	fclose(rec->fh);
+
+	if (rec->dropped)
+		fprintf(stderr, "[w] Spectrogram archive : %u rows dropped (disk too slow)\n", rec->dropped);
+
+	for (i=0; i<REC_QUEUE_LEN; i++)
+		free(rec->chunks[i].raw);
+
+	free(rec->index);
+	free(rec->enc);
+	free(rec);
+}
+
+void
+fosphor_rec_publish(struct fosphor_rec *rec, struct fosphor *fosphor,
+                    int new_rows)
+{
+	uint64_t now, t;
+	int pos, s, j;
+
+	if (!new_rows)
+		return;
+
+	pos = fosphor_cl_get_waterfall_position(fosphor);
+
+	/* Spread the rows over the time since last batch */
+	now = _rec_now_ns();
+	if (!rec->t_last_ns)
+		rec->t_last_ns = now;
+
+	for (j=0; j<new_rows; j++)
+	{
+		struct rec_chunk *c;
+
+		t = rec->t_last_ns + ((now - rec->t_last_ns) * (j + 1)) / new_rows;
+
+		/* Need a chunk ? */
+		if (!rec->cur) {
+			rec->cur = _rec_get_chunk(rec);
+
+			if (!rec->cur) {
+				/* Writer can't keep up, drop what doesn't fit */
+				rec->dropped++;
+				rec->total_rows++;
+				continue;
+			}
+
+			rec->cur->hdr.magic      = FOSPHOR_REC_CHUNK_MAGIC;
+			rec->cur->hdr.n_rows     = 0;
+			rec->cur->hdr.first_row  = rec->total_rows;
+			rec->cur->hdr.t_first_ns = t;
+		}
+
+		c = rec->cur;
+
+		/* Quantize row of every stream ([stream][row] layout) */
+		for (s=0; s<rec->hdr.n_streams; s++)
+		{
+			fosphor_export_waterfall_row(fosphor, s, pos - new_rows + j, rec->row);
+			fosphor_export_quantize(
+				&c->raw[((s * FOSPHOR_REC_CHUNK_ROWS) + c->hdr.n_rows) * rec->row_len],
+				rec->row, FOSPHOR_FFT_LEN,
+				rec->hdr.bits, rec->hdr.q_db0, rec->hdr.q_db1
+			);
+		}
+
+		c->hdr.t_last_ns = t;
+		c->hdr.n_rows++;
+		rec->total_rows++;
+
+		/* Full ? */
+		if (c->hdr.n_rows == FOSPHOR_REC_CHUNK_ROWS)
+			_rec_submit(rec);
+	}
+
+	rec->t_last_ns = now;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* Reader                                                                     */
+/* -------------------------------------------------------------------------- */
+
+struct fosphor_rec_reader
+{
+	const uint8_t *map;
+	size_t map_len;
+
+	struct fosphor_rec_header hdr;
+	size_t row_len;			/* Bytes per row */
+
+	struct fosphor_rec_index_entry *index;
+	uint32_t n_chunks;
+	int64_t n_rows;			/* Last row + 1 */
+
+	/* Last decoded chunk */
+	int cache_idx;
+	struct fosphor_rec_chunk cache_hdr;
+	uint8_t *raw;
+};
+
+
+/* Chunk headers are not aligned in the file, always copy them out */
+static int
+_rd_chunk_hdr(const struct fosphor_rec_reader *rd, uint64_t offset,
+              struct fosphor_rec_chunk *ch)
+{
+	if ((offset < sizeof(struct fosphor_rec_header)) ||
+	    (offset + sizeof(struct fosphor_rec_chunk) > rd->map_len))
+		return -1;
+
+	memcpy(ch, rd->map + offset, sizeof(struct fosphor_rec_chunk));
+
+	if ((ch->magic != FOSPHOR_REC_CHUNK_MAGIC) ||
+	    !ch->n_rows || (ch->n_rows > rd->hdr.chunk_rows) ||
+	    (ch->raw_len != rd->hdr.n_streams * ch->n_rows * rd->row_len) ||
+	    (ch->data_len > rd->map_len - offset - sizeof(struct fosphor_rec_chunk)))
+		return -1;
+
+	return 0;
+}
+
+static int
+_rd_load_index(struct fosphor_rec_reader *rd)
+{
+	struct fosphor_rec_trailer trailer;
+	struct fosphor_rec_chunk ch;
+	uint64_t offset;
+	uint32_t size;
+
+	/* Index written on close ? */
+	if (rd->map_len >= sizeof(struct fosphor_rec_header) + sizeof(trailer))
+	{
+		memcpy(&trailer, rd->map + rd->map_len - sizeof(trailer), sizeof(trailer));
+
+		if ((trailer.magic == FOSPHOR_REC_INDEX_MAGIC) &&
+		    (trailer.index_offset >= sizeof(struct fosphor_rec_header)) &&
+		    (trailer.index_offset <= rd->map_len) &&
+		    (trailer.index_offset + (uint64_t)trailer.n_chunks * sizeof(struct fosphor_rec_index_entry) + sizeof(trailer) == rd->map_len))
+		{
+			rd->n_chunks = trailer.n_chunks;
+			rd->index = malloc(rd->n_chunks * sizeof(struct fosphor_rec_index_entry) + 1);
+			if (!rd->index)
+				return -ENOMEM;
+
+			memcpy(rd->index, rd->map + trailer.index_offset,
+			       rd->n_chunks * sizeof(struct fosphor_rec_index_entry));
+
+			return 0;
+		}
+	}
+
+	/* Unterminated recording : walk the chunks */
+	fprintf(stderr, "[w] Spectrogram archive has no index, scanning it\n");
+
+	offset = sizeof(struct fosphor_rec_header);
+	size = 0;
+
+	while (!_rd_chunk_hdr(rd, offset, &ch))
+	{
+		if (rd->n_chunks == size) {
+			uint32_t ns = size ? (size * 2) : 1024;
+			void *ni = realloc(rd->index, ns * sizeof(struct fosphor_rec_index_entry));
+			if (!ni)
+				return -ENOMEM;
+			rd->index = ni;
+			size = ns;
+		}
+
+		rd->index[rd->n_chunks].offset     = offset;
+		rd->index[rd->n_chunks].first_row  = ch.first_row;
+		rd->index[rd->n_chunks].t_first_ns = ch.t_first_ns;
+		rd->index[rd->n_chunks].t_last_ns  = ch.t_last_ns;
+		rd->n_chunks++;
+
+		offset += sizeof(struct fosphor_rec_chunk) + ch.data_len;
+	}
+
+	return 0;
+}
+
+/* Last chunk starting at or before `row`, -1 if none */
+static int
+_rd_find_row(const struct fosphor_rec_reader *rd, int64_t row)
+{
+	int lo = 0, hi = rd->n_chunks - 1, m;
+
+	if ((row < 0) || (rd->index[0].first_row > (uint64_t)row))
+		return -1;
+
+	while (lo < hi) {
+		m = (lo + hi + 1) >> 1;
+		if (rd->index[m].first_row <= (uint64_t)row)
+			lo = m;
+		else
+			hi = m - 1;
+	}
+
+	return lo;
+}
+
+static int
+_rd_decode(struct fosphor_rec_reader *rd, int idx)
+{
+	struct fosphor_rec_chunk *ch = &rd->cache_hdr;
+	const uint8_t *data;
+	int s, r, i;
+
+	if (rd->cache_idx == idx)
+		return 0;
+
+	rd->cache_idx = -1;
+
+	if (_rd_chunk_hdr(rd, rd->index[idx].offset, ch))
+		return -EIO;
+
+	data = rd->map + rd->index[idx].offset + sizeof(struct fosphor_rec_chunk);
+
+	/* Codec */
+	switch (rd->hdr.codec)
+	{
+	case FOSPHOR_REC_CODEC_RAW:
+		if (ch->data_len != ch->raw_len)
+			return -EIO;
+		memcpy(rd->raw, data, ch->raw_len);
+		break;
+
+#ifdef ENABLE_ZLIB
+	case FOSPHOR_REC_CODEC_DEFLATE:
+	{
+		uLongf rl = ch->raw_len;
+
+		if ((uncompress(rd->raw, &rl, data, ch->data_len) != Z_OK) ||
+		    (rl != ch->raw_len))
+			return -EIO;
+		break;
+	}
+#endif
+
+	default:
+		return -EIO;
+	}
+
+	/* Undo the row delta */
+	for (s=0; s<rd->hdr.n_streams; s++)
+	{
+		uint8_t *pr = rd->raw + s * ch->n_rows * rd->row_len;
+
+		for (r=1; r<(int)ch->n_rows; r++, pr+=rd->row_len)
+		{
+			uint8_t *cr = pr + rd->row_len;
+
+			if (rd->hdr.bits == 8) {
+				for (i=0; i<FOSPHOR_FFT_LEN; i++)
+					cr[i] += pr[i];
+			} else {
+				for (i=0; i<FOSPHOR_FFT_LEN; i++) {
+					uint16_t v = (cr[2*i] | (cr[2*i+1] << 8)) +
+					             (pr[2*i] | (pr[2*i+1] << 8));
+					cr[2*i+0] = v;
+					cr[2*i+1] = v >> 8;
+				}
+			}
+		}
+	}
+
+	rd->cache_idx = idx;
+
+	return 0;
+}
+
+
+struct fosphor_rec_reader *
+fosphor_rec_reader_open(const char *path)
+{
+	struct fosphor_rec_reader *rd;
+	struct fosphor_rec_chunk ch;
+	struct stat st;
+	void *map;
+	int fd;
+
+	/* Map the whole file */
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "[!] Unable to open spectrogram archive '%s'\n", path);
+		return NULL;
+	}
+
+	/* Anything not empty holds at least a header and a chunk (or the
+	 * trailer), _rd_load_index() looks for the latter at the end */
+	if (fstat(fd, &st) || (st.st_size < 0) ||
+	    ((size_t)st.st_size < sizeof(struct fosphor_rec_header) + sizeof(struct fosphor_rec_trailer))) {
+		fprintf(stderr, "[!] Invalid spectrogram archive '%s'\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "[!] Unable to map spectrogram archive '%s'\n", path);
+		return NULL;
+	}
+
+	/* Allocate structure */
+	rd = malloc(sizeof(struct fosphor_rec_reader));
+	if (!rd)
+		goto error;
+
+	memset(rd, 0, sizeof(struct fosphor_rec_reader));
+
+	rd->map = map;
+	rd->map_len = st.st_size;
+	rd->cache_idx = -1;
+
+	/* Header */
+	memcpy(&rd->hdr, rd->map, sizeof(struct fosphor_rec_header));
+
+	if ((rd->hdr.magic != FOSPHOR_REC_MAGIC) ||
+	    (rd->hdr.version != FOSPHOR_REC_VERSION) ||
+	    ((rd->hdr.bits != 8) && (rd->hdr.bits != 16)) ||
+	    (rd->hdr.fft_len != FOSPHOR_FFT_LEN) ||
+	    !rd->hdr.n_streams || !rd->hdr.chunk_rows)
+	{
+		fprintf(stderr, "[!] Invalid spectrogram archive '%s'\n", path);
+		goto error;
+	}
+
+#ifndef ENABLE_ZLIB
+	if (rd->hdr.codec == FOSPHOR_REC_CODEC_DEFLATE) {
+		fprintf(stderr, "[!] Compressed spectrogram archive but built without zlib\n");
+		goto error;
+	}
+#endif
+
+	rd->row_len = FOSPHOR_FFT_LEN * (rd->hdr.bits >> 3);
+
+	/* Index */
+	if (_rd_load_index(rd))
+		goto error;
+
+	if (!rd->n_chunks) {
+		fprintf(stderr, "[!] Spectrogram archive '%s' is empty\n", path);
+		goto error;
+	}
+
+	if (_rd_chunk_hdr(rd, rd->index[rd->n_chunks-1].offset, &ch)) {
+		fprintf(stderr, "[!] Corrupted spectrogram archive index\n");
+		goto error;
+	}
+
+	rd->n_rows = ch.first_row + ch.n_rows;
+
+	/* Decode buffer */
+	rd->raw = malloc(rd->hdr.n_streams * rd->hdr.chunk_rows * rd->row_len);
+	if (!rd->raw)
+		goto error;
+
+	return rd;
+
+	/* Error path */
+error:
+	if (rd) {
+		free(rd->index);
+		free(rd);
+	}
+
+	munmap(map, st.st_size);
+
+	return NULL;
+}
+
+void
+fosphor_rec_reader_close(struct fosphor_rec_reader *rd)
+{
+	if (!rd)
+		return;
+
+	munmap((void*)rd->map, rd->map_len);
+
+	free(rd->raw);
+	free(rd->index);
+	free(rd);
+}
+
+const struct fosphor_rec_header *
+fosphor_rec_reader_header(const struct fosphor_rec_reader *rd)
+{
+	return &rd->hdr;
+}
+
+int64_t
+fosphor_rec_reader_rows(const struct fosphor_rec_reader *rd)
+{
+	return rd->n_rows;
+}
+
+uint64_t
+fosphor_rec_reader_row_time(struct fosphor_rec_reader *rd, int64_t row)
+{
+	struct fosphor_rec_chunk ch;
+	int idx;
+
+	idx = _rd_find_row(rd, row);
+	if (idx < 0)
+		return rd->index[0].t_first_ns;
+
+	if (_rd_chunk_hdr(rd, rd->index[idx].offset, &ch))
+		return rd->index[idx].t_first_ns;
+
+	row -= ch.first_row;
+
+	if (row >= ch.n_rows - 1)
+		return ch.t_last_ns;
+
+	return ch.t_first_ns + ((ch.t_last_ns - ch.t_first_ns) * row) / (ch.n_rows - 1);
+}
+
+int64_t
+fosphor_rec_reader_find_time(struct fosphor_rec_reader *rd, uint64_t t_ns)
+{
+	struct fosphor_rec_chunk ch;
+	int lo = 0, hi = rd->n_chunks - 1, m;
+
+	/* Last chunk starting at or before t */
+	if (t_ns <= rd->index[0].t_first_ns)
+		return rd->index[0].first_row;
+
+	while (lo < hi) {
+		m = (lo + hi + 1) >> 1;
+		if (rd->index[m].t_first_ns <= t_ns)
+			lo = m;
+		else
+			hi = m - 1;
+	}
+
+	if (_rd_chunk_hdr(rd, rd->index[lo].offset, &ch))
+		return rd->index[lo].first_row;
+
+	/* Rows are evenly spread over the chunk */
+	if (t_ns >= ch.t_last_ns)
+		return ch.first_row + ch.n_rows - 1;
+
+	return ch.first_row +
+		((t_ns - ch.t_first_ns) * (ch.n_rows - 1)) / (ch.t_last_ns - ch.t_first_ns);
+}
+
+int
+fosphor_rec_reader_read(struct fosphor_rec_reader *rd,
+                        int64_t row, int n_rows, float *db)
+{
+	const struct fosphor_rec_header *h = &rd->hdr;
+	int rv = 0, j = 0, s, n, idx;
+
+	while (j < n_rows)
+	{
+		int64_t r = row + j;
+		int64_t cr;
+
+		/* Find the chunk holding this row */
+		idx = _rd_find_row(rd, r);
+		n = 0;
+
+		if ((idx >= 0) && (r < rd->n_rows)) {
+			if (_rd_decode(rd, idx))
+				rv = -EIO;
+			else if (r < (int64_t)(rd->cache_hdr.first_row + rd->cache_hdr.n_rows))
+				n = rd->cache_hdr.first_row + rd->cache_hdr.n_rows - r;
+		}
+
+		/* Missing row */
+		if (!n) {
+			for (s=0; s<h->n_streams; s++) {
+				float *d = &db[((s * n_rows) + j) * FOSPHOR_FFT_LEN];
+				int i;
+
+				for (i=0; i<FOSPHOR_FFT_LEN; i++)
+					d[i] = h->q_db0;
+			}
+
+			j++;
+			continue;
+		}
+
+		/* Dequantize as many as we can from this chunk */
+		if (n > n_rows - j)
+			n = n_rows - j;
+
+		cr = r - rd->cache_hdr.first_row;
+
+		for (s=0; s<h->n_streams; s++)
+			fosphor_import_dequantize(
+				&db[((s * n_rows) + j) * FOSPHOR_FFT_LEN],
+				&rd->raw[((s * rd->cache_hdr.n_rows) + cr) * rd->row_len],
+				n * FOSPHOR_FFT_LEN,
+				h->bits, h->q_db0, h->q_db1
+			);
+
+		j += n;
+	}
+
+	return rv;
+}
+
+#else /* _WIN32 */
+
+struct fosphor_rec *
+fosphor_rec_create(const char *path, int n_streams,
+                   int bits, float db_min, float db_max,
+                   double freq_center, double freq_span)
+{
+	fprintf(stderr, "[!] Spectrogram archive not supported on this platform\n");
+	return NULL;
+}
+
+void
+fosphor_rec_destroy(struct fosphor_rec *rec)
+{
+}
+
+void
+fosphor_rec_publish(struct fosphor_rec *rec, struct fosphor *fosphor,
+                    int new_rows)
+{
+}
+
+struct fosphor_rec_reader *
+fosphor_rec_reader_open(const char *path)
+{
+	fprintf(stderr, "[!] Spectrogram archive not supported on this platform\n");
+	return NULL;
+}
+
+void
+fosphor_rec_reader_close(struct fosphor_rec_reader *rd)
+{
+}
+
+const struct fosphor_rec_header *
+fosphor_rec_reader_header(const struct fosphor_rec_reader *rd)
+{
+	return NULL;
+}
+
+int64_t
+fosphor_rec_reader_rows(const struct fosphor_rec_reader *rd)
+{
+	return 0;
+}
+
+uint64_t
+fosphor_rec_reader_row_time(struct fosphor_rec_reader *rd, int64_t row)
+{
+	return 0;
+}
+
+int64_t
+fosphor_rec_reader_find_time(struct fosphor_rec_reader *rd, uint64_t t_ns)
+{
+	return 0;
+}
+
+int
+fosphor_rec_reader_read(struct fosphor_rec_reader *rd,
+                        int64_t row, int n_rows, float *db)
+{
+	return -ENOTSUP;
+}
+
+#endif /* _WIN32 */
+
+
+/*! @} */
@@ -0,0 +1,134 @@
+/*
+ * rec.h
+ *
+ * Spectrogram archive recorder & reader
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+/*! \defgroup rec
+ *  @{
+ */
+
+/*! \file rec.h
+ *  \brief Spectrogram archive recorder & reader
+ *
+ *  Archive layout (headers in native byte order, so it can be used
+ *  straight from a mmap, readers check the magics) :
+ *
+ *   fosphor_rec_header
+ *   { fosphor_rec_chunk, data } * n
+ *   fosphor_rec_index_entry * n
+ *   fosphor_rec_trailer
+ *
+ *  Each chunk holds up to `chunk_rows` waterfall rows of every stream,
+ *  laid out as [n_streams][n_rows][fft_len] samples of `bits` bits, in
+ *  dB quantized linearly over [q_db0, q_db1] (see export.h, 16 bits
+ *  samples are little endian) and lowest frequency first.
+ *  Within a chunk, every row but the first one of each stream is stored
+ *  as the (wrapping) difference to the previous row, which makes the
+ *  data a lot more compressible. Then the whole chunk goes through the
+ *  codec.
+ *
+ *  The index and trailer are only written when the recording is closed
+ *  properly. Since the chunk headers are self describing, an archive
+ *  without them can still be read by walking the chunks.
+ */
+
+#include <stdint.h>
+
+struct fosphor;
+
+
+#define FOSPHOR_REC_MAGIC		0x52534f46	/* "FOSR" */
+#define FOSPHOR_REC_CHUNK_MAGIC		0x4b434f46	/* "FOCK" */
+#define FOSPHOR_REC_INDEX_MAGIC		0x58494f46	/* "FOIX" */
+#define FOSPHOR_REC_VERSION		1
+
+#define FOSPHOR_REC_CHUNK_ROWS		256
+
+enum fosphor_rec_codec {
+	FOSPHOR_REC_CODEC_RAW		= 0,
+	FOSPHOR_REC_CODEC_DEFLATE	= 1,
+};
+
+struct fosphor_rec_header
+{
+	uint32_t magic;
+	uint16_t version;
+	uint8_t  bits;
+	uint8_t  codec;
+	uint32_t fft_len;
+	uint16_t n_streams;
+	uint16_t chunk_rows;
+	float    q_db0;
+	float    q_db1;
+	double   freq_center;
+	double   freq_span;
+	uint64_t t_start_ns;
+	uint64_t _rsvd[2];
+};
+
+struct fosphor_rec_chunk
+{
+	uint32_t magic;
+	uint32_t n_rows;
+	uint32_t data_len;	/* Bytes following this header */
+	uint32_t raw_len;	/* Bytes once decoded */
+	uint64_t first_row;	/* Absolute number of the first row */
+	uint64_t t_first_ns;	/* Time of first row */
+	uint64_t t_last_ns;	/* Time of last row */
+};
+
+struct fosphor_rec_index_entry
+{
+	uint64_t offset;	/* File offset of the chunk header */
+	uint64_t first_row;
+	uint64_t t_first_ns;
+	uint64_t t_last_ns;
+};
+
+struct fosphor_rec_trailer
+{
+	uint32_t magic;
+	uint32_t n_chunks;
+	uint64_t index_offset;
+};
+
+
+/* Recorder */
+
+struct fosphor_rec;
+
+struct fosphor_rec *fosphor_rec_create(const char *path, int n_streams,
+                                       int bits, float db_min, float db_max,
+                                       double freq_center, double freq_span);
+void fosphor_rec_destroy(struct fosphor_rec *rec);
+void fosphor_rec_publish(struct fosphor_rec *rec, struct fosphor *fosphor,
+                         int new_rows);
+
+
+/* Reader
+ *  Rows are addressed by their absolute number. Rows that are not in the
+ *  archive (before the start, past the end or dropped while recording)
+ *  read back as q_db0. Output layout is [n_streams][n_rows][fft_len] dB,
+ *  lowest frequency first, ready for fosphor_load_waterfall() */
+
+struct fosphor_rec_reader;
+
+struct fosphor_rec_reader *fosphor_rec_reader_open(const char *path);
+void fosphor_rec_reader_close(struct fosphor_rec_reader *rd);
+
+const struct fosphor_rec_header *
+fosphor_rec_reader_header(const struct fosphor_rec_reader *rd);
+int64_t  fosphor_rec_reader_rows(const struct fosphor_rec_reader *rd);
+uint64_t fosphor_rec_reader_row_time(struct fosphor_rec_reader *rd, int64_t row);
+int64_t  fosphor_rec_reader_find_time(struct fosphor_rec_reader *rd, uint64_t t_ns);
+int fosphor_rec_reader_read(struct fosphor_rec_reader *rd,
+                            int64_t row, int n_rows, float *db);
+
+
+/*! @} */
@@ -0,0 +1,543 @@
+/*
+ * rollup.c
+ *
+ * Long-term multi-resolution spectrum rollups
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*! \addtogroup rollup
+ *  @{
+ */
+
+/*! \file rollup.c
+ *  \brief Long-term multi-resolution spectrum rollups
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "private.h"
+#include "rollup.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define ROLLUP_QUEUE_LEN	8
+#define ROLLUP_DB_MIN		-200.0f
+
+static const int rollup_def_period[] = { 1, 60, 3600 };
+static const int rollup_def_slots[]  = { 3600, 7 * 24 * 60, 366 * 24 };
+
+struct rollup_frame
+{
+	uint64_t t_ns;			/* Time of the last merged batch */
+	int n_spectra;			/* 0 = empty */
+	float *stats;			/* [stream][bin] (min, max, sum, -) */
+};
+
+struct rollup_acc
+{
+	uint64_t period_ns;
+	uint64_t bucket;		/* Current period number */
+	int n_spectra;			/* 0 = nothing accumulated */
+	float *min;			/* [stream][bin], FFT order */
+	float *max;
+	double *sum;
+};
+
+struct fosphor_rollup
+{
+	int fd;
+	struct fosphor_rollup_header hdr;
+
+	int n;				/* Bins of all streams */
+	float norm_db;			/* Device power to dB */
+
+	/* Producer side (render thread) */
+	struct rollup_frame *cur;
+
+	/* Frames : free pool and queue to the writer */
+	struct rollup_frame frames[ROLLUP_QUEUE_LEN];
+	struct rollup_frame *pool[ROLLUP_QUEUE_LEN];
+	struct rollup_frame *queue[ROLLUP_QUEUE_LEN];
+	int n_pool, q_head, q_len;
+
+	/* Writer thread */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stop;
+
+	struct rollup_acc acc[FOSPHOR_ROLLUP_MAX_LEVELS];
+	uint8_t *slot;			/* Slot write buffer */
+	int io_error;
+};
+
+
+static uint64_t
+_rollup_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline float
+_rollup_db(const struct fosphor_rollup *rlp, double pwr)
+{
+	float db = (pwr > 0.0) ? (10.0f * log10f((float)pwr) - rlp->norm_db) : ROLLUP_DB_MIN;
+	return (db > ROLLUP_DB_MIN) ? db : ROLLUP_DB_MIN;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* Writer thread                                                              */
+/* -------------------------------------------------------------------------- */
+
+static int
+_rollup_write_slot(struct fosphor_rollup *rlp, int level)
+{
+	struct fosphor_rollup_level *lvl = &rlp->hdr.level[level];
+	struct rollup_acc *acc = &rlp->acc[level];
+	struct fosphor_rollup_slot *sh;
+	float *d;
+	off_t ofs;
+	int s, i;
+
+	/* Slot header */
+	sh = (struct fosphor_rollup_slot *)rlp->slot;
+	sh->t_start_ns = acc->bucket * acc->period_ns;
+	sh->n_spectra  = acc->n_spectra;
+	sh->_rsvd      = 0;
+
+	/* Data in dB, display order */
+	d = (float *)(rlp->slot + sizeof(struct fosphor_rollup_slot));
+
+	for (s=0; s<rlp->hdr.n_streams; s++)
+	{
+		int b = s * FOSPHOR_FFT_LEN;
+
+		for (i=0; i<FOSPHOR_FFT_LEN; i++)
+		{
+			int j = b + (i ^ (FOSPHOR_FFT_LEN >> 1));
+
+			d[i]                       = _rollup_db(rlp, acc->min[j]);
+			d[i +     FOSPHOR_FFT_LEN] = _rollup_db(rlp, acc->sum[j] / acc->n_spectra);
+			d[i + 2 * FOSPHOR_FFT_LEN] = _rollup_db(rlp, acc->max[j]);
+		}
+
+		d += 3 * FOSPHOR_FFT_LEN;
+	}
+
+	/* Slot first, then the level position */
+	ofs = lvl->offset + (acc->bucket % lvl->n_slots) * rlp->hdr.slot_len;
+
+	if (pwrite(rlp->fd, rlp->slot, rlp->hdr.slot_len, ofs) != (ssize_t)rlp->hdr.slot_len)
+		return -1;
+
+	lvl->t_last_ns = sh->t_start_ns;
+
+	ofs = offsetof(struct fosphor_rollup_header, level) +
+	      level * sizeof(struct fosphor_rollup_level) +
+	      offsetof(struct fosphor_rollup_level, t_last_ns);
+
+	if (pwrite(rlp->fd, &lvl->t_last_ns, sizeof(uint64_t), ofs) != sizeof(uint64_t))
+		return -1;
+
+	return 0;
+}
+
+static int
+_rollup_merge(struct fosphor_rollup *rlp, struct rollup_frame *f)
+{
+	int l, i, rv = 0;
+
+	for (l=0; l<rlp->hdr.n_levels; l++)
+	{
+		struct rollup_acc *acc = &rlp->acc[l];
+		uint64_t bucket = f->t_ns / acc->period_ns;
+
+		/* Period over ? */
+		if (acc->n_spectra && (acc->bucket != bucket)) {
+			rv |= _rollup_write_slot(rlp, l);
+			acc->n_spectra = 0;
+		}
+
+		if (!acc->n_spectra) {
+			acc->bucket = bucket;
+			for (i=0; i<rlp->n; i++) {
+				acc->min[i] = f->stats[4*i+0];
+				acc->max[i] = f->stats[4*i+1];
+				acc->sum[i] = f->stats[4*i+2];
+			}
+		} else {
+			for (i=0; i<rlp->n; i++) {
+				acc->min[i]  = fminf(acc->min[i], f->stats[4*i+0]);
+				acc->max[i]  = fmaxf(acc->max[i], f->stats[4*i+1]);
+				acc->sum[i] += f->stats[4*i+2];
+			}
+		}
+
+		acc->n_spectra += f->n_spectra;
+	}
+
+	return rv;
+}
+
+static void *
+_rollup_thread(void *arg)
+{
+	struct fosphor_rollup *rlp = arg;
+	struct rollup_frame *f;
+
+	pthread_mutex_lock(&rlp->lock);
+
+	while (1)
+	{
+		/* Wait for work */
+		while (!rlp->q_len && !rlp->stop)
+			pthread_cond_wait(&rlp->cond, &rlp->lock);
+
+		if (!rlp->q_len)
+			break;
+
+		f = rlp->queue[rlp->q_head];
+		rlp->q_head = (rlp->q_head + 1) % ROLLUP_QUEUE_LEN;
+		rlp->q_len--;
+
+		/* Do the slow part unlocked */
+		pthread_mutex_unlock(&rlp->lock);
+
+		if (!rlp->io_error && _rollup_merge(rlp, f)) {
+			fprintf(stderr, "[!] Spectrum rollups write error, rollups stopped\n");
+			rlp->io_error = 1;
+		}
+
+		pthread_mutex_lock(&rlp->lock);
+
+		rlp->pool[rlp->n_pool++] = f;
+	}
+
+	pthread_mutex_unlock(&rlp->lock);
+
+	return NULL;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* File                                                                       */
+/* -------------------------------------------------------------------------- */
+
+/* Can we carry on with an existing file ? */
+static int
+_rollup_resume(struct fosphor_rollup *rlp)
+{
+	struct fosphor_rollup_header hdr;
+	int l;
+
+	if (pread(rlp->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+		return 0;
+
+	if ((hdr.magic       != rlp->hdr.magic)     ||
+	    (hdr.version     != rlp->hdr.version)   ||
+	    (hdr.n_levels    != rlp->hdr.n_levels)  ||
+	    (hdr.fft_len     != rlp->hdr.fft_len)   ||
+	    (hdr.n_streams   != rlp->hdr.n_streams) ||
+	    (hdr.freq_center != rlp->hdr.freq_center) ||
+	    (hdr.freq_span   != rlp->hdr.freq_span) ||
+	    (hdr.slot_len    != rlp->hdr.slot_len))
+		return 0;
+
+	for (l=0; l<hdr.n_levels; l++)
+		if ((hdr.level[l].period_s != rlp->hdr.level[l].period_s) ||
+		    (hdr.level[l].n_slots  != rlp->hdr.level[l].n_slots))
+			return 0;
+
+	/* Same geometry, keep its history */
+	rlp->hdr = hdr;
+
+	return 1;
+}
+
+static int
+_rollup_open(struct fosphor_rollup *rlp, const char *path)
+{
+	uint64_t size;
+	int l;
+
+	rlp->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (rlp->fd < 0) {
+		fprintf(stderr, "[!] Unable to open spectrum rollups file '%s'\n", path);
+		return -1;
+	}
+
+	if (_rollup_resume(rlp))
+		return 0;
+
+	/* New file : sparse, every slot stale */
+	size = rlp->hdr.level[rlp->hdr.n_levels-1].offset +
+	       (uint64_t)rlp->hdr.level[rlp->hdr.n_levels-1].n_slots * rlp->hdr.slot_len;
+
+	if (ftruncate(rlp->fd, 0) || ftruncate(rlp->fd, size) ||
+	    (pwrite(rlp->fd, &rlp->hdr, sizeof(rlp->hdr), 0) != sizeof(rlp->hdr))) {
+		fprintf(stderr, "[!] Unable to create spectrum rollups file '%s'\n", path);
+		return -1;
+	}
+
+	for (l=0; l<rlp->hdr.n_levels; l++)
+		rlp->hdr.level[l].t_last_ns = 0;
+
+	return 0;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* Producer                                                                   */
+/* -------------------------------------------------------------------------- */
+
+struct fosphor_rollup *
+fosphor_rollup_create(const char *path, int n_streams,
+                      const int *period_s, const int *n_slots, int n_levels,
+                      double freq_center, double freq_span)
+{
+	struct fosphor_rollup *rlp;
+	uint64_t ofs;
+	int i;
+
+	if (!period_s || !n_slots) {
+		period_s = rollup_def_period;
+		n_slots  = rollup_def_slots;
+		n_levels = sizeof(rollup_def_period) / sizeof(int);
+	}
+
+	if ((n_levels < 1) || (n_levels > FOSPHOR_ROLLUP_MAX_LEVELS))
+		return NULL;
+
+	for (i=0; i<n_levels; i++)
+		if ((period_s[i] < 1) || (n_slots[i] < 1))
+			return NULL;
+
+	/* Allocate structure */
+	rlp = malloc(sizeof(struct fosphor_rollup));
+	if (!rlp)
+		return NULL;
+
+	memset(rlp, 0, sizeof(struct fosphor_rollup));
+
+	rlp->fd      = -1;
+	rlp->n       = n_streams * FOSPHOR_FFT_LEN;
+	rlp->norm_db = 20.0f * log10f((float)FOSPHOR_FFT_LEN);
+
+	/* Header */
+	rlp->hdr.magic       = FOSPHOR_ROLLUP_MAGIC;
+	rlp->hdr.version     = FOSPHOR_ROLLUP_VERSION;
+	rlp->hdr.n_levels    = n_levels;
+	rlp->hdr.fft_len     = FOSPHOR_FFT_LEN;
+	rlp->hdr.n_streams   = n_streams;
+	rlp->hdr.freq_center = freq_center;
+	rlp->hdr.freq_span   = freq_span;
+	rlp->hdr.t_create_ns = _rollup_now_ns();
+	rlp->hdr.slot_len    = sizeof(struct fosphor_rollup_slot) +
+	                       rlp->n * 3 * sizeof(float);
+
+	ofs = (sizeof(struct fosphor_rollup_header) + 4095) & ~4095ULL;
+
+	for (i=0; i<n_levels; i++) {
+		rlp->hdr.level[i].period_s = period_s[i];
+		rlp->hdr.level[i].n_slots  = n_slots[i];
+		rlp->hdr.level[i].offset   = ofs;
+		ofs += (uint64_t)n_slots[i] * rlp->hdr.slot_len;
+	}
+
+	/* Buffers */
+	for (i=0; i<ROLLUP_QUEUE_LEN; i++) {
+		rlp->frames[i].stats = malloc(rlp->n * 4 * sizeof(float));
+		if (!rlp->frames[i].stats)
+			goto error;
+		rlp->pool[rlp->n_pool++] = &rlp->frames[i];
+	}
+
+	for (i=0; i<n_levels; i++) {
+		rlp->acc[i].period_ns = period_s[i] * 1000000000ULL;
+		rlp->acc[i].min = malloc(rlp->n * sizeof(float));
+		rlp->acc[i].max = malloc(rlp->n * sizeof(float));
+		rlp->acc[i].sum = malloc(rlp->n * sizeof(double));
+		if (!rlp->acc[i].min || !rlp->acc[i].max || !rlp->acc[i].sum)
+			goto error;
+	}
+
+	rlp->slot = malloc(rlp->hdr.slot_len);
+	if (!rlp->slot)
+		goto error;
+
+	/* File */
+	if (_rollup_open(rlp, path))
+		goto error;
+
+	/* Frame being filled */
+	rlp->cur = rlp->pool[--rlp->n_pool];
+	rlp->cur->n_spectra = 0;
+
+	/* Writer thread */
+	pthread_mutex_init(&rlp->lock, NULL);
+	pthread_cond_init(&rlp->cond, NULL);
+
+	if (pthread_create(&rlp->thread, NULL, _rollup_thread, rlp)) {
+		pthread_cond_destroy(&rlp->cond);
+		pthread_mutex_destroy(&rlp->lock);
+		goto error;
+	}
+
+	return rlp;
+
+	/* Error path */
+error:
+	if (rlp->fd >= 0)
+		close(rlp->fd);
+
+	for (i=0; i<ROLLUP_QUEUE_LEN; i++)
+		free(rlp->frames[i].stats);
+
+	for (i=0; i<FOSPHOR_ROLLUP_MAX_LEVELS; i++) {
+		free(rlp->acc[i].min);
+		free(rlp->acc[i].max);
+		free(rlp->acc[i].sum);
+	}
+
+	free(rlp->slot);
+	free(rlp);
+
+	return NULL;
+}
+
+static void
+_rollup_submit(struct fosphor_rollup *rlp)
+{
+	struct rollup_frame *nf = NULL;
+
+	pthread_mutex_lock(&rlp->lock);
+
+	/* Only hand it over if there is a fresh one to continue with,
+	 * otherwise keep merging into the current one */
+	if (rlp->n_pool) {
+		nf = rlp->pool[--rlp->n_pool];
+		rlp->queue[(rlp->q_head + rlp->q_len) % ROLLUP_QUEUE_LEN] = rlp->cur;
+		rlp->q_len++;
+		pthread_cond_signal(&rlp->cond);
+	}
+
+	pthread_mutex_unlock(&rlp->lock);
+
+	if (nf) {
+		nf->n_spectra = 0;
+		rlp->cur = nf;
+	}
+}
+
+void
+fosphor_rollup_destroy(struct fosphor_rollup *rlp)
+{
+	int i;
+
+	if (!rlp)
+		return;
+
+	/* Last frame and let the writer finish */
+	pthread_mutex_lock(&rlp->lock);
+	if (rlp->cur->n_spectra) {
+		rlp->queue[(rlp->q_head + rlp->q_len) % ROLLUP_QUEUE_LEN] = rlp->cur;
+		rlp->q_len++;
+	}
+	rlp->stop = 1;
+	pthread_cond_signal(&rlp->cond);
+	pthread_mutex_unlock(&rlp->lock);
+
+	pthread_join(rlp->thread, NULL);
+
+	pthread_cond_destroy(&rlp->cond);
+	pthread_mutex_destroy(&rlp->lock);
+
+	/* Partial periods */
+	for (i=0; i<rlp->hdr.n_levels; i++)
+		if (!rlp->io_error && rlp->acc[i].n_spectra && _rollup_write_slot(rlp, i))
+			rlp->io_error = 1;
+
+	close(rlp->fd);
+
+	for (i=0; i<ROLLUP_QUEUE_LEN; i++)
+		free(rlp->frames[i].stats);
+
+	for (i=0; i<FOSPHOR_ROLLUP_MAX_LEVELS; i++) {
+		free(rlp->acc[i].min);
+		free(rlp->acc[i].max);
+		free(rlp->acc[i].sum);
+	}
+
+	free(rlp->slot);
+	free(rlp);
+}
+
+void
+fosphor_rollup_publish(struct fosphor_rollup *rlp,
+                       const float *raw, int n_spectra)
+{
+	struct rollup_frame *f = rlp->cur;
+	int i;
+
+	if (!n_spectra)
+		return;
+
+	/* Merge the batch statistics in the current frame */
+	if (!f->n_spectra) {
+		memcpy(f->stats, raw, rlp->n * 4 * sizeof(float));
+	} else {
+		for (i=0; i<rlp->n; i++) {
+			f->stats[4*i+0]  = fminf(f->stats[4*i+0], raw[4*i+0]);
+			f->stats[4*i+1]  = fmaxf(f->stats[4*i+1], raw[4*i+1]);
+			f->stats[4*i+2] += raw[4*i+2];
+		}
+	}
+
+	f->n_spectra += n_spectra;
+	f->t_ns = _rollup_now_ns();
+
+	_rollup_submit(rlp);
+}
+
+
+#else /* _WIN32 */
+
+struct fosphor_rollup *
+fosphor_rollup_create(const char *path, int n_streams,
+                      const int *period_s, const int *n_slots, int n_levels,
+                      double freq_center, double freq_span)
+{
+	fprintf(stderr, "[!] Spectrum rollups not supported on this platform\n");
+	return NULL;
+}
+
+void
+fosphor_rollup_destroy(struct fosphor_rollup *rlp)
+{
+}
+
+void
+fosphor_rollup_publish(struct fosphor_rollup *rlp,
+                       const float *raw, int n_spectra)
+{
+}
+
+#endif /* _WIN32 */
+
+
+/*! @} */
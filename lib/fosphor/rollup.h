@@ -0,0 +1,100 @@
+/*
+ * rollup.h
+ *
+ * Long-term multi-resolution spectrum rollups
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+/*! \defgroup rollup
+ *  @{
+ */
+
+/*! \file rollup.h
+ *  \brief Long-term multi-resolution spectrum rollups
+ *
+ *  Per bin min / mean / max power of every spectrum, over periods of
+ *  several lengths (levels), each stored in its own fixed size ring of
+ *  slots. The file never grows past its creation size and is meant to be
+ *  used straight from a mmap (native byte order, readers check the magic) :
+ *
+ *   fosphor_rollup_header
+ *   (padding to a page boundary)
+ *   { fosphor_rollup_slot, data } * level[0].n_slots
+ *   { fosphor_rollup_slot, data } * level[1].n_slots
+ *   ...
+ *
+ *  Slots are addressed by time : the period starting at t (a multiple of
+ *  period_s since the epoch) goes in slot (t / period_s) % n_slots. A slot
+ *  holding an older period (or nothing, t_start_ns == 0) is stale. Data is
+ *  [n_streams][3][fft_len] dB floats (min, mean, max), lowest frequency
+ *  first, the mean being the one of the linear power.
+ *
+ *  Each level's t_last_ns is updated after its slot was written, it's the
+ *  start of the latest complete (or, once closed, partial) period. The slot
+ *  after it may be in the middle of being overwritten.
+ *
+ *  Re-opening a file with the same geometry and frequency range resumes it
+ *  (a period interrupted by the restart only keeps what came after it),
+ *  anything else starts a new one.
+ */
+
+#include <stdint.h>
+
+
+#define FOSPHOR_ROLLUP_MAGIC		0x55524f46	/* "FORU" */
+#define FOSPHOR_ROLLUP_VERSION		1
+
+#define FOSPHOR_ROLLUP_MAX_LEVELS	4
+
+struct fosphor_rollup_level
+{
+	uint32_t period_s;	/* Time covered by a slot */
+	uint32_t n_slots;	/* Ring capacity */
+	uint64_t offset;	/* File offset of the first slot */
+	uint64_t t_last_ns;	/* Start of the last written period, 0 = none */
+};
+
+struct fosphor_rollup_header
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t n_levels;
+	uint32_t fft_len;
+	uint16_t n_streams;
+	uint16_t _rsvd0;
+	double   freq_center;
+	double   freq_span;
+	uint64_t t_create_ns;
+	uint64_t slot_len;	/* Bytes per slot, header included */
+	struct fosphor_rollup_level level[FOSPHOR_ROLLUP_MAX_LEVELS];
+};
+
+struct fosphor_rollup_slot
+{
+	uint64_t t_start_ns;	/* Start of the period */
+	uint32_t n_spectra;	/* Spectra accounted for */
+	uint32_t _rsvd;
+};
+
+
+struct fosphor_rollup;
+
+/* Levels are given by slot period (seconds) and ring capacity, NULL for
+ * the defaults (1 s for 1 h, 1 min for a week, 1 h for a year) */
+struct fosphor_rollup *fosphor_rollup_create(const char *path, int n_streams,
+                                             const int *period_s, const int *n_slots,
+                                             int n_levels,
+                                             double freq_center, double freq_span);
+void fosphor_rollup_destroy(struct fosphor_rollup *rlp);
+
+/* 'raw' is [stream][bin] (min, max, sum, -) of the linear power of
+ * 'n_spectra' spectra, FFT order, as produced by the device */
+void fosphor_rollup_publish(struct fosphor_rollup *rlp,
+                            const float *raw, int n_spectra);
+
+
+/*! @} */
@@ -0,0 +1,314 @@
+/*
+ * shm.c
+ *
+ * Shared memory publisher of processed frames
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*! \addtogroup shm
+ *  @{
+ */
+
+/*! \file shm.c
+ *  \brief Shared memory publisher of processed frames
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cl.h"
+#include "export.h"
+#include "private.h"
+#include "shm.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+
+struct fosphor_shm
+{
+	char name[256];
+	struct fosphor_shm_header *hdr;
+	size_t len;
+};
+
+
+static void
+_shm_name(char *dst, size_t len, const char *name)
+{
+	/* POSIX wants a single leading '/' */
+	snprintf(dst, len, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+static inline float *
+_shm_section(struct fosphor_shm_header *hdr, uint64_t ofs)
+{
+	return (float *)((char *)hdr + ofs);
+}
+
+
+struct fosphor_shm *
+fosphor_shm_create(const char *name, int n_streams)
+{
+	struct fosphor_shm *shm;
+	struct fosphor_shm_header *hdr;
+	size_t wf_len, histo_len, spectrum_len;
+	int fd = -1;
+
+	/* Allocate structure */
+	shm = malloc(sizeof(struct fosphor_shm));
+	if (!shm)
+		return NULL;
+
+	memset(shm, 0, sizeof(struct fosphor_shm));
+
+	_shm_name(shm->name, sizeof(shm->name), name);
+
+	/* Layout */
+	wf_len       = n_streams * FOSPHOR_EXPORT_WF_ROWS    * FOSPHOR_FFT_LEN * sizeof(float);
+	histo_len    = n_streams * FOSPHOR_EXPORT_HISTO_BINS * FOSPHOR_FFT_LEN * sizeof(float);
+	spectrum_len = n_streams * 2 * FOSPHOR_FFT_LEN * sizeof(float);
+
+	shm->len = 4096 + wf_len + histo_len + spectrum_len;
+
+	/* Create and map the segment */
+	fd = shm_open(shm->name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "[!] Unable to create shared memory '%s'\n", shm->name);
+		goto error;
+	}
+
+	if (ftruncate(fd, shm->len)) {
+		fprintf(stderr, "[!] Unable to size shared memory '%s'\n", shm->name);
+		goto error;
+	}
+
+	hdr = mmap(NULL, shm->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		fprintf(stderr, "[!] Unable to map shared memory '%s'\n", shm->name);
+		goto error;
+	}
+
+	close(fd);
+	fd = -1;
+
+	shm->hdr = hdr;
+
+	/* Static header fields (magic last, so readers see a valid header) */
+	hdr->version       = FOSPHOR_SHM_VERSION;
+	hdr->n_streams     = n_streams;
+	hdr->fft_len       = FOSPHOR_FFT_LEN;
+	hdr->wf_rows       = FOSPHOR_EXPORT_WF_ROWS;
+	hdr->histo_bins    = FOSPHOR_EXPORT_HISTO_BINS;
+	hdr->ofs_waterfall = 4096;
+	hdr->ofs_histogram = hdr->ofs_waterfall + wf_len;
+	hdr->ofs_spectrum  = hdr->ofs_histogram + histo_len;
+	hdr->total_len     = shm->len;
+
+	atomic_thread_fence(memory_order_release);
+
+	hdr->magic = FOSPHOR_SHM_MAGIC;
+
+	return shm;
+
+	/* Error path */
+error:
+	if (fd >= 0) {
+		close(fd);
+		shm_unlink(shm->name);
+	}
+
+	free(shm);
+
+	return NULL;
+}
+
+void
+fosphor_shm_destroy(struct fosphor_shm *shm)
+{
+	if (!shm)
+		return;
+
+	/* Readers keep their mapping, but the name goes away */
+	munmap(shm->hdr, shm->len);
+	shm_unlink(shm->name);
+
+	free(shm);
+}
+
+void
+fosphor_shm_publish(struct fosphor_shm *shm, struct fosphor *fosphor,
+                    int new_rows)
+{
+	struct fosphor_shm_header *hdr = shm->hdr;
+	struct timespec ts;
+	float *wf, *histo, *spectrum;
+	int pos, i, j;
+
+	wf       = _shm_section(hdr, hdr->ofs_waterfall);
+	histo    = _shm_section(hdr, hdr->ofs_histogram);
+	spectrum = _shm_section(hdr, hdr->ofs_spectrum);
+
+	pos = fosphor_cl_get_waterfall_position(fosphor);
+
+	/* Start write */
+	hdr->seq++;
+	atomic_thread_fence(memory_order_release);
+
+	/* Data */
+	for (i=0; i<fosphor->n_streams; i++)
+	{
+		for (j=new_rows; j>0; j--)
+		{
+			int row = (pos - j) & (FOSPHOR_EXPORT_WF_ROWS - 1);
+			fosphor_export_waterfall_row(fosphor, i,
+				row, &wf[((i * FOSPHOR_EXPORT_WF_ROWS) + row) * FOSPHOR_FFT_LEN]);
+		}
+
+		fosphor_export_histogram(fosphor, i,
+			&histo[i * FOSPHOR_EXPORT_HISTO_BINS * FOSPHOR_FFT_LEN]);
+
+		fosphor_export_spectrum(fosphor, i,
+			&spectrum[(2 * i + 0) * FOSPHOR_FFT_LEN],
+			&spectrum[(2 * i + 1) * FOSPHOR_FFT_LEN]);
+	}
+
+	/* Header */
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	hdr->frame++;
+	hdr->total_rows   += new_rows;
+	hdr->timestamp_ns  = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	hdr->waterfall_pos = pos;
+	hdr->db_ref        = fosphor->power.db_ref;
+	hdr->db_per_div    = fosphor->power.db_per_div;
+	hdr->freq_center   = fosphor->frequency.center;
+	hdr->freq_span     = fosphor->frequency.span;
+
+	/* Done */
+	atomic_thread_fence(memory_order_release);
+	hdr->seq++;
+}
+
+
+const struct fosphor_shm_header *
+fosphor_shm_attach(const char *name)
+{
+	struct fosphor_shm_header *hdr;
+	char shm_name[256];
+	struct stat st;
+	int fd;
+
+	_shm_name(shm_name, sizeof(shm_name), name);
+
+	fd = shm_open(shm_name, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) || (st.st_size < (off_t)sizeof(struct fosphor_shm_header))) {
+		close(fd);
+		return NULL;
+	}
+
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (hdr == MAP_FAILED)
+		return NULL;
+
+	if ((hdr->magic != FOSPHOR_SHM_MAGIC) ||
+	    (hdr->version != FOSPHOR_SHM_VERSION) ||
+	    (hdr->total_len != (uint64_t)st.st_size))
+	{
+		munmap(hdr, st.st_size);
+		return NULL;
+	}
+
+	return hdr;
+}
+
+void
+fosphor_shm_detach(const struct fosphor_shm_header *hdr)
+{
+	if (hdr)
+		munmap((void *)hdr, hdr->total_len);
+}
+
+uint64_t
+fosphor_shm_read_begin(const struct fosphor_shm_header *hdr)
+{
+	uint64_t seq;
+
+	while ((seq = hdr->seq) & 1)
+		sched_yield();
+
+	atomic_thread_fence(memory_order_acquire);
+
+	return seq;
+}
+
+int
+fosphor_shm_read_retry(const struct fosphor_shm_header *hdr, uint64_t seq)
+{
+	atomic_thread_fence(memory_order_acquire);
+
+	return hdr->seq != seq;
+}
+
+#else /* _WIN32 */
+
+struct fosphor_shm *
+fosphor_shm_create(const char *name, int n_streams)
+{
+	fprintf(stderr, "[!] Shared memory output not supported on this platform\n");
+	return NULL;
+}
+
+void
+fosphor_shm_destroy(struct fosphor_shm *shm)
+{
+}
+
+void
+fosphor_shm_publish(struct fosphor_shm *shm, struct fosphor *fosphor,
+                    int new_rows)
+{
+}
+
+const struct fosphor_shm_header *
+fosphor_shm_attach(const char *name)
+{
+	return NULL;
+}
+
+void
+fosphor_shm_detach(const struct fosphor_shm_header *hdr)
+{
+}
+
+uint64_t
+fosphor_shm_read_begin(const struct fosphor_shm_header *hdr)
+{
+	return 0;
+}
+
+int
+fosphor_shm_read_retry(const struct fosphor_shm_header *hdr, uint64_t seq)
+{
+	return 1;
+}
+
+#endif /* _WIN32 */
+
+
+/*! @} */
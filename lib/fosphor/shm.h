@@ -0,0 +1,93 @@
+/*
+ * shm.h
+ *
+ * Shared memory publisher of processed frames
+ *
+ * Copyright (C) 2013-2021 Sylvain Munaut
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+/*! \defgroup shm
+ *  @{
+ */
+
+/*! \file shm.h
+ *  \brief Shared memory publisher of processed frames
+ *
+ *  The segment starts with a fosphor_shm_header followed by the data
+ *  sections at the offsets given in the header. All data is float, in dB,
+ *  lowest frequency first (see export.h):
+ *
+ *   - waterfall : [n_streams][wf_rows][fft_len]   ring, see waterfall_pos
+ *   - histogram : [n_streams][histo_bins][fft_len]
+ *   - spectrum  : [n_streams][2][fft_len]          live then max-hold
+ *
+ *  The header and the data are protected by a sequence lock : `seq` is
+ *  odd while the publisher is writing. Readers must sample `seq` before
+ *  and after copying what they need and retry if it changed or was odd
+ *  (see fosphor_shm_read_begin / fosphor_shm_read_retry).
+ *
+ *  The waterfall is a ring of `wf_rows` lines, `waterfall_pos` is the next
+ *  line to be written and `total_rows` counts all lines ever written, so
+ *  a reader can tell which lines are new (and whether it fell behind).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct fosphor;
+
+
+#define FOSPHOR_SHM_MAGIC	0x48534f46	/* "FOSH" */
+#define FOSPHOR_SHM_VERSION	1
+
+struct fosphor_shm_header
+{
+	/* Static (set at creation) */
+	uint32_t magic;
+	uint32_t version;
+	uint32_t n_streams;
+	uint32_t fft_len;
+	uint32_t wf_rows;
+	uint32_t histo_bins;
+	uint64_t ofs_waterfall;
+	uint64_t ofs_histogram;
+	uint64_t ofs_spectrum;
+	uint64_t total_len;
+
+	/* Dynamic (updated each frame) */
+	volatile uint64_t seq;
+	uint64_t frame;
+	uint64_t total_rows;
+	uint64_t timestamp_ns;
+	int32_t  waterfall_pos;
+	int32_t  db_ref;
+	int32_t  db_per_div;
+	int32_t  _pad;
+	double   freq_center;
+	double   freq_span;
+};
+
+
+/* Publisher */
+
+struct fosphor_shm;
+
+struct fosphor_shm *fosphor_shm_create(const char *name, int n_streams);
+void fosphor_shm_destroy(struct fosphor_shm *shm);
+void fosphor_shm_publish(struct fosphor_shm *shm, struct fosphor *fosphor,
+                         int new_rows);
+
+
+/* Readers */
+
+const struct fosphor_shm_header *fosphor_shm_attach(const char *name);
+void fosphor_shm_detach(const struct fosphor_shm_header *hdr);
+
+uint64_t fosphor_shm_read_begin(const struct fosphor_shm_header *hdr);
+int      fosphor_shm_read_retry(const struct fosphor_shm_header *hdr, uint64_t seq);
+
+
+/*! @} */
@@ -21,13 +21,14 @@ namespace gr {
   namespace fosphor {
 
 glfw_sink_c::sptr
-glfw_sink_c::make()
+glfw_sink_c::make(int n_inputs, bool real_input)
 {
-	return gnuradio::get_initial_sptr(new glfw_sink_c_impl());
+	return gnuradio::get_initial_sptr(new glfw_sink_c_impl(n_inputs, real_input));
 }
 
-glfw_sink_c_impl::glfw_sink_c_impl()
-  : base_sink_c("glfw_sink_c")
+glfw_sink_c_impl::glfw_sink_c_impl(int n_inputs, bool real_input)
+  : base_sink_c("glfw_sink_c", n_inputs, real_input),
+    base_sink_c_impl(n_inputs, real_input)
 {
 	/* Nothing to do but super call */
 }
@@ -43,6 +44,18 @@ glfw_sink_c_impl::glfw_cb_reshape(int w, int h)
 	this->cb_visibility(true);
 }
 
+void
+glfw_sink_c_impl::glfw_cb_iconify(int iconified)
+{
+	this->cb_visibility(!iconified);
+}
+
+void
+glfw_sink_c_impl::glfw_cb_refresh(void)
+{
+	this->cb_redraw();
+}
+
 void
 glfw_sink_c_impl::glfw_cb_key(int key, int scancode, int action, int mods)
 {
@@ -102,6 +115,18 @@ glfw_sink_c_impl::glfw_cb_key(int key, int scancode, int action, int mods)
 	case GLFW_KEY_SPACE:
 		this->execute_ui_action(FREEZE_TOGGLE);
 		break;
+
+	case GLFW_KEY_R:
+		this->execute_ui_action(AUTO_RANGE_TOGGLE);
+		break;
+
+	case GLFW_KEY_LEFT_BRACKET:
+		this->execute_ui_action(TIME_BACK);
+		break;
+
+	case GLFW_KEY_RIGHT_BRACKET:
+		this->execute_ui_action(TIME_FORWARD);
+		break;
 	}
 }
 
@@ -132,6 +157,20 @@ glfw_sink_c_impl::_glfw_cb_reshape(GLFWwindow *wnd, int w, int h)
 	sink->glfw_cb_reshape(w, h);
 }
 
+void
+glfw_sink_c_impl::_glfw_cb_iconify(GLFWwindow *wnd, int iconified)
+{
+	glfw_sink_c_impl *sink = (glfw_sink_c_impl *) glfwGetWindowUserPointer(wnd);
+	sink->glfw_cb_iconify(iconified);
+}
+
+void
+glfw_sink_c_impl::_glfw_cb_refresh(GLFWwindow *wnd)
+{
+	glfw_sink_c_impl *sink = (glfw_sink_c_impl *) glfwGetWindowUserPointer(wnd);
+	sink->glfw_cb_refresh();
+}
+
 void
 glfw_sink_c_impl::_glfw_cb_key(GLFWwindow *wnd, int key, int scancode, int action, int mods)
 {
@@ -167,6 +206,8 @@ glfw_sink_c_impl::glctx_init()
 
 	/* Setup callbacks */
 	glfwSetFramebufferSizeCallback(wnd, _glfw_cb_reshape);
+	glfwSetWindowIconifyCallback(wnd, _glfw_cb_iconify);
+	glfwSetWindowRefreshCallback(wnd, _glfw_cb_refresh);
 	glfwSetKeyCallback(wnd, _glfw_cb_key);
 	glfwSetMouseButtonCallback(wnd, _glfw_cb_mouse);
 
@@ -199,6 +240,12 @@ glfw_sink_c_impl::glctx_update()
 	/* Nothing to do for GLFW */
 }
 
+void
+glfw_sink_c_impl::glctx_swap_interval(int interval)
+{
+	glfwSwapInterval(interval);
+}
+
 
   } /* namespace fosphor */
 } /* namespace gr */
@@ -30,10 +30,14 @@ namespace gr {
 
       void glfw_render(void);
       void glfw_cb_reshape(int w, int h);
+      void glfw_cb_iconify(int iconified);
+      void glfw_cb_refresh(void);
       void glfw_cb_key(int key, int scancode, int action, int mods);
       void glfw_cb_mouse(int btn, int action, int mods);
 
       static void _glfw_cb_reshape(GLFWwindow *wnd, int w, int h);
+      static void _glfw_cb_iconify(GLFWwindow *wnd, int iconified);
+      static void _glfw_cb_refresh(GLFWwindow *wnd);
       static void _glfw_cb_key(GLFWwindow *wnd, int key, int scancode, int action, int mods);
       static void _glfw_cb_mouse(GLFWwindow *wnd, int btn, int action, int mods);
 
@@ -44,9 +48,10 @@ namespace gr {
       void glctx_poll();
       void glctx_fini();
       void glctx_update();
+      void glctx_swap_interval(int interval);
 
      public:
-      glfw_sink_c_impl();
+      glfw_sink_c_impl(int n_inputs, bool real_input);
     };
 
   } // namespace fosphor
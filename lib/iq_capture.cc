@@ -0,0 +1,366 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2013-2021 Sylvain Munaut <tnt@246tNt.com>
+ *
+ * This file is part of gr-fosphor
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "iq_capture.h"
+
+namespace gr {
+  namespace fosphor {
+
+/* Writer backlog before captures get cut short */
+const size_t iq_capture::k_max_queued = 256 * 1024 * 1024;
+
+
+static std::string
+_format_time(std::chrono::system_clock::time_point tp, bool filename)
+{
+	int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count();
+	time_t t = (time_t)(us / 1000000);
+	struct tm tm;
+	char buf[64];
+	size_t l;
+
+#ifdef _WIN32
+	gmtime_s(&tm, &t);
+#else
+	gmtime_r(&t, &tm);
+#endif
+
+	l = strftime(buf, sizeof(buf), filename ? "%Y%m%dT%H%M%S" : "%Y-%m-%dT%H:%M:%S", &tm);
+	snprintf(buf + l, sizeof(buf) - l, ".%06dZ", (int)(us % 1000000));
+
+	return std::string(buf);
+}
+
+
+iq_capture::iq_capture(int n_streams, bool real_input, const std::string &prefix,
+                       double sample_rate, double frequency, size_t pre, size_t post,
+                       size_t latency) :
+	d_n_streams(n_streams), d_real_input(real_input), d_prefix(prefix),
+	d_sample_rate(sample_rate), d_frequency(frequency), d_pre(pre), d_post(post),
+	d_ring(n_streams, pre + latency), d_pos(0),
+	d_active(false), d_start(0), d_end(0),
+	d_queued(0), d_stop(false), d_status(0)
+{
+	this->d_writer = gr::thread::thread(_writer, this);
+}
+
+iq_capture::~iq_capture()
+{
+	/* Finish what was started, whatever we have */
+	if (this->d_active)
+		this->close();
+
+	{
+		gr::thread::scoped_lock lock(this->d_mutex);
+		this->d_stop = true;
+		this->d_cond.notify_one();
+	}
+
+	this->d_writer.join();
+}
+
+int
+iq_capture::status()
+{
+	gr::thread::scoped_lock lock(this->d_mutex);
+	int v = this->d_status;
+	this->d_status = 0;
+	return v;
+}
+
+
+bool
+iq_capture::queue(job *j)
+{
+	gr::thread::scoped_lock lock(this->d_mutex);
+	size_t size = j->data.size() * sizeof(gr_complex);
+
+	if ((this->d_queued + size) > k_max_queued) {
+		this->d_status |= STATUS_OVERRUN;
+		delete j;
+		return false;
+	}
+
+	this->d_queued += size;
+	this->d_queue.push_back(j);
+	this->d_cond.notify_one();
+
+	return true;
+}
+
+void
+iq_capture::close()
+{
+	job *j = new job();
+
+	j->type = job::CLOSE;
+	j->annotations.swap(this->d_annotations);
+
+	this->queue(j);
+	this->d_active = false;
+}
+
+void
+iq_capture::write(void * const *data, size_t len)
+{
+	uint64_t pos = this->d_pos;
+	size_t n;
+	job *j;
+	int s;
+
+	this->d_ring.write(data, len);
+	this->d_pos += len;
+
+	if (!this->d_active)
+		return;
+
+	/* Up to the end of the capture */
+	n = (size_t)std::min((uint64_t)len, this->d_end - pos);
+
+	j = new job();
+	j->type = job::DATA;
+	j->len  = n;
+	j->data.resize(n * this->d_n_streams);
+
+	for (s=0; s<this->d_n_streams; s++)
+		memcpy(&j->data[s * n], data[s], n * sizeof(gr_complex));
+
+	if (!this->queue(j) || (this->d_pos >= this->d_end))
+		this->close();
+}
+
+bool
+iq_capture::trigger(uint64_t pos, size_t len, const std::string &label,
+                    double f_lo, double f_hi)
+{
+	double rate = this->d_real_input ? (this->d_sample_rate / 2.0) : this->d_sample_rate;
+	uint64_t oldest, start;
+	bool complete;
+	annotation a;
+	size_t n;
+	job *j;
+	int s;
+
+	pos = std::min(pos, this->d_pos);
+
+	a.len   = len;
+	a.label = label;
+	a.f_lo  = f_lo;
+	a.f_hi  = f_hi;
+
+	/* Already recording : just carry on for longer */
+	if (this->d_active) {
+		a.start = pos - std::min(pos, this->d_start);
+		this->d_annotations.push_back(a);
+		this->d_end = std::max(this->d_end, pos + this->d_post);
+		return true;
+	}
+
+	/* Pre-trigger window, as much as the ring still has */
+	oldest   = this->d_pos - this->d_ring.fill();
+	start    = (pos > this->d_pre) ? (pos - this->d_pre) : 0;
+	complete = (start >= oldest);
+	start    = std::max(start, oldest);
+
+	/* New recording, named after its first sample (time it reached us) */
+	std::chrono::system_clock::time_point t0 = std::chrono::system_clock::now() -
+		std::chrono::duration_cast<std::chrono::system_clock::duration>(
+			std::chrono::duration<double>((double)(this->d_pos - start) / rate));
+
+	j = new job();
+	j->type     = job::OPEN;
+	j->name     = this->d_prefix + "_" + _format_time(t0, true);
+	j->datetime = _format_time(t0, false);
+	this->queue(j);
+
+	this->d_active = true;
+	this->d_start  = start;
+	this->d_end    = pos + this->d_post;
+
+	a.start = pos - std::min(pos, start);
+	this->d_annotations.push_back(a);
+
+	/* What we already have */
+	n = (size_t)(this->d_pos - start);
+
+	if (n) {
+		std::vector<void *> dst(this->d_n_streams);
+
+		j = new job();
+		j->type = job::DATA;
+		j->len  = n;
+		j->data.resize(n * this->d_n_streams);
+
+		for (s=0; s<this->d_n_streams; s++)
+			dst[s] = &j->data[s * n];
+
+		this->d_ring.read(dst.data(), 0, n);
+
+		if (!this->queue(j)) {
+			this->close();
+			return complete;
+		}
+	}
+
+	if (this->d_pos >= this->d_end)
+		this->close();
+
+	return complete;
+}
+
+
+void
+iq_capture::writer()
+{
+	const int fpu = this->d_real_input ? 1 : 2;	/* Floats per unit */
+	std::string name, datetime;
+	std::vector<float> buf;
+	FILE *fh = NULL;
+
+	while (1)
+	{
+		job *j;
+
+		{
+			gr::thread::scoped_lock lock(this->d_mutex);
+
+			while (this->d_queue.empty() && !this->d_stop)
+				this->d_cond.wait(lock);
+
+			if (this->d_queue.empty())
+				break;
+
+			j = this->d_queue.front();
+			this->d_queue.pop_front();
+			this->d_queued -= j->data.size() * sizeof(gr_complex);
+		}
+
+		switch (j->type) {
+		case job::OPEN:
+			name     = j->name;
+			datetime = j->datetime;
+
+			fh = fopen((name + ".sigmf-data").c_str(), "wb");
+			if (!fh) {
+				gr::thread::scoped_lock lock(this->d_mutex);
+				this->d_status |= STATUS_WRITE_ERROR;
+			}
+			break;
+
+		case job::DATA:
+			if (fh) {
+				/* Channels interleaved, sample by sample */
+				size_t units = j->len * 2 / fpu;
+				size_t u;
+				int s, k;
+
+				buf.resize(units * this->d_n_streams * fpu);
+
+				for (s=0; s<this->d_n_streams; s++) {
+					const float *src = (const float *)&j->data[s * j->len];
+					for (u=0; u<units; u++)
+						for (k=0; k<fpu; k++)
+							buf[(u * this->d_n_streams + s) * fpu + k] = src[u * fpu + k];
+				}
+
+				if (fwrite(buf.data(), sizeof(float), buf.size(), fh) != buf.size()) {
+					gr::thread::scoped_lock lock(this->d_mutex);
+					this->d_status |= STATUS_WRITE_ERROR;
+					fclose(fh);
+					fh = NULL;
+				}
+			}
+			break;
+
+		case job::CLOSE:
+			if (fh) {
+				bool ok = (fclose(fh) == 0);
+				fh = NULL;
+
+				ok &= this->write_meta(name, datetime, j->annotations);
+
+				if (!ok) {
+					gr::thread::scoped_lock lock(this->d_mutex);
+					this->d_status |= STATUS_WRITE_ERROR;
+				}
+			}
+			break;
+		}
+
+		delete j;
+	}
+
+	if (fh)
+		fclose(fh);
+}
+
+void
+iq_capture::_writer(iq_capture *obj)
+{
+	obj->writer();
+}
+
+bool
+iq_capture::write_meta(const std::string &name, const std::string &datetime,
+                       const std::vector<annotation> &annotations)
+{
+	const int upp = this->d_real_input ? 2 : 1;	/* Samples per position */
+	FILE *fh;
+	size_t i;
+
+	fh = fopen((name + ".sigmf-meta").c_str(), "w");
+	if (!fh)
+		return false;
+
+	fprintf(fh, "{\n");
+	fprintf(fh, "    \"global\": {\n");
+	fprintf(fh, "        \"core:datatype\": \"%s\",\n", this->d_real_input ? "rf32_le" : "cf32_le");
+	fprintf(fh, "        \"core:sample_rate\": %.17g,\n", this->d_sample_rate);
+	fprintf(fh, "        \"core:num_channels\": %d,\n", this->d_n_streams);
+	fprintf(fh, "        \"core:version\": \"1.0.0\",\n");
+	fprintf(fh, "        \"core:recorder\": \"gr-fosphor\"\n");
+	fprintf(fh, "    },\n");
+	fprintf(fh, "    \"captures\": [\n");
+	fprintf(fh, "        {\n");
+	fprintf(fh, "            \"core:sample_start\": 0,\n");
+	fprintf(fh, "            \"core:frequency\": %.17g,\n", this->d_frequency);
+	fprintf(fh, "            \"core:datetime\": \"%s\"\n", datetime.c_str());
+	fprintf(fh, "        }\n");
+	fprintf(fh, "    ],\n");
+	fprintf(fh, "    \"annotations\": [");
+
+	for (i=0; i<annotations.size(); i++)
+	{
+		const annotation &a = annotations[i];
+
+		fprintf(fh, "%s\n        {\n", i ? "," : "");
+		fprintf(fh, "            \"core:sample_start\": %llu,\n", (unsigned long long)(a.start * upp));
+		if (a.len)
+			fprintf(fh, "            \"core:sample_count\": %llu,\n", (unsigned long long)(a.len * upp));
+		fprintf(fh, "            \"core:freq_lower_edge\": %.17g,\n", a.f_lo);
+		fprintf(fh, "            \"core:freq_upper_edge\": %.17g,\n", a.f_hi);
+		fprintf(fh, "            \"core:label\": \"%s\"\n", a.label.c_str());
+		fprintf(fh, "        }");
+	}
+
+	fprintf(fh, "%s]\n", annotations.empty() ? "" : "\n    ");
+	fprintf(fh, "}\n");
+
+	return (fclose(fh) == 0);
+}
+
+  } /* namespace fosphor */
+} /* namespace gr */
@@ -0,0 +1,115 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2013-2021 Sylvain Munaut <tnt@246tNt.com>
+ *
+ * This file is part of gr-fosphor
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gnuradio/fosphor/api.h>
+
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/thread/thread.h>
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "iq_ring.h"
+
+namespace gr {
+  namespace fosphor {
+
+   /* Triggered raw samples capture : keeps the last 'pre' samples of each
+    * stream and, once triggered, has them and the next 'post' ones written
+    * as a SigMF recording (<prefix>_<time>.sigmf-data / .sigmf-meta) by a
+    * background thread. Positions count samples given to write(), and all
+    * but the writer runs from the render thread. 'latency' is the most
+    * samples that can be written between a trigger position and the
+    * trigger() call, it's kept in history on top of 'pre' */
+   class GR_FOSPHOR_API iq_capture
+   {
+    public:
+     enum {
+       STATUS_OVERRUN     = (1 << 0),	/* Writer too slow, capture cut short */
+       STATUS_WRITE_ERROR = (1 << 1),
+     };
+
+    private:
+     struct annotation {
+       uint64_t start;		/* From the start of the capture */
+       size_t len;		/* 0 when unknown */
+       std::string label;
+       double f_lo;
+       double f_hi;
+     };
+
+     struct job {
+       enum { OPEN, DATA, CLOSE } type;
+       std::string name;		/* OPEN : file names, without extension */
+       std::string datetime;		/* OPEN : time of the first sample */
+       std::vector<gr_complex> data;	/* DATA : [stream][len] */
+       size_t len;
+       std::vector<annotation> annotations;	/* CLOSE */
+     };
+
+     static const size_t k_max_queued;
+
+     int d_n_streams;
+     bool d_real_input;
+     std::string d_prefix;
+     double d_sample_rate;	/* Of the input, real samples for real input */
+     double d_frequency;
+     size_t d_pre;
+     size_t d_post;
+
+     iq_ring d_ring;
+     uint64_t d_pos;		/* Samples written so far */
+
+     bool d_active;
+     uint64_t d_start;
+     uint64_t d_end;
+     std::vector<annotation> d_annotations;
+
+     /* Writer thread */
+     gr::thread::thread d_writer;
+     gr::thread::mutex d_mutex;
+     gr::thread::condition_variable d_cond;
+     std::deque<job *> d_queue;
+     size_t d_queued;		/* Bytes waiting in the queue */
+     bool d_stop;
+     int d_status;
+
+     bool queue(job *j);
+     void close();
+
+     void writer();
+     static void _writer(iq_capture *obj);
+     bool write_meta(const std::string &name, const std::string &datetime,
+                     const std::vector<annotation> &annotations);
+
+    public:
+     iq_capture(int n_streams, bool real_input, const std::string &prefix,
+                double sample_rate, double frequency, size_t pre, size_t post,
+                size_t latency);
+     ~iq_capture();
+
+     uint64_t position() const { return this->d_pos; }
+     bool active() const { return this->d_active; }
+     int status();
+
+     void write(void * const *data, size_t len);
+
+     /* Returns false if the pre-trigger window was cut short because
+      * some of its samples were already out of the history */
+     bool trigger(uint64_t pos, size_t len, const std::string &label,
+                  double f_lo, double f_hi);
+   };
+
+  } // namespace fosphor
+} // namespace gr
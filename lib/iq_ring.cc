@@ -0,0 +1,121 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2013-2021 Sylvain Munaut <tnt@246tNt.com>
+ *
+ * This file is part of gr-fosphor
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+# include <sys/mman.h>
+#endif
+
+#include "iq_ring.h"
+
+namespace gr {
+  namespace fosphor {
+
+iq_ring::iq_ring(int n_streams, size_t length, bool hugepages) :
+	d_buf(NULL), d_map_len(0), d_hugepages(false),
+	d_n_streams(n_streams), d_len(length), d_wp(0), d_fill(0)
+{
+	size_t size = sizeof(gr_complex) * this->d_len * this->d_n_streams;
+
+#if !defined(_WIN32) && defined(MAP_HUGETLB)
+	/* Huge pages if we can get them (they need to be reserved by the
+	 * admin, vm.nr_hugepages), normal memory otherwise */
+	if (hugepages) {
+		const size_t hp = 2 * 1024 * 1024;
+		size_t map_len = (size + hp - 1) & ~(hp - 1);
+		void *p;
+
+		p = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+		         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if (p != MAP_FAILED) {
+			this->d_buf       = (gr_complex *)p;
+			this->d_map_len   = map_len;
+			this->d_hugepages = true;
+			return;
+		}
+	}
+#endif
+
+	this->d_buf = new gr_complex[this->d_len * this->d_n_streams];
+}
+
+iq_ring::~iq_ring()
+{
+#ifndef _WIN32
+	if (this->d_map_len) {
+		munmap(this->d_buf, this->d_map_len);
+		return;
+	}
+#endif
+
+	delete[] this->d_buf;
+}
+
+void
+iq_ring::clear()
+{
+	this->d_wp   = 0;
+	this->d_fill = 0;
+}
+
+void
+iq_ring::write(void * const *data, size_t len)
+{
+	size_t skip = 0, pos, n;
+	int s;
+
+	/* Only the tail can fit */
+	if (len > this->d_len) {
+		skip = len - this->d_len;
+		len  = this->d_len;
+	}
+
+	for (s=0; s<this->d_n_streams; s++)
+	{
+		const gr_complex *src = (const gr_complex *)data[s] + skip;
+		gr_complex *dst = &this->d_buf[s * this->d_len];
+
+		pos = this->d_wp;
+		n   = std::min(len, this->d_len - pos);
+
+		memcpy(&dst[pos], src, n * sizeof(gr_complex));
+		memcpy(&dst[0], src + n, (len - n) * sizeof(gr_complex));
+	}
+
+	this->d_wp   = (this->d_wp + len) % this->d_len;
+	this->d_fill = std::min(this->d_fill + len, this->d_len);
+}
+
+void
+iq_ring::read(void * const *data, size_t back, size_t len) const
+{
+	size_t pos, n;
+	int s;
+
+	/* 'len' samples, the last one being 'back' before the newest. The
+	 * caller keeps back + len within fill() */
+	pos = (this->d_wp + 2 * this->d_len - back - len) % this->d_len;
+	n   = std::min(len, this->d_len - pos);
+
+	for (s=0; s<this->d_n_streams; s++)
+	{
+		const gr_complex *src = &this->d_buf[s * this->d_len];
+		gr_complex *dst = (gr_complex *)data[s];
+
+		memcpy(dst, &src[pos], n * sizeof(gr_complex));
+		memcpy(dst + n, &src[0], (len - n) * sizeof(gr_complex));
+	}
+}
+
+  } /* namespace fosphor */
+} /* namespace gr */
@@ -0,0 +1,48 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2013-2021 Sylvain Munaut <tnt@246tNt.com>
+ *
+ * This file is part of gr-fosphor
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gnuradio/fosphor/api.h>
+
+#include <gnuradio/gr_complex.h>
+
+#include <cstddef>
+
+namespace gr {
+  namespace fosphor {
+
+   /* Last 'length' samples of each stream, all streams in lock step.
+    * Single threaded, it's only touched by the render thread */
+   class GR_FOSPHOR_API iq_ring
+   {
+    private:
+     gr_complex *d_buf;
+     size_t d_map_len;	/* Size of the mapping, 0 if allocated with new */
+     bool d_hugepages;
+     int d_n_streams;
+     size_t d_len;	/* Per stream */
+     size_t d_wp;
+     size_t d_fill;
+
+    public:
+     iq_ring(int n_streams, size_t length, bool hugepages=false);
+     ~iq_ring();
+
+     size_t length() const { return this->d_len; }
+     size_t fill() const { return this->d_fill; }
+     bool hugepages() const { return this->d_hugepages; }
+
+     void clear();
+     void write(void * const *data, size_t len);
+     void read(void * const *data, size_t back, size_t len) const;
+   };
+
+  } // namespace fosphor
+} // namespace gr
@@ -28,13 +28,14 @@ namespace gr {
   namespace fosphor {
 
 qt_sink_c::sptr
-qt_sink_c::make(QWidget *parent)
+qt_sink_c::make(QWidget *parent, int n_inputs, bool real_input)
 {
-	return gnuradio::get_initial_sptr(new qt_sink_c_impl(parent));
+	return gnuradio::get_initial_sptr(new qt_sink_c_impl(parent, n_inputs, real_input));
 }
 
-qt_sink_c_impl::qt_sink_c_impl(QWidget *parent)
-  : base_sink_c("qt_sink_c")
+qt_sink_c_impl::qt_sink_c_impl(QWidget *parent, int n_inputs, bool real_input)
+  : base_sink_c("qt_sink_c", n_inputs, real_input),
+    base_sink_c_impl(n_inputs, real_input)
 {
 	/* QT stuff */
 	if(qApp != NULL) {
@@ -81,6 +82,12 @@ qt_sink_c_impl::glctx_update()
 	this->d_gui->makeCurrent();
 }
 
+void
+qt_sink_c_impl::glctx_swap_interval(int interval)
+{
+	/* Qt only allows it when creating the context */
+}
+
 
 void
 qt_sink_c_impl::exec_()
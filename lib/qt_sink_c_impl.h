@@ -36,9 +36,10 @@ namespace gr {
       void glctx_poll();
       void glctx_fini();
       void glctx_update();
+      void glctx_swap_interval(int interval);
 
      public:
-      qt_sink_c_impl(QWidget *parent=NULL);
+      qt_sink_c_impl(QWidget *parent=NULL, int n_inputs=1, bool real_input=false);
 
       void exec_();
       QWidget* qwidget();
@@ -40,14 +40,24 @@ void bind_base_sink_c(py::module& m)
 	.value("RATIO_UP",         base_sink_c::RATIO_UP)
 	.value("RATIO_DOWN",       base_sink_c::RATIO_DOWN)
 	.value("FREEZE_TOGGLE",    base_sink_c::FREEZE_TOGGLE)
+	.value("AUTO_RANGE_TOGGLE", base_sink_c::AUTO_RANGE_TOGGLE)
+	.value("TIME_BACK",        base_sink_c::TIME_BACK)
+	.value("TIME_FORWARD",     base_sink_c::TIME_FORWARD)
         .export_values();
 
 	py::enum_<base_sink_c::mouse_action_t>(sink_class, "mouse_action")
 	.value("CLICK",           base_sink_c::CLICK)
         .export_values();
 
+	py::enum_<base_sink_c::hidden_mode_t>(sink_class, "hidden_mode")
+	.value("HIDDEN_DISCARD",  base_sink_c::HIDDEN_DISCARD)
+	.value("HIDDEN_DECIMATE", base_sink_c::HIDDEN_DECIMATE)
+	.value("HIDDEN_FULL",     base_sink_c::HIDDEN_FULL)
+        .export_values();
+
 	py::implicitly_convertible<int, base_sink_c::ui_action_t>();
 	py::implicitly_convertible<int, base_sink_c::mouse_action_t>();
+	py::implicitly_convertible<int, base_sink_c::hidden_mode_t>();
 
 	sink_class
 		.def("execute_ui_action",
@@ -89,5 +99,151 @@ void bind_base_sink_c(py::module& m)
 			D(base_sink_c,set_fft_window)
 		)
 
+		.def("set_filter_bank",
+			&base_sink_c::set_filter_bank,
+			py::arg("taps_per_bin"),
+			D(base_sink_c,set_filter_bank)
+		)
+
+		.def("set_frame_rate",
+			&base_sink_c::set_frame_rate,
+			py::arg("max_fps"),
+			D(base_sink_c,set_frame_rate)
+		)
+
+		.def("set_swap_interval",
+			&base_sink_c::set_swap_interval,
+			py::arg("interval"),
+			D(base_sink_c,set_swap_interval)
+		)
+
+		.def("set_auto_range",
+			&base_sink_c::set_auto_range,
+			py::arg("enable"),
+			D(base_sink_c,set_auto_range)
+		)
+
+		.def("set_peak_detection",
+			&base_sink_c::set_peak_detection,
+			py::arg("enable"),
+			py::arg("threshold_db") = 10.0f,
+			py::arg("rate") = 10.0f,
+			py::arg("max_peaks") = 16,
+			D(base_sink_c,set_peak_detection)
+		)
+
+		.def("set_band_power",
+			&base_sink_c::set_band_power,
+			py::arg("freqs"),
+			py::arg("bandwidths"),
+			py::arg("duty_threshold_db") = -60.0f,
+			py::arg("rate") = 10.0f,
+			D(base_sink_c,set_band_power)
+		)
+
+		.def("set_occupancy",
+			&base_sink_c::set_occupancy,
+			py::arg("enable"),
+			py::arg("threshold_db") = -60.0f,
+			py::arg("window") = 60.0f,
+			py::arg("rate") = 1.0f,
+			py::arg("draw") = true,
+			D(base_sink_c,set_occupancy)
+		)
+
+		.def("set_spectral_kurtosis",
+			&base_sink_c::set_spectral_kurtosis,
+			py::arg("enable"),
+			py::arg("rate") = 1.0f,
+			py::arg("draw") = true,
+			py::arg("waterfall") = false,
+			D(base_sink_c,set_spectral_kurtosis)
+		)
+
+		.def("set_cross_spectrum",
+			&base_sink_c::set_cross_spectrum,
+			py::arg("enable"),
+			py::arg("alpha") = 0.0f,
+			py::arg("rate") = 1.0f,
+			py::arg("draw") = true,
+			D(base_sink_c,set_cross_spectrum)
+		)
+
+		.def("set_spectrum_mask",
+			&base_sink_c::set_spectrum_mask,
+			py::arg("freqs"),
+			py::arg("levels_db"),
+			D(base_sink_c,set_spectrum_mask)
+		)
+
+		.def("set_noise_floor",
+			&base_sink_c::set_noise_floor,
+			py::arg("enable"),
+			py::arg("percentile") = 0.1f,
+			py::arg("interval") = 1.0f,
+			py::arg("draw") = true,
+			D(base_sink_c,set_noise_floor)
+		)
+
+		.def("set_hidden_mode",
+			&base_sink_c::set_hidden_mode,
+			py::arg("mode"),
+			py::arg("decimation") = 8,
+			D(base_sink_c,set_hidden_mode)
+		)
+
+		.def("set_shm_output",
+			&base_sink_c::set_shm_output,
+			py::arg("name"),
+			D(base_sink_c,set_shm_output)
+		)
+
+		.def("set_net_output",
+			&base_sink_c::set_net_output,
+			py::arg("endpoint"),
+			py::arg("bits") = 8,
+			py::arg("histogram") = false,
+			D(base_sink_c,set_net_output)
+		)
+
+		.def("set_rec_output",
+			&base_sink_c::set_rec_output,
+			py::arg("path"),
+			py::arg("bits") = 8,
+			py::arg("db_min") = -120.0f,
+			py::arg("db_max") = 0.0f,
+			D(base_sink_c,set_rec_output)
+		)
+
+		.def("set_rollup_output",
+			&base_sink_c::set_rollup_output,
+			py::arg("path"),
+			D(base_sink_c,set_rollup_output)
+		)
+
+		.def("set_time_machine",
+			&base_sink_c::set_time_machine,
+			py::arg("length"),
+			py::arg("hugepages") = false,
+			D(base_sink_c,set_time_machine)
+		)
+
+		.def("time_machine_seek",
+			&base_sink_c::time_machine_seek,
+			py::arg("seconds"),
+			D(base_sink_c,time_machine_seek)
+		)
+
+		.def("set_trigger_capture",
+			&base_sink_c::set_trigger_capture,
+			py::arg("path"),
+			py::arg("pre") = 0.1f,
+			py::arg("post") = 0.1f,
+			py::arg("band") = true,
+			py::arg("band_threshold_db") = -40.0f,
+			py::arg("new_peaks") = false,
+			D(base_sink_c,set_trigger_capture)
+		)
+
 		;
 }
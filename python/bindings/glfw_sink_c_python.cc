@@ -28,6 +28,8 @@ void bind_glfw_sink_c(py::module& m)
 		std::shared_ptr<glfw_sink_c>>(m, "glfw_sink_c", D(glfw_sink_c))
 
 		.def(py::init(&glfw_sink_c::make),
+			py::arg("n_inputs") = 1,
+			py::arg("real_input") = false,
 			D(glfw_sink_c,make)
 		)
 
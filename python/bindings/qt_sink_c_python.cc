@@ -31,6 +31,8 @@ void bind_qt_sink_c(py::module& m)
 
 		.def(py::init(&qt_sink_c::make),
 			py::arg("parent") = nullptr,
+			py::arg("n_inputs") = 1,
+			py::arg("real_input") = false,
 			D(qt_sink_c,make)
 		)
 